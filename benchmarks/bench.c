@@ -0,0 +1,53 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include "bench.h"
+#include "hardware/clocks.h"
+
+#define BENCH_FORMAT_VERSION 1
+// Keep each chunk well inside the 2^24 cycle SysTick period, even for
+// operations of a few thousand cycles
+#define CHUNK_ITERATIONS 1000
+
+void bench_cycle_counter_init(void) {
+    systick_hw->rvr = 0x00ffffff;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+}
+
+void bench_init(void) {
+    bench_cycle_counter_init();
+    printf("BENCH_START %d %lu\n", BENCH_FORMAT_VERSION, clock_get_hz(clk_sys));
+}
+
+void bench_run(const char *name, bench_func_t func, uint32_t iterations) {
+    // Warm up the flash cache and anything else the first run would pay for
+    func(CHUNK_ITERATIONS < iterations ? CHUNK_ITERATIONS : iterations);
+
+    uint64_t cycles = 0;
+    uint64_t start_us = time_us_64();
+    for (uint32_t done = 0; done < iterations;) {
+        uint32_t n = iterations - done < CHUNK_ITERATIONS ? iterations - done : CHUNK_ITERATIONS;
+        uint32_t start = bench_cycle_count();
+        func(n);
+        cycles += (start - bench_cycle_count()) & 0x00ffffff;
+        done += n;
+    }
+    uint64_t us = time_us_64() - start_us;
+
+    printf("BENCH %s %lu %.2f %.1f\n", name, iterations, (double)cycles / iterations,
+           us * 1000.0 / iterations);
+}
+
+void bench_done(void) {
+    printf("BENCH_END\n");
+}
+
+void bench_timestamp_init(void) {
+    pwm_config config = pwm_get_default_config();
+    pwm_init(BENCH_TIMESTAMP_PWM_SLICE, &config, true);
+}
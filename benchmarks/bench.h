@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include "pico/stdlib.h"
+#include "hardware/pwm.h"
+#include "hardware/structs/systick.h"
+
+// PWM slice bench_timestamp() counts on. Its output isn't connected to any
+// GPIO, but the slice can't be used for anything else.
+#ifndef BENCH_TIMESTAMP_PWM_SLICE
+#define BENCH_TIMESTAMP_PWM_SLICE 0
+#endif
+
+// A benchmark runs `iterations` operations in a loop of its own, so the
+// harness's call overhead is spread over many of them
+typedef void (*bench_func_t)(uint32_t iterations);
+
+// Start the SysTick cycle counter and print the results header
+void bench_init(void);
+
+// Start SysTick counting down at the system clock rate, wrapping after 2^24
+// cycles, for benchmarks that time themselves with bench_cycle_count()
+void bench_cycle_counter_init(void);
+
+// SysTick's current value. It counts down, so code that takes fewer than
+// 2^24 cycles took (start - end) & 0x00ffffff.
+static inline uint32_t bench_cycle_count(void) {
+    return systick_hw->cvr;
+}
+
+// Time `iterations` operations of `func`, in chunks short enough for the
+// 24-bit SysTick counter not to wrap more than once, and print a result
+// line:
+//
+//   BENCH <name> <iterations> <cycles per op> <ns per op>
+//
+// Names must not contain spaces.
+void bench_run(const char *name, bench_func_t func, uint32_t iterations);
+
+// Print the results trailer
+void bench_done(void);
+
+// Start a free-running 16-bit counter clocked at the system clock rate, for
+// timing things that happen on the other core or in DMA, which SysTick (one
+// per core) can't see
+void bench_timestamp_init(void);
+
+// The counter, which wraps every 65536 cycles; take differences as uint16_t
+static inline uint16_t bench_timestamp(void) {
+    return pwm_get_counter(BENCH_TIMESTAMP_PWM_SLICE);
+}
+
+// Address of the counter, for DMA to copy
+static inline const volatile void *bench_timestamp_addr(void) {
+    return &pwm_hw->slice[BENCH_TIMESTAMP_PWM_SLICE].ctr;
+}
+
+#endif
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+
+# Collects the results printed by the sdk_benchmarks program and compares
+# them with a saved baseline.
+#
+# usage: python3 run_benchmarks.py [--port /dev/ttyACM0 | --input results.txt]
+#                                  [--baseline baseline.json] [--save-baseline]
+#                                  [--threshold PERCENT]
+#
+# With --port, the results are read straight from the board's serial port
+# (this needs pyserial); reset the board after starting the script. With
+# --input, they are read from a saved copy of its output ("-" for stdin).
+#
+# --save-baseline stores the results as the new baseline. Otherwise each
+# result's cycles per operation is compared with the baseline, and the
+# script exits with status 1 if any got slower by more than the threshold.
+#
+# No baseline comes with the examples, as the figures depend on the board,
+# the SDK version and the compiler. The first run with --save-baseline
+# creates baseline.json next to this script; commit it alongside your own
+# changes if you want later runs compared with it.
+
+import argparse
+import json
+import os
+import sys
+
+FORMAT_VERSION = 1
+
+
+def read_lines(args):
+    if args.port:
+        try:
+            import serial
+        except ImportError:
+            sys.exit("Reading from a serial port needs pyserial: pip install pyserial")
+        with serial.Serial(args.port, 115200, timeout=args.timeout) as port:
+            while True:
+                line = port.readline()
+                if not line:
+                    sys.exit("Timed out waiting for results")
+                yield line.decode("ascii", "replace")
+    elif args.input == "-":
+        yield from sys.stdin
+    else:
+        with open(args.input) as f:
+            yield from f
+
+
+def parse_results(lines):
+    """Return (system clock Hz, {name: (cycles per op, ns per op)}) from a run's output."""
+    sys_clock_hz = None
+    results = {}
+    for line in lines:
+        fields = line.split()
+        if not fields:
+            continue
+        if fields[0] == "BENCH_START":
+            if int(fields[1]) != FORMAT_VERSION:
+                sys.exit(f"Unsupported results format version {fields[1]}")
+            sys_clock_hz = int(fields[2])
+            results = {}
+        elif fields[0] == "BENCH" and sys_clock_hz is not None:
+            name, _iterations, cycles, ns = fields[1:5]
+            results[name] = (float(cycles), float(ns))
+        elif fields[0] == "BENCH_END" and sys_clock_hz is not None:
+            return sys_clock_hz, results
+    sys.exit("Didn't find a complete set of results")
+
+
+def compare(baseline, sys_clock_hz, results, threshold):
+    if baseline["sys_clock_hz"] != sys_clock_hz:
+        print(f"Warning: the baseline was taken at {baseline['sys_clock_hz']} Hz, "
+              f"this run at {sys_clock_hz} Hz")
+    regressions = 0
+    print(f"{'benchmark':36} {'baseline':>10} {'now':>10} {'change':>8}")
+    for name, (cycles, _ns) in results.items():
+        if name not in baseline["results"]:
+            print(f"{name:36} {'-':>10} {cycles:10.2f} {'new':>8}")
+            continue
+        base = baseline["results"][name]["cycles"]
+        change = (cycles - base) / base * 100 if base else 0.0
+        flag = ""
+        if change > threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:36} {base:10.2f} {cycles:10.2f} {change:+7.1f}%{flag}")
+    for name in baseline["results"]:
+        if name not in results:
+            print(f"{name:36} missing from this run")
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Run and compare SDK microbenchmarks")
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="serial port the board's output appears on")
+    source.add_argument("--input", help="file holding the board's output, or - for stdin")
+    parser.add_argument("--timeout", type=float, default=60, help="serial read timeout in seconds")
+    parser.add_argument("--baseline", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "baseline.json"),
+                        help="baseline file (default: baseline.json next to this script)")
+    parser.add_argument("--save-baseline", action="store_true", help="save these results as the baseline")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="percentage slowdown to report as a regression")
+    args = parser.parse_args()
+
+    sys_clock_hz, results = parse_results(read_lines(args))
+
+    if args.save_baseline:
+        with open(args.baseline, "w") as f:
+            json.dump({"sys_clock_hz": sys_clock_hz,
+                       "results": {name: {"cycles": cycles, "ns": ns} for name, (cycles, ns) in results.items()}},
+                      f, indent=2)
+        print(f"Saved {len(results)} results to {args.baseline}")
+        return
+
+    try:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    except FileNotFoundError:
+        sys.exit(f"No baseline in {args.baseline}; save one with --save-baseline")
+
+    regressions = compare(baseline, sys_clock_hz, results, args.threshold)
+    if regressions:
+        print(f"{regressions} benchmark(s) slower than the baseline by more than {args.threshold}%")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Microbenchmarks for SDK primitives used throughout the examples. Each
+// result is printed as a machine-readable BENCH line; run_benchmarks.py
+// collects them and compares them with a saved baseline.
+//
+// The figures include the benchmark's own loop, which "empty_loop" measures
+// on its own.
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "pico/util/queue.h"
+#include "hardware/divider.h"
+#include "hardware/interp.h"
+#include "bench.h"
+#include "dma_memcpy.h"
+
+#define QUEUE_DEPTH 8
+#define QUEUE_ECHO_STOP 0xffffffffu
+#define COPY_BUF_LEN 4096
+
+static volatile uint32_t sink;
+static queue_t queue;
+static queue_t reply_queue;
+static uint8_t copy_src[COPY_BUF_LEN];
+static uint8_t copy_dst[COPY_BUF_LEN];
+
+static void empty_loop(uint32_t n) {
+    for (uint32_t i = 0; i < n; i++)
+        __compiler_memory_barrier();
+}
+
+// Synchronisation
+
+static void queue_add_remove(uint32_t n) {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        queue_add_blocking(&queue, &i);
+        queue_remove_blocking(&queue, &value);
+    }
+    sink = value;
+}
+
+static void queue_round_trip(uint32_t n) {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        queue_add_blocking(&queue, &i);
+        queue_remove_blocking(&reply_queue, &value);
+    }
+    sink = value;
+}
+
+static void fifo_round_trip(uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        multicore_fifo_push_blocking(i);
+        sink = multicore_fifo_pop_blocking();
+    }
+}
+
+static void core1_fifo_echo(void) {
+    while (true)
+        multicore_fifo_push_blocking(multicore_fifo_pop_blocking());
+}
+
+static void core1_queue_echo(void) {
+    uint32_t value;
+    do {
+        queue_remove_blocking(&queue, &value);
+        queue_add_blocking(&reply_queue, &value);
+    } while (value != QUEUE_ECHO_STOP);
+    // Park outside the queue's lock, so core 1 can be reset safely
+    while (true)
+        tight_loop_contents();
+}
+
+// Divider
+
+static void divider_divmod_s32(uint32_t n) {
+    int32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        divmod_result_t r = hw_divider_divmod_s32(0x12345678 - (int32_t)i, 7 + (int32_t)(i & 0xff));
+        acc += to_quotient_s32(r) + to_remainder_s32(r);
+    }
+    sink = acc;
+}
+
+static void divider_quotient_inlined(uint32_t n) {
+    int32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++)
+        acc += hw_divider_s32_quotient_inlined(0x12345678 - (int32_t)i, 7 + (int32_t)(i & 0xff));
+    sink = acc;
+}
+
+static void divide_operator(uint32_t n) {
+    // The SDK routes C division through the hardware divider
+    volatile int32_t divisor_base = 7;
+    int32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++)
+        acc += (0x12345678 - (int32_t)i) / (divisor_base + (int32_t)(i & 0xff));
+    sink = acc;
+}
+
+static void divider_save_restore(uint32_t n) {
+    hw_divider_state_t state;
+    for (uint32_t i = 0; i < n; i++) {
+        hw_divider_save_state(&state);
+        hw_divider_restore_state(&state);
+    }
+}
+
+// Interpolator
+
+static void interp_pop_lane0(uint32_t n) {
+    interp_config cfg = interp_default_config();
+    interp_set_config(interp0, 0, &cfg);
+    interp0->accum[0] = 0;
+    interp0->base[0] = 9;
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++)
+        acc += interp0->pop[0];
+    sink = acc;
+}
+
+static void soft_pop_lane0(uint32_t n) {
+    // What interp_pop_lane0 does, in software
+    volatile uint32_t accum = 0;
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t result = accum + 9;
+        accum = result;
+        acc += result;
+    }
+    sink = acc;
+}
+
+static void interp_blend(uint32_t n) {
+    interp_config cfg = interp_default_config();
+    interp_config_set_blend(&cfg, true);
+    interp_set_config(interp0, 0, &cfg);
+    cfg = interp_default_config();
+    interp_set_config(interp0, 1, &cfg);
+    interp0->base[0] = 500;
+    interp0->base[1] = 1000;
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        interp0->accum[1] = i & 0xff;
+        acc += interp0->peek[1];
+    }
+    sink = acc;
+}
+
+static void soft_blend(uint32_t n) {
+    volatile int32_t base0 = 500, base1 = 1000;
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t alpha = i & 0xff;
+        acc += base0 + (((base1 - base0) * (int32_t)alpha) >> 8);
+    }
+    sink = acc;
+}
+
+// Memory
+
+static void memcpy_256(uint32_t n) {
+    for (uint32_t i = 0; i < n; i++)
+        memcpy(copy_dst, copy_src, 256);
+}
+
+static void dma_memcpy_256(uint32_t n) {
+    for (uint32_t i = 0; i < n; i++)
+        dma_memcpy(copy_dst, copy_src, 256);
+}
+
+static void memcpy_4096(uint32_t n) {
+    for (uint32_t i = 0; i < n; i++)
+        memcpy(copy_dst, copy_src, COPY_BUF_LEN);
+}
+
+static void dma_memcpy_4096(uint32_t n) {
+    for (uint32_t i = 0; i < n; i++)
+        dma_memcpy(copy_dst, copy_src, COPY_BUF_LEN);
+}
+
+int main() {
+    stdio_init_all();
+    bench_init();
+
+    bench_run("empty_loop", empty_loop, 100000);
+
+    queue_init(&queue, sizeof(uint32_t), QUEUE_DEPTH);
+    queue_init(&reply_queue, sizeof(uint32_t), QUEUE_DEPTH);
+    bench_run("queue_add_remove", queue_add_remove, 20000);
+    multicore_launch_core1(core1_queue_echo);
+    bench_run("queue_round_trip_core1", queue_round_trip, 20000);
+    uint32_t stop = QUEUE_ECHO_STOP;
+    queue_add_blocking(&queue, &stop);
+    queue_remove_blocking(&reply_queue, &stop);
+    multicore_reset_core1();
+    multicore_launch_core1(core1_fifo_echo);
+    bench_run("fifo_round_trip_core1", fifo_round_trip, 20000);
+    multicore_reset_core1();
+
+    bench_run("hw_divider_divmod_s32", divider_divmod_s32, 100000);
+    bench_run("hw_divider_s32_quotient_inlined", divider_quotient_inlined, 100000);
+    bench_run("divide_operator_s32", divide_operator, 100000);
+    bench_run("hw_divider_save_restore", divider_save_restore, 100000);
+
+    bench_run("interp_pop_lane0", interp_pop_lane0, 100000);
+    bench_run("soft_pop_lane0", soft_pop_lane0, 100000);
+    bench_run("interp_blend", interp_blend, 100000);
+    bench_run("soft_blend", soft_blend, 100000);
+
+    dma_memcpy_init(1, 0);
+    bench_run("memcpy_256", memcpy_256, 10000);
+    bench_run("dma_memcpy_256", dma_memcpy_256, 10000);
+    bench_run("memcpy_4096", memcpy_4096, 2000);
+    bench_run("dma_memcpy_4096", dma_memcpy_4096, 2000);
+
+    bench_done();
+}
@@ -0,0 +1,192 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdlib.h>
+#include "fixed_math.h"
+#if PICO_ON_DEVICE
+#include "hardware/divider.h"
+#endif
+
+// 2^32 / (2 * pi), to turn radians into binary angles
+#define RADIANS_TO_ANGLE 683565276u
+
+// Constants for atan(z) ~= (pi / 4) z + z (1 - z) (C1 + C2 z), for z in [0, 1]
+#define ATAN_PI_4 51472u
+#define ATAN_C1 16037u
+#define ATAN_C2 4345u
+
+// sin() over a quarter turn in Q1.15, with one extra entry for interpolating
+// up to the end
+static const int16_t sin_table[257] = {
+        0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809, 2009, 2210,
+        2410, 2611, 2811, 3012, 3212, 3412, 3612, 3811, 4011, 4210, 4410, 4609,
+        4808, 5007, 5205, 5404, 5602, 5800, 5998, 6195, 6393, 6590, 6786, 6983,
+        7179, 7375, 7571, 7767, 7962, 8157, 8351, 8545, 8739, 8933, 9126, 9319,
+        9512, 9704, 9896, 10087, 10278, 10469, 10659, 10849, 11039, 11228, 11417, 11605,
+        11793, 11980, 12167, 12353, 12539, 12725, 12910, 13094, 13279, 13462, 13645, 13828,
+        14010, 14191, 14372, 14553, 14732, 14912, 15090, 15269, 15446, 15623, 15800, 15976,
+        16151, 16325, 16499, 16673, 16846, 17018, 17189, 17360, 17530, 17700, 17869, 18037,
+        18204, 18371, 18537, 18703, 18868, 19032, 19195, 19357, 19519, 19680, 19841, 20000,
+        20159, 20317, 20475, 20631, 20787, 20942, 21096, 21250, 21403, 21554, 21705, 21856,
+        22005, 22154, 22301, 22448, 22594, 22739, 22884, 23027, 23170, 23311, 23452, 23592,
+        23731, 23870, 24007, 24143, 24279, 24413, 24547, 24680, 24811, 24942, 25072, 25201,
+        25329, 25456, 25582, 25708, 25832, 25955, 26077, 26198, 26319, 26438, 26556, 26674,
+        26790, 26905, 27019, 27133, 27245, 27356, 27466, 27575, 27683, 27790, 27896, 28001,
+        28105, 28208, 28310, 28411, 28510, 28609, 28706, 28803, 28898, 28992, 29085, 29177,
+        29268, 29358, 29447, 29534, 29621, 29706, 29791, 29874, 29956, 30037, 30117, 30195,
+        30273, 30349, 30424, 30498, 30571, 30643, 30714, 30783, 30852, 30919, 30985, 31050,
+        31113, 31176, 31237, 31297, 31356, 31414, 31470, 31526, 31580, 31633, 31685, 31736,
+        31785, 31833, 31880, 31926, 31971, 32014, 32057, 32098, 32137, 32176, 32213, 32250,
+        32285, 32318, 32351, 32382, 32412, 32441, 32469, 32495, 32521, 32545, 32567, 32589,
+        32609, 32628, 32646, 32663, 32678, 32692, 32705, 32717, 32728, 32737, 32745, 32752,
+        32757, 32761, 32765, 32766, 32767,
+};
+
+// Unsigned divide, returning the quotient and setting *rem to the remainder
+static inline uint32_t udivmod(uint32_t a, uint32_t b, uint32_t *rem) {
+#if PICO_ON_DEVICE
+    divmod_result_t result;
+    if (__get_current_exception()) {
+        // The code we interrupted may be part way through a divide of its own
+        hw_divider_state_t state;
+        hw_divider_save_state(&state);
+        hw_divider_divmod_u32_start(a, b);
+        result = hw_divider_result_wait();
+        hw_divider_restore_state(&state);
+    } else {
+        hw_divider_divmod_u32_start(a, b);
+        result = hw_divider_result_wait();
+    }
+    *rem = to_remainder_u32(result);
+    return to_quotient_u32(result);
+#else
+    *rem = a % b;
+    return a / b;
+#endif
+}
+
+static inline uint32_t uabs(int32_t x) {
+    return x < 0 ? -(uint32_t)x : (uint32_t)x;
+}
+
+fix16_t fix16_mul(fix16_t a, fix16_t b) {
+    int64_t product = ((int64_t)a * b + 0x8000) >> 16;
+    if (product > FIX16_MAX)
+        return FIX16_MAX;
+    if (product < FIX16_MIN)
+        return FIX16_MIN;
+    return (fix16_t)product;
+}
+
+// |a| / |b| in Q16.16, saturated
+static uint32_t udiv_q16(uint32_t a, uint32_t b) {
+    uint32_t r;
+    uint32_t q = udivmod(a, b, &r);
+    if (q > 0x7fff)
+        return 0x80000000u;
+    uint32_t frac;
+    if (b <= 0xffff) {
+        // r < b, so r << 16 still fits
+        frac = udivmod(r << 16, b, &r);
+    } else {
+        frac = (uint32_t)(((uint64_t)r << 16) / b);
+    }
+    return (q << 16) | frac;
+}
+
+fix16_t fix16_div(fix16_t a, fix16_t b) {
+    bool negative = (a < 0) != (b < 0);
+    if (!b)
+        return a < 0 ? FIX16_MIN : FIX16_MAX;
+    uint32_t result = udiv_q16(uabs(a), uabs(b));
+    if (negative)
+        return result >= 0x80000000u ? FIX16_MIN : -(fix16_t)result;
+    return result >= 0x80000000u ? FIX16_MAX : (fix16_t)result;
+}
+
+fix16_t fix16_sqrt(fix16_t x) {
+    if (x <= 0)
+        return 0;
+    // Newton's method, starting from a power of two no smaller than the
+    // root, so it closes in from above
+    uint bits = 32 - __builtin_clz(x);
+    fix16_t root = 1 << ((bits + 17) / 2);
+    while (true) {
+        fix16_t next = (root + fix16_div(x, root)) >> 1;
+        if (next >= root)
+            return root;
+        root = next;
+    }
+}
+
+fix16_t fix16_atan2(fix16_t y, fix16_t x) {
+    if (!x && !y)
+        return 0;
+    uint32_t ax = uabs(x);
+    uint32_t ay = uabs(y);
+    bool steep = ay > ax;
+    uint32_t num = steep ? ax : ay;
+    uint32_t den = steep ? ay : ax;
+    // Scale down so that num << 16 fits; num <= den, so z is in [0, 1]
+    if (den > 0xffff) {
+        uint shift = 16 - __builtin_clz(den);
+        num >>= shift;
+        den >>= shift;
+    }
+    uint32_t r;
+    uint32_t z = udivmod(num << 16, den, &r);
+
+    uint32_t angle = (ATAN_PI_4 * z >> 16) + ((z * (FIX16_ONE - z) >> 16) * (ATAN_C1 + (ATAN_C2 * z >> 16)) >> 16);
+    if (steep)
+        angle = FIX16_HALF_PI - angle;
+    if (x < 0)
+        angle = FIX16_PI - angle;
+    return y < 0 ? -(fix16_t)angle : (fix16_t)angle;
+}
+
+q15_t q15_sin(uint16_t angle) {
+    uint quadrant = angle >> 14;
+    uint32_t offset = angle & 0x3fff;
+    if (quadrant & 1)
+        offset = 0x4000 - offset;
+    uint i = offset >> 6;
+    int32_t value = sin_table[i];
+    uint frac = offset & 0x3f;
+    if (frac)
+        value += ((sin_table[i + 1] - value) * (int32_t)frac) >> 6;
+    return quadrant & 2 ? -value : value;
+}
+
+q15_t q15_cos(uint16_t angle) {
+    return q15_sin(angle + 0x4000);
+}
+
+static uint16_t radians_to_angle(fix16_t radians) {
+    // radians / (2 pi) turns, in 16.16, is the binary angle in its bottom
+    // 16 bits
+    return (uint16_t)(((int64_t)radians * RADIANS_TO_ANGLE) >> 32);
+}
+
+fix16_t fix16_sin(fix16_t radians) {
+    return (fix16_t)q15_sin(radians_to_angle(radians)) * 2;
+}
+
+fix16_t fix16_cos(fix16_t radians) {
+    return (fix16_t)q15_cos(radians_to_angle(radians)) * 2;
+}
+
+q15_t q15_div(q15_t a, q15_t b) {
+    uint32_t ua = uabs(a);
+    uint32_t ub = uabs(b);
+    bool negative = (a < 0) != (b < 0);
+    if (ua >= ub) {
+        // Out of range, apart from exactly -1
+        return negative ? Q15_MIN : Q15_MAX;
+    }
+    uint32_t r;
+    uint32_t q = udivmod(ua << 15, ub, &r);
+    return negative ? -(q15_t)q : (q15_t)q;
+}
@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _FIXED_MATH_H
+#define _FIXED_MATH_H
+
+#include "pico/stdlib.h"
+
+// Fixed-point maths using the SIO hardware divider.
+//
+// fix16_t is Q16.16: 16 integer bits (including the sign) and 16 fraction
+// bits. q15_t is Q1.15, for values from -1 up to just under 1. Angles passed
+// to q15_sin() and q15_cos() are binary angles, where 65536 is a full turn;
+// the fix16_ trig functions use radians.
+//
+// Divides start the calling core's divider and wait for it directly, rather
+// than going through the SDK's interrupt-safe division routines. In an
+// interrupt handler, the divider state of whatever was interrupted is saved
+// and restored around each divide, so the library can be used from
+// interrupts and from thread code at the same time. On the host the
+// portable C operators are used instead.
+//
+// Results that don't fit are saturated to FIX16_MAX/FIX16_MIN or
+// Q15_MAX/Q15_MIN.
+
+typedef int32_t fix16_t;
+typedef int16_t q15_t;
+
+#define FIX16_ONE 0x00010000
+#define FIX16_MAX INT32_MAX
+#define FIX16_MIN INT32_MIN
+#define FIX16_PI 205887
+#define FIX16_HALF_PI 102944
+
+#define Q15_MAX INT16_MAX
+#define Q15_MIN INT16_MIN
+
+#define fix16_from_int(x) ((fix16_t)((x) * FIX16_ONE))
+// For constants; the conversion is done by the compiler
+#define fix16_from_float(f) ((fix16_t)((f) * FIX16_ONE + ((f) >= 0 ? 0.5f : -0.5f)))
+#define fix16_to_float(x) ((float)(x) / FIX16_ONE)
+
+// a * b, rounded to nearest
+fix16_t fix16_mul(fix16_t a, fix16_t b);
+
+// a / b, rounded towards zero
+fix16_t fix16_div(fix16_t a, fix16_t b);
+
+// 1 / x
+static inline fix16_t fix16_recip(fix16_t x) {
+    return fix16_div(FIX16_ONE, x);
+}
+
+// Square root, rounded down; 0 for negative numbers
+fix16_t fix16_sqrt(fix16_t x);
+
+// Angle of (x, y) from the x axis in radians, between -pi and pi, to within
+// 0.002 radians
+fix16_t fix16_atan2(fix16_t y, fix16_t x);
+
+// sin and cos of an angle in radians
+fix16_t fix16_sin(fix16_t radians);
+fix16_t fix16_cos(fix16_t radians);
+
+// a * b, rounded down
+static inline q15_t q15_mul(q15_t a, q15_t b) {
+    int32_t product = ((int32_t)a * b) >> 15;
+    // Only -1 * -1 can overflow
+    return product > Q15_MAX ? Q15_MAX : (q15_t)product;
+}
+
+// a / b, rounded towards zero
+q15_t q15_div(q15_t a, q15_t b);
+
+// sin and cos of a binary angle (65536 per turn), from a quarter-wave table
+// with linear interpolation
+q15_t q15_sin(uint16_t angle);
+q15_t q15_cos(uint16_t angle);
+
+#endif
@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Accuracy checks for the fixed_math library against double precision, for
+// the host build (PICO_PLATFORM=host), where the portable C division stands
+// in for the hardware divider. divider_fixed_point runs the same operations
+// on the device.
+//
+// Exits with 0 if every check passes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "fixed_math.h"
+
+#define DIV_CASES 1000000
+#define ATAN2_CASES 200000
+// From fixed_math.h
+#define ATAN2_MAX_ERROR 0.002
+// Quarter-wave table with 256 steps and linear interpolation
+#define SIN_MAX_ERROR 0.0001
+
+static int failures;
+
+static void check(bool ok, const char *what, double worst) {
+    printf("%-13s %s, worst error %.7f\n", what, ok ? "ok" : "FAILED", worst);
+    if (!ok)
+        failures++;
+}
+
+static fix16_t saturate(int64_t x) {
+    return x > FIX16_MAX ? FIX16_MAX : x < FIX16_MIN ? FIX16_MIN : (fix16_t)x;
+}
+
+// Any 32-bit value; rand() only gives 31 bits
+static int32_t random32(void) {
+    return (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand());
+}
+
+static int32_t random_sign(int32_t x) {
+    return rand() & 1 ? x : -x;
+}
+
+static void check_div(void) {
+    // Rounded towards zero, so exactly what 64-bit integer division gives
+    bool ok = true;
+    double worst = 0;
+    for (int i = 0; i < DIV_CASES; i++) {
+        int32_t a = random32();
+        int32_t b = random_sign(rand() >> (rand() % 31));
+        if (!b)
+            continue;
+        fix16_t want = saturate((int64_t)a * FIX16_ONE / b);
+        fix16_t got = fix16_div(a, b);
+        if (got != want) {
+            if (ok)
+                printf("fix16_div(%ld, %ld) = %ld, want %ld\n", a, b, got, want);
+            ok = false;
+        }
+        if (want != FIX16_MAX && want != FIX16_MIN)
+            worst = MAX(worst, fabs(got / 65536.0 - (double)a / b));
+    }
+    check(ok && worst < 1 / 65536.0, "divide", worst);
+}
+
+static void check_mul(void) {
+    // Rounded to nearest
+    double worst = 0;
+    for (int i = 0; i < DIV_CASES; i++) {
+        fix16_t a = random_sign(rand() >> (rand() % 16));
+        fix16_t b = random_sign(rand() >> (rand() % 16));
+        double want = (double)a * b / 65536.0 / 65536.0;
+        if (fabs(want) < 32767)
+            worst = MAX(worst, fabs(fix16_mul(a, b) / 65536.0 - want));
+    }
+    check(worst <= 0.5 / 65536.0, "multiply", worst);
+}
+
+static void check_sqrt(void) {
+    // Rounded down
+    bool ok = fix16_sqrt(0) == 0 && fix16_sqrt(-FIX16_ONE) == 0;
+    double worst = 0;
+    for (int64_t x = 1; x <= FIX16_MAX; x += 1 + x / 1000) {
+        double want = sqrt(x / 65536.0);
+        double got = fix16_sqrt(x) / 65536.0;
+        if (got > want || want - got >= 1 / 65536.0) {
+            if (ok)
+                printf("fix16_sqrt(%ld) = %.6f, want %.6f\n", (int32_t)x, got, want);
+            ok = false;
+        }
+        worst = MAX(worst, want - got);
+    }
+    check(ok, "sqrt", worst);
+}
+
+static void check_atan2(void) {
+    double worst = 0;
+    for (int i = 0; i < ATAN2_CASES; i++) {
+        // Mostly around the origin, and some far out, where the inputs are
+        // scaled down before dividing
+        int32_t y = (rand() % 200001 - 100000) * (rand() & 3 ? 1 : 1000);
+        int32_t x = (rand() % 200001 - 100000) * (rand() & 3 ? 1 : 1000);
+        double error = fabs(fix16_atan2(y, x) / 65536.0 - atan2(y, x));
+        // -pi and pi are the same angle
+        if (error > M_PI)
+            error = 2 * M_PI - error;
+        worst = MAX(worst, error);
+    }
+    check(worst < ATAN2_MAX_ERROR, "atan2", worst);
+}
+
+static void check_sin_cos(void) {
+    double worst = 0;
+    for (uint32_t angle = 0; angle < 65536; angle++) {
+        double theta = angle * (2 * M_PI / 65536);
+        worst = MAX(worst, fabs(q15_sin(angle) / 32768.0 - sin(theta)));
+        worst = MAX(worst, fabs(q15_cos(angle) / 32768.0 - cos(theta)));
+    }
+    check(worst < SIN_MAX_ERROR, "q15 sin/cos", worst);
+
+    // The radian versions also round the angle to 1/65536 of a turn
+    worst = 0;
+    for (fix16_t radians = -20 * FIX16_ONE; radians < 20 * FIX16_ONE; radians += 97) {
+        worst = MAX(worst, fabs(fix16_sin(radians) / 65536.0 - sin(radians / 65536.0)));
+        worst = MAX(worst, fabs(fix16_cos(radians) / 65536.0 - cos(radians / 65536.0)));
+    }
+    check(worst < SIN_MAX_ERROR + 2 * M_PI / 65536, "fix16 sin/cos", worst);
+}
+
+int main() {
+    stdio_init_all();
+    srand(1);
+    check_div();
+    check_mul();
+    check_sqrt();
+    check_atan2();
+    check_sin_cos();
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
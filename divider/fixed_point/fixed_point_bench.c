@@ -0,0 +1,248 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Compare the fixed_math library with single-precision float (the SDK's
+// ROM-accelerated float routines and libm) for the operations the other
+// examples use: division, square roots, atan2, the cosf()/sinf() rotation
+// matrix pio/st7789_lcd recalculates every frame, and the onboard
+// temperature sensor conversion from adc/onboard_temperature.
+//
+// Each operation is timed in system clock cycles over a table of random
+// inputs, and its largest error against double precision is reported.
+//
+// Finally a timer interrupt divides continuously while the main loop does
+// the same, to check that neither corrupts the other's divider results.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "bench.h"
+#include "fixed_math.h"
+
+#define N_INPUTS 256
+#define ISR_CHECK_MS 2000
+#define ISR_PERIOD_US 20
+
+static fix16_t fix_a[N_INPUTS];
+static fix16_t fix_b[N_INPUTS];
+static float float_a[N_INPUTS];
+static float float_b[N_INPUTS];
+// |a|, for square roots; the same values in both forms
+static fix16_t fix_abs_a[N_INPUTS];
+static float float_abs_a[N_INPUTS];
+static uint16_t angles[N_INPUTS];
+static uint16_t adc_raw[N_INPUTS];
+
+static volatile fix16_t fix_sink;
+static volatile float float_sink;
+
+// Each benchmark runs over all N_INPUTS inputs
+
+static void fix_div(void) {
+    for (int i = 0; i < N_INPUTS; i++)
+        fix_sink = fix16_div(fix_a[i], fix_b[i]);
+}
+
+static void float_div(void) {
+    for (int i = 0; i < N_INPUTS; i++)
+        float_sink = float_a[i] / float_b[i];
+}
+
+static void fix_sqrt(void) {
+    for (int i = 0; i < N_INPUTS; i++)
+        fix_sink = fix16_sqrt(fix_abs_a[i]);
+}
+
+static void float_sqrt(void) {
+    for (int i = 0; i < N_INPUTS; i++)
+        float_sink = sqrtf(float_abs_a[i]);
+}
+
+static void fix_atan2(void) {
+    for (int i = 0; i < N_INPUTS; i++)
+        fix_sink = fix16_atan2(fix_a[i], fix_b[i]);
+}
+
+static void float_atan2(void) {
+    for (int i = 0; i < N_INPUTS; i++)
+        float_sink = atan2f(float_a[i], float_b[i]);
+}
+
+// The rotation matrix from pio/st7789_lcd, in 16.16 fixed point, for one
+// frame per input
+static void fix_rotation(void) {
+    for (int i = 0; i < N_INPUTS; i++) {
+        fix16_t c = (fix16_t)q15_cos(angles[i]) * 2;
+        fix16_t s = (fix16_t)q15_sin(angles[i]) * 2;
+        int32_t rotate[4] = {c, -s, s, c};
+        fix_sink = rotate[0] + rotate[1] + rotate[2] + rotate[3];
+    }
+}
+
+static void float_rotation(void) {
+    for (int i = 0; i < N_INPUTS; i++) {
+        float theta = angles[i] * (2.f * (float)M_PI / 65536.f);
+        int32_t rotate[4] = {
+                cosf(theta) * (1 << 16), -sinf(theta) * (1 << 16),
+                sinf(theta) * (1 << 16), cosf(theta) * (1 << 16)
+        };
+        fix_sink = rotate[0] + rotate[1] + rotate[2] + rotate[3];
+    }
+}
+
+// Temperature in degrees C from a 12-bit ADC reading of the onboard sensor
+static inline fix16_t fix_temperature(uint16_t raw) {
+    fix16_t volts = (raw * fix16_from_float(3.3f)) >> 12;
+    return fix16_from_int(27) - fix16_div(volts - fix16_from_float(0.706f), fix16_from_float(0.001721f));
+}
+
+static inline float float_temperature(uint16_t raw) {
+    float volts = raw * (3.3f / (1 << 12));
+    return 27.0f - (volts - 0.706f) / 0.001721f;
+}
+
+static void fix_sensor(void) {
+    for (int i = 0; i < N_INPUTS; i++)
+        fix_sink = fix_temperature(adc_raw[i]);
+}
+
+static void float_sensor(void) {
+    for (int i = 0; i < N_INPUTS; i++)
+        float_sink = float_temperature(adc_raw[i]);
+}
+
+static uint32_t cycles_per_op(void (*bench)(void)) {
+    // Once to warm up the flash cache
+    bench();
+    uint32_t start = bench_cycle_count();
+    bench();
+    return ((start - bench_cycle_count()) & 0xffffff) / N_INPUTS;
+}
+
+static void print_comparison(const char *name, void (*fix_bench)(void), void (*float_bench)(void), double max_error) {
+    uint32_t fix_cycles = cycles_per_op(fix_bench);
+    uint32_t float_cycles = cycles_per_op(float_bench);
+    printf("%-22s %6lu  %6lu  %7.2f  %.6f\n", name, fix_cycles, float_cycles, (float)float_cycles / fix_cycles,
+           max_error);
+}
+
+static double fix_to_double(fix16_t x) {
+    return x / 65536.0;
+}
+
+static double max_error_div(void) {
+    double worst = 0;
+    for (int i = 0; i < N_INPUTS; i++) {
+        double want = fix_to_double(fix_a[i]) / fix_to_double(fix_b[i]);
+        if (fabs(want) < 32767)
+            worst = MAX(worst, fabs(fix_to_double(fix16_div(fix_a[i], fix_b[i])) - want));
+    }
+    return worst;
+}
+
+static double max_error_sqrt(void) {
+    double worst = 0;
+    for (int i = 0; i < N_INPUTS; i++) {
+        worst = MAX(worst, fabs(fix_to_double(fix16_sqrt(fix_abs_a[i])) - sqrt(float_abs_a[i])));
+    }
+    return worst;
+}
+
+static double max_error_atan2(void) {
+    double worst = 0;
+    for (int i = 0; i < N_INPUTS; i++) {
+        double want = atan2(fix_to_double(fix_a[i]), fix_to_double(fix_b[i]));
+        worst = MAX(worst, fabs(fix_to_double(fix16_atan2(fix_a[i], fix_b[i])) - want));
+    }
+    return worst;
+}
+
+static double max_error_rotation(void) {
+    double worst = 0;
+    for (int i = 0; i < N_INPUTS; i++) {
+        double theta = angles[i] * (2 * M_PI / 65536);
+        worst = MAX(worst, fabs(q15_sin(angles[i]) / 32768.0 - sin(theta)));
+        worst = MAX(worst, fabs(q15_cos(angles[i]) / 32768.0 - cos(theta)));
+    }
+    return worst;
+}
+
+static double max_error_sensor(void) {
+    double worst = 0;
+    for (int i = 0; i < N_INPUTS; i++) {
+        double want = 27 - (adc_raw[i] * 3.3 / 4096 - 0.706) / 0.001721;
+        worst = MAX(worst, fabs(fix_to_double(fix_temperature(adc_raw[i])) - want));
+    }
+    return worst;
+}
+
+// The ISR divides a fixed pair of numbers and checks the answer, while the
+// main loop checks its own divides against 64-bit integer division
+static volatile uint32_t isr_divides;
+static volatile uint32_t isr_errors;
+
+static bool divide_in_isr(repeating_timer_t *rt) {
+    if (fix16_div(fix16_from_int(-1000), fix16_from_int(7)) != -((1000 << 16) / 7))
+        isr_errors++;
+    isr_divides++;
+    return true;
+}
+
+static void check_isr_safety(void) {
+    repeating_timer_t timer;
+    add_repeating_timer_us(-ISR_PERIOD_US, divide_in_isr, NULL, &timer);
+
+    uint32_t divides = 0;
+    uint32_t errors = 0;
+    absolute_time_t end = make_timeout_time_ms(ISR_CHECK_MS);
+    while (!time_reached(end)) {
+        int32_t a = rand() - RAND_MAX / 2;
+        int32_t b = (rand() >> (rand() & 15)) + 1;
+        int64_t want = ((int64_t)a << 16) / b;
+        if (want > FIX16_MAX)
+            want = FIX16_MAX;
+        if (want < FIX16_MIN)
+            want = FIX16_MIN;
+        if (fix16_div(a, b) != want)
+            errors++;
+        divides++;
+    }
+    cancel_repeating_timer(&timer);
+
+    printf("\nDivides in the main loop %lu, errors %lu\n", divides, errors);
+    printf("Divides in the timer interrupt %lu, errors %lu\n", isr_divides, isr_errors);
+}
+
+int main() {
+    stdio_init_all();
+    printf("Fixed point maths with the hardware divider\n");
+    bench_cycle_counter_init();
+
+    for (int i = 0; i < N_INPUTS; i++) {
+        // Values between about -1000 and 1000, avoiding division by zero
+        fix_a[i] = (rand() % (2000 << 16)) - (1000 << 16);
+        fix_b[i] = (rand() % (2000 << 16)) - (1000 << 16);
+        if (!fix_b[i])
+            fix_b[i] = 1;
+        float_a[i] = fix16_to_float(fix_a[i]);
+        float_b[i] = fix16_to_float(fix_b[i]);
+        fix_abs_a[i] = fix_a[i] < 0 ? -fix_a[i] : fix_a[i];
+        float_abs_a[i] = fix16_to_float(fix_abs_a[i]);
+        angles[i] = rand();
+        adc_raw[i] = rand() & 0xfff;
+    }
+
+    printf("\noperation               fixed   float  speedup  max error\n");
+    print_comparison("divide", fix_div, float_div, max_error_div());
+    print_comparison("sqrt", fix_sqrt, float_sqrt, max_error_sqrt());
+    print_comparison("atan2", fix_atan2, float_atan2, max_error_atan2());
+    print_comparison("st7789 rotation", fix_rotation, float_rotation, max_error_rotation());
+    print_comparison("temperature sensor", fix_sensor, float_sensor, max_error_sensor());
+    printf("(cycles per operation; errors against double precision)\n");
+
+    check_isr_safety();
+}
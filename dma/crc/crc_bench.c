@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Check the dma_crc library against bit-at-a-time reference implementations,
+// for every CRC type, alignment and a range of lengths, then measure the
+// throughput of the software and DMA sniffer implementations in bytes per
+// system clock cycle.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "bench.h"
+#include "dma_crc.h"
+#include "crc_ref.h"
+
+#define BUF_LEN 4096
+#define CHECK_MAX_LEN 300
+#define BENCH_REPEATS 8
+
+static uint8_t buf[BUF_LEN + 4];
+
+static const char *type_names[] = {"CRC32", "CRC32R", "CRC16-CCITT", "SUM"};
+
+typedef uint32_t (*crc_func_t)(dma_crc_type_t, uint32_t, const void *, size_t);
+
+static uint32_t bench_cycles(crc_func_t func, dma_crc_type_t type, size_t len) {
+    uint32_t total = 0;
+    for (int i = 0; i < BENCH_REPEATS; i++) {
+        uint32_t start = bench_cycle_count();
+        func(type, 0, buf, len);
+        total += (start - bench_cycle_count()) & 0x00ffffff;
+    }
+    return total / BENCH_REPEATS;
+}
+
+int main() {
+    stdio_init_all();
+    printf("DMA sniffer CRC library check\n");
+
+    dma_crc_init();
+    bench_cycle_counter_init();
+
+    for (int i = 0; i < count_of(buf); i++)
+        buf[i] = rand();
+
+    // Standard check values for "123456789"
+    const uint8_t check[] = "123456789";
+    printf("CRC-32 (zlib)          0x%08lx (expect 0xcbf43926)\n",
+           ~dma_crc_calculate(DMA_CRC_TYPE_CRC32R, ~0u, check, 9));
+    printf("CRC-32/MPEG-2          0x%08lx (expect 0x0376e6e7)\n",
+           dma_crc_calculate(DMA_CRC_TYPE_CRC32, ~0u, check, 9));
+    printf("CRC-16/CCITT-FALSE     0x%04lx (expect 0x29b1)\n",
+           dma_crc_calculate(DMA_CRC_TYPE_CRC16_CCITT, 0xffff, check, 9));
+
+    // Every type at every alignment, checking both implementations (and so
+    // the DMA head/body/tail split) against the reference
+    uint failures = 0;
+    for (dma_crc_type_t type = DMA_CRC_TYPE_CRC32; type <= DMA_CRC_TYPE_SUM; type++) {
+        for (uint offset = 0; offset < 4; offset++) {
+            for (size_t len = 0; len <= BUF_LEN; len = len < CHECK_MAX_LEN ? len + 1 : len * 2) {
+                uint32_t seed = rand();
+                if (type == DMA_CRC_TYPE_CRC16_CCITT)
+                    seed &= 0xffff;
+                uint32_t expected = dma_crc_ref_calculate(type, seed, buf + offset, len);
+                uint32_t soft = dma_crc_calculate_soft(type, seed, buf + offset, len);
+                uint32_t dma = dma_crc_calculate_dma(type, seed, buf + offset, len);
+                if (soft != expected || dma != expected) {
+                    if (failures++ < 10) {
+                        printf("ERROR - %s offset %u len %u: expected 0x%08lx, soft 0x%08lx, dma 0x%08lx\n",
+                               type_names[type], offset, len, expected, soft, dma);
+                    }
+                }
+            }
+        }
+    }
+    if (failures)
+        printf("ERROR - %u CRC checks FAILED!\n", failures);
+    else
+        printf("All CRC checks are good\n");
+
+    // Throughput. With fewer than DMA_CRC_DMA_MIN_LEN bytes dma_crc_calculate()
+    // uses software; compare the soft and dma columns to tune that threshold.
+    printf("\nbytes/cycle     len   reference    soft         dma\n");
+    for (dma_crc_type_t type = DMA_CRC_TYPE_CRC32; type <= DMA_CRC_TYPE_SUM; type++) {
+        for (size_t len = 16; len <= BUF_LEN; len *= 4) {
+            uint32_t ref_cycles = bench_cycles(dma_crc_ref_calculate, type, len);
+            uint32_t soft_cycles = bench_cycles(dma_crc_calculate_soft, type, len);
+            uint32_t dma_cycles = bench_cycles(dma_crc_calculate_dma, type, len);
+            printf("%-12s %6u   %-12.3f %-12.3f %-12.3f\n", type_names[type], len,
+                   (float)len / ref_cycles, (float)len / soft_cycles, (float)len / dma_cycles);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "crc_ref.h"
+
+// ref_crc32r() is soft_crc32_block() from the sniff_crc example
+static uint32_t ref_crc32(uint32_t crc, const uint8_t *bytp, size_t length) {
+    while (length--) {
+        crc ^= (uint32_t)*bytp++ << 24;
+        for (uint8_t bit = 8; bit; bit--)
+            crc = (crc << 1) ^ ((crc & 0x80000000ul) ? 0x04C11DB7ul : 0ul);
+    }
+    return crc;
+}
+
+static uint32_t ref_crc32r(uint32_t crc, const uint8_t *bytp, size_t length) {
+    while (length--) {
+        uint32_t byte32 = (uint32_t)*bytp++;
+
+        for (uint8_t bit = 8; bit; bit--, byte32 >>= 1) {
+            crc = (crc >> 1) ^ (((crc ^ byte32) & 1ul) ? 0xEDB88320ul : 0ul);
+        }
+    }
+    return crc;
+}
+
+static uint32_t ref_crc16(uint32_t crc, const uint8_t *bytp, size_t length) {
+    crc &= 0xffff;
+    while (length--) {
+        crc ^= (uint32_t)*bytp++ << 8;
+        for (uint8_t bit = 8; bit; bit--)
+            crc = ((crc << 1) ^ ((crc & 0x8000ul) ? 0x1021ul : 0ul)) & 0xffff;
+    }
+    return crc;
+}
+
+static uint32_t ref_sum(uint32_t sum, const uint8_t *bytp, size_t length) {
+    while (length--)
+        sum += *bytp++;
+    return sum;
+}
+
+uint32_t dma_crc_ref_calculate(dma_crc_type_t type, uint32_t seed, const void *data, size_t len) {
+    switch (type) {
+        case DMA_CRC_TYPE_CRC32: return ref_crc32(seed, data, len);
+        case DMA_CRC_TYPE_CRC32R: return ref_crc32r(seed, data, len);
+        case DMA_CRC_TYPE_CRC16_CCITT: return ref_crc16(seed, data, len);
+        default: return ref_sum(seed, data, len);
+    }
+}
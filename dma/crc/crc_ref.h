@@ -0,0 +1,16 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _CRC_REF_H
+#define _CRC_REF_H
+
+#include "dma_crc.h"
+
+// Bit-at-a-time version of dma_crc_calculate(), for checking the table-driven
+// and DMA implementations against, and as the baseline in crc_bench
+uint32_t dma_crc_ref_calculate(dma_crc_type_t type, uint32_t seed, const void *data, size_t len);
+
+#endif
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Checks of dma_crc's table-driven software implementation against the
+// bit-at-a-time references in crc_ref.c, for the host build
+// (PICO_PLATFORM=host), where there is no DMA sniffer. dma_crc_bench checks
+// the sniffer on the device. It is built twice, as dma_crc_test and
+// dma_crc_test_slices8, to cover both values of DMA_CRC_SOFT_SLICES.
+//
+// For each CRC type and the checksum:
+//
+// - the standard check values for "123456789"
+// - every start alignment within a word pair, for every length up to
+//   CHECK_MAX_LEN and then doubling up to BUF_LEN, from a random seed
+// - a buffer split at every point into two calls, the first result seeding
+//   the second
+//
+// Exits with 0 if every check passes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "dma_crc.h"
+#include "crc_ref.h"
+
+#define BUF_LEN 4096
+#define CHECK_MAX_LEN 300
+#define SPLIT_LEN 64
+
+static uint8_t buf[BUF_LEN + 8];
+static int failures;
+
+static const char *type_names[] = {"CRC32", "CRC32R", "CRC16-CCITT", "SUM"};
+
+static void check_value(const char *name, uint32_t value, uint32_t expected) {
+    bool ok = value == expected;
+    printf("%-22s 0x%08x %s\n", name, (unsigned int)value, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+static void check_type(dma_crc_type_t type) {
+    uint errors = 0;
+    uint checks = 0;
+    for (uint offset = 0; offset < 8; offset++) {
+        for (size_t len = 0; len <= BUF_LEN; len = len < CHECK_MAX_LEN ? len + 1 : len * 2) {
+            uint32_t seed = rand();
+            if (type == DMA_CRC_TYPE_CRC16_CCITT)
+                seed &= 0xffff;
+            uint32_t expected = dma_crc_ref_calculate(type, seed, buf + offset, len);
+            uint32_t soft = dma_crc_calculate_soft(type, seed, buf + offset, len);
+            uint32_t any = dma_crc_calculate(type, seed, buf + offset, len);
+            checks++;
+            if (soft != expected || any != expected) {
+                if (errors++ < 5) {
+                    printf("%s offset %u len %u: expected 0x%08x, soft 0x%08x, dma_crc_calculate 0x%08x\n",
+                           type_names[type], offset, (uint)len, (unsigned int)expected, (unsigned int)soft,
+                           (unsigned int)any);
+                }
+            }
+        }
+    }
+
+    // Each split starts the second call at a different alignment
+    uint32_t whole = dma_crc_ref_calculate(type, 0, buf + 1, SPLIT_LEN);
+    for (uint split = 0; split <= SPLIT_LEN; split++) {
+        uint32_t crc = dma_crc_calculate_soft(type, 0, buf + 1, split);
+        crc = dma_crc_calculate_soft(type, crc, buf + 1 + split, SPLIT_LEN - split);
+        checks++;
+        if (crc != whole && errors++ < 5)
+            printf("%s split at %u: expected 0x%08x, got 0x%08x\n", type_names[type], split,
+                   (unsigned int)whole, (unsigned int)crc);
+    }
+
+    printf("%-12s slicing-by-%d %u checks %s\n", type_names[type], DMA_CRC_SOFT_SLICES, checks,
+           errors ? "FAILED" : "ok");
+    if (errors)
+        failures++;
+}
+
+int main() {
+    stdio_init_all();
+    dma_crc_init();
+    for (int i = 0; i < count_of(buf); i++)
+        buf[i] = rand();
+
+    const uint8_t check[] = "123456789";
+    check_value("CRC-32 (zlib)", ~dma_crc_calculate(DMA_CRC_TYPE_CRC32R, ~0u, check, 9), 0xcbf43926);
+    check_value("CRC-32/MPEG-2", dma_crc_calculate(DMA_CRC_TYPE_CRC32, ~0u, check, 9), 0x0376e6e7);
+    check_value("CRC-16/CCITT-FALSE", dma_crc_calculate(DMA_CRC_TYPE_CRC16_CCITT, 0xffff, check, 9), 0x29b1);
+    check_value("sum", dma_crc_calculate(DMA_CRC_TYPE_SUM, 0, check, 9), 477);
+
+    for (dma_crc_type_t type = DMA_CRC_TYPE_CRC32; type <= DMA_CRC_TYPE_SUM; type++)
+        check_type(type);
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,313 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "dma_crc.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/dma.h"
+#include "pico/bit_ops.h"
+#endif
+
+#if DMA_CRC_SOFT_SLICES != 4 && DMA_CRC_SOFT_SLICES != 8
+#error DMA_CRC_SOFT_SLICES must be 4 or 8
+#endif
+
+#define CRC32_POLY   0x04c11db7u
+#define CRC32R_POLY  0xedb88320u
+#define CRC16_POLY   0x1021u
+
+// Table k gives the effect on the CRC register of a byte followed by k zero
+// bytes, so several bytes can be folded into the register with one lookup
+// each. The tables live in RAM: reading them through the XIP cache would be
+// much slower than the calculation itself.
+static uint32_t crc32_table[DMA_CRC_SOFT_SLICES][256];
+static uint32_t crc32r_table[DMA_CRC_SOFT_SLICES][256];
+static uint16_t crc16_table[4][256];
+
+#if PICO_ON_DEVICE
+static int crc_dma_chan = -1;
+// Reprograms crc_dma_chan from a list of control blocks
+static int crc_ctrl_chan = -1;
+// The sniffer only looks at the data read by the channel, so every transfer
+// is written to the same dummy word
+static uint32_t crc_dma_dummy_dst;
+#endif
+
+void dma_crc_init(void) {
+    for (uint i = 0; i < 256; i++) {
+        uint32_t c = i << 24;
+        uint32_t r = i;
+        uint16_t s = i << 8;
+        for (uint bit = 0; bit < 8; bit++) {
+            c = (c << 1) ^ ((c & 0x80000000u) ? CRC32_POLY : 0);
+            r = (r >> 1) ^ ((r & 1u) ? CRC32R_POLY : 0);
+            s = (s << 1) ^ ((s & 0x8000u) ? CRC16_POLY : 0);
+        }
+        crc32_table[0][i] = c;
+        crc32r_table[0][i] = r;
+        crc16_table[0][i] = s;
+    }
+    for (uint k = 1; k < DMA_CRC_SOFT_SLICES; k++) {
+        for (uint i = 0; i < 256; i++) {
+            uint32_t c = crc32_table[k - 1][i];
+            uint32_t r = crc32r_table[k - 1][i];
+            crc32_table[k][i] = (c << 8) ^ crc32_table[0][c >> 24];
+            crc32r_table[k][i] = (r >> 8) ^ crc32r_table[0][r & 0xff];
+        }
+    }
+    for (uint k = 1; k < 4; k++) {
+        for (uint i = 0; i < 256; i++) {
+            uint16_t s = crc16_table[k - 1][i];
+            crc16_table[k][i] = (uint16_t)(s << 8) ^ crc16_table[0][s >> 8];
+        }
+    }
+
+#if PICO_ON_DEVICE
+    if (crc_dma_chan < 0) {
+        crc_dma_chan = dma_claim_unused_channel(true);
+        crc_ctrl_chan = dma_claim_unused_channel(true);
+    }
+#endif
+}
+
+// The software implementations consume single bytes until the pointer is word
+// aligned (the M0+ can't do unaligned loads), then a word or two at a time.
+
+static uint32_t crc32_soft(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len && ((uintptr_t)p & 3u)) {
+        crc = (crc << 8) ^ crc32_table[0][(crc >> 24) ^ *p++];
+        len--;
+    }
+#if DMA_CRC_SOFT_SLICES == 8
+    while (len >= 8) {
+        uint32_t a = crc ^ __builtin_bswap32(((const uint32_t *)p)[0]);
+        uint32_t b = __builtin_bswap32(((const uint32_t *)p)[1]);
+        crc = crc32_table[7][a >> 24] ^ crc32_table[6][(a >> 16) & 0xff] ^
+              crc32_table[5][(a >> 8) & 0xff] ^ crc32_table[4][a & 0xff] ^
+              crc32_table[3][b >> 24] ^ crc32_table[2][(b >> 16) & 0xff] ^
+              crc32_table[1][(b >> 8) & 0xff] ^ crc32_table[0][b & 0xff];
+        p += 8;
+        len -= 8;
+    }
+#endif
+    while (len >= 4) {
+        uint32_t a = crc ^ __builtin_bswap32(*(const uint32_t *)p);
+        crc = crc32_table[3][a >> 24] ^ crc32_table[2][(a >> 16) & 0xff] ^
+              crc32_table[1][(a >> 8) & 0xff] ^ crc32_table[0][a & 0xff];
+        p += 4;
+        len -= 4;
+    }
+    while (len--)
+        crc = (crc << 8) ^ crc32_table[0][(crc >> 24) ^ *p++];
+    return crc;
+}
+
+static uint32_t crc32r_soft(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len && ((uintptr_t)p & 3u)) {
+        crc = (crc >> 8) ^ crc32r_table[0][(crc ^ *p++) & 0xff];
+        len--;
+    }
+#if DMA_CRC_SOFT_SLICES == 8
+    while (len >= 8) {
+        uint32_t a = crc ^ ((const uint32_t *)p)[0];
+        uint32_t b = ((const uint32_t *)p)[1];
+        crc = crc32r_table[7][a & 0xff] ^ crc32r_table[6][(a >> 8) & 0xff] ^
+              crc32r_table[5][(a >> 16) & 0xff] ^ crc32r_table[4][a >> 24] ^
+              crc32r_table[3][b & 0xff] ^ crc32r_table[2][(b >> 8) & 0xff] ^
+              crc32r_table[1][(b >> 16) & 0xff] ^ crc32r_table[0][b >> 24];
+        p += 8;
+        len -= 8;
+    }
+#endif
+    while (len >= 4) {
+        uint32_t a = crc ^ *(const uint32_t *)p;
+        crc = crc32r_table[3][a & 0xff] ^ crc32r_table[2][(a >> 8) & 0xff] ^
+              crc32r_table[1][(a >> 16) & 0xff] ^ crc32r_table[0][a >> 24];
+        p += 4;
+        len -= 4;
+    }
+    while (len--)
+        crc = (crc >> 8) ^ crc32r_table[0][(crc ^ *p++) & 0xff];
+    return crc;
+}
+
+static uint32_t crc16_soft(uint32_t crc, const uint8_t *p, size_t len) {
+    crc &= 0xffff;
+    while (len && ((uintptr_t)p & 3u)) {
+        crc = ((crc << 8) & 0xffff) ^ crc16_table[0][(crc >> 8) ^ *p++];
+        len--;
+    }
+    // The 16-bit register lines up with the first two bytes of each word
+    while (len >= 4) {
+        uint32_t a = (crc << 16) ^ __builtin_bswap32(*(const uint32_t *)p);
+        crc = crc16_table[3][a >> 24] ^ crc16_table[2][(a >> 16) & 0xff] ^
+              crc16_table[1][(a >> 8) & 0xff] ^ crc16_table[0][a & 0xff];
+        p += 4;
+        len -= 4;
+    }
+    while (len--)
+        crc = ((crc << 8) & 0xffff) ^ crc16_table[0][(crc >> 8) ^ *p++];
+    return crc;
+}
+
+static uint32_t sum_soft(uint32_t sum, const uint8_t *p, size_t len) {
+    while (len--)
+        sum += *p++;
+    return sum;
+}
+
+uint32_t dma_crc_calculate_soft(dma_crc_type_t type, uint32_t seed, const void *data, size_t len) {
+    switch (type) {
+        case DMA_CRC_TYPE_CRC32:
+            return crc32_soft(seed, data, len);
+        case DMA_CRC_TYPE_CRC32R:
+            return crc32r_soft(seed, data, len);
+        case DMA_CRC_TYPE_CRC16_CCITT:
+            return crc16_soft(seed, data, len);
+        case DMA_CRC_TYPE_SUM:
+            return sum_soft(seed, data, len);
+    }
+    panic("unknown crc type %d", type);
+}
+
+#if PICO_ON_DEVICE
+
+// Set up the sniffer to calculate `type` on the data channel, starting from
+// the software register value `seed`. Result transforms are done in software
+// rather than with the sniffer's output options, so the accumulator can be
+// written and read back in the same form.
+static void crc_sniffer_start(dma_crc_type_t type, uint32_t seed, enum dma_channel_transfer_size size) {
+    uint calc;
+    switch (type) {
+        case DMA_CRC_TYPE_CRC32:
+            calc = DMA_SNIFF_CTRL_CALC_VALUE_CRC32;
+            break;
+        case DMA_CRC_TYPE_CRC32R:
+            // The register is the bit-reverse of the software one
+            calc = DMA_SNIFF_CTRL_CALC_VALUE_CRC32R;
+            seed = __rev(seed);
+            break;
+        case DMA_CRC_TYPE_CRC16_CCITT:
+            calc = DMA_SNIFF_CTRL_CALC_VALUE_CRC16;
+            seed &= 0xffff;
+            break;
+        case DMA_CRC_TYPE_SUM:
+            calc = DMA_SNIFF_CTRL_CALC_VALUE_SUM;
+            break;
+        default:
+            panic("unknown crc type %d", type);
+    }
+    dma_sniffer_set_output_invert_enabled(false);
+    dma_sniffer_set_output_reverse_enabled(false);
+    // The sniffer works MSB first on each transfer. For the MSB-first CRCs a
+    // byte swap puts the first byte in memory at the top of a 32-bit word.
+    // CRC32R bit-reverses the whole word, which already presents the bytes in
+    // memory order LSB first.
+    dma_sniffer_set_byte_swap_enabled(size == DMA_SIZE_32 &&
+                                      (type == DMA_CRC_TYPE_CRC32 || type == DMA_CRC_TYPE_CRC16_CCITT));
+    dma_sniffer_set_data_accumulator(seed);
+    dma_sniffer_enable(crc_dma_chan, calc, true);
+}
+
+static uint32_t crc_sniffer_finish(dma_crc_type_t type) {
+    uint32_t acc = dma_sniffer_get_data_accumulator();
+    dma_sniffer_disable();
+    if (type == DMA_CRC_TYPE_CRC32R)
+        return __rev(acc);
+    if (type == DMA_CRC_TYPE_CRC16_CCITT)
+        return acc & 0xffff;
+    return acc;
+}
+
+static dma_channel_config crc_data_chan_config(enum dma_channel_transfer_size size) {
+    dma_channel_config c = dma_channel_get_default_config(crc_dma_chan);
+    channel_config_set_transfer_data_size(&c, size);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_sniff_enable(&c, true);
+    return c;
+}
+
+// Run the sniffer over `count` transfers of `size` in one go
+static uint32_t crc_dma_sniff(dma_crc_type_t type, uint32_t seed, const void *data, uint count,
+                              enum dma_channel_transfer_size size) {
+    dma_channel_config c = crc_data_chan_config(size);
+    crc_sniffer_start(type, seed, size);
+    dma_channel_configure(crc_dma_chan, &c, &crc_dma_dummy_dst, data, count, true);
+    dma_channel_wait_for_finish_blocking(crc_dma_chan);
+    return crc_sniffer_finish(type);
+}
+
+uint32_t dma_crc_calculate_dma(dma_crc_type_t type, uint32_t seed, const void *data, size_t len) {
+    // The checksum is defined over bytes, so it has to be sniffed a byte at a
+    // time (a word transfer would add the whole word)
+    if (type == DMA_CRC_TYPE_SUM)
+        return len ? crc_dma_sniff(type, seed, data, len, DMA_SIZE_8) : seed;
+
+    const uint8_t *p = data;
+    size_t head = (4u - ((uintptr_t)p & 3u)) & 3u;
+    if (head > len)
+        head = len;
+    uint32_t crc = dma_crc_calculate_soft(type, seed, p, head);
+    p += head;
+    len -= head;
+
+    uint words = len / 4;
+    if (words) {
+        crc = crc_dma_sniff(type, crc, p, words, DMA_SIZE_32);
+        p += words * 4;
+        len -= words * 4;
+    }
+    return dma_crc_calculate_soft(type, crc, p, len);
+}
+
+uint32_t dma_crc_calculate_chain(dma_crc_type_t type, uint32_t seed, const dma_crc_control_block_t *blocks,
+                                 enum dma_channel_transfer_size size) {
+    if (size != DMA_SIZE_8 && (size != DMA_SIZE_32 || type == DMA_CRC_TYPE_SUM))
+        panic("unsupported transfer size %d for crc type %d", size, type);
+
+    // As in the control_blocks example, the control channel writes each
+    // block to the data channel's alias 3 TRANS_COUNT and READ_ADDR_TRIG
+    // registers, then halts. The write address wraps on an eight-byte
+    // boundary so it hits the same two registers every time.
+    dma_channel_config c = dma_channel_get_default_config(crc_ctrl_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, 3);
+    dma_channel_configure(crc_ctrl_chan, &c, &dma_hw->ch[crc_dma_chan].al3_transfer_count, blocks, 2, false);
+
+    // The data channel runs unpaced, chains back to the control channel when
+    // each fragment completes, and only flags an interrupt on the null
+    // trigger at the end of the list. The sniffer keeps accumulating across
+    // all of the fragments.
+    c = crc_data_chan_config(size);
+    channel_config_set_chain_to(&c, crc_ctrl_chan);
+    channel_config_set_irq_quiet(&c, true);
+    dma_channel_configure(crc_dma_chan, &c, &crc_dma_dummy_dst, NULL, 0, false);
+
+    // An earlier crc_dma_sniff on this channel (which isn't IRQ quiet) leaves
+    // its raw interrupt flag set; clear it so only the null trigger counts
+    dma_hw->intr = 1u << crc_dma_chan;
+    crc_sniffer_start(type, seed, size);
+    dma_start_channel_mask(1u << crc_ctrl_chan);
+
+    while (!(dma_hw->intr & 1u << crc_dma_chan))
+        tight_loop_contents();
+    dma_hw->intr = 1u << crc_dma_chan;
+
+    return crc_sniffer_finish(type);
+}
+
+#endif
+
+uint32_t dma_crc_calculate(dma_crc_type_t type, uint32_t seed, const void *data, size_t len) {
+#if PICO_ON_DEVICE
+    if (len >= DMA_CRC_DMA_MIN_LEN)
+        return dma_crc_calculate_dma(type, seed, data, len);
+#endif
+    return dma_crc_calculate_soft(type, seed, data, len);
+}
@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _DMA_CRC_H
+#define _DMA_CRC_H
+
+#include "pico/stdlib.h"
+#if PICO_ON_DEVICE
+#include "hardware/dma.h"
+#endif
+
+// CRC and checksum calculation using the DMA sniffer for large buffers and a
+// table-driven (slicing-by-4 or slicing-by-8) software implementation for
+// small ones.
+//
+// All the functions take and return the raw CRC register value: no initial
+// or final inversion is applied, so a calculation can be split over several
+// calls by passing the previous result as the next seed. For example the
+// common zlib/Ethernet CRC-32 is
+//
+//     ~dma_crc_calculate(DMA_CRC_TYPE_CRC32R, ~0u, data, len)
+//
+// Note the DMA sniffer is a single shared resource: nothing else may use it
+// while a calculation is in progress.
+//
+// On the host there is no sniffer, so only the software implementation is
+// built and dma_crc_calculate() always uses it.
+
+typedef enum {
+    // CRC-32 (IEEE 802.3 polynomial 0x04c11db7), data processed MSB first
+    DMA_CRC_TYPE_CRC32,
+    // CRC-32 (IEEE 802.3 polynomial), data processed LSB first, i.e. the
+    // bit-reversed form used by Ethernet, zlib and soft_crc32_block() in the
+    // sniff_crc example
+    DMA_CRC_TYPE_CRC32R,
+    // CRC-16-CCITT (polynomial 0x1021), data processed MSB first
+    DMA_CRC_TYPE_CRC16_CCITT,
+    // 32-bit sum of all the bytes
+    DMA_CRC_TYPE_SUM,
+} dma_crc_type_t;
+
+// Number of table lookups per step of the software implementation, 4 or 8.
+// Slicing-by-8 is faster but the CRC-32 tables use 8 KB of RAM each rather
+// than 4 KB.
+#ifndef DMA_CRC_SOFT_SLICES
+#define DMA_CRC_SOFT_SLICES 4
+#endif
+
+// Buffers shorter than this are processed in software by dma_crc_calculate(),
+// as setting up the DMA would take longer than doing the calculation.
+#ifndef DMA_CRC_DMA_MIN_LEN
+#define DMA_CRC_DMA_MIN_LEN 64
+#endif
+
+// Build the software lookup tables and claim two DMA channels. Must be called
+// before any of the other functions.
+void dma_crc_init(void);
+
+// Calculate using whichever of the DMA or software is expected to be faster
+// for this length
+uint32_t dma_crc_calculate(dma_crc_type_t type, uint32_t seed, const void *data, size_t len);
+
+// Calculate entirely in software
+uint32_t dma_crc_calculate_soft(dma_crc_type_t type, uint32_t seed, const void *data, size_t len);
+
+#if PICO_ON_DEVICE
+
+// One fragment of a scattered buffer for dma_crc_calculate_chain(). The
+// field order matters: the control channel writes each block straight into
+// the data channel's alias 3 TRANS_COUNT and READ_ADDR_TRIG registers.
+typedef struct {
+    uint32_t count;   // number of transfers (not bytes, unless DMA_SIZE_8)
+    const void *data;
+} dma_crc_control_block_t;
+
+// Calculate using the DMA sniffer. Any unaligned head and tail bytes are
+// processed in software so that the bulk of the data can be read a word at
+// a time.
+uint32_t dma_crc_calculate_dma(dma_crc_type_t type, uint32_t seed, const void *data, size_t len);
+
+// Calculate over a list of fragments in one go, ending with a {0, NULL}
+// block. A second DMA channel loads each block into the data channel, so
+// the CPU isn't involved between fragments, and the sniffer accumulates over
+// the whole chain. `size` is DMA_SIZE_8, or DMA_SIZE_32 if every fragment is
+// word aligned and its count is in words (not supported for
+// DMA_CRC_TYPE_SUM, which is defined over bytes). The list must stay valid
+// until the call returns.
+uint32_t dma_crc_calculate_chain(dma_crc_type_t type, uint32_t seed, const dma_crc_control_block_t *blocks,
+                                 enum dma_channel_transfer_size size);
+
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "dma_irq_dispatch.h"
+#include "hardware/claim.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+#if !DMA_IRQ_DISPATCH_TRACE
+#define TRACE_ENABLED 0
+#endif
+#include "trace.h"
+
+static struct {
+    dma_irq_dispatch_handler_t handler;
+    void *user_data;
+    uint irq_index;
+} channel_handlers[NUM_DMA_CHANNELS];
+
+// Channels with a handler on each IRQ line
+static volatile uint32_t dispatch_mask[2];
+
+TRACE_NAME(trace_dma_handler, "dma handler");
+
+static inline io_rw_32 *ints_reg(uint irq_index) {
+    return irq_index ? &dma_hw->ints1 : &dma_hw->ints0;
+}
+
+static inline void dispatch(uint irq_index) {
+    io_rw_32 *ints = ints_reg(irq_index);
+    uint32_t pending;
+    // Keep going until nothing is left, so a channel that completes while
+    // we're calling handlers doesn't cost another exception entry
+    while ((pending = *ints & dispatch_mask[irq_index])) {
+        do {
+            uint chan = 31 - __builtin_clz(pending);
+            uint32_t bit = 1u << chan;
+            *ints = bit;
+            trace_begin(trace_dma_handler, chan);
+            channel_handlers[chan].handler(chan, channel_handlers[chan].user_data);
+            trace_end(trace_dma_handler, chan);
+            pending &= ~bit;
+        } while (pending);
+    }
+}
+
+// Kept in RAM so a flash cache miss doesn't add to the latency
+static void __isr __not_in_flash_func(dma_irq_dispatch_irq0)(void) {
+    dispatch(0);
+}
+
+static void __isr __not_in_flash_func(dma_irq_dispatch_irq1)(void) {
+    dispatch(1);
+}
+
+void dma_irq_dispatch_init(uint irq_index) {
+    irq_add_shared_handler(DMA_IRQ_0 + irq_index, irq_index ? dma_irq_dispatch_irq1 : dma_irq_dispatch_irq0,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0 + irq_index, true);
+}
+
+uint dma_irq_dispatch_add(uint channel, dma_irq_dispatch_handler_t handler, void *user_data, int irq_index) {
+    if (irq_index == DMA_IRQ_DISPATCH_AUTO)
+        irq_index = __builtin_popcount(dispatch_mask[1]) < __builtin_popcount(dispatch_mask[0]);
+
+    channel_handlers[channel].handler = handler;
+    channel_handlers[channel].user_data = user_data;
+    channel_handlers[channel].irq_index = irq_index;
+
+    // The claim lock is already shared by both cores for this kind of thing
+    uint32_t save = hw_claim_lock();
+    dispatch_mask[irq_index] |= 1u << channel;
+    hw_claim_unlock(save);
+
+    dma_irqn_set_channel_enabled(irq_index, channel, true);
+    return irq_index;
+}
+
+void dma_irq_dispatch_remove(uint channel) {
+    uint irq_index = channel_handlers[channel].irq_index;
+    dma_irqn_set_channel_enabled(irq_index, channel, false);
+
+    // The handler is left in place, in case the other core is already
+    // dispatching to it
+    uint32_t save = hw_claim_lock();
+    dispatch_mask[irq_index] &= ~(1u << channel);
+    hw_claim_unlock(save);
+}
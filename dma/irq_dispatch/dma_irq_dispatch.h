@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _DMA_IRQ_DISPATCH_H
+#define _DMA_IRQ_DISPATCH_H
+
+#include "pico/stdlib.h"
+
+// Per-channel DMA interrupt dispatch.
+//
+// Rather than each driver installing its own handler on DMA_IRQ_0 and
+// testing INTS0 bits itself, drivers register a callback for each channel
+// they own. One handler per DMA IRQ line finds the pending channels (highest
+// first, using count-leading-zeros) and calls their callbacks, so any number
+// of drivers can share the DMA interrupts.
+//
+// DMA_IRQ_0 and DMA_IRQ_1 can be serviced by different cores: call
+// dma_irq_dispatch_init() on the core that should take each one.
+
+// Define DMA_IRQ_DISPATCH_TRACE to 1 (e.g. with target_compile_definitions on
+// the executable) to record a system/trace event around each callback. It
+// adds a few cycles to every interrupt.
+#ifndef DMA_IRQ_DISPATCH_TRACE
+#define DMA_IRQ_DISPATCH_TRACE 0
+#endif
+
+// Pass as `irq_index` to dma_irq_dispatch_add() to use whichever DMA IRQ has
+// fewer channels on it
+#define DMA_IRQ_DISPATCH_AUTO -1
+
+// Called from the interrupt, after the channel's interrupt has been
+// acknowledged
+typedef void (*dma_irq_dispatch_handler_t)(uint channel, void *user_data);
+
+// Install the dispatcher for DMA_IRQ_0 or DMA_IRQ_1 (`irq_index` 0 or 1) on
+// the calling core. It is added as a shared handler, so drivers that still
+// install their own can coexist with it.
+void dma_irq_dispatch_init(uint irq_index);
+
+// Call `handler` whenever `channel` raises its interrupt, and enable that
+// interrupt on DMA_IRQ_<irq_index>. Returns the IRQ index used.
+uint dma_irq_dispatch_add(uint channel, dma_irq_dispatch_handler_t handler, void *user_data, int irq_index);
+
+// Disable the channel's interrupt and stop dispatching to its handler
+void dma_irq_dispatch_remove(uint channel);
+
+#endif
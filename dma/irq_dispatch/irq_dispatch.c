@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Measure the latency from a DMA channel completing to its callback being
+// called by the dma_irq_dispatch library, with 8 channels active at once.
+//
+// Each channel repeatedly copies the bench_timestamp() PWM counter, which
+// counts system clock cycles, into a word of its own, paced by a DMA timer. The last value it
+// copies is therefore the time at which it completed, and its callback reads
+// the counter again to find the latency before restarting the channel.
+//
+// This is done first with every channel on DMA_IRQ_0, serviced by core 0,
+// and then with the channels spread between DMA_IRQ_0 on core 0 and
+// DMA_IRQ_1 on core 1.
+//
+// Build with DMA_IRQ_DISPATCH_TRACE=1 to have the dispatcher record a trace
+// event around each callback, and the most recent ones dumped at the end for
+// system/trace/trace_to_json.py to show the callbacks queueing up on each
+// core. Recording adds a few cycles to the latency, so it is off by default.
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/dma.h"
+#include "bench.h"
+#include "dma_irq_dispatch.h"
+#include "trace.h"
+
+#define NUM_TEST_CHANNELS 8
+// One transfer every 1000 system clock cycles
+#define TIMER_FRACTION_DENOMINATOR 1000
+#define PHASE_MS 2000
+
+typedef struct {
+    uint irq_index;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} latency_stats_t;
+
+static uint test_chans[NUM_TEST_CHANNELS];
+static latency_stats_t stats[NUM_TEST_CHANNELS];
+static volatile uint32_t stamps[NUM_DMA_CHANNELS];
+static volatile bool running;
+
+static void __not_in_flash_func(on_complete)(uint chan, void *user_data) {
+    uint16_t now = bench_timestamp();
+    latency_stats_t *s = user_data;
+    // The counter wraps every 65536 cycles, far longer than any latency
+    uint32_t latency = (uint16_t)(now - stamps[chan]);
+    s->count++;
+    s->total += latency;
+    if (latency < s->min)
+        s->min = latency;
+    if (latency > s->max)
+        s->max = latency;
+    if (running)
+        dma_channel_start(chan);
+}
+
+static void core1_entry() {
+    // Core 1 services DMA_IRQ_1
+    dma_irq_dispatch_init(1);
+    while (true)
+        tight_loop_contents();
+}
+
+static void run_phase(const char *name, int irq_index) {
+    uint32_t mask = 0;
+    for (int i = 0; i < NUM_TEST_CHANNELS; i++) {
+        stats[i] = (latency_stats_t) {.min = UINT32_MAX};
+        stats[i].irq_index = dma_irq_dispatch_add(test_chans[i], on_complete, &stats[i], irq_index);
+        mask |= 1u << test_chans[i];
+    }
+
+    running = true;
+    dma_start_channel_mask(mask);
+    sleep_ms(PHASE_MS);
+    running = false;
+    for (int i = 0; i < NUM_TEST_CHANNELS; i++) {
+        while (dma_channel_is_busy(test_chans[i]))
+            tight_loop_contents();
+    }
+    // Let the last callbacks finish
+    sleep_ms(1);
+    for (int i = 0; i < NUM_TEST_CHANNELS; i++)
+        dma_irq_dispatch_remove(test_chans[i]);
+
+    printf("\n%s\n", name);
+    printf("channel  irq  completions  min  avg  max (cycles)\n");
+    uint32_t all_max = 0;
+    uint64_t all_total = 0;
+    uint32_t all_count = 0;
+    for (int i = 0; i < NUM_TEST_CHANNELS; i++) {
+        latency_stats_t *s = &stats[i];
+        printf("%7u  %3u  %11lu  %3lu  %3lu  %3lu\n", test_chans[i], s->irq_index, s->count, s->min,
+               s->count ? (uint32_t)(s->total / s->count) : 0, s->max);
+        if (s->max > all_max)
+            all_max = s->max;
+        all_total += s->total;
+        all_count += s->count;
+    }
+    printf("overall average %lu cycles, worst %lu cycles\n", all_count ? (uint32_t)(all_total / all_count) : 0,
+           all_max);
+}
+
+int main() {
+    stdio_init_all();
+    printf("DMA IRQ dispatch latency\n");
+
+    bench_timestamp_init();
+
+    int timer = dma_claim_unused_timer(true);
+    dma_timer_set_fraction(timer, 1, TIMER_FRACTION_DENOMINATOR);
+
+    // Give each channel a different transfer count, so their completions
+    // drift in and out of step with each other
+    for (int i = 0; i < NUM_TEST_CHANNELS; i++) {
+        uint chan = dma_claim_unused_channel(true);
+        test_chans[i] = chan;
+        dma_channel_config c = dma_channel_get_default_config(chan);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+        channel_config_set_read_increment(&c, false);
+        channel_config_set_write_increment(&c, false);
+        channel_config_set_dreq(&c, dma_get_timer_dreq(timer));
+        dma_channel_configure(chan, &c, &stamps[chan], bench_timestamp_addr(), 10 + i * 7, false);
+    }
+
+    dma_irq_dispatch_init(0);
+    multicore_launch_core1(core1_entry);
+
+    run_phase("All channels on DMA_IRQ_0 (core 0)", 0);
+    run_phase("Channels spread over DMA_IRQ_0 (core 0) and DMA_IRQ_1 (core 1)", DMA_IRQ_DISPATCH_AUTO);
+#if DMA_IRQ_DISPATCH_TRACE
+    trace_dump();
+#endif
+}
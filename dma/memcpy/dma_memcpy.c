@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "dma_memcpy.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+static uint8_t pool_chans[NUM_DMA_CHANNELS];
+static uint pool_size;
+static uint32_t pool_mask;
+static uint pool_irq_index;
+
+// Channels not currently running an operation, and which request each
+// running channel belongs to
+static uint32_t idle_mask;
+static dma_memcpy_request_t *owner[NUM_DMA_CHANNELS];
+static critical_section_t pool_lock;
+
+static void request_init(dma_memcpy_request_t *req, dma_memcpy_callback_t callback, void *user_data) {
+    sem_init(&req->done, 0, 1);
+    req->callback = callback;
+    req->user_data = user_data;
+    req->pending = 0;
+}
+
+static void request_complete(dma_memcpy_request_t *req) {
+    if (req->callback)
+        req->callback(req, req->user_data);
+    sem_release(&req->done);
+}
+
+static void __isr dma_memcpy_irq_handler(void) {
+    uint32_t status = (pool_irq_index ? dma_hw->ints1 : dma_hw->ints0) & pool_mask;
+    while (status) {
+        uint chan = __builtin_ctz(status);
+        status &= status - 1;
+        dma_irqn_acknowledge_channel(pool_irq_index, chan);
+
+        dma_memcpy_request_t *req = owner[chan];
+        critical_section_enter_blocking(&pool_lock);
+        idle_mask |= 1u << chan;
+        critical_section_exit(&pool_lock);
+
+        if (--req->pending == 0)
+            request_complete(req);
+    }
+}
+
+void dma_memcpy_init(uint max_channels, uint irq_index) {
+    critical_section_init(&pool_lock);
+    pool_irq_index = irq_index;
+    for (uint i = 0; i < max_channels; i++) {
+        // We must get at least one; after that take what's spare
+        int chan = dma_claim_unused_channel(i == 0);
+        if (chan < 0)
+            break;
+        pool_chans[pool_size++] = chan;
+        pool_mask |= 1u << chan;
+        dma_irqn_set_channel_enabled(irq_index, chan, true);
+    }
+    idle_mask = pool_mask;
+
+    irq_add_shared_handler(DMA_IRQ_0 + irq_index, dma_memcpy_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0 + irq_index, true);
+}
+
+// Claim up to `want` idle channels, returning the number claimed
+static uint claim_idle_channels(uint want, uint *chans) {
+    uint n = 0;
+    critical_section_enter_blocking(&pool_lock);
+    for (uint i = 0; i < pool_size && n < want; i++) {
+        uint chan = pool_chans[i];
+        if (idle_mask & (1u << chan)) {
+            idle_mask &= ~(1u << chan);
+            chans[n++] = chan;
+        }
+    }
+    critical_section_exit(&pool_lock);
+    return n;
+}
+
+// Split `units` transfers of `size` between the claimed channels and start
+// them all at once
+static void start_channels(dma_memcpy_request_t *req, const uint *chans, uint n, uint8_t *dst,
+                           const uint8_t *src, bool src_increment, size_t units,
+                           enum dma_channel_transfer_size size) {
+    size_t per_chan = units / n;
+    uint32_t mask = 0;
+    req->pending = n;
+    for (uint i = 0; i < n; i++) {
+        size_t count = i == n - 1 ? units - per_chan * (n - 1) : per_chan;
+        owner[chans[i]] = req;
+
+        // No DREQ is selected, so the DMA transfers as fast as it can
+        dma_channel_config c = dma_channel_get_default_config(chans[i]);
+        channel_config_set_transfer_data_size(&c, size);
+        channel_config_set_read_increment(&c, src_increment);
+        channel_config_set_write_increment(&c, true);
+        dma_channel_configure(chans[i], &c, dst, src, count, false);
+
+        dst += count << size;
+        if (src_increment)
+            src += count << size;
+        mask |= 1u << chans[i];
+    }
+    dma_start_channel_mask(mask);
+}
+
+static uint channels_wanted(size_t len) {
+    uint want = len / DMA_MEMCPY_MIN_SPLIT_LEN;
+    return want ? want : 1;
+}
+
+void dma_memcpy_async(dma_memcpy_request_t *req, void *dst, const void *src, size_t len,
+                      dma_memcpy_callback_t callback, void *user_data) {
+    request_init(req, callback, user_data);
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    if (len >= DMA_MEMCPY_MIN_LEN) {
+        // Use the widest transfers the relative alignment allows
+        enum dma_channel_transfer_size size;
+        size_t head;
+        uintptr_t misalign = (uintptr_t)d ^ (uintptr_t)s;
+        if (!(misalign & 3u)) {
+            size = DMA_SIZE_32;
+            head = -(uintptr_t)d & 3u;
+        } else if (!(misalign & 1u)) {
+            size = DMA_SIZE_16;
+            head = (uintptr_t)d & 1u;
+        } else {
+            size = DMA_SIZE_8;
+            head = 0;
+        }
+        if (head > len)
+            head = len;
+        size_t units = (len - head) >> size;
+        size_t body = units << size;
+
+        uint chans[NUM_DMA_CHANNELS];
+        uint n;
+        if (units && (n = claim_idle_channels(channels_wanted(len), chans))) {
+            // The head and tail are done first, so the operation is complete
+            // as soon as the last channel finishes
+            memcpy(d, s, head);
+            memcpy(d + head + body, s + head + body, len - head - body);
+            start_channels(req, chans, n, d + head, s + head, true, units, size);
+            return;
+        }
+    }
+    memcpy(d, s, len);
+    request_complete(req);
+}
+
+void dma_memset_async(dma_memcpy_request_t *req, void *dst, int c, size_t len,
+                      dma_memcpy_callback_t callback, void *user_data) {
+    request_init(req, callback, user_data);
+    uint8_t *d = dst;
+    if (len >= DMA_MEMCPY_MIN_LEN) {
+        size_t head = -(uintptr_t)d & 3u;
+        size_t units = len >= head ? (len - head) / 4 : 0;
+        size_t body = units * 4;
+
+        uint chans[NUM_DMA_CHANNELS];
+        uint n;
+        if (units && (n = claim_idle_channels(channels_wanted(len), chans))) {
+            req->fill = (uint8_t)c * 0x01010101u;
+            memset(d, c, head);
+            memset(d + head + body, c, len - head - body);
+            start_channels(req, chans, n, d + head, (const uint8_t *)&req->fill, false, units, DMA_SIZE_32);
+            return;
+        }
+    }
+    memset(d, c, len);
+    request_complete(req);
+}
+
+void dma_memcpy_wait(dma_memcpy_request_t *req) {
+    sem_acquire_blocking(&req->done);
+}
+
+void *dma_memcpy(void *dst, const void *src, size_t len) {
+    dma_memcpy_request_t req;
+    dma_memcpy_async(&req, dst, src, len, NULL, NULL);
+    dma_memcpy_wait(&req);
+    return dst;
+}
+
+void *dma_memset(void *dst, int c, size_t len) {
+    dma_memcpy_request_t req;
+    dma_memset_async(&req, dst, c, len, NULL, NULL);
+    dma_memcpy_wait(&req);
+    return dst;
+}
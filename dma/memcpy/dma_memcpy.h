@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _DMA_MEMCPY_H
+#define _DMA_MEMCPY_H
+
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+
+// Asynchronous memcpy and memset using a pool of DMA channels.
+//
+// The bulk of each operation is done by the DMA, using the widest transfers
+// the relative alignment of source and destination allows; unaligned head
+// and tail bytes are done by the processor before the DMA is started. Large
+// operations are split between however many channels in the pool are idle.
+// When every channel has finished, the request's semaphore is released and
+// its callback (if any) is called from the DMA interrupt.
+
+// Operations shorter than this are done by the processor straight away
+#ifndef DMA_MEMCPY_MIN_LEN
+#define DMA_MEMCPY_MIN_LEN 128
+#endif
+
+// Don't split an operation into pieces smaller than this
+#ifndef DMA_MEMCPY_MIN_SPLIT_LEN
+#define DMA_MEMCPY_MIN_SPLIT_LEN 4096
+#endif
+
+typedef struct dma_memcpy_request dma_memcpy_request_t;
+typedef void (*dma_memcpy_callback_t)(dma_memcpy_request_t *req, void *user_data);
+
+// Caller-owned state for one operation, which must stay valid until it
+// completes
+struct dma_memcpy_request {
+    semaphore_t done;
+    dma_memcpy_callback_t callback;
+    void *user_data;
+    // Channels still running
+    volatile uint pending;
+    // The memset value, read repeatedly by the DMA
+    uint32_t fill;
+};
+
+// Claim up to `max_channels` DMA channels for the pool (at least one) and
+// route their completion interrupts to DMA_IRQ_0 or DMA_IRQ_1 according to
+// `irq_index`, via a shared handler
+void dma_memcpy_init(uint max_channels, uint irq_index);
+
+// Start copying `len` bytes from `src` to `dst`. If the operation is short,
+// or no channel is idle, it is done by the processor and has completed
+// (including calling `callback`) before this returns.
+void dma_memcpy_async(dma_memcpy_request_t *req, void *dst, const void *src, size_t len,
+                      dma_memcpy_callback_t callback, void *user_data);
+
+// Start setting `len` bytes at `dst` to `c`, as dma_memcpy_async()
+void dma_memset_async(dma_memcpy_request_t *req, void *dst, int c, size_t len,
+                      dma_memcpy_callback_t callback, void *user_data);
+
+// Block until the operation has completed
+void dma_memcpy_wait(dma_memcpy_request_t *req);
+
+// Blocking versions, with the same signatures as memcpy() and memset()
+void *dma_memcpy(void *dst, const void *src, size_t len);
+void *dma_memset(void *dst, int c, size_t len);
+
+#endif
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Check the dma_memcpy library for every combination of source and
+// destination alignment, then compare its speed with the processor's memcpy
+// across a range of sizes and bus priority settings, to find the size at
+// which the DMA starts to win.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/structs/busctrl.h"
+#include "bench.h"
+#include "dma_memcpy.h"
+
+#define BUF_LEN (64 * 1024)
+#define GUARD 8
+#define POOL_CHANNELS 4
+#define BENCH_REPEATS 4
+
+static uint8_t src[BUF_LEN + GUARD];
+static uint8_t dst[BUF_LEN + GUARD];
+
+static const size_t check_lens[] = {0, 1, 3, 127, 128, 129, 1000, 4099, 9000, BUF_LEN - GUARD};
+
+static const struct {
+    const char *name;
+    uint32_t priority;
+} priorities[] = {
+    {"default", 0},
+    {"DMA high", BUSCTRL_BUS_PRIORITY_DMA_W_BITS | BUSCTRL_BUS_PRIORITY_DMA_R_BITS},
+    {"proc0 high", BUSCTRL_BUS_PRIORITY_PROC0_BITS},
+};
+
+typedef void *(*copy_func_t)(void *, const void *, size_t);
+
+static uint32_t bench_cycles(copy_func_t func, size_t len) {
+    uint32_t total = 0;
+    for (int i = 0; i < BENCH_REPEATS; i++) {
+        uint32_t start = bench_cycle_count();
+        func(dst, src, len);
+        total += (start - bench_cycle_count()) & 0x00ffffff;
+    }
+    return total / BENCH_REPEATS;
+}
+
+static bool check_copy(uint src_offset, uint dst_offset, size_t len) {
+    memset(dst, 0xaa, sizeof(dst));
+    dma_memcpy(dst + dst_offset, src + src_offset, len);
+    for (size_t i = 0; i < sizeof(dst); i++) {
+        uint8_t expected = (i >= dst_offset && i < dst_offset + len) ? src[i - dst_offset + src_offset] : 0xaa;
+        if (dst[i] != expected)
+            return false;
+    }
+    return true;
+}
+
+static bool check_set(uint dst_offset, size_t len) {
+    memset(dst, 0xaa, sizeof(dst));
+    dma_memset(dst + dst_offset, 0x5c, len);
+    for (size_t i = 0; i < sizeof(dst); i++) {
+        uint8_t expected = (i >= dst_offset && i < dst_offset + len) ? 0x5c : 0xaa;
+        if (dst[i] != expected)
+            return false;
+    }
+    return true;
+}
+
+int main() {
+    stdio_init_all();
+    printf("DMA memcpy benchmark\n");
+
+    dma_memcpy_init(POOL_CHANNELS, 0);
+    bench_cycle_counter_init();
+
+    for (int i = 0; i < count_of(src); i++)
+        src[i] = rand();
+
+    uint failures = 0;
+    for (int l = 0; l < count_of(check_lens); l++) {
+        for (uint dst_offset = 0; dst_offset < 4; dst_offset++) {
+            if (!check_set(dst_offset, check_lens[l])) {
+                printf("ERROR - memset of %u bytes at offset %u FAILED\n", check_lens[l], dst_offset);
+                failures++;
+            }
+            for (uint src_offset = 0; src_offset < 4; src_offset++) {
+                if (!check_copy(src_offset, dst_offset, check_lens[l])) {
+                    printf("ERROR - copy of %u bytes from offset %u to %u FAILED\n", check_lens[l], src_offset,
+                           dst_offset);
+                    failures++;
+                }
+            }
+        }
+    }
+    if (!failures)
+        printf("All copy and set checks are good\n");
+
+    // Aligned copies, so both memcpy and the DMA can use word transfers. This
+    // example is built with DMA_MEMCPY_MIN_LEN=1 so that the DMA is measured
+    // at every size; the crossover is the value to use for it.
+    for (int p = 0; p < count_of(priorities); p++) {
+        bus_ctrl_hw->priority = priorities[p].priority;
+        printf("\nBus priority: %s\n", priorities[p].name);
+        printf("     len  memcpy cycles  dma cycles  dma speedup\n");
+        size_t crossover = 0;
+        for (size_t len = 16; len <= BUF_LEN; len *= 2) {
+            uint32_t cpu_cycles = bench_cycles(memcpy, len);
+            uint32_t dma_cycles = bench_cycles(dma_memcpy, len);
+            printf("%8u  %13lu  %10lu  %11.2f\n", len, cpu_cycles, dma_cycles, (float)cpu_cycles / dma_cycles);
+            if (!crossover && dma_cycles < cpu_cycles)
+                crossover = len;
+        }
+        if (crossover)
+            printf("DMA is faster from %u bytes\n", crossover);
+        else
+            printf("DMA was never faster\n");
+    }
+    bus_ctrl_hw->priority = 0;
+}
@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "dma_sg.h"
+#include "hardware/irq.h"
+#include "pico/sync.h"
+
+static dma_sg_list_t pool[DMA_SG_POOL_SIZE];
+static dma_sg_list_t *free_lists;
+
+static dma_sg_engine_t *engines[DMA_SG_MAX_ENGINES];
+static uint num_engines;
+static bool irq_handler_added[2];
+
+// Protects the pool and the engine queues, which are used both from the
+// DMA interrupt and from either core
+static critical_section_t dma_sg_lock;
+
+static void dma_sg_start(dma_sg_engine_t *engine, dma_sg_list_t *list) {
+    dma_sg_descriptor_t *null_desc = &list->desc[list->count];
+    null_desc->ctrl = engine->ctrl;
+    null_desc->read_addr = NULL;
+    null_desc->write_addr = engine->write_addr;
+    null_desc->transfer_count = 0;
+
+    engine->active = list;
+    // The control channel still has its write address and transfer count
+    // from last time; just point it at the new list and go.
+    dma_channel_set_read_addr(engine->ctrl_chan, list->desc, true);
+}
+
+static void dma_sg_complete(dma_sg_engine_t *engine) {
+    critical_section_enter_blocking(&dma_sg_lock);
+    dma_sg_list_t *list = engine->active;
+    dma_sg_list_t *next = engine->pending_head;
+    if (next) {
+        engine->pending_head = next->next;
+        if (!engine->pending_head)
+            engine->pending_tail = NULL;
+        // Get the next list going before running the callback, to keep the
+        // gap on the wire short
+        dma_sg_start(engine, next);
+    } else {
+        engine->active = NULL;
+    }
+    critical_section_exit(&dma_sg_lock);
+
+    if (list) {
+        if (list->callback)
+            list->callback(list, list->user_data);
+        dma_sg_list_free(list);
+    }
+}
+
+static void dma_sg_irq_handler(uint irq_index) {
+    for (uint i = 0; i < num_engines; i++) {
+        dma_sg_engine_t *engine = engines[i];
+        if (engine->irq_index == irq_index && dma_irqn_get_channel_status(irq_index, engine->data_chan)) {
+            dma_irqn_acknowledge_channel(irq_index, engine->data_chan);
+            dma_sg_complete(engine);
+        }
+    }
+}
+
+static void __isr dma_sg_irq0_handler(void) {
+    dma_sg_irq_handler(0);
+}
+
+static void __isr dma_sg_irq1_handler(void) {
+    dma_sg_irq_handler(1);
+}
+
+void dma_sg_engine_init(dma_sg_engine_t *engine, uint dreq, volatile void *write_addr, bool write_increment,
+                        enum dma_channel_transfer_size size, uint irq_index) {
+    if (!critical_section_is_initialized(&dma_sg_lock)) {
+        critical_section_init(&dma_sg_lock);
+        for (int i = 0; i < DMA_SG_POOL_SIZE; i++)
+            dma_sg_list_free(&pool[i]);
+    }
+    if (num_engines == DMA_SG_MAX_ENGINES)
+        panic("too many scatter-gather engines");
+    engines[num_engines++] = engine;
+
+    engine->data_chan = dma_claim_unused_channel(true);
+    engine->ctrl_chan = dma_claim_unused_channel(true);
+    engine->irq_index = irq_index;
+    engine->transfer_size_bytes = 1u << size;
+    engine->write_addr = write_addr;
+    engine->write_increment = write_increment;
+    engine->active = NULL;
+    engine->pending_head = NULL;
+    engine->pending_tail = NULL;
+
+    // The data channel is paced by the target's DREQ, chains to the control
+    // channel after each buffer, and only raises its interrupt on the null
+    // trigger at the end of the list. Every descriptor reloads this CTRL value.
+    dma_channel_config c = dma_channel_get_default_config(engine->data_chan);
+    channel_config_set_transfer_data_size(&c, size);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, write_increment);
+    channel_config_set_dreq(&c, dreq);
+    channel_config_set_chain_to(&c, engine->ctrl_chan);
+    channel_config_set_irq_quiet(&c, true);
+    engine->ctrl = channel_config_get_ctrl_value(&c);
+    dma_channel_configure(engine->data_chan, &c, write_addr, NULL, 0, false);
+
+    // The control channel copies one four-word descriptor into the data
+    // channel's alias 1 registers each time it is triggered, the last write
+    // (TRANS_COUNT_TRIG) starting the data channel. The write address wraps
+    // on a 16-byte boundary so the same four registers are written each time.
+    c = dma_channel_get_default_config(engine->ctrl_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, 4);
+    dma_channel_configure(engine->ctrl_chan, &c, &dma_hw->ch[engine->data_chan].al1_ctrl, NULL,
+                          sizeof(dma_sg_descriptor_t) / sizeof(uint32_t), false);
+
+    dma_irqn_set_channel_enabled(irq_index, engine->data_chan, true);
+    if (!irq_handler_added[irq_index]) {
+        irq_handler_added[irq_index] = true;
+        irq_add_shared_handler(DMA_IRQ_0 + irq_index, irq_index ? dma_sg_irq1_handler : dma_sg_irq0_handler,
+                               PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_0 + irq_index, true);
+    }
+}
+
+dma_sg_list_t *dma_sg_list_alloc(dma_sg_engine_t *engine) {
+    critical_section_enter_blocking(&dma_sg_lock);
+    dma_sg_list_t *list = free_lists;
+    if (list)
+        free_lists = list->next;
+    critical_section_exit(&dma_sg_lock);
+
+    if (list) {
+        list->count = 0;
+        list->engine = engine;
+        list->next_write_addr = engine->write_addr;
+        list->callback = NULL;
+        list->user_data = NULL;
+        list->next = NULL;
+    }
+    return list;
+}
+
+void dma_sg_list_free(dma_sg_list_t *list) {
+    critical_section_enter_blocking(&dma_sg_lock);
+    list->next = free_lists;
+    free_lists = list;
+    critical_section_exit(&dma_sg_lock);
+}
+
+bool dma_sg_list_append_to(dma_sg_list_t *list, const volatile void *read_addr, volatile void *write_addr,
+                           uint32_t count) {
+    if (list->count == DMA_SG_MAX_DESCRIPTORS)
+        return false;
+    // A zero count would end the list early
+    if (!count)
+        return true;
+    dma_sg_descriptor_t *desc = &list->desc[list->count++];
+    desc->ctrl = list->engine->ctrl;
+    desc->read_addr = read_addr;
+    desc->write_addr = write_addr;
+    desc->transfer_count = count;
+    if (list->engine->write_increment)
+        list->next_write_addr = (volatile uint8_t *)write_addr + count * list->engine->transfer_size_bytes;
+    return true;
+}
+
+bool dma_sg_list_append(dma_sg_list_t *list, const volatile void *read_addr, uint32_t count) {
+    return dma_sg_list_append_to(list, read_addr, list->next_write_addr, count);
+}
+
+void dma_sg_submit(dma_sg_list_t *list, dma_sg_callback_t callback, void *user_data) {
+    dma_sg_engine_t *engine = list->engine;
+    list->callback = callback;
+    list->user_data = user_data;
+    list->next = NULL;
+
+    critical_section_enter_blocking(&dma_sg_lock);
+    if (!engine->active) {
+        dma_sg_start(engine, list);
+    } else if (engine->pending_tail) {
+        engine->pending_tail->next = list;
+        engine->pending_tail = list;
+    } else {
+        engine->pending_head = engine->pending_tail = list;
+    }
+    critical_section_exit(&dma_sg_lock);
+}
+
+bool dma_sg_engine_is_busy(dma_sg_engine_t *engine) {
+    return engine->active != NULL;
+}
@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _DMA_SG_H
+#define _DMA_SG_H
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+
+// Scatter-gather DMA built on control blocks.
+//
+// An engine is a pair of DMA channels driving one target: a peripheral FIFO
+// paced by its DREQ (UART, SPI, PIO...), or memory. A list of descriptors is
+// built at run time, each naming a buffer to read and where to write it, and
+// submitted to an engine. The control channel loads the descriptors into the
+// data channel one after another, so the whole list goes out as a single
+// zero-copy transfer; the null descriptor at the end raises an interrupt,
+// the list's callback runs and the list goes back to the pool.
+
+// Maximum number of buffers in one list (not counting the null descriptor)
+#ifndef DMA_SG_MAX_DESCRIPTORS
+#define DMA_SG_MAX_DESCRIPTORS 8
+#endif
+
+// Number of lists in the pool, shared by all engines
+#ifndef DMA_SG_POOL_SIZE
+#define DMA_SG_POOL_SIZE 8
+#endif
+
+// Maximum number of engines
+#ifndef DMA_SG_MAX_ENGINES
+#define DMA_SG_MAX_ENGINES 4
+#endif
+
+// The field order matters: the control channel writes each descriptor
+// straight into the data channel's alias 1 registers, the last of which is
+// TRANS_COUNT_TRIG. A zero transfer count is a null trigger, which ends the
+// list.
+typedef struct {
+    uint32_t ctrl;
+    const volatile void *read_addr;
+    volatile void *write_addr;
+    uint32_t transfer_count;
+} dma_sg_descriptor_t;
+
+typedef struct dma_sg_list dma_sg_list_t;
+typedef struct dma_sg_engine dma_sg_engine_t;
+
+// Called from the DMA interrupt once the whole list has been transferred.
+// The list is returned to the pool straight afterwards.
+typedef void (*dma_sg_callback_t)(dma_sg_list_t *list, void *user_data);
+
+struct dma_sg_list {
+    dma_sg_descriptor_t desc[DMA_SG_MAX_DESCRIPTORS + 1];
+    uint count;
+    dma_sg_engine_t *engine;
+    volatile void *next_write_addr;
+    dma_sg_callback_t callback;
+    void *user_data;
+    dma_sg_list_t *next;
+};
+
+struct dma_sg_engine {
+    uint data_chan;
+    uint ctrl_chan;
+    uint irq_index;
+    // CTRL value loaded into the data channel with every descriptor
+    uint32_t ctrl;
+    uint transfer_size_bytes;
+    volatile void *write_addr;
+    bool write_increment;
+    // List being transferred, and lists waiting to follow it
+    dma_sg_list_t *volatile active;
+    dma_sg_list_t *pending_head;
+    dma_sg_list_t *pending_tail;
+};
+
+// Claim two DMA channels and set up an engine writing to `write_addr`, paced
+// by `dreq` (DREQ_FORCE for memory). For memory targets set
+// `write_increment`; successive buffers in a list are then written one
+// after another. The completion interrupt goes to DMA_IRQ_0 or DMA_IRQ_1
+// according to `irq_index`, via a shared handler, so other drivers can use
+// the same IRQ.
+void dma_sg_engine_init(dma_sg_engine_t *engine, uint dreq, volatile void *write_addr, bool write_increment,
+                        enum dma_channel_transfer_size size, uint irq_index);
+
+// Take a list from the pool for use with `engine`, or NULL if the pool is
+// empty.
+dma_sg_list_t *dma_sg_list_alloc(dma_sg_engine_t *engine);
+
+// Return a list to the pool without submitting it
+void dma_sg_list_free(dma_sg_list_t *list);
+
+// Append `count` transfers read from `read_addr`. For an incrementing
+// target the data is written straight after that of the previous buffer.
+// Returns false if the list is full.
+bool dma_sg_list_append(dma_sg_list_t *list, const volatile void *read_addr, uint32_t count);
+
+// Append `count` transfers from `read_addr` to an explicit `write_addr`
+// (scatter). Returns false if the list is full.
+bool dma_sg_list_append_to(dma_sg_list_t *list, const volatile void *read_addr, volatile void *write_addr,
+                           uint32_t count);
+
+// Start the list, or queue it behind the list the engine is already
+// transferring. The buffers must stay valid until `callback` has been
+// called. `callback` may be NULL.
+void dma_sg_submit(dma_sg_list_t *list, dma_sg_callback_t callback, void *user_data);
+
+// True if the engine has a list in flight or queued
+bool dma_sg_engine_is_busy(dma_sg_engine_t *engine);
+
+#endif
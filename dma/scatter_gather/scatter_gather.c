@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Use the dma_sg scatter-gather library to send framed messages to the UART.
+// Each frame is a header and a CRC trailer built in RAM around a payload
+// that is left where it is (here, in flash), and the three pieces go out as
+// one DMA transfer without being copied together. Several frames are queued
+// at once; lists come from a pool and are recycled as each frame completes.
+//
+// The same frames are then gathered into a RAM buffer by a second engine
+// with a memory target, and checked against a copy made by the processor.
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/structs/uart.h"
+#include "dma_sg.h"
+#include "dma_crc.h"
+
+static const char *payloads[] = {
+    "Transferring ",
+    "a header, a payload and a trailer ",
+    "as a single ",
+    "zero-copy DMA transfer.",
+};
+
+#define NUM_FRAMES count_of(payloads)
+
+typedef struct {
+    char header[16];
+    char trailer[16];
+} frame_t;
+
+// Must stay valid until each frame has been sent
+static frame_t frames[NUM_FRAMES];
+static volatile uint frames_sent;
+
+static char gathered[256];
+static char expected[256];
+static volatile bool gather_done;
+
+static void frame_sent(dma_sg_list_t *list, void *user_data) {
+    frames_sent++;
+}
+
+static void gather_complete(dma_sg_list_t *list, void *user_data) {
+    gather_done = true;
+}
+
+static void build_frame(frame_t *frame, uint seq, const char *payload) {
+    uint len = strlen(payload);
+    snprintf(frame->header, sizeof(frame->header), "[%u:%u] ", seq, len);
+    uint32_t crc = dma_crc_calculate(DMA_CRC_TYPE_CRC32R, ~0u, frame->header, strlen(frame->header));
+    crc = dma_crc_calculate(DMA_CRC_TYPE_CRC32R, crc, payload, len);
+    snprintf(frame->trailer, sizeof(frame->trailer), " %08lx\n", ~crc);
+}
+
+// The header goes to `dst` if given, otherwise to the engine's target
+static void append_frame(dma_sg_list_t *list, const frame_t *frame, const char *payload, char *dst) {
+    if (dst)
+        dma_sg_list_append_to(list, frame->header, dst, strlen(frame->header));
+    else
+        dma_sg_list_append(list, frame->header, strlen(frame->header));
+    dma_sg_list_append(list, payload, strlen(payload));
+    dma_sg_list_append(list, frame->trailer, strlen(frame->trailer));
+}
+
+int main() {
+#ifndef uart_default
+#warning dma/scatter_gather example requires a UART
+#else
+    stdio_init_all();
+    puts("DMA scatter-gather example:");
+
+    dma_crc_init();
+
+    dma_sg_engine_t uart_engine;
+    dma_sg_engine_init(&uart_engine, uart_get_dreq(uart_default, true), &uart_get_hw(uart_default)->dr, false,
+                       DMA_SIZE_8, 0);
+
+    dma_sg_engine_t mem_engine;
+    dma_sg_engine_init(&mem_engine, DREQ_FORCE, gathered, true, DMA_SIZE_8, 1);
+
+    for (uint i = 0; i < NUM_FRAMES; i++)
+        build_frame(&frames[i], i, payloads[i]);
+
+    // Queue every frame; the engine runs them back to back, and the CPU
+    // isn't involved again until each frame's completion interrupt. Nothing
+    // else may print to the UART until they have all gone.
+    for (uint i = 0; i < NUM_FRAMES; i++) {
+        dma_sg_list_t *list;
+        while (!(list = dma_sg_list_alloc(&uart_engine)))
+            tight_loop_contents(); // wait for a completion to recycle a list
+        append_frame(list, &frames[i], payloads[i], NULL);
+        dma_sg_submit(list, frame_sent, NULL);
+    }
+    while (frames_sent < NUM_FRAMES)
+        tight_loop_contents();
+    printf("%u frames sent\n", frames_sent);
+
+    // Gather all the frames into RAM with one list per frame, each starting
+    // where the previous one ended, and compare with a copy made by the
+    // processor
+    uint offset = 0;
+    for (uint i = 0; i < NUM_FRAMES; i++) {
+        dma_sg_list_t *list = dma_sg_list_alloc(&mem_engine);
+        append_frame(list, &frames[i], payloads[i], gathered + offset);
+        bool last = i == NUM_FRAMES - 1;
+        dma_sg_submit(list, last ? gather_complete : NULL, NULL);
+
+        strcpy(expected + offset, frames[i].header);
+        strcat(expected + offset, payloads[i]);
+        strcat(expected + offset, frames[i].trailer);
+        offset += strlen(expected + offset);
+    }
+    while (!gather_done)
+        tight_loop_contents();
+
+    if (memcmp(gathered, expected, offset) == 0)
+        puts("Gathered frames match");
+    else
+        puts("ERROR - gathered frames don't match!");
+#endif
+}
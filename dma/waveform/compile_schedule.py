@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+
+# Compiles an LED fade curve into a DMA schedule for the dma/waveform example.
+#
+# usage: python3 compile_schedule.py [options] TIME_MS:LEVEL [TIME_MS:LEVEL ...] > schedule.h
+#
+# e.g. python3 compile_schedule.py --gamma 2.2 0:0 1000:32 1200:32 2200:0 2500:0 > generated/waveform_schedule.h
+#
+# Each keyframe gives a brightness level (0 to 32) at a time in milliseconds,
+# starting at 0 ms. The brightness is interpolated linearly between keyframes
+# and the last keyframe marks the end of the period, after which the curve
+# repeats. With --gamma the brightness is gamma corrected on its way to the
+# PWM level.
+#
+# The PIO serialiser sends one 32-bit word every 32 * clkdiv system clock
+# cycles, and a word with n one bits gives a PWM level of n/32. The curve is
+# sampled once per word and runs of the same level are merged into one
+# (count, level) schedule entry. The DMA loops over the schedule by walking a
+# ring of pointers to its entries, which must be a power of two long, so the
+# longest entries are split in two until it is.
+
+import argparse
+import sys
+
+N_PWM_LEVELS = 33
+# The DMA ring size is limited to 2^15 bytes of 4-byte pointers
+MAX_ENTRIES = 1 << 13
+
+
+def parse_keyframe(text):
+    try:
+        time_ms, level = text.split(':')
+        return float(time_ms), float(level)
+    except ValueError:
+        sys.exit(f"Keyframe '{text}' should be TIME_MS:LEVEL")
+
+
+def check_keyframes(keyframes):
+    if len(keyframes) < 2:
+        sys.exit("At least two keyframes are needed")
+    if keyframes[0][0] != 0:
+        sys.exit("The first keyframe must be at 0 ms")
+    for (t0, _), (t1, _) in zip(keyframes, keyframes[1:]):
+        if t1 <= t0:
+            sys.exit("Keyframe times must increase")
+    for _, level in keyframes:
+        if not 0 <= level <= N_PWM_LEVELS - 1:
+            sys.exit(f"Levels must be between 0 and {N_PWM_LEVELS - 1}")
+
+
+def pwm_level(brightness, gamma):
+    scale = N_PWM_LEVELS - 1
+    return round(scale * (brightness / scale) ** gamma)
+
+
+def sample_curve(keyframes, words_per_ms, gamma):
+    """Return the run-length encoded PWM level for each word, as [level, count] pairs."""
+    entries = []
+    word = 0
+    for (t0, l0), (t1, l1) in zip(keyframes, keyframes[1:]):
+        # Work from the absolute word number so rounding doesn't accumulate
+        end_word = round(t1 * words_per_ms)
+        start_word = word
+        while word < end_word:
+            fraction = (word - start_word) / (end_word - start_word)
+            level = pwm_level(l0 + (l1 - l0) * fraction, gamma)
+            if entries and entries[-1][0] == level:
+                entries[-1][1] += 1
+            else:
+                entries.append([level, 1])
+            word += 1
+    # The curve repeats, so the last run may continue into the first
+    if len(entries) > 1 and entries[0][0] == entries[-1][0]:
+        entries[0][1] += entries.pop()[1]
+    return entries
+
+
+def pad_to_power_of_2(entries):
+    """Split the longest entries until there are a power-of-two number of them."""
+    target = 1
+    while target < len(entries):
+        target *= 2
+    if target > MAX_ENTRIES:
+        sys.exit(f"The curve needs {len(entries)} entries, but at most {MAX_ENTRIES} are supported")
+    while len(entries) < target:
+        i = max(range(len(entries)), key=lambda i: entries[i][1])
+        level, count = entries[i]
+        if count < 2:
+            sys.exit("The curve is too short to pad the schedule")
+        entries[i:i + 1] = [[level, count // 2], [level, count - count // 2]]
+    return entries
+
+
+def emit_header(entries, args, out):
+    n = len(entries)
+    period_words = sum(count for _, count in entries)
+    words_per_ms = args.sys_clock_hz / (32 * args.clkdiv * 1000)
+    out.write("// --------------------------------------------------------------- //\n")
+    out.write("// This file is autogenerated by compile_schedule.py; do not edit! //\n")
+    out.write("// --------------------------------------------------------------- //\n\n")
+    out.write(f"// python3 compile_schedule.py {' '.join(sys.argv[1:])}\n\n")
+    out.write("#ifndef _WAVEFORM_SCHEDULE_H\n#define _WAVEFORM_SCHEDULE_H\n\n")
+    out.write("#include <stdint.h>\n\n")
+    out.write(f"#define WAVEFORM_SYS_CLOCK_HZ {args.sys_clock_hz}\n")
+    out.write(f"#define WAVEFORM_PIO_CLKDIV {args.clkdiv}f\n")
+    out.write(f"#define WAVEFORM_PERIOD_MS {round(period_words / words_per_ms)}\n")
+    out.write(f"#define WAVEFORM_SCHEDULE_LEN {n}\n")
+    out.write(f"// log2 of the size in bytes of waveform_schedule_ring\n")
+    out.write(f"#define WAVEFORM_SCHEDULE_RING_BITS {(n * 4).bit_length() - 1}\n\n")
+
+    out.write("// Entry i has i one bits and (32 - i) zero bits\n")
+    out.write(f"static uint32_t waveform_levels[{N_PWM_LEVELS}] = {{\n")
+    for i in range(N_PWM_LEVELS):
+        out.write(f"    0x{(1 << i) - 1:08x},\n")
+    out.write("};\n\n")
+
+    out.write("// The field order matters: each entry is written to the data channel's\n")
+    out.write("// alias 3 TRANS_COUNT and READ_ADDR_TRIG registers\n")
+    out.write("typedef struct {\n    uint32_t count;\n    const uint32_t *level;\n} waveform_entry_t;\n\n")
+    out.write(f"static waveform_entry_t waveform_schedule[WAVEFORM_SCHEDULE_LEN] = {{\n")
+    for level, count in entries:
+        out.write(f"    {{{count}, &waveform_levels[{level}]}},\n")
+    out.write("};\n\n")
+
+    out.write("// Aligned to its size so the DMA can wrap around it\n")
+    out.write("static const waveform_entry_t *waveform_schedule_ring[WAVEFORM_SCHEDULE_LEN]\n")
+    out.write("        __attribute__((aligned(WAVEFORM_SCHEDULE_LEN * sizeof(void *)))) = {\n")
+    for i in range(n):
+        out.write(f"    &waveform_schedule[{i}],\n")
+    out.write("};\n\n#endif\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile an LED fade curve into a DMA schedule")
+    parser.add_argument("--sys-clock-hz", type=int, default=125000000, help="system clock frequency")
+    parser.add_argument("--clkdiv", type=float, default=10.0, help="PIO serialiser clock divider")
+    parser.add_argument("--gamma", type=float, default=1.0, help="gamma correction for the brightness")
+    parser.add_argument("keyframes_text", nargs="+", metavar="TIME_MS:LEVEL")
+    args = parser.parse_args()
+
+    keyframes = [parse_keyframe(k) for k in args.keyframes_text]
+    check_keyframes(keyframes)
+    words_per_ms = args.sys_clock_hz / (32 * args.clkdiv * 1000)
+    entries = sample_curve(keyframes, words_per_ms, args.gamma)
+    period_words = sum(count for _, count in entries)
+    entries = pad_to_power_of_2(entries)
+    # Padding only splits entries, so the curve itself must be unchanged
+    assert sum(count for _, count in entries) == period_words
+    emit_header(entries, args, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
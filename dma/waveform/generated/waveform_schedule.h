@@ -0,0 +1,199 @@
+// --------------------------------------------------------------- //
+// This file is autogenerated by compile_schedule.py; do not edit! //
+// --------------------------------------------------------------- //
+
+// python3 compile_schedule.py --gamma 2.2 0:0 1000:32 1200:32 2200:0 2500:0
+
+#ifndef _WAVEFORM_SCHEDULE_H
+#define _WAVEFORM_SCHEDULE_H
+
+#include <stdint.h>
+
+#define WAVEFORM_SYS_CLOCK_HZ 125000000
+#define WAVEFORM_PIO_CLKDIV 10.0f
+#define WAVEFORM_PERIOD_MS 2500
+#define WAVEFORM_SCHEDULE_LEN 64
+// log2 of the size in bytes of waveform_schedule_ring
+#define WAVEFORM_SCHEDULE_RING_BITS 8
+
+// Entry i has i one bits and (32 - i) zero bits
+static uint32_t waveform_levels[33] = {
+    0x00000000,
+    0x00000001,
+    0x00000003,
+    0x00000007,
+    0x0000000f,
+    0x0000001f,
+    0x0000003f,
+    0x0000007f,
+    0x000000ff,
+    0x000001ff,
+    0x000003ff,
+    0x000007ff,
+    0x00000fff,
+    0x00001fff,
+    0x00003fff,
+    0x00007fff,
+    0x0000ffff,
+    0x0001ffff,
+    0x0003ffff,
+    0x0007ffff,
+    0x000fffff,
+    0x001fffff,
+    0x003fffff,
+    0x007fffff,
+    0x00ffffff,
+    0x01ffffff,
+    0x03ffffff,
+    0x07ffffff,
+    0x0fffffff,
+    0x1fffffff,
+    0x3fffffff,
+    0x7fffffff,
+    0xffffffff,
+};
+
+// The field order matters: each entry is written to the data channel's
+// alias 3 TRANS_COUNT and READ_ADDR_TRIG registers
+typedef struct {
+    uint32_t count;
+    const uint32_t *level;
+} waveform_entry_t;
+
+static waveform_entry_t waveform_schedule[WAVEFORM_SCHEDULE_LEN] = {
+    {235164, &waveform_levels[0]},
+    {38206, &waveform_levels[1]},
+    {25403, &waveform_levels[2]},
+    {20261, &waveform_levels[3]},
+    {17287, &waveform_levels[4]},
+    {15295, &waveform_levels[5]},
+    {13841, &waveform_levels[6]},
+    {12721, &waveform_levels[7]},
+    {11825, &waveform_levels[8]},
+    {11089, &waveform_levels[9]},
+    {10468, &waveform_levels[10]},
+    {9937, &waveform_levels[11]},
+    {9477, &waveform_levels[12]},
+    {9071, &waveform_levels[13]},
+    {8711, &waveform_levels[14]},
+    {8390, &waveform_levels[15]},
+    {8099, &waveform_levels[16]},
+    {7836, &waveform_levels[17]},
+    {7595, &waveform_levels[18]},
+    {7374, &waveform_levels[19]},
+    {7171, &waveform_levels[20]},
+    {6982, &waveform_levels[21]},
+    {6808, &waveform_levels[22]},
+    {6644, &waveform_levels[23]},
+    {6492, &waveform_levels[24]},
+    {6349, &waveform_levels[25]},
+    {6214, &waveform_levels[26]},
+    {6088, &waveform_levels[27]},
+    {5968, &waveform_levels[28]},
+    {5855, &waveform_levels[29]},
+    {5747, &waveform_levels[30]},
+    {5646, &waveform_levels[31]},
+    {83698, &waveform_levels[32]},
+    {5646, &waveform_levels[31]},
+    {5747, &waveform_levels[30]},
+    {5855, &waveform_levels[29]},
+    {5968, &waveform_levels[28]},
+    {6088, &waveform_levels[27]},
+    {6214, &waveform_levels[26]},
+    {6349, &waveform_levels[25]},
+    {6492, &waveform_levels[24]},
+    {6644, &waveform_levels[23]},
+    {6808, &waveform_levels[22]},
+    {6982, &waveform_levels[21]},
+    {7171, &waveform_levels[20]},
+    {7374, &waveform_levels[19]},
+    {7595, &waveform_levels[18]},
+    {7836, &waveform_levels[17]},
+    {8099, &waveform_levels[16]},
+    {8390, &waveform_levels[15]},
+    {8711, &waveform_levels[14]},
+    {9071, &waveform_levels[13]},
+    {9477, &waveform_levels[12]},
+    {9937, &waveform_levels[11]},
+    {10468, &waveform_levels[10]},
+    {11089, &waveform_levels[9]},
+    {11825, &waveform_levels[8]},
+    {12721, &waveform_levels[7]},
+    {13841, &waveform_levels[6]},
+    {15295, &waveform_levels[5]},
+    {17287, &waveform_levels[4]},
+    {20261, &waveform_levels[3]},
+    {25403, &waveform_levels[2]},
+    {38206, &waveform_levels[1]},
+};
+
+// Aligned to its size so the DMA can wrap around it
+static const waveform_entry_t *waveform_schedule_ring[WAVEFORM_SCHEDULE_LEN]
+        __attribute__((aligned(WAVEFORM_SCHEDULE_LEN * sizeof(void *)))) = {
+    &waveform_schedule[0],
+    &waveform_schedule[1],
+    &waveform_schedule[2],
+    &waveform_schedule[3],
+    &waveform_schedule[4],
+    &waveform_schedule[5],
+    &waveform_schedule[6],
+    &waveform_schedule[7],
+    &waveform_schedule[8],
+    &waveform_schedule[9],
+    &waveform_schedule[10],
+    &waveform_schedule[11],
+    &waveform_schedule[12],
+    &waveform_schedule[13],
+    &waveform_schedule[14],
+    &waveform_schedule[15],
+    &waveform_schedule[16],
+    &waveform_schedule[17],
+    &waveform_schedule[18],
+    &waveform_schedule[19],
+    &waveform_schedule[20],
+    &waveform_schedule[21],
+    &waveform_schedule[22],
+    &waveform_schedule[23],
+    &waveform_schedule[24],
+    &waveform_schedule[25],
+    &waveform_schedule[26],
+    &waveform_schedule[27],
+    &waveform_schedule[28],
+    &waveform_schedule[29],
+    &waveform_schedule[30],
+    &waveform_schedule[31],
+    &waveform_schedule[32],
+    &waveform_schedule[33],
+    &waveform_schedule[34],
+    &waveform_schedule[35],
+    &waveform_schedule[36],
+    &waveform_schedule[37],
+    &waveform_schedule[38],
+    &waveform_schedule[39],
+    &waveform_schedule[40],
+    &waveform_schedule[41],
+    &waveform_schedule[42],
+    &waveform_schedule[43],
+    &waveform_schedule[44],
+    &waveform_schedule[45],
+    &waveform_schedule[46],
+    &waveform_schedule[47],
+    &waveform_schedule[48],
+    &waveform_schedule[49],
+    &waveform_schedule[50],
+    &waveform_schedule[51],
+    &waveform_schedule[52],
+    &waveform_schedule[53],
+    &waveform_schedule[54],
+    &waveform_schedule[55],
+    &waveform_schedule[56],
+    &waveform_schedule[57],
+    &waveform_schedule[58],
+    &waveform_schedule[59],
+    &waveform_schedule[60],
+    &waveform_schedule[61],
+    &waveform_schedule[62],
+    &waveform_schedule[63],
+};
+
+#endif
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+
+# Unit tests for compile_schedule.py.
+#
+# usage: python3 test_compile_schedule.py
+
+import os
+import shlex
+import subprocess
+import sys
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, HERE)
+
+import compile_schedule  # noqa: E402
+
+
+def expand(entries):
+    """The PWM level of every word, from (level, count) entries."""
+    return [level for level, count in entries for _ in range(count)]
+
+
+class SampleCurveTest(unittest.TestCase):
+    def test_constant(self):
+        self.assertEqual(compile_schedule.sample_curve([(0, 5), (10, 5)], 1, 1.0), [[5, 10]])
+
+    def test_ramp(self):
+        # One word per ms, from level 0 to level 4 over 4 words
+        entries = compile_schedule.sample_curve([(0, 0), (4, 4), (8, 4)], 1, 1.0)
+        self.assertEqual(expand(entries), [0, 1, 2, 3, 4, 4, 4, 4])
+
+    def test_period_is_exact(self):
+        # Rounding is worked out from the absolute word number, so it doesn't add up
+        words_per_ms = 125000000 / (32 * 10.0 * 1000)
+        keyframes = [(0, 0), (333.3, 32), (666.6, 7), (1000, 0)]
+        entries = compile_schedule.sample_curve(keyframes, words_per_ms, 1.0)
+        self.assertEqual(sum(count for _, count in entries), round(1000 * words_per_ms))
+
+    def test_gamma(self):
+        entries = compile_schedule.sample_curve([(0, 16), (4, 16)], 1, 2.0)
+        self.assertEqual(entries, [[8, 4]])
+
+    def test_runs_are_merged(self):
+        entries = compile_schedule.sample_curve([(0, 0), (2, 0), (4, 32), (6, 32)], 1, 1.0)
+        for (level0, _), (level1, _) in zip(entries, entries[1:]):
+            self.assertNotEqual(level0, level1)
+
+
+class WrapMergeTest(unittest.TestCase):
+    def test_last_run_joins_first(self):
+        # Starts and ends at level 0, so the runs either side of the wrap are one
+        entries = compile_schedule.sample_curve([(0, 0), (2, 0), (3, 32), (5, 32), (6, 0), (8, 0)], 1, 1.0)
+        self.assertEqual(entries[0][0], 0)
+        self.assertNotEqual(entries[-1][0], 0)
+        self.assertEqual(sum(count for _, count in entries), 8)
+
+    def test_single_run_not_merged_with_itself(self):
+        self.assertEqual(compile_schedule.sample_curve([(0, 3), (4, 3)], 1, 1.0), [[3, 4]])
+
+    def test_different_ends_kept(self):
+        entries = compile_schedule.sample_curve([(0, 0), (2, 0), (2.5, 32), (4, 32)], 1, 1.0)
+        self.assertEqual(entries[0][0], 0)
+        self.assertEqual(entries[-1][0], 32)
+
+
+class PadToPowerOf2Test(unittest.TestCase):
+    def test_already_power_of_2(self):
+        entries = [[1, 3], [2, 5]]
+        self.assertEqual(compile_schedule.pad_to_power_of_2([list(e) for e in entries]), entries)
+
+    def test_splits_longest(self):
+        entries = compile_schedule.pad_to_power_of_2([[1, 2], [2, 9], [3, 4]])
+        self.assertEqual(entries, [[1, 2], [2, 4], [2, 5], [3, 4]])
+
+    def test_keeps_curve(self):
+        entries = [[level % 33, 1 + level * 7 % 13] for level in range(37)]
+        before = expand(entries)
+        padded = compile_schedule.pad_to_power_of_2([list(e) for e in entries])
+        self.assertEqual(len(padded), 64)
+        self.assertEqual(expand(padded), before)
+
+    def test_too_short(self):
+        with self.assertRaises(SystemExit):
+            compile_schedule.pad_to_power_of_2([[1, 1], [2, 1], [3, 1]])
+
+    def test_too_many_entries(self):
+        with self.assertRaises(SystemExit):
+            compile_schedule.pad_to_power_of_2([[i % 33, 2] for i in range(compile_schedule.MAX_ENTRIES + 1)])
+
+
+class GeneratedHeaderTest(unittest.TestCase):
+    def test_regenerates_byte_for_byte(self):
+        header = os.path.join(HERE, "generated", "waveform_schedule.h")
+        with open(header) as f:
+            expected = f.read()
+        prefix = "// python3 compile_schedule.py "
+        command = next(line for line in expected.splitlines() if line.startswith(prefix))
+        args = shlex.split(command[len(prefix):])
+        result = subprocess.run([sys.executable, os.path.join(HERE, "compile_schedule.py")] + args,
+                                capture_output=True, text=True, check=True)
+        self.assertEqual(result.stdout, expected)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Play an LED fade curve through a PIO serialiser with no processor
+// involvement at all, and compare it with the interrupt-driven approach of
+// the dma/channel_irq example.
+//
+// As in that example, the data channel sends the same 32-bit word to the PIO
+// over and over, and the balance of 1s and 0s in the word sets the LED
+// brightness. Here, though, the sequence of words and how long each is sent
+// for comes from a schedule of (count, read address) pairs, compiled from a
+// list of keyframes by compile_schedule.py.
+//
+// When the data channel finishes an entry it chains to a loop channel, which
+// copies the next pointer from a ring of pointers to the schedule entries
+// into the control channel's READ_ADDR_TRIG. The control channel then writes
+// the entry into the data channel's alias 3 TRANS_COUNT and READ_ADDR_TRIG
+// registers, which starts the data channel on the next entry. The ring wraps
+// around, so the curve repeats forever.
+//
+// To compare, the same schedule is first played for a few periods by
+// reprogramming the data channel from an interrupt handler, counting the
+// interrupts taken. Then the DMA is left to sequence it by itself.
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "pio_serialiser.pio.h"
+#include "waveform_schedule.h"
+
+#define COMPARE_PERIODS 2
+
+static uint data_chan;
+static volatile uint32_t irq_count;
+static uint irq_entry;
+
+static void dma_handler() {
+    if (!(dma_hw->ints0 & (1u << data_chan)))
+        return;
+    dma_hw->ints0 = 1u << data_chan;
+    irq_count++;
+
+    irq_entry = (irq_entry + 1) % WAVEFORM_SCHEDULE_LEN;
+    dma_channel_set_trans_count(data_chan, waveform_schedule[irq_entry].count, false);
+    dma_channel_set_read_addr(data_chan, waveform_schedule[irq_entry].level, true);
+}
+
+// Configure the data channel to write the same word repeatedly to the state
+// machine's TX FIFO
+static void data_chan_configure(PIO pio, uint sm, int chain_to) {
+    dma_channel_config c = dma_channel_get_default_config(data_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+    if (chain_to >= 0)
+        channel_config_set_chain_to(&c, chain_to);
+    dma_channel_configure(data_chan, &c, &pio->txf[sm], NULL, 0, false);
+}
+
+static void play_with_irq(PIO pio, uint sm) {
+    data_chan_configure(pio, sm, -1);
+    irq_count = 0;
+    irq_entry = 0;
+    dma_channel_set_irq0_enabled(data_chan, true);
+
+    dma_channel_set_trans_count(data_chan, waveform_schedule[0].count, false);
+    dma_channel_set_read_addr(data_chan, waveform_schedule[0].level, true);
+    sleep_ms(COMPARE_PERIODS * WAVEFORM_PERIOD_MS);
+
+    dma_channel_set_irq0_enabled(data_chan, false);
+    dma_channel_abort(data_chan);
+    printf("Interrupt driven: %lu interrupts in %u periods\n", irq_count, COMPARE_PERIODS);
+}
+
+static void play_sequenced(PIO pio, uint sm) {
+    uint ctrl_chan = dma_claim_unused_channel(true);
+    uint loop_chan = dma_claim_unused_channel(true);
+
+    // When an entry is done, chain to the loop channel to fetch the next one
+    data_chan_configure(pio, sm, loop_chan);
+
+    // Write one (count, read address) entry into the data channel's alias 3
+    // registers. The write ring wraps the two words back round on the next
+    // entry.
+    dma_channel_config c = dma_channel_get_default_config(ctrl_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, 3); // 1 << 3 byte boundary on write ptr
+    dma_channel_configure(ctrl_chan, &c, &dma_hw->ch[data_chan].al3_transfer_count, NULL, 2, false);
+
+    // Point the control channel at the next entry, wrapping around the ring
+    // of entry pointers
+    c = dma_channel_get_default_config(loop_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, WAVEFORM_SCHEDULE_RING_BITS);
+    dma_channel_configure(loop_chan, &c, &dma_hw->ch[ctrl_chan].al3_read_addr_trig, waveform_schedule_ring, 1,
+                          false);
+
+    irq_count = 0;
+    dma_channel_start(loop_chan);
+    sleep_ms(COMPARE_PERIODS * WAVEFORM_PERIOD_MS);
+    printf("DMA sequenced: %lu interrupts in %u periods\n", irq_count, COMPARE_PERIODS);
+}
+
+int main() {
+    stdio_init_all();
+#ifndef PICO_DEFAULT_LED_PIN
+#warning dma/waveform example requires a board with a regular LED
+#else
+    printf("DMA sequenced waveform\n");
+    if (clock_get_hz(clk_sys) != WAVEFORM_SYS_CLOCK_HZ)
+        printf("The schedule was compiled for a %u Hz system clock, so its timing will be off\n",
+               WAVEFORM_SYS_CLOCK_HZ);
+
+    // Set up a PIO state machine to serialise our bits
+    PIO pio = pio0;
+    uint sm = 0;
+    uint offset = pio_add_program(pio, &pio_serialiser_program);
+    pio_serialiser_program_init(pio, sm, offset, PICO_DEFAULT_LED_PIN, WAVEFORM_PIO_CLKDIV);
+
+    data_chan = dma_claim_unused_channel(true);
+
+    // The handler stays installed throughout, so it would count any
+    // interrupt the sequenced version raised
+    irq_set_exclusive_handler(DMA_IRQ_0, dma_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    play_with_irq(pio, sm);
+    play_sequenced(pio, sm);
+
+    // The DMA carries on playing the curve by itself
+    while (true)
+        tight_loop_contents();
+#endif
+}
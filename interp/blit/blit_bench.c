@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Run each interp_blit operation on a 160x120 RGB565 frame, check that the
+// output is pixel-for-pixel the same as the portable reference in blit_ref.c,
+// and report how many pixels per second each version manages.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "bench.h"
+#include "interp_blit.h"
+#include "blit_ref.h"
+
+#define FRAME_WIDTH 160
+#define FRAME_HEIGHT 120
+#define FRAME_PIXELS (FRAME_WIDTH * FRAME_HEIGHT)
+#define TEXTURE_BITS 6
+#define TEXTURE_PIXELS (1 << (2 * TEXTURE_BITS))
+#define BLEND_ALPHA 96
+
+static uint16_t texture_rgb565[TEXTURE_PIXELS];
+static uint8_t texture_pal8[TEXTURE_PIXELS];
+static uint16_t palette[256];
+static uint8_t yuyv[FRAME_PIXELS * 2];
+static uint16_t background[FRAME_PIXELS];
+static uint16_t overlay[FRAME_PIXELS];
+static uint16_t frame[FRAME_PIXELS];
+static uint16_t frame_ref[FRAME_PIXELS];
+
+static const blit_texture_t rgb565_tex = {texture_rgb565, TEXTURE_BITS, TEXTURE_BITS};
+static const blit_texture_t pal8_tex = {texture_pal8, TEXTURE_BITS, TEXTURE_BITS};
+
+static struct {
+    const char *name;
+    blit_affine_t xf;
+} transforms[3];
+
+static void set_transform(int i, const char *name, float scale, float degrees) {
+    // Rotate and scale about the middle of the frame, which shows the middle
+    // of the texture
+    float theta = degrees * (float)M_PI / 180.f;
+    float c = cosf(theta) / scale * (1 << BLIT_UV_FRAC_BITS);
+    float s = sinf(theta) / scale * (1 << BLIT_UV_FRAC_BITS);
+    blit_affine_t *xf = &transforms[i].xf;
+    xf->dudx = (int32_t)c;
+    xf->dvdx = (int32_t)s;
+    xf->dudy = -(int32_t)s;
+    xf->dvdy = (int32_t)c;
+    int32_t centre = (1 << TEXTURE_BITS) << (BLIT_UV_FRAC_BITS - 1);
+    xf->u0 = centre - (FRAME_WIDTH / 2) * xf->dudx - (FRAME_HEIGHT / 2) * xf->dudy;
+    xf->v0 = centre - (FRAME_WIDTH / 2) * xf->dvdx - (FRAME_HEIGHT / 2) * xf->dvdy;
+    transforms[i].name = name;
+}
+
+static uint32_t mismatches(void) {
+    uint32_t count = 0;
+    for (int i = 0; i < FRAME_PIXELS; i++)
+        count += frame[i] != frame_ref[i];
+    return count;
+}
+
+static void print_result(const char *name, uint32_t interp_cycles, uint32_t ref_cycles) {
+    float sys_hz = clock_get_hz(clk_sys);
+    float interp_mpx = FRAME_PIXELS * sys_hz / interp_cycles / 1e6f;
+    float ref_mpx = FRAME_PIXELS * sys_hz / ref_cycles / 1e6f;
+    uint32_t bad = mismatches();
+    printf("%-24s %12.2f  %9.2f\n", name, interp_mpx, ref_mpx);
+    if (bad)
+        printf("ERROR - %lu pixels differ from the reference\n", bad);
+}
+
+// Time one call of each version, after a call to warm up the flash cache
+
+#define TIME_CALL(cycles, call) do { \
+    call; \
+    uint32_t start = bench_cycle_count(); \
+    call; \
+    cycles = (start - bench_cycle_count()) & 0xffffff; \
+} while (0)
+
+int main() {
+    stdio_init_all();
+    printf("Interpolator blits\n");
+    bench_cycle_counter_init();
+
+    for (int i = 0; i < TEXTURE_PIXELS; i++) {
+        texture_rgb565[i] = rand();
+        texture_pal8[i] = rand();
+    }
+    for (int i = 0; i < count_of(palette); i++)
+        palette[i] = rand();
+    for (int i = 0; i < count_of(yuyv); i++)
+        yuyv[i] = rand();
+    for (int i = 0; i < FRAME_PIXELS; i++)
+        background[i] = rand();
+
+    set_transform(0, "1:1", 1.f, 0.f);
+    set_transform(1, "2x zoom", 2.f, 0.f);
+    set_transform(2, "30 degrees, 0.75x", 0.75f, 30.f);
+
+    uint32_t interp_cycles, ref_cycles;
+    char name[32];
+    printf("\noperation                interp Mpx/s  ref Mpx/s\n");
+    for (int i = 0; i < count_of(transforms); i++) {
+        const blit_affine_t *xf = &transforms[i].xf;
+        TIME_CALL(interp_cycles, blit_affine_rgb565(frame, FRAME_WIDTH, FRAME_WIDTH, FRAME_HEIGHT, &rgb565_tex, xf));
+        TIME_CALL(ref_cycles, blit_ref_affine_rgb565(frame_ref, FRAME_WIDTH, FRAME_WIDTH, FRAME_HEIGHT, &rgb565_tex, xf));
+        snprintf(name, sizeof(name), "rgb565 %s", transforms[i].name);
+        print_result(name, interp_cycles, ref_cycles);
+
+        TIME_CALL(interp_cycles,
+                  blit_affine_pal8(frame, FRAME_WIDTH, FRAME_WIDTH, FRAME_HEIGHT, &pal8_tex, palette, xf));
+        TIME_CALL(ref_cycles,
+                  blit_ref_affine_pal8(frame_ref, FRAME_WIDTH, FRAME_WIDTH, FRAME_HEIGHT, &pal8_tex, palette, xf));
+        snprintf(name, sizeof(name), "pal8 %s", transforms[i].name);
+        print_result(name, interp_cycles, ref_cycles);
+    }
+
+    // Blend the 1:1 texture over the background. The second call of each
+    // pair blends again onto the result of the first, for both versions.
+    blit_ref_affine_rgb565(frame_ref, FRAME_WIDTH, FRAME_WIDTH, FRAME_HEIGHT, &rgb565_tex, &transforms[0].xf);
+    memcpy(overlay, frame_ref, sizeof(overlay));
+    memcpy(frame, background, sizeof(frame));
+    memcpy(frame_ref, background, sizeof(frame_ref));
+    TIME_CALL(interp_cycles, blit_blend_span_rgb565(frame, overlay, FRAME_PIXELS, BLEND_ALPHA));
+    TIME_CALL(ref_cycles, blit_ref_blend_span_rgb565(frame_ref, overlay, FRAME_PIXELS, BLEND_ALPHA));
+    print_result("blend", interp_cycles, ref_cycles);
+
+    TIME_CALL(interp_cycles, blit_yuyv_to_rgb565(frame, yuyv, FRAME_PIXELS));
+    TIME_CALL(ref_cycles, blit_ref_yuyv_to_rgb565(frame_ref, yuyv, FRAME_PIXELS));
+    print_result("yuyv to rgb565", interp_cycles, ref_cycles);
+}
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "blit_ref.h"
+
+static inline uint texel_index(const blit_texture_t *tex, uint32_t u, uint32_t v) {
+    uint32_t x = (u >> BLIT_UV_FRAC_BITS) & ((1u << tex->width_bits) - 1);
+    uint32_t y = (v >> BLIT_UV_FRAC_BITS) & ((1u << tex->height_bits) - 1);
+    return x + (y << tex->width_bits);
+}
+
+void blit_ref_affine_rgb565(uint16_t *dst, uint dst_stride, uint width, uint height, const blit_texture_t *tex,
+                            const blit_affine_t *xf) {
+    const uint16_t *texels = tex->pixels;
+    for (uint y = 0; y < height; y++) {
+        uint32_t u = xf->u0 + y * xf->dudy;
+        uint32_t v = xf->v0 + y * xf->dvdy;
+        for (uint x = 0; x < width; x++) {
+            dst[x] = texels[texel_index(tex, u, v)];
+            u += xf->dudx;
+            v += xf->dvdx;
+        }
+        dst += dst_stride;
+    }
+}
+
+void blit_ref_affine_pal8(uint16_t *dst, uint dst_stride, uint width, uint height, const blit_texture_t *tex,
+                          const uint16_t *palette, const blit_affine_t *xf) {
+    const uint8_t *texels = tex->pixels;
+    for (uint y = 0; y < height; y++) {
+        uint32_t u = xf->u0 + y * xf->dudy;
+        uint32_t v = xf->v0 + y * xf->dvdy;
+        for (uint x = 0; x < width; x++) {
+            dst[x] = palette[texels[texel_index(tex, u, v)]];
+            u += xf->dudx;
+            v += xf->dvdx;
+        }
+        dst += dst_stride;
+    }
+}
+
+static inline uint blend(uint d, uint s, uint alpha) {
+    return (d * (256 - alpha) + s * alpha) >> 8;
+}
+
+void blit_ref_blend_span_rgb565(uint16_t *dst, const uint16_t *src, uint count, uint alpha) {
+    for (uint i = 0; i < count; i++) {
+        uint d = dst[i];
+        uint s = src[i];
+        uint r = blend(d >> 11, s >> 11, alpha);
+        uint g = blend((d >> 5) & 0x3f, (s >> 5) & 0x3f, alpha);
+        uint b = blend(d & 0x1f, s & 0x1f, alpha);
+        dst[i] = (r << 11) | (g << 5) | b;
+    }
+}
+
+static inline uint clamp_bits(int32_t x, uint bits) {
+    // Clamp to 0-255, then keep the top bits
+    x >>= 8 - bits;
+    int32_t max = (1 << bits) - 1;
+    return x < 0 ? 0 : x > max ? max : x;
+}
+
+void blit_ref_yuyv_to_rgb565(uint16_t *dst, const uint8_t *yuyv, uint count) {
+    for (uint i = 0; i < count; i += 2) {
+        int32_t cb = yuyv[1] - 128;
+        int32_t cr = yuyv[3] - 128;
+        int32_t dr = BLIT_YUV_RED(cr);
+        int32_t dg = BLIT_YUV_GREEN(cb, cr);
+        int32_t db = BLIT_YUV_BLUE(cb);
+        for (uint j = 0; j < 2; j++) {
+            int32_t y = yuyv[j * 2];
+            dst[i + j] = (clamp_bits(y + dr, 5) << 11) | (clamp_bits(y + dg, 6) << 5) | clamp_bits(y + db, 5);
+        }
+        yuyv += 4;
+    }
+}
@@ -0,0 +1,32 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _BLIT_REF_H
+#define _BLIT_REF_H
+
+#include "interp_blit.h"
+
+// Portable versions of the interp_blit functions, which produce exactly the
+// same pixels. They are used by interp_blit on the host, and on the device
+// to check the interpolator versions against.
+
+// Red, green and blue offsets from Cb and Cr (each less 128) for full-range
+// BT.601 YCbCr, in whole 8-bit steps
+#define BLIT_YUV_RED(cr) ((359 * (cr)) >> 8)
+#define BLIT_YUV_GREEN(cb, cr) (-((88 * (cb) + 183 * (cr)) >> 8))
+#define BLIT_YUV_BLUE(cb) ((454 * (cb)) >> 8)
+
+void blit_ref_affine_rgb565(uint16_t *dst, uint dst_stride, uint width, uint height, const blit_texture_t *tex,
+                            const blit_affine_t *xf);
+
+void blit_ref_affine_pal8(uint16_t *dst, uint dst_stride, uint width, uint height, const blit_texture_t *tex,
+                          const uint16_t *palette, const blit_affine_t *xf);
+
+void blit_ref_blend_span_rgb565(uint16_t *dst, const uint16_t *src, uint count, uint alpha);
+
+void blit_ref_yuyv_to_rgb565(uint16_t *dst, const uint8_t *yuyv, uint count);
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Check blit_yuyv_to_rgb565(), with its model of interp1's clamp, against
+// the portable reference for every combination of Y, Cb and Cr, for the host
+// build (PICO_PLATFORM=host). interp_blit_bench does the same comparison on
+// the device, with random pixels.
+//
+// Exits with 0 if every pixel matches.
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "interp_blit.h"
+#include "blit_ref.h"
+
+// One YUYV pair for each Cb and Cr
+#define PAIRS (256 * 256)
+
+static uint8_t yuyv[PAIRS * 4];
+static uint16_t out[PAIRS * 2];
+static uint16_t out_ref[PAIRS * 2];
+
+int main() {
+    stdio_init_all();
+    uint32_t bad = 0;
+    for (uint y = 0; y < 256; y++) {
+        for (uint i = 0; i < PAIRS; i++) {
+            // Each pair has a dark and a light pixel
+            yuyv[i * 4] = y;
+            yuyv[i * 4 + 1] = i & 0xff;
+            yuyv[i * 4 + 2] = 255 - y;
+            yuyv[i * 4 + 3] = i >> 8;
+        }
+        blit_yuyv_to_rgb565(out, yuyv, PAIRS * 2);
+        blit_ref_yuyv_to_rgb565(out_ref, yuyv, PAIRS * 2);
+        for (uint i = 0; i < PAIRS * 2; i++) {
+            if (out[i] != out_ref[i]) {
+                if (!bad) {
+                    printf("Y %u Cb %u Cr %u: got %04x, want %04x\n", yuyv[i * 2], yuyv[(i & ~1u) * 2 + 1],
+                           yuyv[(i & ~1u) * 2 + 3], out[i], out_ref[i]);
+                }
+                bad++;
+            }
+        }
+    }
+    printf("yuyv to rgb565: %lu of %u pixels differ from the reference\n", bad, 256 * PAIRS * 2);
+    printf("%s\n", bad ? "FAILED" : "PASSED");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "interp_blit.h"
+#include "blit_ref.h"
+
+#if PICO_ON_DEVICE
+
+#include "hardware/interp.h"
+
+// Texture mapping as in hello_interp: lanes 0 and 1 step u and v, and their
+// shifted and masked results are the texel's x and y offsets in bytes, which
+// lane 2 adds to the texture address. `log2_bytes` is log2 of the bytes per
+// texel.
+static void texture_mapping_setup(const blit_texture_t *tex, uint log2_bytes) {
+    uint wb = tex->width_bits;
+    uint hb = tex->height_bits;
+    if (!wb || !hb || wb + log2_bytes > BLIT_UV_FRAC_BITS || hb > BLIT_UV_FRAC_BITS)
+        panic("Unsupported texture size");
+
+    interp_config cfg = interp_default_config();
+    // Add the raw accumulator to the base, so each pop steps u and v
+    interp_config_set_add_raw(&cfg, true);
+    interp_config_set_shift(&cfg, BLIT_UV_FRAC_BITS - log2_bytes);
+    interp_config_set_mask(&cfg, log2_bytes, log2_bytes + wb - 1);
+    interp_set_config(interp0, 0, &cfg);
+
+    interp_config_set_shift(&cfg, BLIT_UV_FRAC_BITS - log2_bytes - wb);
+    interp_config_set_mask(&cfg, log2_bytes + wb, log2_bytes + wb + hb - 1);
+    interp_set_config(interp0, 1, &cfg);
+
+    interp0->base[2] = (uintptr_t)tex->pixels;
+}
+
+static inline void texture_mapping_row(const blit_affine_t *xf, uint y) {
+    interp0->accum[0] = xf->u0 + y * xf->dudy;
+    interp0->base[0] = xf->dudx;
+    interp0->accum[1] = xf->v0 + y * xf->dvdy;
+    interp0->base[1] = xf->dvdx;
+}
+
+void __not_in_flash_func(blit_affine_rgb565)(uint16_t *dst, uint dst_stride, uint width, uint height,
+                                             const blit_texture_t *tex, const blit_affine_t *xf) {
+    texture_mapping_setup(tex, 1);
+    for (uint y = 0; y < height; y++) {
+        texture_mapping_row(xf, y);
+        for (uint x = 0; x < width; x++)
+            dst[x] = *(uint16_t *)interp0->pop[2];
+        dst += dst_stride;
+    }
+}
+
+void __not_in_flash_func(blit_affine_pal8)(uint16_t *dst, uint dst_stride, uint width, uint height,
+                                           const blit_texture_t *tex, const uint16_t *palette,
+                                           const blit_affine_t *xf) {
+    texture_mapping_setup(tex, 0);
+    for (uint y = 0; y < height; y++) {
+        texture_mapping_row(xf, y);
+        for (uint x = 0; x < width; x++)
+            dst[x] = palette[*(uint8_t *)interp0->pop[2]];
+        dst += dst_stride;
+    }
+}
+
+// Lane 1 of interp0 blends BASE0 towards BASE1 by the bottom 8 bits of
+// ACCUM1. Writing BASE01 sets both bases at once, one channel at a time.
+static inline uint blend_channel(uint d, uint s) {
+    interp0->base01 = d | (s << 16);
+    return interp0->peek[1];
+}
+
+void __not_in_flash_func(blit_blend_span_rgb565)(uint16_t *dst, const uint16_t *src, uint count, uint alpha) {
+    interp_config cfg = interp_default_config();
+    interp_config_set_blend(&cfg, true);
+    interp_set_config(interp0, 0, &cfg);
+    cfg = interp_default_config();
+    interp_set_config(interp0, 1, &cfg);
+    interp0->accum[1] = alpha;
+
+    for (uint i = 0; i < count; i++) {
+        uint d = dst[i];
+        uint s = src[i];
+        uint r = blend_channel(d >> 11, s >> 11);
+        uint g = blend_channel((d >> 5) & 0x3f, (s >> 5) & 0x3f);
+        uint b = blend_channel(d & 0x1f, s & 0x1f);
+        dst[i] = (r << 11) | (g << 5) | b;
+    }
+}
+
+#else
+
+void blit_affine_rgb565(uint16_t *dst, uint dst_stride, uint width, uint height, const blit_texture_t *tex,
+                        const blit_affine_t *xf) {
+    blit_ref_affine_rgb565(dst, dst_stride, width, height, tex, xf);
+}
+
+void blit_affine_pal8(uint16_t *dst, uint dst_stride, uint width, uint height, const blit_texture_t *tex,
+                      const uint16_t *palette, const blit_affine_t *xf) {
+    blit_ref_affine_pal8(dst, dst_stride, width, height, tex, palette, xf);
+}
+
+void blit_blend_span_rgb565(uint16_t *dst, const uint16_t *src, uint count, uint alpha) {
+    blit_ref_blend_span_rgb565(dst, src, count, alpha);
+}
+
+#endif
+
+// Only interp1 has clamp mode, so its lane 0 clamps all three channels, set
+// up for green's 6 bits. Red and blue are shifted down one more bit
+// afterwards: clamp(x >> 2, 0, 63) >> 1 is clamp(x >> 3, 0, 31) for any x.
+#define YUV_CLAMP_BITS 6
+#define YUV_CLAMP_SHIFT (8 - YUV_CLAMP_BITS)
+#define YUV_CLAMP_MAX ((1 << YUV_CLAMP_BITS) - 1)
+
+#if PICO_ON_DEVICE
+
+static void yuv_clamp_setup(void) {
+    interp_config cfg = interp_default_config();
+    interp_config_set_clamp(&cfg, true);
+    interp_config_set_shift(&cfg, YUV_CLAMP_SHIFT);
+    // Mask at the new position of the sign bit, so it is sign extended
+    interp_config_set_mask(&cfg, 0, 31 - YUV_CLAMP_SHIFT);
+    interp_config_set_signed(&cfg, true);
+    interp_set_config(interp1, 0, &cfg);
+    interp1->base[0] = 0;
+    interp1->base[1] = YUV_CLAMP_MAX;
+}
+
+static inline uint yuv_clamp(int32_t x) {
+    interp1->accum[0] = x;
+    return interp1->peek[0];
+}
+
+#else
+
+static void yuv_clamp_setup(void) {
+}
+
+// What interp1's lane 0 does as yuv_clamp_setup() configures it, so the host
+// build checks the same arithmetic: shift, mask to bit 31 - shift and sign
+// extend from there, then clamp to BASE0 ... BASE1
+static inline uint yuv_clamp(int32_t x) {
+    uint msb = 31 - YUV_CLAMP_SHIFT;
+    uint32_t v = ((uint32_t)x >> YUV_CLAMP_SHIFT) & (0xffffffffu >> (31 - msb));
+    if (v & (1u << msb))
+        v |= 0xffffffffu << msb;
+    int32_t clamped = (int32_t)v;
+    return clamped < 0 ? 0 : clamped > YUV_CLAMP_MAX ? YUV_CLAMP_MAX : clamped;
+}
+
+#endif
+
+void __not_in_flash_func(blit_yuyv_to_rgb565)(uint16_t *dst, const uint8_t *yuyv, uint count) {
+    yuv_clamp_setup();
+
+    for (uint i = 0; i < count; i += 2) {
+        int32_t cb = yuyv[1] - 128;
+        int32_t cr = yuyv[3] - 128;
+        int32_t dr = BLIT_YUV_RED(cr);
+        int32_t dg = BLIT_YUV_GREEN(cb, cr);
+        int32_t db = BLIT_YUV_BLUE(cb);
+        for (uint j = 0; j < 2; j++) {
+            int32_t y = yuyv[j * 2];
+            uint r = yuv_clamp(y + dr) >> 1;
+            uint g = yuv_clamp(y + dg);
+            uint b = yuv_clamp(y + db) >> 1;
+            dst[i + j] = (r << 11) | (g << 5) | b;
+        }
+        yuyv += 4;
+    }
+}
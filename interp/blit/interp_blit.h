@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _INTERP_BLIT_H
+#define _INTERP_BLIT_H
+
+#include "pico/stdlib.h"
+
+// 2D drawing with the interpolators, built on the texture mapping, blend and
+// clamp techniques from hello_interp:
+//
+// - affine-transformed (rotated, scaled, sheared) blits from RGB565 and 8-bit
+//   palettized textures, which wrap around at their edges
+// - alpha blending one RGB565 span onto another
+// - converting YUYV (YCbCr 4:2:2) camera data to RGB565, with clamping
+//
+// The blits and blending configure interp0, and the colour conversion
+// interp1 (the only one with clamp mode), on the calling core. Code that uses
+// them from an interrupt must save and restore the interpolators with
+// interp_save()/interp_restore() if anything else might be using them.
+//
+// On the host the blits and blending are the portable versions in blit_ref.c,
+// which give exactly the same pixels. The colour conversion runs with a
+// software model of interp1's clamp, which blit_test checks against
+// blit_ref.c.
+
+// Fraction bits in texture coordinates
+#define BLIT_UV_FRAC_BITS 16
+
+typedef struct {
+    const void *pixels;
+    // The texture is (1 << width_bits) by (1 << height_bits) pixels
+    uint width_bits;
+    uint height_bits;
+} blit_texture_t;
+
+// Maps destination pixel (x, y) to texture coordinate
+// (u0 + x * dudx + y * dudy, v0 + x * dvdx + y * dvdy), in 16.16 fixed point
+typedef struct {
+    int32_t u0, v0;
+    int32_t dudx, dvdx;
+    int32_t dudy, dvdy;
+} blit_affine_t;
+
+// Fill a width by height rectangle of `dst`, whose rows are `dst_stride`
+// pixels apart, from an RGB565 texture of up to 2^15 pixels across
+void blit_affine_rgb565(uint16_t *dst, uint dst_stride, uint width, uint height, const blit_texture_t *tex,
+                        const blit_affine_t *xf);
+
+// As blit_affine_rgb565(), from a texture of 8-bit indices into `palette`
+void blit_affine_pal8(uint16_t *dst, uint dst_stride, uint width, uint height, const blit_texture_t *tex,
+                      const uint16_t *palette, const blit_affine_t *xf);
+
+// dst = dst + (src - dst) * alpha / 256 for each channel, rounded down, with
+// `alpha` from 0 (dst unchanged) to 255
+void blit_blend_span_rgb565(uint16_t *dst, const uint16_t *src, uint count, uint alpha);
+
+// Convert `count` pixels (which must be even) of full-range YUYV to RGB565
+void blit_yuyv_to_rgb565(uint16_t *dst, const uint8_t *yuyv, uint count);
+
+#endif
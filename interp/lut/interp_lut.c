@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "interp_lut.h"
+#include "lut_ref.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/interp.h"
+#endif
+
+// The calibration curve at x, rounded to the nearest output
+static uint16_t curve_at(const interp_lut_point_t *points, uint n_points, int32_t x) {
+    if (x <= points[0].x)
+        return points[0].y;
+    for (uint i = 1; i < n_points; i++) {
+        if (x <= points[i].x) {
+            int32_t x0 = points[i - 1].x;
+            int32_t y0 = points[i - 1].y;
+            int32_t dx = points[i].x - x0;
+            int64_t num = (int64_t)(points[i].y - y0) * (x - x0);
+            return y0 + (int32_t)((num >= 0 ? num + dx / 2 : num - dx / 2) / dx);
+        }
+    }
+    return points[n_points - 1].y;
+}
+
+void interp_lut_compile(interp_lut_t *lut, const interp_lut_point_t *points, uint n_points, uint input_bits,
+                        uint segment_bits) {
+    if (n_points < 2 || input_bits > 16 || !segment_bits || segment_bits > INTERP_LUT_MAX_SEGMENT_BITS ||
+        segment_bits > input_bits)
+        panic("Invalid lookup table parameters");
+    for (uint i = 1; i < n_points; i++) {
+        if (points[i].x <= points[i - 1].x)
+            panic("Calibration points must be in increasing order of x");
+    }
+
+    uint frac_bits = input_bits - segment_bits;
+    lut->input_bits = input_bits;
+    lut->segment_bits = segment_bits;
+    lut->preshift = frac_bits < 8 ? 8 - frac_bits : 0;
+    lut->frac_bits = frac_bits + lut->preshift;
+
+    uint16_t start = curve_at(points, n_points, 0);
+    for (uint i = 0; i < 1u << segment_bits; i++) {
+        uint16_t end = curve_at(points, n_points, (int32_t)(i + 1) << frac_bits);
+        lut->entries[i] = start | ((uint32_t)end << 16);
+        start = end;
+    }
+}
+
+#if PICO_ON_DEVICE
+
+void __not_in_flash_func(interp_lut_process)(const interp_lut_t *lut, const uint16_t *in, uint16_t *out,
+                                             uint count) {
+    // Lane 0 picks out the segment index, times 4 bytes per entry, which the
+    // full result adds to the table address
+    interp_config cfg = interp_default_config();
+    interp_config_set_blend(&cfg, true);
+    interp_config_set_shift(&cfg, lut->frac_bits - 2);
+    interp_config_set_mask(&cfg, 2, lut->segment_bits + 1);
+    interp_set_config(interp0, 0, &cfg);
+
+    // Lane 1 takes the top 8 fraction bits from ACCUM0 as the blend weight.
+    // It is unsigned, so decreasing curves blend correctly too.
+    cfg = interp_default_config();
+    interp_config_set_cross_input(&cfg, true);
+    interp_config_set_shift(&cfg, lut->frac_bits - 8);
+    interp_set_config(interp0, 1, &cfg);
+
+    interp0->base[2] = (uintptr_t)lut->entries;
+    uint preshift = lut->preshift;
+    for (uint i = 0; i < count; i++) {
+        interp0->accum[0] = in[i] << preshift;
+        // Both ends of the segment at once: BASE0 from the bottom half, BASE1
+        // from the top
+        interp0->base01 = *(uint32_t *)interp0->peek[2];
+        out[i] = interp0->peek[1];
+    }
+}
+
+#else
+
+void interp_lut_process(const interp_lut_t *lut, const uint16_t *in, uint16_t *out, uint count) {
+    interp_lut_ref_process(lut, in, out, count);
+}
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _INTERP_LUT_H
+#define _INTERP_LUT_H
+
+#include "pico/stdlib.h"
+
+// Piecewise-linear lookup tables on interp0, for linearising sensor
+// readings with a calibration curve.
+//
+// interp_lut_compile() resamples a list of calibration points into
+// 2^segment_bits equal segments spanning the input range. Each table entry
+// packs the outputs at both ends of its segment into one word, so
+// converting a sample takes one write to the interpolator, one table load,
+// one write of both blend bases and one read of the blended result, in the
+// same way as the linear_interpolation() demo in hello_interp.
+//
+// interp_lut_process() reconfigures interp0 on the calling core; code
+// using it from an interrupt must save and restore interp0 with
+// interp_save()/interp_restore() if anything else might be using it.
+//
+// On the host, lut_ref.c's portable version is used instead, which gives
+// exactly the same results.
+
+#define INTERP_LUT_MAX_SEGMENT_BITS 8
+
+// The calibration curve passes through (x, y); x is a raw sample
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+} interp_lut_point_t;
+
+typedef struct {
+    // Entry i is the output at the start of segment i, plus the output at
+    // its end shifted left by 16
+    uint32_t entries[1u << INTERP_LUT_MAX_SEGMENT_BITS];
+    uint input_bits;
+    uint segment_bits;
+    // Samples are shifted left by `preshift` so that there are `frac_bits`
+    // (at least 8) bits below the segment index
+    uint preshift;
+    uint frac_bits;
+} interp_lut_t;
+
+// Build `lut` for samples of `input_bits` bits from `n_points` calibration
+// points, in increasing order of x. Outside the points the curve is flat.
+void interp_lut_compile(interp_lut_t *lut, const interp_lut_point_t *points, uint n_points, uint input_bits,
+                        uint segment_bits);
+
+// Convert `count` samples, each less than 2^input_bits
+void interp_lut_process(const interp_lut_t *lut, const uint16_t *in, uint16_t *out, uint count);
+
+#endif
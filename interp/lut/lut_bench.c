@@ -0,0 +1,185 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Linearise readings from an NTC thermistor with an interp_lut table.
+//
+// The thermistor (10k at 25 C, B = 3950) goes from GPIO 26 to ground, with
+// a 10k resistor from GPIO 26 to 3.3V. Its calibration curve is given as
+// temperatures in hundredths of a kelvin at 5 C steps, and compiled into a
+// 256-segment table for 12-bit samples.
+//
+// The example first checks, for every possible sample, that the
+// interpolator gives exactly the same result as the portable reference and
+// how far both are from the thermistor's B-parameter equation. It then
+// times a block of conversions with the interpolator, the reference and
+// the equation in float. Finally it captures blocks of samples with the
+// DMA, as in adc/dma_capture, and linearises each one as it arrives.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "bench.h"
+#include "interp_lut.h"
+#include "lut_ref.h"
+
+// Channel 0 is GPIO26
+#define CAPTURE_CHANNEL 0
+#define BLOCK_SIZE 1024
+#define INPUT_BITS 12
+#define SEGMENT_BITS 8
+
+#define NTC_B 3950.f
+#define NTC_R25 10000.f
+#define PULLUP_OHMS 10000.f
+
+static const interp_lut_point_t ntc_calibration[] = {
+        {267, 37315},
+        {305, 36815},
+        {350, 36315},
+        {401, 35815},
+        {462, 35315},
+        {532, 34815},
+        {613, 34315},
+        {707, 33815},
+        {816, 33315},
+        {940, 32815},
+        {1082, 32315},
+        {1241, 31815},
+        {1419, 31315},
+        {1614, 30815},
+        {1825, 30315},
+        {2048, 29815},
+        {2278, 29315},
+        {2511, 28815},
+        {2739, 28315},
+        {2956, 27815},
+        {3157, 27315},
+        {3338, 26815},
+        {3496, 26315},
+        {3630, 25815},
+        {3741, 25315},
+};
+
+static interp_lut_t lut;
+static uint16_t samples[BLOCK_SIZE];
+static uint16_t centikelvin[BLOCK_SIZE];
+static uint16_t centikelvin_ref[BLOCK_SIZE];
+static float kelvin_float[BLOCK_SIZE];
+
+// The thermistor's temperature in kelvin, from the B-parameter equation
+static float ntc_kelvin(uint16_t sample) {
+    float ohms = PULLUP_OHMS * sample / ((1 << INPUT_BITS) - sample);
+    return 1.f / (1.f / 298.15f + logf(ohms / NTC_R25) / NTC_B);
+}
+
+static void float_process(const uint16_t *in, float *out, uint count) {
+    for (uint i = 0; i < count; i++)
+        out[i] = ntc_kelvin(in[i]);
+}
+
+static void check_accuracy(void) {
+    uint32_t mismatches = 0;
+    float max_error = 0;
+    uint16_t worst_sample = 0;
+    uint first = ntc_calibration[0].x;
+    uint last = ntc_calibration[count_of(ntc_calibration) - 1].x;
+    for (uint base = 0; base < 1u << INPUT_BITS; base += BLOCK_SIZE) {
+        for (uint i = 0; i < BLOCK_SIZE; i++)
+            samples[i] = base + i;
+        interp_lut_process(&lut, samples, centikelvin, BLOCK_SIZE);
+        interp_lut_ref_process(&lut, samples, centikelvin_ref, BLOCK_SIZE);
+        for (uint i = 0; i < BLOCK_SIZE; i++) {
+            mismatches += centikelvin[i] != centikelvin_ref[i];
+            // Only compare with the equation over the calibrated range
+            if (samples[i] >= first && samples[i] <= last) {
+                float error = fabsf(centikelvin[i] / 100.f - ntc_kelvin(samples[i]));
+                if (error > max_error) {
+                    max_error = error;
+                    worst_sample = samples[i];
+                }
+            }
+        }
+    }
+    printf("Samples differing from the reference: %lu\n", mismatches);
+    printf("Largest difference from the B equation: %.3f K at sample %u\n", max_error, worst_sample);
+}
+
+static void check_throughput(void) {
+    for (uint i = 0; i < BLOCK_SIZE; i++)
+        samples[i] = rand() & ((1 << INPUT_BITS) - 1);
+
+    // Run each once to warm up the flash cache before timing it
+    interp_lut_process(&lut, samples, centikelvin, BLOCK_SIZE);
+    uint32_t start = bench_cycle_count();
+    interp_lut_process(&lut, samples, centikelvin, BLOCK_SIZE);
+    uint32_t interp_cycles = (start - bench_cycle_count()) & 0xffffff;
+
+    interp_lut_ref_process(&lut, samples, centikelvin_ref, BLOCK_SIZE);
+    start = bench_cycle_count();
+    interp_lut_ref_process(&lut, samples, centikelvin_ref, BLOCK_SIZE);
+    uint32_t ref_cycles = (start - bench_cycle_count()) & 0xffffff;
+
+    float_process(samples, kelvin_float, BLOCK_SIZE);
+    start = bench_cycle_count();
+    float_process(samples, kelvin_float, BLOCK_SIZE);
+    uint32_t float_cycles = (start - bench_cycle_count()) & 0xffffff;
+
+    printf("\nCycles per sample, over %d samples\n", BLOCK_SIZE);
+    printf("interpolator  %5.1f\n", (float)interp_cycles / BLOCK_SIZE);
+    printf("reference     %5.1f\n", (float)ref_cycles / BLOCK_SIZE);
+    printf("float         %5.1f\n", (float)float_cycles / BLOCK_SIZE);
+}
+
+int main() {
+    stdio_init_all();
+    printf("Interpolator lookup tables\n");
+    bench_cycle_counter_init();
+
+    interp_lut_compile(&lut, ntc_calibration, count_of(ntc_calibration), INPUT_BITS, SEGMENT_BITS);
+    check_accuracy();
+    check_throughput();
+
+    // Free-running capture of full 12-bit samples into a halfword buffer
+    adc_gpio_init(26 + CAPTURE_CHANNEL);
+    adc_init();
+    adc_select_input(CAPTURE_CHANNEL);
+    adc_fifo_setup(true, true, 1, false, false);
+    // About 1000 samples per second
+    adc_set_clkdiv(48000 - 1);
+
+    uint dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config cfg = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_16);
+    channel_config_set_read_increment(&cfg, false);
+    channel_config_set_write_increment(&cfg, true);
+    channel_config_set_dreq(&cfg, DREQ_ADC);
+    dma_channel_configure(dma_chan, &cfg, samples, &adc_hw->fifo, BLOCK_SIZE, false);
+
+    printf("\nCapturing blocks of %d samples from GPIO %d\n", BLOCK_SIZE, 26 + CAPTURE_CHANNEL);
+    adc_run(true);
+    while (true) {
+        dma_channel_set_write_addr(dma_chan, samples, true);
+        dma_channel_wait_for_finish_blocking(dma_chan);
+
+        uint32_t start = bench_cycle_count();
+        interp_lut_process(&lut, samples, centikelvin, BLOCK_SIZE);
+        uint32_t cycles = (start - bench_cycle_count()) & 0xffffff;
+
+        uint32_t total = 0;
+        uint16_t min = UINT16_MAX;
+        uint16_t max = 0;
+        for (uint i = 0; i < BLOCK_SIZE; i++) {
+            total += centikelvin[i];
+            min = MIN(min, centikelvin[i]);
+            max = MAX(max, centikelvin[i]);
+        }
+        printf("mean %.2f C, min %.2f C, max %.2f C (converted in %lu cycles)\n",
+               (float)total / BLOCK_SIZE / 100.f - 273.15f, min / 100.f - 273.15f, max / 100.f - 273.15f, cycles);
+    }
+}
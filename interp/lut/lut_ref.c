@@ -0,0 +1,18 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "lut_ref.h"
+
+void interp_lut_ref_process(const interp_lut_t *lut, const uint16_t *in, uint16_t *out, uint count) {
+    uint32_t index_mask = (1u << lut->segment_bits) - 1;
+    for (uint i = 0; i < count; i++) {
+        uint32_t x = (uint32_t)in[i] << lut->preshift;
+        uint32_t entry = lut->entries[(x >> lut->frac_bits) & index_mask];
+        // The blend weight is the top 8 bits of the fraction
+        uint32_t alpha = (x >> (lut->frac_bits - 8)) & 0xff;
+        out[i] = ((entry & 0xffff) * (256 - alpha) + (entry >> 16) * alpha) >> 8;
+    }
+}
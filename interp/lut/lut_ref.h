@@ -0,0 +1,17 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _LUT_REF_H
+#define _LUT_REF_H
+
+#include "interp_lut.h"
+
+// Portable version of interp_lut_process(), giving exactly the same
+// results. It is used by interp_lut on the host, and on the device to check
+// the interpolator version against.
+void interp_lut_ref_process(const interp_lut_t *lut, const uint16_t *in, uint16_t *out, uint count);
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Accuracy checks for interp_lut against float references, for the host
+// build (PICO_PLATFORM=host), where the portable version in lut_ref.c does
+// the conversion. interp_lut_bench checks on the device that the
+// interpolator gives exactly the same results as lut_ref.c.
+//
+// For each table size:
+//
+// - every sample is within one output step, plus the 8-bit blend weight's
+//   rounding, of a straight line between the ends of its segment
+// - samples at the start of a segment give the table entry exactly
+// - the NTC thermistor table from lut_bench.c is within a set tolerance of
+//   the thermistor's B-parameter equation over the calibrated range
+//
+// Exits with 0 if every check passes.
+
+#include <stdio.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "interp_lut.h"
+#include "lut_ref.h"
+
+#define NTC_INPUT_BITS 12
+#define NTC_B 3950.0
+#define NTC_R25 10000.0
+#define PULLUP_OHMS 10000.0
+
+// The same curve as lut_bench.c, in hundredths of a kelvin
+static const interp_lut_point_t ntc_calibration[] = {
+        {267, 37315},
+        {305, 36815},
+        {350, 36315},
+        {401, 35815},
+        {462, 35315},
+        {532, 34815},
+        {613, 34315},
+        {707, 33815},
+        {816, 33315},
+        {940, 32815},
+        {1082, 32315},
+        {1241, 31815},
+        {1419, 31315},
+        {1614, 30815},
+        {1825, 30315},
+        {2048, 29815},
+        {2278, 29315},
+        {2511, 28815},
+        {2739, 28315},
+        {2956, 27815},
+        {3157, 27315},
+        {3338, 26815},
+        {3496, 26315},
+        {3630, 25815},
+        {3741, 25315},
+};
+
+// Largest difference from the B equation allowed for each number of segment
+// bits, in kelvin. Straight lines between the calibration points are within
+// 0.13 K of it, but the table is resampled at the segment ends, which cuts
+// the corners where the points don't line up with them, most of all at the
+// steep cold end.
+static const double ntc_tolerance[INTERP_LUT_MAX_SEGMENT_BITS + 1] = {
+        [4] = 3.0, [5] = 1.4, [6] = 1.4, [7] = 1.2, [8] = 0.6,
+};
+
+// A steep rising line and falling curves, for inputs with fewer than 8 bits
+// below the segment index (so samples are shifted up) as well as more
+static const interp_lut_point_t rising[] = {{0, 0}, {255, 65535}};
+static const interp_lut_point_t falling[] = {{10, 60000}, {200, 1000}, {255, 900}};
+static const interp_lut_point_t falling_wide[] = {{2560, 60000}, {51200, 1000}, {65280, 900}};
+
+static interp_lut_t lut;
+static uint16_t samples[1 << 16];
+static uint16_t out[1 << 16];
+static int failures;
+
+static double ntc_kelvin(uint16_t sample) {
+    double ohms = PULLUP_OHMS * sample / ((1 << NTC_INPUT_BITS) - sample);
+    return 1.0 / (1.0 / 298.15 + log(ohms / NTC_R25) / NTC_B);
+}
+
+static void convert_all(uint input_bits) {
+    for (uint i = 0; i < 1u << input_bits; i++)
+        samples[i] = i;
+    interp_lut_process(&lut, samples, out, 1u << input_bits);
+}
+
+// Check every sample against the straight line through its segment's ends
+static void check_segments(const char *name) {
+    uint32_t frac_bits = lut.input_bits - lut.segment_bits;
+    double worst = 0;
+    bool ok = true;
+    for (uint i = 0; i < 1u << lut.input_bits; i++) {
+        uint32_t entry = lut.entries[i >> frac_bits];
+        double y0 = entry & 0xffff;
+        double y1 = entry >> 16;
+        double t = (double)(i & ((1u << frac_bits) - 1)) / (1u << frac_bits);
+        double error = fabs(out[i] - (y0 + (y1 - y0) * t));
+        // The weight is rounded down to 8 bits, and so is the result
+        double allowed = 1 + fabs(y1 - y0) / 256;
+        if (error > allowed || (t == 0 && out[i] != y0)) {
+            if (ok)
+                printf("%s: sample %u gives %u, want %.2f\n", name, i, out[i], y0 + (y1 - y0) * t);
+            ok = false;
+        }
+        worst = MAX(worst, error);
+    }
+    printf("%-22s segments %s, worst error %.2f\n", name, ok ? "ok" : "FAILED", worst);
+    if (!ok)
+        failures++;
+}
+
+static void check_ntc(uint segment_bits) {
+    char name[32];
+    snprintf(name, sizeof(name), "ntc, %u segment bits", segment_bits);
+    interp_lut_compile(&lut, ntc_calibration, count_of(ntc_calibration), NTC_INPUT_BITS, segment_bits);
+    convert_all(NTC_INPUT_BITS);
+    check_segments(name);
+
+    double worst = 0;
+    uint first = ntc_calibration[0].x;
+    uint last = ntc_calibration[count_of(ntc_calibration) - 1].x;
+    for (uint i = first; i <= last; i++)
+        worst = MAX(worst, fabs(out[i] / 100.0 - ntc_kelvin(i)));
+    bool ok = worst < ntc_tolerance[segment_bits];
+    printf("%-22s B equation %s, worst error %.3f K\n", name, ok ? "ok" : "FAILED", worst);
+    if (!ok)
+        failures++;
+}
+
+static void check_line(const char *name, const interp_lut_point_t *points, uint n_points, uint input_bits,
+                       uint segment_bits) {
+    interp_lut_compile(&lut, points, n_points, input_bits, segment_bits);
+    convert_all(input_bits);
+    check_segments(name);
+}
+
+int main() {
+    stdio_init_all();
+    for (uint segment_bits = 4; segment_bits <= INTERP_LUT_MAX_SEGMENT_BITS; segment_bits++)
+        check_ntc(segment_bits);
+    check_line("rising, 8 bit input", rising, count_of(rising), 8, 8);
+    check_line("falling, 8 bit input", falling, count_of(falling), 8, 5);
+    check_line("falling, 16 bit input", falling_wide, count_of(falling_wide), 16, 8);
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Keep interrupt handlers short by deferring their work with the
+// deferred_work library, while several interrupt sources are active:
+//
+// - a repeating timer at 2kHz, whose callback posts a sample to be processed
+//   on core 1, and every 20th tick posts a slower log job to run on core 0
+// - a DMA channel copying a buffer around 1000 times a second, paced by a
+//   DMA timer, whose completion handler (like dma_complete_handler in
+//   pio/ws2812/ws2812_parallel.c) restarts the channel and posts the frame
+//   to core 1 to be checksummed
+//
+// The interrupt handlers only take a few microseconds, however long the work
+// takes. Every few seconds the latency histograms for each type of work are
+// printed, along with the longest time spent in each interrupt handler.
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "deferred_work.h"
+
+#define SAMPLE_PERIOD_US 500
+#define LOG_EVERY_SAMPLES 20
+#define FRAME_WORDS 256
+// One transfer every 500 system clock cycles, so about 1000 frames a second
+#define FRAME_TIMER_DENOMINATOR 500
+#define REPORT_MS 5000
+#define CORE1_READY_FLAG 123
+
+static void process_sample(uint32_t arg);
+static void write_log(uint32_t arg);
+static void checksum_frame(uint32_t arg);
+
+static deferred_work_type_t sample_work = DEFERRED_WORK_TYPE("sample", process_sample);
+static deferred_work_type_t log_work = DEFERRED_WORK_TYPE("log", write_log);
+static deferred_work_type_t frame_work = DEFERRED_WORK_TYPE("frame", checksum_frame);
+
+static uint32_t frame_src[FRAME_WORDS];
+static uint32_t frames[2][FRAME_WORDS];
+static uint frame_chan;
+static uint frame_count;
+static volatile uint32_t frame_checksum;
+
+static volatile uint32_t max_timer_isr_us;
+static volatile uint32_t max_dma_isr_us;
+
+static void process_sample(uint32_t arg) {
+    // Stand in for filtering or similar
+    busy_wait_us(40);
+}
+
+static void write_log(uint32_t arg) {
+    busy_wait_us(300);
+}
+
+static void checksum_frame(uint32_t arg) {
+    uint32_t sum = 0;
+    for (int i = 0; i < FRAME_WORDS; i++)
+        sum += frames[arg][i];
+    frame_checksum = sum;
+}
+
+static bool timer_callback(repeating_timer_t *rt) {
+    static uint32_t tick;
+    uint32_t start = time_us_32();
+    deferred_work_post(&sample_work, tick, 1);
+    if (++tick % LOG_EVERY_SAMPLES == 0)
+        deferred_work_post(&log_work, tick, 0);
+    uint32_t took = time_us_32() - start;
+    if (took > max_timer_isr_us)
+        max_timer_isr_us = took;
+    return true;
+}
+
+static void dma_complete_handler(void) {
+    uint32_t start = time_us_32();
+    dma_hw->ints0 = 1u << frame_chan;
+    // Double buffered, so the frame being checksummed isn't overwritten
+    uint done = frame_count++ & 1;
+    dma_channel_set_read_addr(frame_chan, frame_src, false);
+    dma_channel_set_write_addr(frame_chan, frames[done ^ 1], true);
+    deferred_work_post(&frame_work, done, 1);
+    uint32_t took = time_us_32() - start;
+    if (took > max_dma_isr_us)
+        max_dma_isr_us = took;
+}
+
+static void core1_entry(void) {
+    deferred_work_init();
+    // Work posted to core 1 before this would sit in its queue with no
+    // doorbell handler to run it, so tell core 0 it can start posting
+    multicore_fifo_push_blocking(CORE1_READY_FLAG);
+    while (true)
+        __wfi();
+}
+
+static void print_stats(deferred_work_type_t *type) {
+    printf("%s: %lu dropped\n", type->name, type->dropped[0] + type->dropped[1]);
+    for (uint core = 0; core < 2; core++) {
+        uint32_t total = 0;
+        for (int b = 0; b < DEFERRED_WORK_HISTOGRAM_BUCKETS; b++)
+            total += type->histogram[core][b];
+        if (!total)
+            continue;
+        printf("  core %u: %lu run, max latency %lu us\n", core, total, type->max_latency_us[core]);
+        printf("    latency us:");
+        for (int b = 0; b < DEFERRED_WORK_HISTOGRAM_BUCKETS; b++) {
+            if (type->histogram[core][b])
+                printf(" <%u:%lu", 1u << b, type->histogram[core][b]);
+        }
+        printf("\n");
+    }
+}
+
+int main() {
+    stdio_init_all();
+    printf("Deferred work\n");
+
+    multicore_launch_core1(core1_entry);
+    // Wait for core 1 before setting up core 0's own doorbell handler, which
+    // would otherwise swallow the flag
+    uint32_t g = multicore_fifo_pop_blocking();
+    if (g != CORE1_READY_FLAG) {
+        printf("Unexpected value from core 1: %lu\n", g);
+        return 1;
+    }
+    deferred_work_init();
+
+    for (int i = 0; i < FRAME_WORDS; i++)
+        frame_src[i] = i;
+
+    int timer = dma_claim_unused_timer(true);
+    dma_timer_set_fraction(timer, 1, FRAME_TIMER_DENOMINATOR);
+    frame_chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(frame_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_dreq(&c, dma_get_timer_dreq(timer));
+    dma_channel_configure(frame_chan, &c, frames[0], frame_src, FRAME_WORDS, false);
+    dma_channel_set_irq0_enabled(frame_chan, true);
+    irq_set_exclusive_handler(DMA_IRQ_0, dma_complete_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+    dma_channel_start(frame_chan);
+
+    repeating_timer_t rt;
+    add_repeating_timer_us(-SAMPLE_PERIOD_US, timer_callback, NULL, &rt);
+
+    while (true) {
+        sleep_ms(REPORT_MS);
+        printf("\nLongest interrupt handlers: timer %lu us, DMA %lu us\n", max_timer_isr_us, max_dma_isr_us);
+        print_stats(&sample_work);
+        print_stats(&log_work);
+        print_stats(&frame_work);
+    }
+}
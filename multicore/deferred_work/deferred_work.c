@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "deferred_work.h"
+#include "pico/multicore.h"
+#include "hardware/irq.h"
+#include "hardware/structs/timer.h"
+#include "hardware/sync.h"
+
+#define QUEUE_MASK (DEFERRED_WORK_QUEUE_SIZE - 1)
+#define DOORBELL 0
+
+typedef struct {
+    deferred_work_type_t *type;
+    uint32_t arg;
+    uint32_t posted_us;
+} work_item_t;
+
+typedef struct {
+    work_item_t items[DEFERRED_WORK_QUEUE_SIZE];
+    // tail is only written by the posting core, head by the servicing core
+    volatile uint32_t tail;
+    volatile uint32_t head;
+} work_queue_t;
+
+// Indexed by [posting core][servicing core]
+static work_queue_t queues[2][2];
+static uint user_irq[2];
+
+static void record_latency(deferred_work_type_t *type, uint core, uint32_t latency_us) {
+    uint bucket = latency_us ? 32 - __builtin_clz(latency_us) : 0;
+    if (bucket >= DEFERRED_WORK_HISTOGRAM_BUCKETS)
+        bucket = DEFERRED_WORK_HISTOGRAM_BUCKETS - 1;
+    type->histogram[core][bucket]++;
+    if (latency_us > type->max_latency_us[core])
+        type->max_latency_us[core] = latency_us;
+}
+
+static void service(void) {
+    uint core = get_core_num();
+    for (uint from = 0; from < 2; from++) {
+        work_queue_t *q = &queues[from][core];
+        while (q->head != q->tail) {
+            __dmb();
+            work_item_t item = q->items[q->head & QUEUE_MASK];
+            __dmb();
+            q->head++;
+            record_latency(item.type, core, timer_hw->timerawl - item.posted_us);
+            item.type->handler(item.arg);
+        }
+    }
+}
+
+static void user_irq_handler(void) {
+    service();
+}
+
+static void sio_irq_handler(void) {
+    // Doorbells carry no data; the queues say what to do
+    while (multicore_fifo_rvalid())
+        (void)multicore_fifo_pop_blocking();
+    multicore_fifo_clear_irq();
+    service();
+}
+
+void deferred_work_init(void) {
+    uint core = get_core_num();
+    user_irq[core] = user_irq_claim_unused(true);
+    irq_set_exclusive_handler(user_irq[core], user_irq_handler);
+    irq_set_priority(user_irq[core], PICO_LOWEST_IRQ_PRIORITY);
+    irq_set_enabled(user_irq[core], true);
+
+    uint sio_irq = core ? SIO_IRQ_PROC1 : SIO_IRQ_PROC0;
+    multicore_fifo_clear_irq();
+    irq_set_exclusive_handler(sio_irq, sio_irq_handler);
+    irq_set_priority(sio_irq, PICO_LOWEST_IRQ_PRIORITY);
+    irq_set_enabled(sio_irq, true);
+}
+
+bool deferred_work_post(deferred_work_type_t *type, uint32_t arg, int core) {
+    uint this_core = get_core_num();
+    uint to = core == DEFERRED_WORK_THIS_CORE ? this_core : core == DEFERRED_WORK_OTHER_CORE ? this_core ^ 1 : core;
+    work_queue_t *q = &queues[this_core][to];
+
+    // Higher priority interrupts on this core may post too
+    uint32_t save = save_and_disable_interrupts();
+    uint32_t tail = q->tail;
+    if (tail - q->head == DEFERRED_WORK_QUEUE_SIZE) {
+        type->dropped[this_core]++;
+        restore_interrupts(save);
+        return false;
+    }
+    work_item_t *item = &q->items[tail & QUEUE_MASK];
+    item->type = type;
+    item->arg = arg;
+    item->posted_us = timer_hw->timerawl;
+    __dmb();
+    q->tail = tail + 1;
+
+    if (to == this_core) {
+        irq_set_pending(user_irq[this_core]);
+    } else if (multicore_fifo_wready()) {
+        // If the FIFO is full there are doorbells waiting already
+        multicore_fifo_push_blocking(DOORBELL);
+    }
+    restore_interrupts(save);
+    return true;
+}
@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _DEFERRED_WORK_H
+#define _DEFERRED_WORK_H
+
+#include "pico/stdlib.h"
+
+// Deferred work ("bottom halves") for interrupt handlers.
+//
+// An interrupt handler that has more to do than acknowledge its peripheral
+// and grab its data can post a work item instead, and return. Work for the
+// posting core runs in a user IRQ at the lowest priority, so any other
+// interrupt can preempt it. Work for the other core is queued for that core,
+// and the inter-core FIFO is used as a doorbell to raise its SIO interrupt,
+// also at the lowest priority.
+//
+// There is a queue for each pair of posting and servicing cores. Posting
+// only disables interrupts on the posting core for a few instructions while
+// the item is added, and the servicing core is the only one taking items
+// off, so no locks are shared between the cores.
+//
+// Each type of work records a histogram of the time from posting to the
+// start of its handler, separately for each core that runs it.
+//
+// The FIFO must not be used for anything else once deferred_work_init() has
+// been called, and it must be called after multicore_launch_core1().
+
+#ifndef DEFERRED_WORK_QUEUE_SIZE
+#define DEFERRED_WORK_QUEUE_SIZE 32
+#endif
+
+#if DEFERRED_WORK_QUEUE_SIZE & (DEFERRED_WORK_QUEUE_SIZE - 1)
+#error DEFERRED_WORK_QUEUE_SIZE must be a power of two
+#endif
+
+// Bucket 0 counts latencies under 1us, and bucket n counts latencies from
+// 2^(n-1) up to 2^n us. The last bucket counts everything longer.
+#define DEFERRED_WORK_HISTOGRAM_BUCKETS 16
+
+// Pass as the `core` to deferred_work_post()
+#define DEFERRED_WORK_THIS_CORE -1
+#define DEFERRED_WORK_OTHER_CORE -2
+
+typedef struct {
+    const char *name;
+    void (*handler)(uint32_t arg);
+    // Indexed by the core that ran the work
+    uint32_t histogram[2][DEFERRED_WORK_HISTOGRAM_BUCKETS];
+    uint32_t max_latency_us[2];
+    // Indexed by the core that tried to post the work
+    uint32_t dropped[2];
+} deferred_work_type_t;
+
+#define DEFERRED_WORK_TYPE(type_name, type_handler) { .name = type_name, .handler = type_handler }
+
+// Start servicing work on the calling core. Call once on each core that
+// should run work.
+void deferred_work_init(void);
+
+// Queue `type`'s handler to be called with `arg` on `core` (0, 1,
+// DEFERRED_WORK_THIS_CORE or DEFERRED_WORK_OTHER_CORE). Returns false, and
+// counts the work as dropped, if that queue is full. Safe to call from any
+// interrupt handler.
+bool deferred_work_post(deferred_work_type_t *type, uint32_t arg, int core);
+
+#endif
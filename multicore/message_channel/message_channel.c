@@ -0,0 +1,186 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Compare msg_channel with pushing values through the inter-core FIFO
+// directly, measuring:
+//
+// - messages per second from core 0 to core 1, with the FIFO carrying one
+//   32-bit word per message and the channel carrying messages of a few sizes,
+//   flushed in batches
+// - wake latency: how long core 1 takes to see a message when it's asleep
+//   waiting for one
+//
+// Timestamps come from bench_timestamp(), a free-running PWM counter clocked
+// at the system clock rate, which both cores can read.
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "bench.h"
+#include "msg_channel.h"
+
+#define THROUGHPUT_MESSAGES 20000
+#define LATENCY_REPEATS 200
+#define CHANNEL_SIZE 4096
+
+static uint32_t to_core1_buf[CHANNEL_SIZE / 4];
+static uint32_t to_core0_buf[CHANNEL_SIZE / 4];
+static msg_channel_t to_core1;
+static msg_channel_t to_core0;
+
+static const uint32_t message_lens[] = {4, 16, 64};
+static const uint batch_sizes[] = {1, 16};
+
+static void core1_fifo_sink(void) {
+    // Count values until the last one, then report how many were in order
+    uint32_t good = 0;
+    for (uint32_t i = 0; i < THROUGHPUT_MESSAGES; i++)
+        good += multicore_fifo_pop_blocking() == i;
+    multicore_fifo_push_blocking(good);
+    while (true)
+        tight_loop_contents();
+}
+
+static void core1_fifo_wake(void) {
+    while (true) {
+        uint16_t sent = multicore_fifo_pop_blocking();
+        multicore_fifo_push_blocking((uint16_t)(bench_timestamp() - sent));
+    }
+}
+
+static void core1_channel_sink(void) {
+    // The first word of each message is its sequence number
+    uint32_t good = 0;
+    for (uint32_t i = 0; i < THROUGHPUT_MESSAGES; i++) {
+        msg_channel_wait(&to_core1);
+        uint32_t len;
+        const uint32_t *msg = msg_channel_receive(&to_core1, &len);
+        good += msg[0] == i;
+        msg_channel_release(&to_core1);
+    }
+    msg_channel_send_blocking(&to_core0, &good, sizeof(good));
+    while (true)
+        tight_loop_contents();
+}
+
+static void core1_channel_wake(void) {
+    while (true) {
+        msg_channel_wait(&to_core1);
+        uint16_t now = bench_timestamp();
+        uint32_t len;
+        const uint16_t *sent = msg_channel_receive(&to_core1, &len);
+        uint32_t latency = (uint16_t)(now - *sent);
+        msg_channel_release(&to_core1);
+        msg_channel_send_blocking(&to_core0, &latency, sizeof(latency));
+    }
+}
+
+static void channels_init(void) {
+    msg_channel_init(&to_core1, to_core1_buf, CHANNEL_SIZE);
+    msg_channel_init(&to_core0, to_core0_buf, CHANNEL_SIZE);
+}
+
+static uint32_t channel_reply(void) {
+    msg_channel_wait(&to_core0);
+    uint32_t len;
+    uint32_t value = *(const uint32_t *)msg_channel_receive(&to_core0, &len);
+    msg_channel_release(&to_core0);
+    return value;
+}
+
+static void print_throughput(const char *method, uint32_t len, uint batch, uint64_t us, uint32_t good,
+                             uint32_t doorbells) {
+    uint32_t per_sec = THROUGHPUT_MESSAGES * 1000000ull / us;
+    printf("%-8s %4lu %6u %9lu %8lu %9lu%s\n", method, len, batch, per_sec, per_sec * len / 1024, doorbells,
+           good == THROUGHPUT_MESSAGES ? "" : "  ERROR - messages lost or out of order");
+}
+
+static void bench_fifo_throughput(void) {
+    multicore_launch_core1(core1_fifo_sink);
+    uint64_t start = time_us_64();
+    for (uint32_t i = 0; i < THROUGHPUT_MESSAGES; i++)
+        multicore_fifo_push_blocking(i);
+    uint32_t good = multicore_fifo_pop_blocking();
+    print_throughput("fifo", 4, 1, time_us_64() - start, good, THROUGHPUT_MESSAGES);
+    multicore_reset_core1();
+}
+
+static void bench_channel_throughput(uint32_t len, uint batch) {
+    channels_init();
+    multicore_launch_core1(core1_channel_sink);
+    uint64_t start = time_us_64();
+    for (uint32_t i = 0; i < THROUGHPUT_MESSAGES; i++) {
+        uint32_t *msg = msg_channel_reserve_blocking(&to_core1, len);
+        msg[0] = i;
+        msg_channel_commit(&to_core1);
+        if ((i + 1) % batch == 0)
+            msg_channel_flush(&to_core1);
+    }
+    msg_channel_flush(&to_core1);
+    uint32_t good = channel_reply();
+    print_throughput("channel", len, batch, time_us_64() - start, good, to_core1.doorbells);
+    multicore_reset_core1();
+}
+
+static void print_latency(const char *method, uint32_t min, uint32_t total, uint32_t max) {
+    printf("%-8s %4lu %4lu %4lu\n", method, min, total / LATENCY_REPEATS, max);
+}
+
+static void bench_fifo_latency(void) {
+    multicore_launch_core1(core1_fifo_wake);
+    uint32_t min = UINT32_MAX, max = 0, total = 0;
+    for (int i = 0; i < LATENCY_REPEATS; i++) {
+        // Give core 1 time to go to sleep
+        sleep_us(100);
+        multicore_fifo_push_blocking(bench_timestamp());
+        uint32_t latency = multicore_fifo_pop_blocking();
+        min = MIN(min, latency);
+        max = MAX(max, latency);
+        total += latency;
+    }
+    print_latency("fifo", min, total, max);
+    multicore_reset_core1();
+}
+
+static void bench_channel_latency(void) {
+    channels_init();
+    multicore_launch_core1(core1_channel_wake);
+    uint32_t min = UINT32_MAX, max = 0, total = 0;
+    for (int i = 0; i < LATENCY_REPEATS; i++) {
+        sleep_us(100);
+        uint16_t *msg = msg_channel_reserve_blocking(&to_core1, sizeof(uint16_t));
+        *msg = bench_timestamp();
+        msg_channel_commit(&to_core1);
+        msg_channel_flush(&to_core1);
+        uint32_t latency = channel_reply();
+        min = MIN(min, latency);
+        max = MAX(max, latency);
+        total += latency;
+    }
+    print_latency("channel", min, total, max);
+    multicore_reset_core1();
+}
+
+int main() {
+    stdio_init_all();
+    printf("Inter-core message channel benchmark\n");
+
+    bench_timestamp_init();
+
+    printf("\n%lu messages from core 0 to core 1\n", THROUGHPUT_MESSAGES);
+    printf("method    len  batch  msgs/sec   KB/sec doorbells\n");
+    bench_fifo_throughput();
+    for (int l = 0; l < count_of(message_lens); l++) {
+        for (int b = 0; b < count_of(batch_sizes); b++)
+            bench_channel_throughput(message_lens[l], batch_sizes[b]);
+    }
+
+    printf("\nWake latency (cycles)\n");
+    printf("method    min  avg  max\n");
+    bench_fifo_latency();
+    bench_channel_latency();
+}
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "msg_channel.h"
+#include "pico/multicore.h"
+
+// Written in place of a message header when a message wouldn't fit before
+// the end of the buffer, to send the consumer back to the start
+#define WRAP_MARKER 0xffffffffu
+#define DOORBELL 0
+
+static inline uint32_t record_len(uint32_t len) {
+    return sizeof(uint32_t) + ((len + 3) & ~3u);
+}
+
+void msg_channel_init(msg_channel_t *ch, void *buf, uint32_t size) {
+    if (size & (size - 1))
+        panic("Channel size %lu is not a power of two", size);
+    memset(ch, 0, sizeof(*ch));
+    ch->buf = buf;
+    ch->size = size;
+}
+
+void *msg_channel_reserve(msg_channel_t *ch, uint32_t len) {
+    uint32_t need = record_len(len);
+    if (need > ch->size / 2)
+        panic("Message of %lu bytes is too big for the channel", len);
+
+    uint32_t offset = ch->write_pos & (ch->size - 1);
+    uint32_t to_end = ch->size - offset;
+    uint32_t pad = need > to_end ? to_end : 0;
+    if (ch->size - (ch->write_pos - ch->head) < pad + need)
+        return NULL;
+
+    if (pad) {
+        *(uint32_t *)(ch->buf + offset) = WRAP_MARKER;
+        ch->write_pos += pad;
+        offset = 0;
+    }
+    *(uint32_t *)(ch->buf + offset) = len;
+    ch->reserved_len = len;
+    return ch->buf + offset + sizeof(uint32_t);
+}
+
+void *msg_channel_reserve_blocking(msg_channel_t *ch, uint32_t len) {
+    void *msg = msg_channel_reserve(ch, len);
+    if (!msg) {
+        // The consumer may be asleep with a full ring it hasn't been told
+        // about yet
+        msg_channel_flush(ch);
+        while (!(msg = msg_channel_reserve(ch, len)))
+            tight_loop_contents();
+    }
+    return msg;
+}
+
+void msg_channel_commit(msg_channel_t *ch) {
+    ch->write_pos += record_len(ch->reserved_len);
+    // Make sure the message is written before the consumer can see it
+    __dmb();
+    ch->tail = ch->write_pos;
+}
+
+void msg_channel_flush(msg_channel_t *ch) {
+    // The consumer sets its flag before checking the ring for the last time,
+    // so either it sees our messages or we see the flag
+    __dmb();
+    if (ch->consumer_waiting) {
+        ch->consumer_waiting = false;
+        // If the FIFO is full, the consumer has doorbells waiting already
+        if (multicore_fifo_wready()) {
+            multicore_fifo_push_blocking(DOORBELL);
+            ch->doorbells++;
+        }
+    }
+}
+
+void msg_channel_send_blocking(msg_channel_t *ch, const void *data, uint32_t len) {
+    memcpy(msg_channel_reserve_blocking(ch, len), data, len);
+    msg_channel_commit(ch);
+    msg_channel_flush(ch);
+}
+
+const void *msg_channel_receive(msg_channel_t *ch, uint32_t *len) {
+    uint32_t head = ch->head;
+    if (head == ch->tail)
+        return NULL;
+    __dmb();
+    uint32_t offset = head & (ch->size - 1);
+    uint32_t header = *(uint32_t *)(ch->buf + offset);
+    if (header == WRAP_MARKER) {
+        // The wrap and the message after it are committed together
+        ch->head = head + ch->size - offset;
+        offset = 0;
+        header = *(uint32_t *)ch->buf;
+    }
+    ch->read_len = header;
+    *len = header;
+    return ch->buf + offset + sizeof(uint32_t);
+}
+
+void msg_channel_release(msg_channel_t *ch) {
+    // Finish reading the message before the producer can overwrite it
+    __dmb();
+    ch->head += record_len(ch->read_len);
+}
+
+void msg_channel_wait(msg_channel_t *ch) {
+    while (ch->head == ch->tail) {
+        ch->consumer_waiting = true;
+        __dmb();
+        if (ch->head != ch->tail)
+            break;
+        // Sleeps until the producer rings. A doorbell left over from an
+        // earlier wait just sends us round the loop again.
+        multicore_fifo_pop_blocking();
+    }
+    ch->consumer_waiting = false;
+}
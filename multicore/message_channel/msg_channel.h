@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _MSG_CHANNEL_H
+#define _MSG_CHANNEL_H
+
+#include "pico/stdlib.h"
+
+// A one-way channel for variable-size messages from one core to the other.
+//
+// Messages are written straight into a ring buffer in shared memory, and read
+// in place by the other core, so nothing is copied on the way. There is
+// exactly one producer and one consumer, so the ring needs no locks.
+//
+// The inter-core FIFO is only used as a doorbell, to wake a consumer that is
+// asleep in msg_channel_wait(). The producer only rings it when the consumer
+// says it is waiting, and msg_channel_commit() doesn't ring it at all: a
+// batch of messages can be committed and then handed over with a single
+// msg_channel_flush(). Doorbells carry no data and consumers always recheck
+// their ring after waking, so a channel in each direction (or several) can
+// share the FIFOs, but nothing else should use them.
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    // Free-running byte positions: everything before tail has been
+    // committed, and everything before head has been released
+    volatile uint32_t tail;
+    volatile uint32_t head;
+    volatile bool consumer_waiting;
+    // Producer's position, including reserved but uncommitted bytes
+    uint32_t write_pos;
+    uint32_t reserved_len;
+    // Size of the message the consumer is looking at
+    uint32_t read_len;
+    // Number of doorbells rung, for comparing with the message count
+    uint32_t doorbells;
+} msg_channel_t;
+
+// Set up a channel using `buf`, which must be word aligned and a power of
+// two bytes long. Each message takes its length rounded up to a multiple of
+// 4, plus 4 bytes, and may take up to half the buffer.
+void msg_channel_init(msg_channel_t *ch, void *buf, uint32_t size);
+
+// Producer: return space for a message of `len` bytes, or NULL if there
+// isn't room yet. Only one message can be reserved at a time.
+void *msg_channel_reserve(msg_channel_t *ch, uint32_t len);
+
+// Producer: as msg_channel_reserve(), but wait for room, flushing first
+// so the consumer can make some
+void *msg_channel_reserve_blocking(msg_channel_t *ch, uint32_t len);
+
+// Producer: make the reserved message visible to the consumer, without
+// waking it
+void msg_channel_commit(msg_channel_t *ch);
+
+// Producer: wake the consumer if it's waiting for messages
+void msg_channel_flush(msg_channel_t *ch);
+
+// Producer: copy in a message, commit it and flush
+void msg_channel_send_blocking(msg_channel_t *ch, const void *data, uint32_t len);
+
+// Consumer: return the next message and set `len` to its length, or return
+// NULL if there are none. The message stays valid until it is released.
+const void *msg_channel_receive(msg_channel_t *ch, uint32_t *len);
+
+// Consumer: hand the space used by the received message back to the producer
+void msg_channel_release(msg_channel_t *ch);
+
+// Consumer: sleep until there is a message to receive
+void msg_channel_wait(msg_channel_t *ch);
+
+#endif
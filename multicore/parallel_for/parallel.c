@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "parallel.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+typedef struct {
+    parallel_for_func_t for_fn;
+    parallel_reduce_func_t reduce_fn;
+    parallel_combine_func_t combine;
+    uint32_t identity;
+    void *ctx;
+    uint32_t end;
+    uint32_t grain;
+    // Start of the next chunk to hand out, protected by the lock
+    uint32_t next;
+} job_t;
+
+static spin_lock_t *lock;
+
+// Claim the next chunk, returning false when there are none left
+static bool claim_chunk(job_t *job, uint32_t *begin, uint32_t *end) {
+    uint32_t save = spin_lock_blocking(lock);
+    *begin = job->next;
+    if (*begin < job->end) {
+        *end = job->end - *begin > job->grain ? *begin + job->grain : job->end;
+        job->next = *end;
+    }
+    spin_unlock(lock, save);
+    return *begin < job->end;
+}
+
+// Run chunks until there are none left, and return this core's result
+static uint32_t run_chunks(job_t *job) {
+    uint32_t result = job->identity;
+    uint32_t begin, end;
+    while (claim_chunk(job, &begin, &end)) {
+        if (job->reduce_fn)
+            result = job->combine(result, job->reduce_fn(begin, end, job->ctx), job->ctx);
+        else
+            job->for_fn(begin, end, job->ctx);
+    }
+    return result;
+}
+
+static void core1_worker(void) {
+    while (true) {
+        job_t *job = (job_t *)(uintptr_t)multicore_fifo_pop_blocking();
+        multicore_fifo_push_blocking(run_chunks(job));
+    }
+}
+
+void parallel_init(void) {
+    lock = spin_lock_instance(spin_lock_claim_unused(true));
+    multicore_launch_core1(core1_worker);
+}
+
+static uint32_t run_job(job_t *job, uint32_t begin) {
+    job->next = begin;
+    if (job->grain == 0)
+        job->grain = 1;
+    // Not worth waking core 1 for
+    if (job->end - begin < 2 * job->grain)
+        return run_chunks(job);
+
+    multicore_fifo_push_blocking((uintptr_t)job);
+    uint32_t result = run_chunks(job);
+    uint32_t core1_result = multicore_fifo_pop_blocking();
+    return job->reduce_fn ? job->combine(result, core1_result, job->ctx) : result;
+}
+
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, parallel_for_func_t fn, void *ctx) {
+    if (begin >= end)
+        return;
+    job_t job = {
+        .for_fn = fn,
+        .ctx = ctx,
+        .end = end,
+        .grain = grain,
+    };
+    run_job(&job, begin);
+}
+
+uint32_t parallel_reduce(uint32_t begin, uint32_t end, uint32_t grain, parallel_reduce_func_t fn,
+                         parallel_combine_func_t combine, uint32_t identity, void *ctx) {
+    if (begin >= end)
+        return identity;
+    job_t job = {
+        .reduce_fn = fn,
+        .combine = combine,
+        .identity = identity,
+        .ctx = ctx,
+        .end = end,
+        .grain = grain,
+    };
+    return run_job(&job, begin);
+}
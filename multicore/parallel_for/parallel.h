@@ -0,0 +1,45 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include "pico/stdlib.h"
+
+// Split a loop between both cores.
+//
+// The range [begin, end) is handed out `grain` indices at a time to whichever
+// core is free, so uneven work still balances. Core 1 sleeps in
+// multicore_fifo_pop_blocking() between loops: the inter-core FIFO is the
+// doorbell that starts it, and carries its part of a reduction back.
+//
+// parallel_for() and parallel_reduce() must be called from core 0, and the
+// FIFO must not be used for anything else once parallel_init() has been
+// called.
+
+// Called with a sub-range of [begin, end)
+typedef void (*parallel_for_func_t)(uint32_t begin, uint32_t end, void *ctx);
+
+// Called with a sub-range of [begin, end), returning its part of the result
+typedef uint32_t (*parallel_reduce_func_t)(uint32_t begin, uint32_t end, void *ctx);
+
+// Combines two partial results. Sub-ranges finish in any order, so this
+// must be associative and commutative.
+typedef uint32_t (*parallel_combine_func_t)(uint32_t a, uint32_t b, void *ctx);
+
+// Launch the worker on core 1
+void parallel_init(void);
+
+// Call `fn` on sub-ranges covering [begin, end), using both cores, and return
+// once all are done. Ranges of less than two grains run on core 0 alone.
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, parallel_for_func_t fn, void *ctx);
+
+// Call `fn` on sub-ranges covering [begin, end), using both cores, and return
+// `identity` combined with all of their results
+uint32_t parallel_reduce(uint32_t begin, uint32_t end, uint32_t grain, parallel_reduce_func_t fn,
+                         parallel_combine_func_t combine, uint32_t identity, void *ctx);
+
+#endif
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Measure the speedup from splitting two workloads between the cores with
+// parallel_for() and parallel_reduce(), at a few different grain sizes:
+//
+// - converting an RGB565 image to 8-bit greyscale
+// - a 32-bit additive checksum over a buffer
+//
+// Each result is checked against a single-core run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "parallel.h"
+
+#define IMAGE_WIDTH 160
+#define IMAGE_HEIGHT 120
+#define IMAGE_PIXELS (IMAGE_WIDTH * IMAGE_HEIGHT)
+#define CHECKSUM_WORDS (64 * 1024 / 4)
+#define REPEATS 8
+
+static uint16_t rgb565[IMAGE_PIXELS];
+static uint8_t grey[IMAGE_PIXELS];
+static uint8_t grey_reference[IMAGE_PIXELS];
+static uint32_t checksum_buf[CHECKSUM_WORDS];
+
+static const uint32_t grains[] = {64, 512, 4096};
+
+static void to_grey(uint32_t begin, uint32_t end, void *ctx) {
+    uint8_t *out = ctx;
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t p = rgb565[i];
+        // Expand each channel to 8 bits, then weight them roughly as in BT.601
+        uint32_t r = (p >> 11) << 3;
+        uint32_t g = ((p >> 5) & 0x3f) << 2;
+        uint32_t b = (p & 0x1f) << 3;
+        out[i] = (r * 77 + g * 150 + b * 29) >> 8;
+    }
+}
+
+static uint32_t checksum(uint32_t begin, uint32_t end, void *ctx) {
+    const uint32_t *words = ctx;
+    uint32_t sum = 0;
+    for (uint32_t i = begin; i < end; i++)
+        sum += words[i];
+    return sum;
+}
+
+static uint32_t add(uint32_t a, uint32_t b, void *ctx) {
+    return a + b;
+}
+
+static void print_speedup(uint32_t grain, uint64_t single_us, uint64_t parallel_us, bool ok) {
+    printf("%8lu  %9lu  %11lu  %7.2f%s\n", grain, (uint32_t)single_us, (uint32_t)parallel_us,
+           (float)single_us / parallel_us, ok ? "" : "  ERROR - result differs");
+}
+
+int main() {
+    stdio_init_all();
+    printf("Parallel for/reduce benchmark\n");
+    parallel_init();
+
+    for (int i = 0; i < IMAGE_PIXELS; i++)
+        rgb565[i] = rand();
+    for (int i = 0; i < CHECKSUM_WORDS; i++)
+        checksum_buf[i] = rand();
+
+    uint64_t start = time_us_64();
+    for (int r = 0; r < REPEATS; r++)
+        to_grey(0, IMAGE_PIXELS, grey_reference);
+    uint64_t single_us = time_us_64() - start;
+
+    printf("\nRGB565 to greyscale, %dx%d, %d repeats\n", IMAGE_WIDTH, IMAGE_HEIGHT, REPEATS);
+    printf("   grain  1 core us  2 cores us  speedup\n");
+    for (int g = 0; g < count_of(grains); g++) {
+        memset(grey, 0, sizeof(grey));
+        start = time_us_64();
+        for (int r = 0; r < REPEATS; r++)
+            parallel_for(0, IMAGE_PIXELS, grains[g], to_grey, grey);
+        uint64_t parallel_us = time_us_64() - start;
+        print_speedup(grains[g], single_us, parallel_us, !memcmp(grey, grey_reference, sizeof(grey)));
+    }
+
+    uint32_t expected = 0;
+    start = time_us_64();
+    for (int r = 0; r < REPEATS; r++)
+        expected = checksum(0, CHECKSUM_WORDS, checksum_buf);
+    single_us = time_us_64() - start;
+
+    printf("\nChecksum of %d bytes, %d repeats\n", CHECKSUM_WORDS * 4, REPEATS);
+    printf("   grain  1 core us  2 cores us  speedup\n");
+    for (int g = 0; g < count_of(grains); g++) {
+        uint32_t sum = 0;
+        start = time_us_64();
+        for (int r = 0; r < REPEATS; r++)
+            sum = parallel_reduce(0, CHECKSUM_WORDS, grains[g], checksum, add, 0, checksum_buf);
+        uint64_t parallel_us = time_us_64() - start;
+        print_speedup(grains[g], single_us, parallel_us, sum == expected);
+    }
+}
@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "thread_pool.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+#if !THREAD_POOL_TRACE
+#define TRACE_ENABLED 0
+#endif
+#include "trace.h"
+
+#define QUEUE_MASK (THREAD_POOL_QUEUE_SIZE - 1)
+
+// A slot at position `pos` is free when seq == pos, filled when
+// seq == pos + 1, and free again for position pos + THREAD_POOL_QUEUE_SIZE
+// once its task has been copied out
+typedef struct {
+    volatile uint32_t seq;
+    thread_pool_task_t task;
+} slot_t;
+
+static slot_t slots[THREAD_POOL_QUEUE_SIZE];
+
+// Next positions to fill and to empty, only touched with the lock held
+static uint32_t tail;
+static uint32_t head;
+static spin_lock_t *lock;
+
+static volatile uint32_t tasks_run[2];
+
+TRACE_NAME(trace_task, "task");
+TRACE_NAME(trace_submit, "submit");
+TRACE_NAME(trace_queue_full, "queue full");
+
+static void core1_worker(void) {
+    while (true) {
+        // Producers signal an event after filling slots
+        if (!thread_pool_run_one())
+            __wfe();
+    }
+}
+
+void thread_pool_init(void) {
+    lock = spin_lock_instance(spin_lock_claim_unused(true));
+    for (uint i = 0; i < THREAD_POOL_QUEUE_SIZE; i++)
+        slots[i].seq = i;
+    multicore_launch_core1(core1_worker);
+}
+
+bool thread_pool_try_submit(const thread_pool_task_t *tasks, uint n) {
+    if (n > THREAD_POOL_QUEUE_SIZE)
+        panic("Can't submit %u tasks at once", n);
+
+    uint32_t save = spin_lock_blocking(lock);
+    uint32_t pos = tail;
+    for (uint i = 0; i < n; i++) {
+        if (slots[(pos + i) & QUEUE_MASK].seq != pos + i) {
+            spin_unlock(lock, save);
+            trace_instant(trace_queue_full, n);
+            return false;
+        }
+    }
+    tail = pos + n;
+    spin_unlock(lock, save);
+    trace_instant(trace_submit, n);
+
+    // The slots are ours now, so fill them without holding the lock
+    for (uint i = 0; i < n; i++) {
+        slot_t *slot = &slots[(pos + i) & QUEUE_MASK];
+        slot->task = tasks[i];
+        if (tasks[i].future)
+            tasks[i].future->done = false;
+        __dmb();
+        slot->seq = pos + i + 1;
+    }
+    __sev();
+    return true;
+}
+
+void thread_pool_submit_blocking(const thread_pool_task_t *tasks, uint n) {
+    while (!thread_pool_try_submit(tasks, n)) {
+        if (!thread_pool_run_one())
+            tight_loop_contents();
+    }
+}
+
+// Kept in RAM, as both cores run it constantly
+bool __not_in_flash_func(thread_pool_run_one)(void) {
+    uint32_t save = spin_lock_blocking(lock);
+    uint32_t pos = head;
+    slot_t *slot = &slots[pos & QUEUE_MASK];
+    if (slot->seq != pos + 1) {
+        spin_unlock(lock, save);
+        return false;
+    }
+    head = pos + 1;
+    spin_unlock(lock, save);
+
+    thread_pool_task_t task = slot->task;
+    __dmb();
+    slot->seq = pos + THREAD_POOL_QUEUE_SIZE;
+
+    trace_begin(trace_task, pos);
+    int32_t result = task.func(task.data);
+    trace_end(trace_task, pos);
+    tasks_run[get_core_num()]++;
+    if (task.future) {
+        task.future->result = result;
+        __dmb();
+        task.future->done = true;
+        // Wake the other core if it's waiting for this
+        __sev();
+    }
+    return true;
+}
+
+int32_t thread_pool_wait(thread_pool_future_t *future) {
+    while (!future->done) {
+        // If there's nothing to help with, sleep until the other core
+        // finishes something
+        if (!thread_pool_run_one())
+            __wfe();
+    }
+    __dmb();
+    return future->result;
+}
+
+void thread_pool_wait_all(thread_pool_future_t *futures, uint n) {
+    for (uint i = 0; i < n; i++)
+        thread_pool_wait(&futures[i]);
+}
+
+uint32_t thread_pool_tasks_run(uint core) {
+    return tasks_run[core];
+}
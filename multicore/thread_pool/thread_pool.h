@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include "pico/stdlib.h"
+
+// A task pool running on both cores.
+//
+// Tasks are queued in a bounded ring shared by both cores. Core 1 runs a
+// worker that takes tasks from the ring, and core 0 helps out whenever it
+// waits for a result, so both cores do useful work. Each task can have a
+// future, which is marked done when the task's result is ready.
+//
+// The RP2040's cores have no compare-and-swap, so an SIO spinlock guards the
+// ring's head and tail positions. It is only held to claim slots; tasks are
+// copied in and out, and run, without it. Each slot carries a sequence
+// number that says whether it is free, filled or being emptied, so a
+// producer or consumer never waits for another one part way through.
+//
+// Tasks may be submitted from either core, and from interrupt handlers using
+// thread_pool_try_submit().
+
+// Define THREAD_POOL_TRACE to 1 (e.g. with target_compile_definitions on the
+// executable) to record each task submitted and run with system/trace
+#ifndef THREAD_POOL_TRACE
+#define THREAD_POOL_TRACE 0
+#endif
+
+#ifndef THREAD_POOL_QUEUE_SIZE
+#define THREAD_POOL_QUEUE_SIZE 64
+#endif
+
+#if THREAD_POOL_QUEUE_SIZE & (THREAD_POOL_QUEUE_SIZE - 1)
+#error THREAD_POOL_QUEUE_SIZE must be a power of two
+#endif
+
+typedef int32_t (*thread_pool_func_t)(void *data);
+
+typedef struct {
+    volatile bool done;
+    int32_t result;
+} thread_pool_future_t;
+
+typedef struct {
+    thread_pool_func_t func;
+    void *data;
+    // May be NULL if nobody needs the result
+    thread_pool_future_t *future;
+} thread_pool_task_t;
+
+// Set up the pool and launch its worker on core 1. Call from core 0.
+void thread_pool_init(void);
+
+// Queue `n` tasks, all or none. Returns false if there isn't room for all of
+// them. Their futures are marked not done.
+bool thread_pool_try_submit(const thread_pool_task_t *tasks, uint n);
+
+// Queue `n` tasks, running tasks on this core while waiting for room
+void thread_pool_submit_blocking(const thread_pool_task_t *tasks, uint n);
+
+// Run one queued task on the calling core. Returns false if none was ready.
+bool thread_pool_run_one(void);
+
+// Wait for the future's task to finish, running other tasks meanwhile, and
+// return its result
+int32_t thread_pool_wait(thread_pool_future_t *future);
+
+// Wait for all of `n` futures
+void thread_pool_wait_all(thread_pool_future_t *futures, uint n);
+
+// The number of tasks each core has run
+uint32_t thread_pool_tasks_run(uint core);
+
+#endif
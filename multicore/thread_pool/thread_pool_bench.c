@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Compare the thread_pool library with the queue_add_blocking round trip
+// used by the multicore_runner_queue example.
+//
+// For each, measure the dispatch latency (the time from core 0 handing over
+// a task that does nothing to it seeing the result) and the number of tasks
+// per second, both for empty tasks and for tasks that do a little work. The
+// queue sends one task at a time and waits for its result; the pool takes
+// tasks in batches and runs them on both cores.
+//
+// Build with THREAD_POOL_TRACE=1 to dump the pool's most recent task events
+// at the end for system/trace/trace_to_json.py, showing how the tasks were
+// shared out.
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "pico/util/queue.h"
+#include "bench.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#define LATENCY_REPEATS 1000
+#define THROUGHPUT_TASKS 4096
+#define BATCH_SIZE 32
+// Loop iterations in each "work" task
+#define WORK_ITERATIONS 200
+
+typedef struct {
+    thread_pool_func_t func;
+    void *data;
+} queue_entry_t;
+
+static queue_t call_queue;
+static queue_t results_queue;
+
+static int32_t nop_task(void *data) {
+    return (int32_t)(uintptr_t)data;
+}
+
+static int32_t work_task(void *data) {
+    // A little xorshift, which the compiler can't skip
+    uint32_t x = (uintptr_t)data + 1;
+    for (int i = 0; i < WORK_ITERATIONS; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+    }
+    return (int32_t)x;
+}
+
+static const struct {
+    const char *name;
+    thread_pool_func_t func;
+} task_types[] = {
+    {"empty", nop_task},
+    {"work", work_task},
+};
+
+static int32_t expected_sum(thread_pool_func_t func) {
+    int32_t sum = 0;
+    for (uint i = 0; i < THROUGHPUT_TASKS; i++)
+        sum += func((void *)(uintptr_t)i);
+    return sum;
+}
+
+static void print_throughput(const char *method, const char *task, uint64_t us, int32_t sum, int32_t expected) {
+    printf("%-12s %-6s %8lu tasks/s%s\n", method, task, (uint32_t)(THROUGHPUT_TASKS * 1000000ull / us),
+           sum == expected ? "" : "  ERROR - wrong results");
+}
+
+static void queue_core1_entry(void) {
+    // As in multicore_runner_queue
+    while (true) {
+        queue_entry_t entry;
+        queue_remove_blocking(&call_queue, &entry);
+        int32_t result = entry.func(entry.data);
+        queue_add_blocking(&results_queue, &result);
+    }
+}
+
+static int32_t queue_call(thread_pool_func_t func, void *data) {
+    queue_entry_t entry = {func, data};
+    int32_t result;
+    queue_add_blocking(&call_queue, &entry);
+    queue_remove_blocking(&results_queue, &result);
+    return result;
+}
+
+static void bench_queue(void) {
+    queue_init(&call_queue, sizeof(queue_entry_t), 2);
+    queue_init(&results_queue, sizeof(int32_t), 2);
+    multicore_launch_core1(queue_core1_entry);
+
+    uint32_t total = 0;
+    for (int i = 0; i < LATENCY_REPEATS; i++) {
+        uint32_t start = bench_cycle_count();
+        queue_call(nop_task, NULL);
+        total += (start - bench_cycle_count()) & 0x00ffffff;
+    }
+    printf("queue        latency %lu cycles\n", total / LATENCY_REPEATS);
+
+    for (int t = 0; t < count_of(task_types); t++) {
+        int32_t sum = 0;
+        uint64_t start = time_us_64();
+        for (uint i = 0; i < THROUGHPUT_TASKS; i++)
+            sum += queue_call(task_types[t].func, (void *)(uintptr_t)i);
+        print_throughput("queue", task_types[t].name, time_us_64() - start, sum, expected_sum(task_types[t].func));
+    }
+
+    multicore_reset_core1();
+    queue_free(&call_queue);
+    queue_free(&results_queue);
+}
+
+static void bench_pool(void) {
+    static thread_pool_task_t tasks[BATCH_SIZE];
+    static thread_pool_future_t futures[BATCH_SIZE];
+
+    thread_pool_init();
+
+    // Don't help here, so the task runs on core 1
+    uint32_t total = 0;
+    for (int i = 0; i < LATENCY_REPEATS; i++) {
+        thread_pool_task_t task = {nop_task, NULL, &futures[0]};
+        uint32_t start = bench_cycle_count();
+        thread_pool_try_submit(&task, 1);
+        while (!futures[0].done)
+            tight_loop_contents();
+        total += (start - bench_cycle_count()) & 0x00ffffff;
+    }
+    printf("thread_pool  latency %lu cycles\n", total / LATENCY_REPEATS);
+
+    for (int t = 0; t < count_of(task_types); t++) {
+        uint32_t core0_before = thread_pool_tasks_run(0);
+        int32_t sum = 0;
+        uint64_t start = time_us_64();
+        for (uint i = 0; i < THROUGHPUT_TASKS; i += BATCH_SIZE) {
+            for (uint j = 0; j < BATCH_SIZE; j++)
+                tasks[j] = (thread_pool_task_t) {task_types[t].func, (void *)(uintptr_t)(i + j), &futures[j]};
+            thread_pool_submit_blocking(tasks, BATCH_SIZE);
+            thread_pool_wait_all(futures, BATCH_SIZE);
+            for (uint j = 0; j < BATCH_SIZE; j++)
+                sum += futures[j].result;
+        }
+        print_throughput("thread_pool", task_types[t].name, time_us_64() - start, sum,
+                         expected_sum(task_types[t].func));
+        printf("             core 0 ran %lu of the tasks\n", thread_pool_tasks_run(0) - core0_before);
+    }
+}
+
+int main() {
+    stdio_init_all();
+    printf("Thread pool benchmark\n");
+    bench_cycle_counter_init();
+
+    for (int t = 0; t < count_of(task_types); t++) {
+        uint64_t start = time_us_64();
+        int32_t sum = expected_sum(task_types[t].func);
+        print_throughput("core 0 only", task_types[t].name, time_us_64() - start, sum, sum);
+    }
+
+    bench_queue();
+    bench_pool();
+#if THREAD_POOL_TRACE
+    trace_dump();
+#endif
+}
@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+
+# Load test for the access point's DHCP server.
+#
+# usage: sudo python3 dhcp_storm.py [--clients N] [--interface wlan0]
+#
+# Run it on a computer connected to the picow_test access point. It pretends
+# to be many clients at once, each with a made-up MAC address, and:
+#
+# - sends a burst of DISCOVERs and waits for the OFFERs
+# - sends a burst of REQUESTs for the offered addresses and waits for the ACKs
+# - sends the DISCOVERs again, as if every client had reconnected, and checks
+#   each one is offered the same address
+# - REQUESTs one client's address for another, which should be NAKed
+# - RELEASEs every address again
+#
+# It needs to bind the DHCP client port, 68, so must usually be run as root.
+# More clients than the server has addresses (DHCPS_MAX_IP) go unanswered.
+
+import argparse
+import os
+import socket
+import struct
+import sys
+import time
+
+SERVER_PORT = 67
+CLIENT_PORT = 68
+MAGIC_COOKIE = b"\x63\x82\x53\x63"
+
+DHCPDISCOVER = 1
+DHCPOFFER = 2
+DHCPREQUEST = 3
+DHCPACK = 5
+DHCPNAK = 6
+DHCPRELEASE = 7
+
+OPT_REQUESTED_IP = 50
+OPT_MSG_TYPE = 53
+OPT_SERVER_ID = 54
+OPT_END = 255
+
+
+def make_mac(i):
+    # Locally administered addresses
+    return bytes([0x02, 0x50, 0x49, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff])
+
+
+def make_msg(msg_type, xid, mac, ciaddr=b"\0" * 4, requested_ip=None, server_id=None):
+    msg = struct.pack("!BBBBIHH4s4s4s4s16s64s128s", 1, 1, 6, 0, xid, 0, 0x8000, ciaddr, b"\0" * 4, b"\0" * 4,
+                      b"\0" * 4, mac, b"", b"")
+    opts = MAGIC_COOKIE + bytes([OPT_MSG_TYPE, 1, msg_type])
+    if requested_ip:
+        opts += bytes([OPT_REQUESTED_IP, 4]) + requested_ip
+    if server_id:
+        opts += bytes([OPT_SERVER_ID, 4]) + server_id
+    return msg + opts + bytes([OPT_END])
+
+
+def parse_reply(data):
+    """Return (xid, mac, yiaddr, msg_type, server_id) from a reply, or None."""
+    if len(data) < 240 or data[0] != 2 or data[236:240] != MAGIC_COOKIE:
+        return None
+    xid = struct.unpack("!I", data[4:8])[0]
+    yiaddr = data[16:20]
+    mac = data[28:34]
+    msg_type = server_id = None
+    i = 240
+    while i < len(data) and data[i] != OPT_END:
+        if data[i] == 0:
+            i += 1
+            continue
+        if i + 2 > len(data):
+            break
+        n = data[i + 1]
+        value = data[i + 2:i + 2 + n]
+        if data[i] == OPT_MSG_TYPE and n == 1:
+            msg_type = value[0]
+        elif data[i] == OPT_SERVER_ID and n == 4:
+            server_id = value
+        i += 2 + n
+    return xid, mac, yiaddr, msg_type, server_id
+
+
+class Storm:
+    def __init__(self, args):
+        self.args = args
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+        if args.interface:
+            self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_BINDTODEVICE, args.interface.encode())
+        try:
+            self.sock.bind(("", CLIENT_PORT))
+        except PermissionError:
+            sys.exit("Can't bind port 68; try running as root")
+        self.xid_base = int.from_bytes(os.urandom(2), "big") << 16
+        self.failures = 0
+
+    def xid(self, n):
+        """The transaction id for message n, wrapping round at 32 bits."""
+        return (self.xid_base + n) & 0xffffffff
+
+    def send(self, msg):
+        self.sock.sendto(msg, ("255.255.255.255", SERVER_PORT))
+
+    def collect(self, expected_xids):
+        """Wait for replies to the given transaction ids. Returns {xid: reply}."""
+        replies = {}
+        deadline = time.monotonic() + self.args.timeout
+        while len(replies) < len(expected_xids):
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                break
+            self.sock.settimeout(remaining)
+            try:
+                data, _ = self.sock.recvfrom(1024)
+            except socket.timeout:
+                break
+            reply = parse_reply(data)
+            if reply and reply[0] in expected_xids:
+                replies[reply[0]] = reply
+        return replies
+
+    def burst(self, name, messages):
+        """Send all messages at once, then wait for the replies."""
+        start = time.monotonic()
+        for msg in messages.values():
+            self.send(msg)
+        replies = self.collect(set(messages))
+        elapsed = time.monotonic() - start
+        print(f"{name}: {len(replies)}/{len(messages)} replies in {elapsed * 1000:.0f} ms"
+              f" ({len(replies) / elapsed:.0f} per second)")
+        return replies
+
+    def fail(self, message):
+        print(f"FAIL: {message}")
+        self.failures += 1
+
+    def run(self):
+        n = self.args.clients
+        macs = [make_mac(i) for i in range(n)]
+
+        discovers = {self.xid(i): make_msg(DHCPDISCOVER, self.xid(i), macs[i]) for i in range(n)}
+        offers = self.burst("DISCOVER", discovers)
+        offered = {}
+        server_id = None
+        for xid, (_, mac, yiaddr, msg_type, sid) in offers.items():
+            if msg_type != DHCPOFFER:
+                self.fail(f"expected an OFFER, got message type {msg_type}")
+                continue
+            offered[mac] = yiaddr
+            server_id = sid
+        if len(set(offered.values())) != len(offered):
+            self.fail("the same address was offered to more than one client")
+        if not offered:
+            sys.exit("No offers received; is this computer connected to the access point?")
+
+        requests = {}
+        for i, mac in enumerate(macs):
+            if mac in offered:
+                xid = self.xid(n + i)
+                requests[xid] = make_msg(DHCPREQUEST, xid, mac, requested_ip=offered[mac], server_id=server_id)
+        acks = self.burst("REQUEST", requests)
+        bound = {}
+        for _, mac, yiaddr, msg_type, _ in acks.values():
+            if msg_type != DHCPACK:
+                self.fail(f"expected an ACK, got message type {msg_type}")
+            elif yiaddr != offered[mac]:
+                self.fail(f"ACK for {socket.inet_ntoa(yiaddr)}, not the offered {socket.inet_ntoa(offered[mac])}")
+            else:
+                bound[mac] = yiaddr
+
+        rediscovers = {self.xid(2 * n + i): make_msg(DHCPDISCOVER, self.xid(2 * n + i), macs[i])
+                       for i in range(n) if macs[i] in bound}
+        reoffers = self.burst("reconnect DISCOVER", rediscovers)
+        for _, mac, yiaddr, msg_type, _ in reoffers.values():
+            if msg_type != DHCPOFFER or yiaddr != bound[mac]:
+                self.fail(f"client {mac.hex(':')} was not offered its address back")
+
+        if len(bound) >= 2:
+            (mac_a, _), (_, ip_b) = list(bound.items())[:2]
+            xid = self.xid(3 * n)
+            nak = self.burst("conflicting REQUEST",
+                             {xid: make_msg(DHCPREQUEST, xid, mac_a, requested_ip=ip_b, server_id=server_id)})
+            if xid not in nak or nak[xid][3] != DHCPNAK:
+                self.fail("a REQUEST for another client's address was not NAKed")
+
+        if not self.args.keep:
+            for mac, ip in bound.items():
+                self.send(make_msg(DHCPRELEASE, self.xid(0), mac, ciaddr=ip, server_id=server_id))
+            print(f"released {len(bound)} addresses")
+
+        print(f"{len(bound)} clients bound, {self.failures} failures")
+        return self.failures == 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="DISCOVER/REQUEST storm against a DHCP server")
+    parser.add_argument("--clients", type=int, default=24, help="number of simulated clients")
+    parser.add_argument("--interface", help="network interface to use, e.g. wlan0 (Linux only)")
+    parser.add_argument("--timeout", type=float, default=2.0, help="seconds to wait for each burst of replies")
+    parser.add_argument("--keep", action="store_true", help="don't release the addresses at the end")
+    args = parser.parse_args()
+    if not 1 <= args.clients <= 65536:
+        sys.exit("--clients must be between 1 and 65536")
+    sys.exit(0 if Storm(args).run() else 1)
+
+
+if __name__ == "__main__":
+    main()
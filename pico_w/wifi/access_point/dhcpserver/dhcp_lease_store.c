@@ -0,0 +1,195 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Leases are saved as whole snapshots, written one after another into
+// fixed-size slots in the store sectors. A sector is only erased when the
+// next snapshot is due to go in its first slot, so each erase is shared by
+// a whole sector's worth of snapshots, and the newest snapshot is always in
+// a sector other than the one being erased. At boot the valid snapshot with
+// the highest sequence number wins.
+
+#include <string.h>
+
+#include "dhcpserver.h"
+#include "dhcp_lease_store.h"
+
+#if PICO_ON_DEVICE
+
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#define STORE_OFFSET (PICO_FLASH_SIZE_BYTES - DHCPS_STORE_SECTORS * FLASH_SECTOR_SIZE)
+#define store_flash ((const uint8_t *)(XIP_BASE + STORE_OFFSET))
+
+static void store_erase(uint32_t offset) {
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_erase(STORE_OFFSET + offset, FLASH_SECTOR_SIZE);
+    restore_interrupts(ints);
+}
+
+static void store_program(uint32_t offset, const uint8_t *data, size_t len) {
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_program(STORE_OFFSET + offset, data, len);
+    restore_interrupts(ints);
+}
+
+#else
+
+// Simulated NOR flash for testing off the device: erasing sets every bit,
+// and programming can only clear them
+#define FLASH_PAGE_SIZE (256)
+#define FLASH_SECTOR_SIZE (4096)
+
+uint8_t dhcp_lease_store_sim_flash[DHCPS_STORE_SECTORS * FLASH_SECTOR_SIZE];
+uint32_t dhcp_lease_store_sim_erases;
+#define store_flash ((const uint8_t *)dhcp_lease_store_sim_flash)
+
+static void store_erase(uint32_t offset) {
+    memset(&dhcp_lease_store_sim_flash[offset], 0xff, FLASH_SECTOR_SIZE);
+    ++dhcp_lease_store_sim_erases;
+}
+
+static void store_program(uint32_t offset, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        dhcp_lease_store_sim_flash[offset + i] &= data[i];
+    }
+}
+
+#endif
+
+#define STORE_MAGIC (0x4c434844) // "DHCL"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;
+    // Everything from here on is covered by the CRC
+    uint32_t seq;
+    uint32_t first_ip;
+    uint8_t num_leases;
+    uint8_t count;
+    uint16_t pad;
+    dhcp_lease_record_t records[];
+} store_snapshot_t;
+
+#define STORE_CRC_START (offsetof(store_snapshot_t, seq))
+#define STORE_CONTENT_START (offsetof(store_snapshot_t, first_ip))
+#define STORE_SNAPSHOT_SIZE(count) (sizeof(store_snapshot_t) + (count) * sizeof(dhcp_lease_record_t))
+
+// Slots are a whole number of pages, and never straddle a sector
+#define SLOT_SIZE ((STORE_SNAPSHOT_SIZE(DHCPS_MAX_IP) + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1))
+#define SLOTS_PER_SECTOR ((int)(FLASH_SECTOR_SIZE / SLOT_SIZE))
+#define NUM_SLOTS (DHCPS_STORE_SECTORS * SLOTS_PER_SECTOR)
+
+static uint32_t store_seq;
+static int store_next_slot;
+// Slot holding the newest snapshot, or -1
+static int store_newest_slot = -1;
+
+static uint32_t crc32(const uint8_t *data, size_t len) {
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t slot_offset(int slot) {
+    return (slot / SLOTS_PER_SECTOR) * FLASH_SECTOR_SIZE + (slot % SLOTS_PER_SECTOR) * SLOT_SIZE;
+}
+
+static const store_snapshot_t *slot_snapshot(int slot) {
+    return (const store_snapshot_t *)&store_flash[slot_offset(slot)];
+}
+
+static bool slot_valid(int slot) {
+    const store_snapshot_t *s = slot_snapshot(slot);
+    if (s->magic != STORE_MAGIC || s->count > DHCPS_MAX_IP) {
+        return false;
+    }
+    size_t len = STORE_SNAPSHOT_SIZE(s->count);
+    return s->crc == crc32((const uint8_t *)s + STORE_CRC_START, len - STORE_CRC_START);
+}
+
+static bool is_blank(uint32_t offset, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        if (store_flash[offset + i] != 0xff) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t dhcp_lease_store_load(uint32_t first_ip, uint8_t num_leases, dhcp_lease_record_t *records, size_t max) {
+    store_newest_slot = -1;
+    for (int slot = 0; slot < NUM_SLOTS; ++slot) {
+        if (slot_valid(slot) &&
+            (store_newest_slot < 0 || (int32_t)(slot_snapshot(slot)->seq - store_seq) > 0)) {
+            store_newest_slot = slot;
+            store_seq = slot_snapshot(slot)->seq;
+        }
+    }
+    if (store_newest_slot < 0) {
+        store_seq = 0;
+        store_next_slot = 0;
+        return 0;
+    }
+    store_next_slot = (store_newest_slot + 1) % NUM_SLOTS;
+
+    const store_snapshot_t *s = slot_snapshot(store_newest_slot);
+    if (s->first_ip != first_ip || s->num_leases != num_leases) {
+        return 0;
+    }
+    size_t count = s->count < max ? s->count : max;
+    memcpy(records, s->records, count * sizeof(dhcp_lease_record_t));
+    return count;
+}
+
+void dhcp_lease_store_save(uint32_t first_ip, uint8_t num_leases, const dhcp_lease_record_t *records, size_t count) {
+    static union {
+        store_snapshot_t snapshot;
+        uint8_t bytes[SLOT_SIZE];
+    } buf;
+    if (count > DHCPS_MAX_IP) {
+        count = DHCPS_MAX_IP;
+    }
+    memset(&buf, 0xff, sizeof(buf));
+    store_snapshot_t *s = &buf.snapshot;
+    s->magic = STORE_MAGIC;
+    s->seq = store_seq + 1;
+    s->first_ip = first_ip;
+    s->num_leases = num_leases;
+    s->count = count;
+    s->pad = 0;
+    memcpy(s->records, records, count * sizeof(dhcp_lease_record_t));
+    size_t len = STORE_SNAPSHOT_SIZE(count);
+
+    if (store_newest_slot >= 0 && slot_snapshot(store_newest_slot)->count == count &&
+        memcmp((const uint8_t *)slot_snapshot(store_newest_slot) + STORE_CONTENT_START,
+            buf.bytes + STORE_CONTENT_START, len - STORE_CONTENT_START) == 0) {
+        // Nothing has changed since the last write
+        return;
+    }
+    s->crc = crc32(buf.bytes + STORE_CRC_START, len - STORE_CRC_START);
+
+    int slot = store_next_slot;
+    if (slot % SLOTS_PER_SECTOR != 0 && !is_blank(slot_offset(slot), SLOT_SIZE)) {
+        // Left over from a write that was cut short, so move on to the next
+        // sector, which can't hold the newest snapshot
+        slot = (slot / SLOTS_PER_SECTOR + 1) % DHCPS_STORE_SECTORS * SLOTS_PER_SECTOR;
+    }
+    if (slot % SLOTS_PER_SECTOR == 0 && !is_blank(slot_offset(slot), FLASH_SECTOR_SIZE)) {
+        store_erase(slot_offset(slot));
+    }
+    // Only program the pages the snapshot uses
+    store_program(slot_offset(slot), buf.bytes, (len + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1));
+
+    store_seq = s->seq;
+    store_newest_slot = slot;
+    store_next_slot = (slot + 1) % NUM_SLOTS;
+}
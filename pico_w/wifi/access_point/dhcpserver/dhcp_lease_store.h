@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _DHCP_LEASE_STORE_H
+#define _DHCP_LEASE_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Sectors at the very end of flash used to keep leases across reboots. At
+// least two are needed, so the newest snapshot survives a sector erase.
+#ifndef DHCPS_STORE_SECTORS
+#define DHCPS_STORE_SECTORS (2)
+#endif
+
+#if DHCPS_STORE_SECTORS < 2
+#error "DHCPS_STORE_SECTORS must be at least 2"
+#endif
+
+typedef struct {
+    uint8_t mac[6];
+    // Index of the address in the pool
+    uint8_t index;
+    uint8_t pad;
+} dhcp_lease_record_t;
+
+// Find the newest snapshot in flash, and return how many records it holds,
+// copying up to max of them. Snapshots saved for a different pool (first
+// address or size) are ignored. Must be called before saving.
+size_t dhcp_lease_store_load(uint32_t first_ip, uint8_t num_leases, dhcp_lease_record_t *records, size_t max);
+
+// Write a snapshot of the leases, unless it's the same as the newest one.
+// This erases and programs flash with interrupts disabled, so should only be
+// called occasionally.
+void dhcp_lease_store_save(uint32_t first_ip, uint8_t num_leases, const dhcp_lease_record_t *records, size_t count);
+
+#if !PICO_ON_DEVICE
+// Off the device the store sectors are simulated in RAM, for testing, with
+// a count of how many times they have been erased
+extern uint8_t dhcp_lease_store_sim_flash[];
+extern uint32_t dhcp_lease_store_sim_erases;
+#endif
+
+#endif
@@ -29,6 +29,7 @@
 //  https://tools.ietf.org/html/rfc2132 -- DHCP Options and BOOTP Vendor Extensions
 
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <errno.h>
 
@@ -36,6 +37,11 @@
 #include "dhcpserver.h"
 #include "lwip/udp.h"
 
+#if DHCPS_PERSIST_LEASES
+#include "lwip/timeouts.h"
+#include "dhcp_lease_store.h"
+#endif
+
 #define DHCPDISCOVER    (1)
 #define DHCPOFFER       (2)
 #define DHCPREQUEST     (3)
@@ -64,11 +70,25 @@
 #define PORT_DHCP_CLIENT (68)
 
 #define DEFAULT_LEASE_TIME_S (24 * 60 * 60) // in seconds
+#define OFFER_TIME_MS (60 * 1000) // how long an offered address is held for
+#define DECLINE_TIME_MS (10 * 60 * 1000) // how long a declined address is kept out of use
+
+#define BOOTREPLY (2)
+
+#define LEASE_FREE      (0)
+#define LEASE_OFFERED   (1)
+#define LEASE_BOUND     (2)
+#define LEASE_DECLINED  (3)
+#define LEASE_RESERVED  (4) // the server's own address
+
+#define NO_LEASE (0xff)
 
 #define MAC_LEN (6)
 #define MAKE_IP4(a, b, c, d) ((a) << 24 | (b) << 16 | (c) << 8 | (d))
 
-typedef struct {
+// Messages are read and written in place in pbufs, which need not be word
+// aligned, hence packed
+typedef struct __attribute__((packed)) {
     uint8_t op; // message opcode
     uint8_t htype; // hardware address type
     uint8_t hlen; // hardware address length
@@ -113,24 +133,14 @@ static int dhcp_socket_bind(struct udp_pcb **udp, uint16_t port) {
     return udp_bind(*udp, IP_ANY_TYPE, port);
 }
 
-static int dhcp_socket_sendto(struct udp_pcb **udp, const void *buf, size_t len, uint32_t ip, uint16_t port) {
-    if (len > 0xffff) {
-        len = 0xffff;
-    }
-
-    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
-    if (p == NULL) {
-        return -ENOMEM;
-    }
-
-    memcpy(p->payload, buf, len);
+// Send the first len bytes of p, which the caller still owns
+static int dhcp_socket_sendto(struct udp_pcb **udp, struct pbuf *p, size_t len, uint32_t ip, uint16_t port) {
+    pbuf_realloc(p, len);
 
     ip_addr_t dest;
     IP4_ADDR(ip_2_ip4(&dest), ip >> 24 & 0xff, ip >> 16 & 0xff, ip >> 8 & 0xff, ip & 0xff);
     err_t err = udp_sendto(*udp, p, &dest, port);
 
-    pbuf_free(p);
-
     if (err != ERR_OK) {
         return err;
     }
@@ -138,14 +148,41 @@ static int dhcp_socket_sendto(struct udp_pcb **udp, const void *buf, size_t len,
     return len;
 }
 
-static uint8_t *opt_find(uint8_t *opt, uint8_t cmd) {
-    for (int i = 0; i < 308 && opt[i] != DHCP_OPT_END;) {
-        if (opt[i] == cmd) {
-            return &opt[i];
+typedef struct {
+    uint8_t msg_type;
+    bool has_requested_ip;
+    bool has_server_id;
+    uint8_t requested_ip[4];
+    uint8_t server_id[4];
+} dhcp_opts_t;
+
+// Pick out the options we use in a single pass. They are copied, because
+// the reply is written over them.
+static void opt_parse(const uint8_t *opt, size_t len, dhcp_opts_t *opts) {
+    memset(opts, 0, sizeof(*opts));
+    size_t i = 0;
+    while (i < len && opt[i] != DHCP_OPT_END) {
+        if (opt[i] == DHCP_OPT_PAD) {
+            ++i;
+            continue;
+        }
+        if (i + 2 > len || i + 2 + opt[i + 1] > len) {
+            // Truncated
+            break;
+        }
+        uint8_t n = opt[i + 1];
+        const uint8_t *data = &opt[i + 2];
+        if (opt[i] == DHCP_OPT_MSG_TYPE && n == 1) {
+            opts->msg_type = data[0];
+        } else if (opt[i] == DHCP_OPT_REQUESTED_IP && n == 4) {
+            opts->has_requested_ip = true;
+            memcpy(opts->requested_ip, data, 4);
+        } else if (opt[i] == DHCP_OPT_SERVER_ID && n == 4) {
+            opts->has_server_id = true;
+            memcpy(opts->server_id, data, 4);
         }
-        i += 2 + opt[i + 1];
+        i += 2 + n;
     }
-    return NULL;
 }
 
 static void opt_write_n(uint8_t **opt, uint8_t cmd, size_t n, const void *data) {
@@ -175,116 +212,388 @@ static void opt_write_u32(uint8_t **opt, uint8_t cmd, uint32_t val) {
     *opt = o;
 }
 
+// Leases are found by MAC address through a hash table, chained through
+// lease.next. Free leases are chained through the same field in a list,
+// oldest first, so a client coming back is likely to find its old address
+// still free. Leases in use are kept in a min-heap on their expiry time, so
+// expired ones can be found without scanning the whole table.
+
+static uint32_t mac_hash(const uint8_t *mac) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < MAC_LEN; ++i) {
+        h = (h ^ mac[i]) * 16777619u;
+    }
+    return h & (DHCPS_HASH_SIZE - 1);
+}
+
+static int lease_find_mac(dhcp_server_t *d, const uint8_t *mac) {
+    for (uint8_t i = d->hash[mac_hash(mac)]; i != NO_LEASE; i = d->lease[i].next) {
+        if (memcmp(d->lease[i].mac, mac, MAC_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void hash_insert(dhcp_server_t *d, uint8_t i) {
+    uint8_t *bucket = &d->hash[mac_hash(d->lease[i].mac)];
+    d->lease[i].next = *bucket;
+    *bucket = i;
+}
+
+static void hash_remove(dhcp_server_t *d, uint8_t i) {
+    uint8_t *p = &d->hash[mac_hash(d->lease[i].mac)];
+    while (*p != i) {
+        p = &d->lease[*p].next;
+    }
+    *p = d->lease[i].next;
+}
+
+static void free_list_push(dhcp_server_t *d, uint8_t i) {
+    d->lease[i].next = NO_LEASE;
+    if (d->free_tail == NO_LEASE) {
+        d->free_head = i;
+    } else {
+        d->lease[d->free_tail].next = i;
+    }
+    d->free_tail = i;
+}
+
+static void free_list_remove(dhcp_server_t *d, uint8_t i) {
+    uint8_t prev = NO_LEASE;
+    uint8_t *p = &d->free_head;
+    while (*p != i) {
+        prev = *p;
+        p = &d->lease[*p].next;
+    }
+    *p = d->lease[i].next;
+    if (d->free_tail == i) {
+        d->free_tail = prev;
+    }
+}
+
+static bool expires_before(dhcp_server_t *d, uint8_t a, uint8_t b) {
+    return (int32_t)(d->lease[a].expiry - d->lease[b].expiry) < 0;
+}
+
+static void heap_set(dhcp_server_t *d, uint8_t pos, uint8_t i) {
+    d->heap[pos] = i;
+    d->lease[i].heap_index = pos;
+}
+
+static void heap_sift(dhcp_server_t *d, uint8_t pos) {
+    uint8_t i = d->heap[pos];
+    // Up...
+    while (pos > 0 && expires_before(d, i, d->heap[(pos - 1) / 2])) {
+        heap_set(d, pos, d->heap[(pos - 1) / 2]);
+        pos = (pos - 1) / 2;
+    }
+    // ...or down
+    for (;;) {
+        size_t child = 2 * pos + 1;
+        if (child >= d->heap_len) {
+            break;
+        }
+        if (child + 1 < d->heap_len && expires_before(d, d->heap[child + 1], d->heap[child])) {
+            ++child;
+        }
+        if (!expires_before(d, d->heap[child], i)) {
+            break;
+        }
+        heap_set(d, pos, d->heap[child]);
+        pos = child;
+    }
+    heap_set(d, pos, i);
+}
+
+static void heap_remove(dhcp_server_t *d, uint8_t i) {
+    uint8_t pos = d->lease[i].heap_index;
+    uint8_t last = d->heap[--d->heap_len];
+    if (pos != d->heap_len) {
+        heap_set(d, pos, last);
+        heap_sift(d, pos);
+    }
+}
+
+static void lease_set_expiry(dhcp_server_t *d, uint8_t i, uint32_t expiry) {
+    d->lease[i].expiry = expiry;
+    heap_sift(d, d->lease[i].heap_index);
+}
+
+// Give free lease i, already taken off the free list, to a client
+static void lease_offer(dhcp_server_t *d, uint8_t i, const uint8_t *mac, uint32_t now) {
+    dhcp_server_lease_t *lease = &d->lease[i];
+    memcpy(lease->mac, mac, MAC_LEN);
+    lease->state = LEASE_OFFERED;
+    lease->expiry = now + OFFER_TIME_MS;
+    hash_insert(d, i);
+    heap_set(d, d->heap_len++, i);
+    heap_sift(d, lease->heap_index);
+}
+
+#if DHCPS_PERSIST_LEASES
+
+// Write the bound leases to flash
+static void store_save(dhcp_server_t *d) {
+    dhcp_lease_record_t records[DHCPS_MAX_IP];
+    size_t count = 0;
+    for (uint8_t i = 0; i < d->num_leases; ++i) {
+        if (d->lease[i].state == LEASE_BOUND) {
+            memcpy(records[count].mac, d->lease[i].mac, MAC_LEN);
+            records[count].index = i;
+            records[count].pad = 0;
+            ++count;
+        }
+    }
+    dhcp_lease_store_save(d->first_ip, d->num_leases, records, count);
+}
+
+static void store_timeout(void *arg) {
+    dhcp_server_t *d = arg;
+    d->store_pending = false;
+    store_save(d);
+}
+
+// Bound leases have changed. Rather than writing to flash for every change,
+// all the changes in the next DHCPS_STORE_DELAY_MS go in one write.
+static void store_schedule(dhcp_server_t *d) {
+    if (!d->store_pending) {
+        d->store_pending = true;
+        sys_timeout(DHCPS_STORE_DELAY_MS, store_timeout, d);
+    }
+}
+
+// Bind the leases saved before the last restart again. How long they had
+// left is not known, so each gets a full lease time.
+static void store_restore(dhcp_server_t *d, uint32_t now) {
+    dhcp_lease_record_t records[DHCPS_MAX_IP];
+    size_t count = dhcp_lease_store_load(d->first_ip, d->num_leases, records, DHCPS_MAX_IP);
+    int restored = 0;
+    for (size_t r = 0; r < count; ++r) {
+        uint8_t i = records[r].index;
+        if (i >= d->num_leases || d->lease[i].state != LEASE_FREE || lease_find_mac(d, records[r].mac) >= 0) {
+            continue;
+        }
+        free_list_remove(d, i);
+        lease_offer(d, i, records[r].mac, now);
+        d->lease[i].state = LEASE_BOUND;
+        lease_set_expiry(d, i, now + DEFAULT_LEASE_TIME_S * 1000);
+        ++restored;
+    }
+    if (restored) {
+        printf("DHCPS: restored %d leases\n", restored);
+    }
+}
+
+#else
+
+static void store_schedule(dhcp_server_t *d) {
+    (void)d;
+}
+
+#endif
+
+static void lease_free(dhcp_server_t *d, uint8_t i) {
+    dhcp_server_lease_t *lease = &d->lease[i];
+    if (lease->state == LEASE_BOUND) {
+        store_schedule(d);
+    }
+    if (lease->state == LEASE_OFFERED || lease->state == LEASE_BOUND) {
+        hash_remove(d, i);
+    }
+    heap_remove(d, i);
+    memset(lease->mac, 0, MAC_LEN);
+    lease->state = LEASE_FREE;
+    free_list_push(d, i);
+}
+
+static void lease_expire(dhcp_server_t *d, uint32_t now) {
+    while (d->heap_len && (int32_t)(d->lease[d->heap[0]].expiry - now) <= 0) {
+        lease_free(d, d->heap[0]);
+    }
+}
+
+// The lease for an address, or -1 if it isn't one of ours
+static int lease_index(dhcp_server_t *d, const uint8_t *ip) {
+    uint32_t addr = (uint32_t)ip[0] << 24 | ip[1] << 16 | ip[2] << 8 | ip[3];
+    uint32_t i = addr - d->first_ip;
+    return i < d->num_leases ? (int)i : -1;
+}
+
+static void lease_ip(dhcp_server_t *d, uint8_t i, uint8_t *ip) {
+    uint32_t addr = d->first_ip + i;
+    ip[0] = addr >> 24;
+    ip[1] = addr >> 16;
+    ip[2] = addr >> 8;
+    ip[3] = addr;
+}
+
 static void dhcp_server_process(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *src_addr, u16_t src_port) {
     dhcp_server_t *d = arg;
+    struct pbuf *reply = p;
     (void)upcb;
     (void)src_addr;
     (void)src_port;
 
-    // This is around 548 bytes
-    dhcp_msg_t dhcp_msg;
-
     #define DHCP_MIN_SIZE (240 + 3)
+    // The fixed fields, plus the options in the longest reply
+    #define DHCP_REPLY_MAX_SIZE (240 + 3 + 5 * 6 + 1)
     if (p->tot_len < DHCP_MIN_SIZE) {
         goto ignore_request;
     }
 
-    size_t len = pbuf_copy_partial(p, &dhcp_msg, sizeof(dhcp_msg), 0);
-    if (len < DHCP_MIN_SIZE) {
-        goto ignore_request;
+    // The reply is written over the request, in the pbuf it arrived in.
+    // Clients nearly always send at least the 300 bytes BOOTP asks for,
+    // which leaves room; otherwise the request is copied to a pbuf big
+    // enough for the reply.
+    if (p->next != NULL || p->len < DHCP_REPLY_MAX_SIZE) {
+        struct pbuf *q = pbuf_alloc(PBUF_TRANSPORT, LWIP_MAX(p->tot_len, DHCP_REPLY_MAX_SIZE), PBUF_RAM);
+        if (q == NULL) {
+            goto ignore_request;
+        }
+        pbuf_copy_partial(p, q->payload, p->tot_len, 0);
+        reply = q;
     }
+    dhcp_msg_t *dhcp_msg = reply->payload;
+    size_t len = p->tot_len;
 
-    dhcp_msg.op = DHCPOFFER;
-    memcpy(&dhcp_msg.yiaddr, &ip4_addr_get_u32(ip_2_ip4(&d->ip)), 4);
-
-    uint8_t *opt = (uint8_t *)&dhcp_msg.options;
-    opt += 4; // assume magic cookie: 99, 130, 83, 99
+    uint8_t *opt = (uint8_t *)dhcp_msg + offsetof(dhcp_msg_t, options);
+    if (memcmp(opt, "\x63\x82\x53\x63", 4) != 0) {
+        // Not DHCP: the magic cookie is missing
+        goto ignore_request;
+    }
+    opt += 4;
 
-    uint8_t *msgtype = opt_find(opt, DHCP_OPT_MSG_TYPE);
-    if (msgtype == NULL) {
+    dhcp_opts_t opts;
+    opt_parse(opt, len - (opt - (uint8_t *)dhcp_msg), &opts);
+    if (opts.msg_type == 0) {
         // A DHCP package without MSG_TYPE?
         goto ignore_request;
     }
 
-    switch (msgtype[2]) {
+    const uint8_t *server_ip = (const uint8_t *)&ip4_addr_get_u32(ip_2_ip4(&d->ip));
+    uint32_t now = cyw43_hal_ticks_ms();
+    lease_expire(d, now);
+    int li = lease_find_mac(d, dhcp_msg->chaddr);
+
+    dhcp_msg->op = BOOTREPLY;
+    uint8_t reply_type;
+
+    switch (opts.msg_type) {
         case DHCPDISCOVER: {
-            int yi = DHCPS_MAX_IP;
-            for (int i = 0; i < DHCPS_MAX_IP; ++i) {
-                if (memcmp(d->lease[i].mac, dhcp_msg.chaddr, MAC_LEN) == 0) {
-                    // MAC match, use this IP address
-                    yi = i;
-                    break;
-                }
-                if (yi == DHCPS_MAX_IP) {
-                    // Look for a free IP address
-                    if (memcmp(d->lease[i].mac, "\x00\x00\x00\x00\x00\x00", MAC_LEN) == 0) {
-                        // IP available
-                        yi = i;
-                    }
-                    uint32_t expiry = d->lease[i].expiry << 16 | 0xffff;
-                    if ((int32_t)(expiry - cyw43_hal_ticks_ms()) < 0) {
-                        // IP expired, reuse it
-                        memset(d->lease[i].mac, 0, MAC_LEN);
-                        yi = i;
-                    }
+            if (li < 0 && opts.has_requested_ip) {
+                // Offer the address the client asked for, if it's free
+                int ri = lease_index(d, opts.requested_ip);
+                if (ri >= 0 && d->lease[ri].state == LEASE_FREE) {
+                    free_list_remove(d, ri);
+                    lease_offer(d, ri, dhcp_msg->chaddr, now);
+                    li = ri;
                 }
             }
-            if (yi == DHCPS_MAX_IP) {
-                // No more IP addresses left
-                goto ignore_request;
+            if (li < 0) {
+                if (d->free_head == NO_LEASE) {
+                    // No more IP addresses left
+                    goto ignore_request;
+                }
+                li = d->free_head;
+                free_list_remove(d, li);
+                lease_offer(d, li, dhcp_msg->chaddr, now);
+            } else if (d->lease[li].state == LEASE_OFFERED) {
+                lease_set_expiry(d, li, now + OFFER_TIME_MS);
             }
-            dhcp_msg.yiaddr[3] = DHCPS_BASE_IP + yi;
-            opt_write_u8(&opt, DHCP_OPT_MSG_TYPE, DHCPOFFER);
+            reply_type = DHCPOFFER;
             break;
         }
 
         case DHCPREQUEST: {
-            uint8_t *o = opt_find(opt, DHCP_OPT_REQUESTED_IP);
-            if (o == NULL) {
-                // Should be NACK
+            if (opts.has_server_id && memcmp(opts.server_id, server_ip, 4) != 0) {
+                // The client took another server's offer
+                if (li >= 0 && d->lease[li].state == LEASE_OFFERED) {
+                    lease_free(d, li);
+                }
                 goto ignore_request;
             }
-            if (memcmp(o + 2, &ip4_addr_get_u32(ip_2_ip4(&d->ip)), 3) != 0) {
-                // Should be NACK
-                goto ignore_request;
+            // A client renewing its lease gives its address in ciaddr instead
+            int ri = lease_index(d, opts.has_requested_ip ? opts.requested_ip : dhcp_msg->ciaddr);
+            if (ri < 0 || (ri != li && d->lease[ri].state != LEASE_FREE)) {
+                // Not one of our addresses, or not free for this client
+                reply_type = DHCPNACK;
+                break;
             }
-            uint8_t yi = o[5] - DHCPS_BASE_IP;
-            if (yi >= DHCPS_MAX_IP) {
-                // Should be NACK
-                goto ignore_request;
+            if (ri != li) {
+                // Moving to a different address, or one we didn't offer
+                if (li >= 0) {
+                    lease_free(d, li);
+                }
+                free_list_remove(d, ri);
+                lease_offer(d, ri, dhcp_msg->chaddr, now);
+                li = ri;
             }
-            if (memcmp(d->lease[yi].mac, dhcp_msg.chaddr, MAC_LEN) == 0) {
-                // MAC match, ok to use this IP address
-            } else if (memcmp(d->lease[yi].mac, "\x00\x00\x00\x00\x00\x00", MAC_LEN) == 0) {
-                // IP unused, ok to use this IP address
-                memcpy(d->lease[yi].mac, dhcp_msg.chaddr, MAC_LEN);
-            } else {
-                // IP already in use
-                // Should be NACK
-                goto ignore_request;
+            if (d->lease[li].state != LEASE_BOUND) {
+                d->lease[li].state = LEASE_BOUND;
+                store_schedule(d);
             }
-            d->lease[yi].expiry = (cyw43_hal_ticks_ms() + DEFAULT_LEASE_TIME_S * 1000) >> 16;
-            dhcp_msg.yiaddr[3] = DHCPS_BASE_IP + yi;
-            opt_write_u8(&opt, DHCP_OPT_MSG_TYPE, DHCPACK);
-            printf("DHCPS: client connected: MAC=%02x:%02x:%02x:%02x:%02x:%02x IP=%u.%u.%u.%u\n",
-                dhcp_msg.chaddr[0], dhcp_msg.chaddr[1], dhcp_msg.chaddr[2], dhcp_msg.chaddr[3], dhcp_msg.chaddr[4], dhcp_msg.chaddr[5],
-                dhcp_msg.yiaddr[0], dhcp_msg.yiaddr[1], dhcp_msg.yiaddr[2], dhcp_msg.yiaddr[3]);
+            lease_set_expiry(d, li, now + DEFAULT_LEASE_TIME_S * 1000);
+            reply_type = DHCPACK;
             break;
         }
 
+        case DHCPDECLINE: {
+            // Something else is using the address, so keep it out of use
+            // for a while
+            if (li >= 0 && opts.has_requested_ip && lease_index(d, opts.requested_ip) == li) {
+                if (d->lease[li].state == LEASE_BOUND) {
+                    store_schedule(d);
+                }
+                hash_remove(d, li);
+                memset(d->lease[li].mac, 0, MAC_LEN);
+                d->lease[li].state = LEASE_DECLINED;
+                lease_set_expiry(d, li, now + DECLINE_TIME_MS);
+                printf("DHCPS: address declined: IP=%u.%u.%u.%u\n", opts.requested_ip[0], opts.requested_ip[1],
+                    opts.requested_ip[2], opts.requested_ip[3]);
+            }
+            goto ignore_request;
+        }
+
+        case DHCPRELEASE: {
+            if (li >= 0 && lease_index(d, dhcp_msg->ciaddr) == li) {
+                lease_free(d, li);
+            }
+            goto ignore_request;
+        }
+
         default:
             goto ignore_request;
     }
 
-    opt_write_n(&opt, DHCP_OPT_SERVER_ID, 4, &ip4_addr_get_u32(ip_2_ip4(&d->ip)));
-    opt_write_n(&opt, DHCP_OPT_SUBNET_MASK, 4, &ip4_addr_get_u32(ip_2_ip4(&d->nm)));
-    opt_write_n(&opt, DHCP_OPT_ROUTER, 4, &ip4_addr_get_u32(ip_2_ip4(&d->ip))); // aka gateway; can have mulitple addresses
-    opt_write_n(&opt, DHCP_OPT_DNS, 4, &ip4_addr_get_u32(ip_2_ip4(&d->ip))); // this server is the dns
-    opt_write_u32(&opt, DHCP_OPT_IP_LEASE_TIME, DEFAULT_LEASE_TIME_S);
+    opt = (uint8_t *)dhcp_msg + offsetof(dhcp_msg_t, options) + 4;
+    opt_write_u8(&opt, DHCP_OPT_MSG_TYPE, reply_type);
+    opt_write_n(&opt, DHCP_OPT_SERVER_ID, 4, server_ip);
+    if (reply_type == DHCPNACK) {
+        memset(dhcp_msg->ciaddr, 0, 4);
+        memset(dhcp_msg->yiaddr, 0, 4);
+    } else {
+        lease_ip(d, li, dhcp_msg->yiaddr);
+        opt_write_n(&opt, DHCP_OPT_SUBNET_MASK, 4, &ip4_addr_get_u32(ip_2_ip4(&d->nm)));
+        opt_write_n(&opt, DHCP_OPT_ROUTER, 4, server_ip); // aka gateway; can have mulitple addresses
+        opt_write_n(&opt, DHCP_OPT_DNS, 4, server_ip); // this server is the dns
+        opt_write_u32(&opt, DHCP_OPT_IP_LEASE_TIME, DEFAULT_LEASE_TIME_S);
+    }
     *opt++ = DHCP_OPT_END;
-    dhcp_socket_sendto(&d->udp, &dhcp_msg, opt - (uint8_t *)&dhcp_msg, 0xffffffff, PORT_DHCP_CLIENT);
+
+    if (reply_type == DHCPACK) {
+        printf("DHCPS: client connected: MAC=%02x:%02x:%02x:%02x:%02x:%02x IP=%u.%u.%u.%u\n",
+            dhcp_msg->chaddr[0], dhcp_msg->chaddr[1], dhcp_msg->chaddr[2], dhcp_msg->chaddr[3], dhcp_msg->chaddr[4], dhcp_msg->chaddr[5],
+            dhcp_msg->yiaddr[0], dhcp_msg->yiaddr[1], dhcp_msg->yiaddr[2], dhcp_msg->yiaddr[3]);
+    }
+
+    dhcp_socket_sendto(&d->udp, reply, opt - (uint8_t *)dhcp_msg, 0xffffffff, PORT_DHCP_CLIENT);
 
 ignore_request:
+    if (reply != p) {
+        pbuf_free(reply);
+    }
     pbuf_free(p);
 }
 
@@ -292,6 +601,32 @@ void dhcp_server_init(dhcp_server_t *d, ip_addr_t *ip, ip_addr_t *nm) {
     ip_addr_copy(d->ip, *ip);
     ip_addr_copy(d->nm, *nm);
     memset(d->lease, 0, sizeof(d->lease));
+    memset(d->hash, NO_LEASE, sizeof(d->hash));
+    d->free_head = NO_LEASE;
+    d->free_tail = NO_LEASE;
+    d->heap_len = 0;
+
+    // The pool runs from DHCPS_BASE_IP into the subnet, stopping short of the
+    // broadcast address
+    uint32_t addr = lwip_ntohl(ip4_addr_get_u32(ip_2_ip4(ip)));
+    uint32_t mask = lwip_ntohl(ip4_addr_get_u32(ip_2_ip4(nm)));
+    uint32_t broadcast = (addr & mask) | ~mask;
+    d->first_ip = (addr & mask) + DHCPS_BASE_IP;
+    uint32_t n = broadcast > d->first_ip ? broadcast - d->first_ip : 0;
+    d->num_leases = n < DHCPS_MAX_IP ? n : DHCPS_MAX_IP;
+    for (uint8_t i = 0; i < d->num_leases; ++i) {
+        if (d->first_ip + i == addr) {
+            d->lease[i].state = LEASE_RESERVED;
+        } else {
+            free_list_push(d, i);
+        }
+    }
+
+#if DHCPS_PERSIST_LEASES
+    d->store_pending = false;
+    store_restore(d, cyw43_hal_ticks_ms());
+#endif
+
     if (dhcp_socket_new_dgram(&d->udp, d, dhcp_server_process) != 0) {
         return;
     }
@@ -300,4 +635,11 @@ void dhcp_server_init(dhcp_server_t *d, ip_addr_t *ip, ip_addr_t *nm) {
 
 void dhcp_server_deinit(dhcp_server_t *d) {
     dhcp_socket_free(&d->udp);
+#if DHCPS_PERSIST_LEASES
+    // Don't lose changes waiting to be written
+    if (d->store_pending) {
+        sys_untimeout(store_timeout, d);
+        store_timeout(d);
+    }
+#endif
 }
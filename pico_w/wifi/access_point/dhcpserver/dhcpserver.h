@@ -28,19 +28,64 @@
 
 #include "lwip/ip_addr.h"
 
+// Addresses are handed out from DHCPS_BASE_IP hosts into the server's
+// subnet, which need not be a /24, up to DHCPS_MAX_IP of them
+#ifndef DHCPS_BASE_IP
 #define DHCPS_BASE_IP (16)
-#define DHCPS_MAX_IP (8)
+#endif
+#ifndef DHCPS_MAX_IP
+#define DHCPS_MAX_IP (32)
+#endif
+// Buckets in the table of leases by MAC address; must be a power of 2
+#ifndef DHCPS_HASH_SIZE
+#define DHCPS_HASH_SIZE (64)
+#endif
+
+// Keep bound leases in flash, so clients get the same addresses back after
+// the access point restarts. Changes are batched up and written at most
+// once every DHCPS_STORE_DELAY_MS, to spare the flash.
+#ifndef DHCPS_PERSIST_LEASES
+#define DHCPS_PERSIST_LEASES (1)
+#endif
+#ifndef DHCPS_STORE_DELAY_MS
+#define DHCPS_STORE_DELAY_MS (10 * 1000)
+#endif
+
+#if DHCPS_MAX_IP > 254
+#error "DHCPS_MAX_IP must be less than 255"
+#endif
 
 typedef struct _dhcp_server_lease_t {
     uint8_t mac[6];
-    uint16_t expiry;
+    uint8_t state;
+    // Next lease in the same hash bucket, or in the free list
+    uint8_t next;
+    // Position in the expiry heap
+    uint8_t heap_index;
+    // In cyw43_hal_ticks_ms() time
+    uint32_t expiry;
 } dhcp_server_lease_t;
 
 typedef struct _dhcp_server_t {
     ip_addr_t ip;
     ip_addr_t nm;
+    // Address of lease[0], in host byte order
+    uint32_t first_ip;
+    uint8_t num_leases;
+    // Free leases, least recently used first
+    uint8_t free_head;
+    uint8_t free_tail;
+    uint8_t heap_len;
     dhcp_server_lease_t lease[DHCPS_MAX_IP];
+    // First lease in each bucket of the MAC address hash
+    uint8_t hash[DHCPS_HASH_SIZE];
+    // Leases in use, as a min-heap on expiry time
+    uint8_t heap[DHCPS_MAX_IP];
     struct udp_pcb *udp;
+#if DHCPS_PERSIST_LEASES
+    // A write of the leases to flash is scheduled
+    bool store_pending;
+#endif
 } dhcp_server_t;
 
 void dhcp_server_init(dhcp_server_t *d, ip_addr_t *ip, ip_addr_t *nm);
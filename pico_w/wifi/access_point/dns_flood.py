@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+
+# Load test for the access point's DNS server.
+#
+# usage: python3 dns_flood.py [--server 192.168.4.1] [--queries N] [--window N]
+#
+# Run it on a computer connected to the picow_test access point. It first
+# checks a few answers:
+#
+# - picow.lan has an A record for the access point
+# - any other name gets the access point's address too, as a captive portal
+# - AAAA queries get no answer and no error, as there is no IPv6 address
+# - a query with more than one question gets an answer for each
+#
+# and then floods the server with queries, keeping up to --window of them
+# outstanding, and reports how many were answered per second and how long
+# the answers took.
+
+import argparse
+import random
+import socket
+import struct
+import sys
+import time
+
+TYPE_A = 1
+TYPE_AAAA = 28
+CLASS_IN = 1
+
+
+def make_query(qid, questions):
+    msg = struct.pack("!HHHHHH", qid, 0x0100, len(questions), 0, 0, 0)
+    for name, qtype in questions:
+        for label in name.split("."):
+            msg += bytes([len(label)]) + label.encode()
+        msg += b"\0" + struct.pack("!HH", qtype, CLASS_IN)
+    return msg
+
+
+def parse_reply(data):
+    """Return (id, rcode, [(type, rdata)]) from a reply."""
+    qid, flags, qdcount, ancount, _, _ = struct.unpack("!HHHHHH", data[:12])
+    i = 12
+    for _ in range(qdcount):
+        while data[i]:
+            i += data[i] + 1
+        i += 5
+    answers = []
+    for _ in range(ancount):
+        if data[i] & 0xc0:
+            i += 2
+        else:
+            while data[i]:
+                i += data[i] + 1
+            i += 1
+        rtype, _, _, rdlen = struct.unpack("!HHIH", data[i:i + 10])
+        answers.append((rtype, data[i + 10:i + 10 + rdlen]))
+        i += 10 + rdlen
+    return qid, flags & 0xf, answers
+
+
+class Flood:
+    def __init__(self, args):
+        self.args = args
+        self.server = (args.server, 53)
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.failures = 0
+
+    def fail(self, message):
+        print(f"FAIL: {message}")
+        self.failures += 1
+
+    def ask(self, questions):
+        qid = random.randrange(0x10000)
+        self.sock.settimeout(self.args.timeout)
+        self.sock.sendto(make_query(qid, questions), self.server)
+        while True:
+            try:
+                data, _ = self.sock.recvfrom(1024)
+            except socket.timeout:
+                return None
+            reply = parse_reply(data)
+            if reply[0] == qid:
+                return reply
+
+    def check(self):
+        server_ip = socket.inet_aton(self.args.server)
+        reply = self.ask([("picow.lan", TYPE_A)])
+        if not reply or reply[1] != 0 or reply[2] != [(TYPE_A, server_ip)]:
+            self.fail(f"picow.lan: unexpected reply {reply}")
+        reply = self.ask([(f"x{random.randrange(1 << 30)}.example.com", TYPE_A)])
+        if not reply or reply[2] != [(TYPE_A, server_ip)]:
+            self.fail(f"captive portal name: unexpected reply {reply}")
+        reply = self.ask([("picow.lan", TYPE_AAAA)])
+        if not reply or reply[1] != 0 or reply[2]:
+            self.fail(f"AAAA: expected no answers and no error, got {reply}")
+        reply = self.ask([("picow.lan", TYPE_A), ("other.lan", TYPE_A)])
+        if not reply or len(reply[2]) != 2:
+            self.fail(f"two questions: unexpected reply {reply}")
+
+    def flood(self):
+        names = ["picow.lan", "connectivitycheck.gstatic.com", "www.msftconnecttest.com", "captive.apple.com"]
+        self.sock.setblocking(False)
+        sent = {}
+        latencies = []
+        next_id = 0
+        start = time.monotonic()
+        deadline = start
+        while len(latencies) + len(sent) < self.args.queries or sent:
+            now = time.monotonic()
+            while len(sent) < self.args.window and len(latencies) + len(sent) < self.args.queries:
+                qid = next_id & 0xffff
+                next_id += 1
+                self.sock.sendto(make_query(qid, [(names[qid % len(names)], TYPE_A)]), self.server)
+                sent[qid] = now
+                deadline = now + self.args.timeout
+            try:
+                data, _ = self.sock.recvfrom(1024)
+            except BlockingIOError:
+                if now > deadline:
+                    break
+                time.sleep(0.0005)
+                continue
+            qid = struct.unpack("!H", data[:2])[0]
+            if qid in sent:
+                latencies.append(time.monotonic() - sent.pop(qid))
+        elapsed = time.monotonic() - start
+        lost = len(sent)
+        if not latencies:
+            sys.exit("No replies; is this computer connected to the access point?")
+        latencies.sort()
+        print(f"{len(latencies)} answered, {lost} lost, in {elapsed:.2f} s: {len(latencies) / elapsed:.0f} queries/s")
+        print(f"latency: median {latencies[len(latencies) // 2] * 1000:.1f} ms, "
+              f"99th percentile {latencies[len(latencies) * 99 // 100] * 1000:.1f} ms")
+
+    def run(self):
+        self.check()
+        self.flood()
+        print(f"{self.failures} failures")
+        return self.failures == 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Query flood against a DNS server")
+    parser.add_argument("--server", default="192.168.4.1", help="address of the DNS server")
+    parser.add_argument("--queries", type=int, default=10000, help="number of queries in the flood")
+    parser.add_argument("--window", type=int, default=16, help="most queries waiting for an answer at once")
+    parser.add_argument("--timeout", type=float, default=1.0, help="seconds to wait for an answer")
+    args = parser.parse_args()
+    sys.exit(0 if Flood(args).run() else 1)
+
+
+if __name__ == "__main__":
+    main()
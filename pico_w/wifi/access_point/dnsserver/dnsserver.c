@@ -6,6 +6,8 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <errno.h>
 #include <assert.h>
 #include <stdbool.h>
@@ -29,6 +31,18 @@ typedef struct dns_header_t_ {
 } dns_header_t;
 
 #define MAX_DNS_MSG_SIZE 300
+#define MAX_DNS_NAME_LEN 255
+// Most questions answered in one query; hardly anything sends more than one
+#define MAX_DNS_QUESTIONS 4
+// Tries at finding a seed that hashes every name to its own slot
+#define MAX_HASH_SEEDS 4096
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_AAAA 28
+#define DNS_CLASS_IN 1
+#define DNS_CLASS_ANY 255
+#define DNS_RCODE_NXDOMAIN 3
+#define DNS_TTL_S 60
 
 static int dns_socket_new_dgram(struct udp_pcb **udp, void *cb_data, udp_recv_fn cb_udp_recv) {
     *udp = udp_new();
@@ -73,41 +87,109 @@ static void dump_bytes(const uint8_t *bptr, uint32_t len) {
 }
 #endif
 
-static int dns_socket_sendto(struct udp_pcb **udp, const void *buf, size_t len, const ip_addr_t *dest, uint16_t port) {
-    if (len > 0xffff) {
-        len = 0xffff;
-    }
-
-    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
-    if (p == NULL) {
-        ERROR_printf("DNS: Failed to send message out of memory\n");
-        return -ENOMEM;
+static int dns_socket_sendto(struct udp_pcb **udp, struct pbuf *p, const ip_addr_t *dest, uint16_t port) {
+#if DUMP_DATA
+    for (struct pbuf *q = p; q != NULL; q = q->next) {
+        dump_bytes(q->payload, q->len);
     }
-
-    memcpy(p->payload, buf, len);
+#endif
     err_t err = udp_sendto(*udp, p, dest, port);
-
-    pbuf_free(p);
-
     if (err != ERR_OK) {
         ERROR_printf("DNS: Failed to send message %d\n", err);
         return err;
     }
+    return p->tot_len;
+}
 
-#if DUMP_DATA
-    dump_bytes(buf, len);
-#endif
-    return len;
+// FNV-1a with a seed, over a name ignoring case, finished so that the low
+// bits used for the slot depend on every character
+static uint32_t name_hash(uint32_t seed, const char *name) {
+    uint32_t h = 2166136261u ^ seed;
+    for (; *name; ++name) {
+        h = (h ^ (uint8_t)tolower((unsigned char)*name)) * 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    return h & (DNS_SERVER_HASH_SIZE - 1);
+}
+
+static const dns_server_record_t *name_lookup(dns_server_t *d, const char *name) {
+    if (!d->num_names) {
+        return NULL;
+    }
+    uint8_t slot = d->hash[name_hash(d->hash_seed, name)];
+    if (slot && strcasecmp(d->records[slot - 1].name, name) == 0) {
+        return &d->records[slot - 1];
+    }
+    return NULL;
+}
+
+// An answer record for the name at offset 12, just after the header. When
+// a reply has it for another question, the name pointer is patched.
+static void write_answer(uint8_t *answer_ptr, uint16_t type, const void *addr, uint16_t addr_len) {
+    *answer_ptr++ = 0xc0; // pointer
+    *answer_ptr++ = sizeof(dns_header_t); // pointer to question
+    *answer_ptr++ = type >> 8;
+    *answer_ptr++ = type;
+    *answer_ptr++ = 0;
+    *answer_ptr++ = DNS_CLASS_IN; // Internet class
+    *answer_ptr++ = 0;
+    *answer_ptr++ = 0;
+    *answer_ptr++ = 0;
+    *answer_ptr++ = DNS_TTL_S;
+    *answer_ptr++ = 0;
+    *answer_ptr++ = addr_len; // length
+    memcpy(answer_ptr, addr, addr_len);
+}
+
+typedef struct {
+    // Offset of the name in the message
+    uint16_t name_offset;
+    // The answer record, or NULL if there isn't one
+    const uint8_t *answer;
+    uint8_t answer_len;
+} dns_question_t;
+
+// Read the name at *ptr as a dotted, nul-terminated string and step past it.
+// Returns false if it isn't valid, or runs past end.
+static bool read_name(const uint8_t **ptr, const uint8_t *end, char *name) {
+    const uint8_t *question_ptr = *ptr;
+    size_t name_len = 0;
+    while (question_ptr < end) {
+        int label_len = *question_ptr++;
+        if (label_len == 0) {
+            name[name_len ? name_len - 1 : 0] = '\0';
+            *ptr = question_ptr;
+            return true;
+        }
+        // This also rules out compression, which queries don't use
+        if (label_len > 63) {
+            DEBUG_printf("Invalid label\n");
+            return false;
+        }
+        if (label_len > end - question_ptr || name_len + label_len + 1 > MAX_DNS_NAME_LEN) {
+            DEBUG_printf("Invalid question length\n");
+            return false;
+        }
+        memcpy(&name[name_len], question_ptr, label_len);
+        name_len += label_len;
+        name[name_len++] = '.';
+        question_ptr += label_len;
+    }
+    return false;
 }
 
 static void dns_server_process(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *src_addr, u16_t src_port) {
     dns_server_t *d = arg;
     DEBUG_printf("dns_server_process %u\n", p->tot_len);
 
-    uint8_t dns_msg[MAX_DNS_MSG_SIZE];
+    // The query is parsed and the reply written in place, so the header and
+    // questions must be in the first pbuf
+    uint8_t *dns_msg = p->payload;
     dns_header_t *dns_hdr = (dns_header_t*)dns_msg;
 
-    size_t msg_len = pbuf_copy_partial(p, dns_msg, sizeof(dns_msg), 0);
+    size_t msg_len = LWIP_MIN(p->len, MAX_DNS_MSG_SIZE);
     if (msg_len < sizeof(dns_header_t)) {
         goto ignore_request;
     }
@@ -141,83 +223,116 @@ static void dns_server_process(void *arg, struct udp_pcb *upcb, struct pbuf *p,
     }
 
     // Check question count
-    if (question_count < 1) {
+    if (question_count < 1 || question_count > MAX_DNS_QUESTIONS) {
         DEBUG_printf("Invalid question count\n");
         goto ignore_request;
     }
 
-    // Print the question
-    DEBUG_printf("question: ");
-    const uint8_t *question_ptr_start = dns_msg + sizeof(dns_header_t);
+    // Find an answer for each question
+    dns_question_t questions[MAX_DNS_QUESTIONS];
+    int answer_count = 0;
+    int unknown_count = 0;
+    size_t answers_len = 0;
+    const uint8_t *question_ptr = dns_msg + sizeof(dns_header_t);
     const uint8_t *question_ptr_end = dns_msg + msg_len;
-    const uint8_t *question_ptr = question_ptr_start;
-    while(question_ptr < question_ptr_end) {
-        if (*question_ptr == 0) {
-            question_ptr++;
-            break;
-        } else {
-            if (question_ptr > question_ptr_start) {
-                DEBUG_printf(".");
+    for (int i = 0; i < question_count; ++i) {
+        char name[MAX_DNS_NAME_LEN + 1];
+        dns_question_t *q = &questions[i];
+        q->name_offset = question_ptr - dns_msg;
+        if (!read_name(&question_ptr, question_ptr_end, name) || question_ptr_end - question_ptr < 4) {
+            goto ignore_request;
+        }
+        uint16_t qtype = question_ptr[0] << 8 | question_ptr[1];
+        uint16_t qclass = question_ptr[2] << 8 | question_ptr[3];
+        question_ptr += 4;
+        DEBUG_printf("question: %s type %u\n", name, qtype);
+
+        // Names we know, but not with this type of address, get no answer and
+        // no error
+        q->answer = NULL;
+        q->answer_len = 0;
+        const dns_server_record_t *record = name_lookup(d, name);
+        if (qclass != DNS_CLASS_IN && qclass != DNS_CLASS_ANY) {
+            // Nothing to say about other classes
+        } else if (record && qtype == DNS_TYPE_A) {
+            q->answer = record->a;
+            q->answer_len = DNS_ANSWER_SIZE;
+        } else if (record && qtype == DNS_TYPE_AAAA && record->has_aaaa) {
+            q->answer = record->aaaa;
+            q->answer_len = DNS_AAAA_ANSWER_SIZE;
+        } else if (!record && d->answer_others) {
+            if (qtype == DNS_TYPE_A) {
+                q->answer = d->answer;
+                q->answer_len = DNS_ANSWER_SIZE;
             }
-            int label_len = *question_ptr++;
-            if (label_len > 63) {
-                DEBUG_printf("Invalid label\n");
+        } else if (!record) {
+            ++unknown_count;
+        }
+        if (q->answer) {
+            ++answer_count;
+            answers_len += q->answer_len;
+        }
+    }
+
+    // Drop anything after the questions, and chain on the answers. The
+    // records are built ahead of time with a pointer to the first question's
+    // name, so one answer to the first question can be sent from where it
+    // is, through the shared answer pbuf if nothing else is holding it.
+    struct pbuf *answers = NULL;
+    if (answer_count == 1 && questions[0].answer) {
+        answers = d->answer_pbuf;
+        if (answers != NULL && answers->ref == 1) {
+            pbuf_ref(answers);
+        } else {
+            answers = pbuf_alloc(PBUF_RAW, questions[0].answer_len, PBUF_REF);
+            if (answers == NULL) {
                 goto ignore_request;
             }
-            DEBUG_printf("%.*s", label_len, question_ptr);
-            question_ptr += label_len;
+        }
+        answers->payload = (void *)questions[0].answer;
+        answers->len = answers->tot_len = questions[0].answer_len;
+    } else if (answer_count) {
+        // Otherwise copy them, pointing each at its own question's name
+        answers = pbuf_alloc(PBUF_RAW, answers_len, PBUF_RAM);
+        if (answers == NULL) {
+            goto ignore_request;
+        }
+        uint8_t *answer_ptr = answers->payload;
+        for (int i = 0; i < question_count; ++i) {
+            if (questions[i].answer) {
+                memcpy(answer_ptr, questions[i].answer, questions[i].answer_len);
+                answer_ptr[0] = 0xc0 | questions[i].name_offset >> 8;
+                answer_ptr[1] = questions[i].name_offset;
+                answer_ptr += questions[i].answer_len;
+            }
         }
     }
-    DEBUG_printf("\n");
-
-    // Check question length
-    if (question_ptr - question_ptr_start > 255) {
-        DEBUG_printf("Invalid question length\n");
-        goto ignore_request;
+    pbuf_realloc(p, question_ptr - dns_msg);
+    if (answers) {
+        pbuf_cat(p, answers);
     }
 
-    // Skip QNAME and QTYPE
-    question_ptr += 4;
-
-    // Generate answer
-    uint8_t *answer_ptr = dns_msg + (question_ptr - dns_msg);
-    *answer_ptr++ = 0xc0; // pointer
-    *answer_ptr++ = question_ptr_start - dns_msg; // pointer to question
-    
-    *answer_ptr++ = 0;
-    *answer_ptr++ = 1; // host address
-
-    *answer_ptr++ = 0;
-    *answer_ptr++ = 1; // Internet class
-
-    *answer_ptr++ = 0;
-    *answer_ptr++ = 0;
-    *answer_ptr++ = 0;
-    *answer_ptr++ = 60; // ttl 60s
-
-    *answer_ptr++ = 0;
-    *answer_ptr++ = 4; // length
-    memcpy(answer_ptr, &d->ip.addr, 4); // use our address
-    answer_ptr += 4;
-
     dns_hdr->flags = lwip_htons(
                 0x1 << 15 | // QR = response
                 0x1 << 10 | // AA = authoritive
-                0x1 << 7);   // RA = authenticated
-    dns_hdr->question_count = lwip_htons(1);
-    dns_hdr->answer_record_count = lwip_htons(1);
+                (flags & 0x1 << 8) | // RD, copied from the query
+                (unknown_count == question_count ? DNS_RCODE_NXDOMAIN : 0));
+    dns_hdr->answer_record_count = lwip_htons(answer_count);
     dns_hdr->authority_record_count = 0;
     dns_hdr->additional_record_count = 0;
 
     // Send the reply
-    DEBUG_printf("Sending %d byte reply to %s:%d\n", answer_ptr - dns_msg, ipaddr_ntoa(src_addr), src_port);
-    dns_socket_sendto(&d->udp, &dns_msg, answer_ptr - dns_msg, src_addr, src_port);
+    DEBUG_printf("Sending %d byte reply to %s:%d\n", p->tot_len, ipaddr_ntoa(src_addr), src_port);
+    dns_socket_sendto(&d->udp, p, src_addr, src_port);
 
 ignore_request:
     pbuf_free(p);
 }
 
 void dns_server_init(dns_server_t *d, ip_addr_t *ip) {
+    d->answer_pbuf = NULL;
+    d->answer_others = true;
+    d->num_names = 0;
     if (dns_socket_new_dgram(&d->udp, d, dns_server_process) != ERR_OK) {
         DEBUG_printf("dns server failed to start\n");
         return;
@@ -227,9 +342,71 @@ void dns_server_init(dns_server_t *d, ip_addr_t *ip) {
         return;
     }
     ip_addr_copy(d->ip, *ip);
+
+    // The answer for names we don't know: our own address
+    write_answer(d->answer, DNS_TYPE_A, &d->ip.addr, 4);
+
+    d->answer_pbuf = pbuf_alloc(PBUF_RAW, DNS_ANSWER_SIZE, PBUF_REF);
+    if (d->answer_pbuf != NULL) {
+        d->answer_pbuf->payload = d->answer;
+    }
     DEBUG_printf("dns server listening on port %d\n", PORT_DNS_SERVER);
 }
 
+bool dns_server_set_names(dns_server_t *d, const dns_server_name_t *names, size_t count, bool answer_others) {
+    // Nothing changes unless the new names are usable, so a bad list leaves
+    // the server answering as it was
+    if (count > DNS_SERVER_MAX_NAMES) {
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            if (strcasecmp(names[i].name, names[j].name) == 0) {
+                return false;
+            }
+        }
+    }
+
+    // Look for a seed that puts each name in a slot of its own, so a lookup
+    // is one hash and one comparison
+    uint8_t hash[DNS_SERVER_HASH_SIZE];
+    uint32_t hash_seed = 0;
+    bool found = false;
+    for (uint32_t seed = 0; seed < MAX_HASH_SEEDS && !found; ++seed) {
+        memset(hash, 0, sizeof(hash));
+        found = true;
+        for (size_t i = 0; i < count && found; ++i) {
+            uint8_t *slot = &hash[name_hash(seed, names[i].name)];
+            found = !*slot;
+            *slot = i + 1;
+        }
+        hash_seed = seed;
+    }
+    if (!found) {
+        return false;
+    }
+
+    // Build each name's answers now, rather than for every query
+    memcpy(d->hash, hash, sizeof(d->hash));
+    d->hash_seed = hash_seed;
+    for (size_t i = 0; i < count; ++i) {
+        dns_server_record_t *record = &d->records[i];
+        record->name = names[i].name;
+        write_answer(record->a, DNS_TYPE_A, &ip4_addr_get_u32(&names[i].ip4), 4);
+        record->has_aaaa = names[i].ip6 != NULL;
+        if (record->has_aaaa) {
+            write_answer(record->aaaa, DNS_TYPE_AAAA, names[i].ip6, 16);
+        }
+    }
+    d->num_names = count;
+    d->answer_others = answer_others;
+    return true;
+}
+
 void dns_server_deinit(dns_server_t *d) {
     dns_socket_free(&d->udp);
+    if (d->answer_pbuf != NULL) {
+        pbuf_free(d->answer_pbuf);
+        d->answer_pbuf = NULL;
+    }
 }
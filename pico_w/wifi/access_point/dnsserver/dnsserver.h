@@ -9,12 +9,68 @@
 
 #include "lwip/ip_addr.h"
 
+// Most names dns_server_set_names accepts
+#ifndef DNS_SERVER_MAX_NAMES
+#define DNS_SERVER_MAX_NAMES 16
+#endif
+
+// Slots in the perfect hash of names; a power of 2, and a few times
+// DNS_SERVER_MAX_NAMES so a collision-free seed is quick to find
+#ifndef DNS_SERVER_HASH_SIZE
+#define DNS_SERVER_HASH_SIZE (4 * DNS_SERVER_MAX_NAMES)
+#endif
+
+#if DNS_SERVER_MAX_NAMES > 255
+#error "DNS_SERVER_MAX_NAMES must be less than 256"
+#endif
+
+#define DNS_ANSWER_SIZE 16
+#define DNS_AAAA_ANSWER_SIZE 28
+
+typedef struct dns_server_name_t_ {
+    // e.g. "picow.lan", matched without regard to case
+    const char *name;
+    // Answer to A queries
+    ip4_addr_t ip4;
+    // Answer to AAAA queries, 16 bytes in network order, or NULL if there is
+    // no IPv6 address
+    const uint8_t *ip6;
+} dns_server_name_t;
+
+// A name with its answer records, built ahead of time
+typedef struct dns_server_record_t_ {
+    const char *name;
+    uint8_t a[DNS_ANSWER_SIZE];
+    uint8_t aaaa[DNS_AAAA_ANSWER_SIZE];
+    bool has_aaaa;
+} dns_server_record_t;
+
 typedef struct dns_server_t_ {
     struct udp_pcb *udp;
      ip_addr_t ip;
+    // Answer A queries for names not in the table with our own address, as
+    // a captive portal does, rather than with NXDOMAIN
+    bool answer_others;
+    uint8_t num_names;
+    uint32_t hash_seed;
+    // Index plus one of the record in each hash slot, or 0
+    uint8_t hash[DNS_SERVER_HASH_SIZE];
+    dns_server_record_t records[DNS_SERVER_MAX_NAMES];
+    // The answer for names not in the table
+    uint8_t answer[DNS_ANSWER_SIZE];
+    // A pbuf pointed at an answer record and chained on to each reply
+    struct pbuf *answer_pbuf;
 } dns_server_t;
 
+// Start a server answering every A query with ip
 void dns_server_init(dns_server_t *d, ip_addr_t *ip);
+
+// Answer for just these names, and any others with ip as well if
+// answer_others is set. The names are copied, but the strings must outlive
+// the server. Returns false if there are too many names, or the same name
+// twice.
+bool dns_server_set_names(dns_server_t *d, const dns_server_name_t *names, size_t count, bool answer_others);
+
 void dns_server_deinit(dns_server_t *d);
 
 #endif
@@ -0,0 +1,18 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Stand-in for the cyw43 driver's configuration, for building the access
+// point's servers on the host; see lwip_standin.h
+
+#ifndef _CYW43_CONFIG_H
+#define _CYW43_CONFIG_H
+
+#include <stdint.h>
+
+// The stand-in's clock, which only moves when a test moves it
+uint32_t cyw43_hal_ticks_ms(void);
+
+#endif
@@ -0,0 +1,386 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the DHCP server against the lwIP stand-in:
+//
+// - the exchanges a client goes through: DISCOVER and REQUEST, coming back
+//   for the same address, renewing, RELEASE and DECLINE, and the NAKs for
+//   addresses that aren't the client's to have
+// - a storm of clients coming, going and disappearing over many lease
+//   times, with the clock wrapping, checking after every message that the
+//   lease table holds together and that no address is given to two clients
+//   at once
+// - pools for subnets other than a /24
+//
+// Exits with 0 if every check passes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cyw43_config.h"
+#include "dhcpserver.h"
+#include "lwip_standin.h"
+
+#define DHCPDISCOVER 1
+#define DHCPOFFER 2
+#define DHCPREQUEST 3
+#define DHCPDECLINE 4
+#define DHCPACK 5
+#define DHCPNAK 6
+#define DHCPRELEASE 7
+
+#define OPT_REQUESTED_IP 50
+#define OPT_LEASE_TIME 51
+#define OPT_MSG_TYPE 53
+#define OPT_SERVER_ID 54
+#define OPT_END 255
+
+// From dhcpserver.c
+#define LEASE_FREE 0
+#define LEASE_OFFERED 1
+#define LEASE_BOUND 2
+#define LEASE_RESERVED 4
+#define NO_LEASE 0xff
+
+// Clients in the storm, a few times the number of addresses
+#define STORM_CLIENTS (4 * DHCPS_MAX_IP)
+#define STORM_ROUNDS 20000
+
+static dhcp_server_t server;
+static const uint8_t server_ip[4] = {192, 168, 4, 1};
+static int failures;
+static bool section_ok;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        section_ok = false; \
+    } \
+} while (0)
+
+static void section_end(const char *name) {
+    printf("%-32s %s\n", name, section_ok ? "ok" : "FAILED");
+    if (!section_ok) {
+        failures++;
+    }
+    section_ok = true;
+}
+
+static void make_mac(uint32_t client, uint8_t *mac) {
+    // Locally administered
+    mac[0] = 0x02;
+    mac[1] = 0x00;
+    mac[2] = client >> 24;
+    mac[3] = client >> 16;
+    mac[4] = client >> 8;
+    mac[5] = client;
+}
+
+// The value of an option in the last reply, or NULL
+static const uint8_t *reply_option(uint8_t code) {
+    const uint8_t *opt = lwip_standin_sent.data + 240;
+    const uint8_t *end = lwip_standin_sent.data + lwip_standin_sent.len;
+    while (opt < end && *opt != OPT_END) {
+        if (*opt == 0) {
+            opt++;
+        } else if (opt + 2 > end || opt + 2 + opt[1] > end) {
+            return NULL;
+        } else if (*opt == code) {
+            return opt + 2;
+        } else {
+            opt += 2 + opt[1];
+        }
+    }
+    return NULL;
+}
+
+static const uint8_t *reply_yiaddr(void) {
+    return lwip_standin_sent.data + 16;
+}
+
+// Send a message from a client, 300 bytes long as BOOTP asks, and return the
+// type of the reply, or 0 if there was none
+static int send_msg(uint8_t type, uint32_t client, const uint8_t *requested_ip, const uint8_t *ciaddr,
+                    const uint8_t *server_id) {
+    uint8_t msg[300] = {1, 1, 6, 0};
+    uint32_t xid = client * 2654435761u + type;
+    memcpy(&msg[4], &xid, 4);
+    if (ciaddr) {
+        memcpy(&msg[12], ciaddr, 4);
+    }
+    make_mac(client, &msg[28]);
+    uint8_t *opt = &msg[236];
+    memcpy(opt, "\x63\x82\x53\x63", 4);
+    opt += 4;
+    *opt++ = OPT_MSG_TYPE;
+    *opt++ = 1;
+    *opt++ = type;
+    if (requested_ip) {
+        *opt++ = OPT_REQUESTED_IP;
+        *opt++ = 4;
+        memcpy(opt, requested_ip, 4);
+        opt += 4;
+    }
+    if (server_id) {
+        *opt++ = OPT_SERVER_ID;
+        *opt++ = 4;
+        memcpy(opt, server_id, 4);
+        opt += 4;
+    }
+    *opt++ = OPT_END;
+
+    ip_addr_t src;
+    IP4_ADDR(&src, 0, 0, 0, 0);
+    uint32_t sent = lwip_standin_stats.datagrams_sent;
+    lwip_standin_udp_deliver(server.udp, msg, sizeof(msg), &src, 68);
+    if (lwip_standin_stats.datagrams_sent == sent) {
+        return 0;
+    }
+    const uint8_t *reply = lwip_standin_sent.data;
+    CHECK(lwip_standin_sent.port == 68 && lwip_standin_sent.addr.addr == 0xffffffff);
+    CHECK(reply[0] == 2 && !memcmp(&reply[4], &xid, 4) && !memcmp(&reply[28], &msg[28], 6));
+    const uint8_t *reply_server = reply_option(OPT_SERVER_ID);
+    CHECK(reply_server && !memcmp(reply_server, server_ip, 4));
+    const uint8_t *reply_type = reply_option(OPT_MSG_TYPE);
+    CHECK(reply_type);
+    return reply_type ? *reply_type : 0;
+}
+
+// DISCOVER then REQUEST, returning the last byte of the address bound
+static int bind_client(uint32_t client) {
+    if (send_msg(DHCPDISCOVER, client, NULL, NULL, NULL) != DHCPOFFER) {
+        return -1;
+    }
+    uint8_t ip[4];
+    memcpy(ip, reply_yiaddr(), 4);
+    if (send_msg(DHCPREQUEST, client, ip, NULL, server_ip) != DHCPACK || memcmp(reply_yiaddr(), ip, 4)) {
+        return -1;
+    }
+    return ip[3];
+}
+
+static bool expires_before(uint8_t a, uint8_t b) {
+    return (int32_t)(server.lease[a].expiry - server.lease[b].expiry) < 0;
+}
+
+// Every lease is in exactly one of the free list and the expiry heap, except
+// the server's own address, and the heap is in order
+static void check_tables(void) {
+    int in_heap[DHCPS_MAX_IP] = {0};
+    for (int pos = 0; pos < server.heap_len; pos++) {
+        uint8_t i = server.heap[pos];
+        CHECK(i < server.num_leases && server.lease[i].heap_index == pos);
+        CHECK(server.lease[i].state != LEASE_FREE && server.lease[i].state != LEASE_RESERVED);
+        CHECK(pos == 0 || !expires_before(i, server.heap[(pos - 1) / 2]));
+        in_heap[i]++;
+    }
+    int free_count = 0;
+    uint8_t last = NO_LEASE;
+    for (uint8_t i = server.free_head; i != NO_LEASE && free_count <= DHCPS_MAX_IP; i = server.lease[i].next) {
+        CHECK(server.lease[i].state == LEASE_FREE && !in_heap[i]);
+        free_count++;
+        last = i;
+    }
+    CHECK(server.free_tail == last);
+    int reserved = 0;
+    int bound_or_offered = 0;
+    for (int i = 0; i < server.num_leases; i++) {
+        CHECK(in_heap[i] <= 1);
+        reserved += server.lease[i].state == LEASE_RESERVED;
+        bound_or_offered += server.lease[i].state == LEASE_OFFERED || server.lease[i].state == LEASE_BOUND;
+        for (int j = 0; j < i; j++) {
+            if (server.lease[i].state == LEASE_BOUND && server.lease[j].state == LEASE_BOUND) {
+                CHECK(memcmp(server.lease[i].mac, server.lease[j].mac, 6) != 0);
+            }
+        }
+    }
+    CHECK(free_count + server.heap_len + reserved == server.num_leases);
+    int hashed = 0;
+    for (int b = 0; b < DHCPS_HASH_SIZE; b++) {
+        for (uint8_t i = server.hash[b]; i != NO_LEASE && hashed <= DHCPS_MAX_IP; i = server.lease[i].next) {
+            CHECK(server.lease[i].state == LEASE_OFFERED || server.lease[i].state == LEASE_BOUND);
+            hashed++;
+        }
+    }
+    CHECK(hashed == bound_or_offered);
+}
+
+static void start_server(const uint8_t *ip, const uint8_t *mask) {
+    ip_addr_t addr, nm;
+    IP4_ADDR(&addr, ip[0], ip[1], ip[2], ip[3]);
+    IP4_ADDR(&nm, mask[0], mask[1], mask[2], mask[3]);
+    dhcp_server_init(&server, &addr, &nm);
+}
+
+static void test_exchanges(void) {
+    static const uint8_t mask[4] = {255, 255, 255, 0};
+    start_server(server_ip, mask);
+    CHECK(server.num_leases == DHCPS_MAX_IP);
+
+    uint8_t a[4], b[4];
+    CHECK(send_msg(DHCPDISCOVER, 1, NULL, NULL, NULL) == DHCPOFFER);
+    memcpy(a, reply_yiaddr(), 4);
+    CHECK(a[0] == 192 && a[1] == 168 && a[2] == 4 && a[3] == DHCPS_BASE_IP);
+    const uint8_t *lease_time = reply_option(OPT_LEASE_TIME);
+    CHECK(lease_time && lease_time[0] == 0 && lease_time[1] == 1 && lease_time[2] == 0x51 && lease_time[3] == 0x80);
+    CHECK(send_msg(DHCPREQUEST, 1, a, NULL, server_ip) == DHCPACK && !memcmp(reply_yiaddr(), a, 4));
+    check_tables();
+
+    // Coming back gets the same address
+    CHECK(send_msg(DHCPDISCOVER, 1, NULL, NULL, NULL) == DHCPOFFER && !memcmp(reply_yiaddr(), a, 4));
+    // Another client asking for it is refused
+    CHECK(send_msg(DHCPREQUEST, 2, a, NULL, server_ip) == DHCPNAK);
+    CHECK(!memcmp(reply_yiaddr(), "\0\0\0\0", 4));
+    // So is an address from outside the pool
+    static const uint8_t elsewhere[4] = {10, 0, 0, 1};
+    CHECK(send_msg(DHCPREQUEST, 3, elsewhere, NULL, server_ip) == DHCPNAK);
+    // Renewing gives the address in ciaddr
+    CHECK(send_msg(DHCPREQUEST, 1, NULL, a, NULL) == DHCPACK && !memcmp(reply_yiaddr(), a, 4));
+    check_tables();
+
+    // Once released, another client can ask for the address
+    CHECK(send_msg(DHCPRELEASE, 1, NULL, a, NULL) == 0);
+    check_tables();
+    CHECK(send_msg(DHCPDISCOVER, 2, a, NULL, NULL) == DHCPOFFER && !memcmp(reply_yiaddr(), a, 4));
+    // The client took another server's offer, so the address is free again
+    CHECK(send_msg(DHCPREQUEST, 2, a, NULL, elsewhere) == 0);
+    check_tables();
+    CHECK(server.heap_len == 0);
+
+    // A declined address is kept out of use
+    int declined = bind_client(5);
+    CHECK(declined >= 0);
+    memcpy(b, server_ip, 3);
+    b[3] = declined;
+    CHECK(send_msg(DHCPDECLINE, 5, b, NULL, server_ip) == 0);
+    check_tables();
+    CHECK(send_msg(DHCPREQUEST, 6, b, NULL, server_ip) == DHCPNAK);
+    for (uint32_t client = 100; client < 100 + DHCPS_MAX_IP; client++) {
+        int got = bind_client(client);
+        CHECK(got != declined);
+        if (got < 0) {
+            break;
+        }
+    }
+    check_tables();
+    // The pool is full, so a new client gets no offer at all
+    CHECK(send_msg(DHCPDISCOVER, 1000, NULL, NULL, NULL) == 0);
+    // After ten minutes the declined address is free again
+    lwip_standin_advance(11 * 60 * 1000);
+    CHECK(send_msg(DHCPDISCOVER, 1000, NULL, NULL, NULL) == DHCPOFFER && reply_yiaddr()[3] == declined);
+    check_tables();
+
+    // A message that isn't DHCP, and one that's too short, get no reply
+    uint8_t junk[300] = {1, 1, 6};
+    uint32_t sent = lwip_standin_stats.datagrams_sent;
+    lwip_standin_udp_deliver(server.udp, junk, sizeof(junk), IP_ADDR_ANY, 68);
+    lwip_standin_udp_deliver(server.udp, junk, 200, IP_ADDR_ANY, 68);
+    CHECK(lwip_standin_stats.datagrams_sent == sent);
+    dhcp_server_deinit(&server);
+    section_end("client exchanges");
+}
+
+static void test_storm(void) {
+    static const uint8_t mask[4] = {255, 255, 255, 0};
+    // Near the end of the clock, so expiry times wrap
+    lwip_standin_set_time(0xffffffff - 3 * 60 * 60 * 1000);
+    start_server(server_ip, mask);
+
+    // What each client was given, as far as it knows
+    static uint8_t client_ip[STORM_CLIENTS];
+    static uint32_t client_expiry[STORM_CLIENTS];
+    uint32_t messages = 0, acks = 0, naks = 0, unanswered = 0;
+    srand(1);
+    clock_t start = clock();
+    for (int round = 0; round < STORM_ROUNDS; round++) {
+        uint32_t client = rand() % STORM_CLIENTS;
+        uint32_t now = cyw43_hal_ticks_ms();
+        bool bound = client_ip[client] && (int32_t)(client_expiry[client] - now) > 0;
+        int action = rand() % 8;
+        if (bound && action == 0) {
+            uint8_t ip[4] = {192, 168, 4, client_ip[client]};
+            send_msg(DHCPRELEASE, client, NULL, ip, NULL);
+            client_ip[client] = 0;
+        } else if (bound && action == 1) {
+            // Renew
+            uint8_t ip[4] = {192, 168, 4, client_ip[client]};
+            int reply = send_msg(DHCPREQUEST, client, NULL, ip, NULL);
+            CHECK(reply == DHCPACK);
+            client_expiry[client] = now + 24 * 60 * 60 * 1000;
+            acks += reply == DHCPACK;
+        } else {
+            int reply = send_msg(DHCPDISCOVER, client, NULL, NULL, NULL);
+            messages++;
+            if (reply == DHCPOFFER) {
+                uint8_t ip[4];
+                memcpy(ip, reply_yiaddr(), 4);
+                // Nobody else may hold the address
+                for (uint32_t other = 0; other < STORM_CLIENTS; other++) {
+                    if (other != client && client_ip[other] == ip[3]) {
+                        CHECK((int32_t)(client_expiry[other] - now) <= 0);
+                        client_ip[other] = 0;
+                    }
+                }
+                // Some clients go away without asking for the offer
+                if (action != 2) {
+                    reply = send_msg(DHCPREQUEST, client, ip, NULL, server_ip);
+                    messages++;
+                    CHECK(reply == DHCPACK && reply_yiaddr()[3] == ip[3]);
+                    acks += reply == DHCPACK;
+                    naks += reply == DHCPNAK;
+                    client_ip[client] = ip[3];
+                    client_expiry[client] = now + 24 * 60 * 60 * 1000;
+                }
+            } else {
+                CHECK(reply == 0 && server.free_head == NO_LEASE);
+                unanswered++;
+            }
+        }
+        messages++;
+        check_tables();
+        // Mostly minutes between messages, sometimes more than a lease time
+        lwip_standin_advance(rand() % 100 ? rand() % (20 * 60 * 1000) : 25 * 60 * 60 * 1000);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("storm: %lu messages, %lu ACKs, %lu NAKs, %lu DISCOVERs unanswered with the pool full"
+           " (%.0f messages/s with the checks)\n", (unsigned long)messages, (unsigned long)acks,
+           (unsigned long)naks, (unsigned long)unanswered, messages / seconds);
+    CHECK(acks > STORM_ROUNDS / 4 && unanswered > 0);
+    dhcp_server_deinit(&server);
+    section_end("storm");
+}
+
+static void test_pools(void) {
+    // Too small for anything past DHCPS_BASE_IP
+    start_server(server_ip, (const uint8_t[]){255, 255, 255, 248});
+    CHECK(server.num_leases == 0 && server.free_head == NO_LEASE);
+    CHECK(send_msg(DHCPDISCOVER, 1, NULL, NULL, NULL) == 0);
+    dhcp_server_deinit(&server);
+
+    // The server's own address is in the pool, and is never offered
+    static const uint8_t inside[4] = {192, 168, 4, DHCPS_BASE_IP + 4};
+    start_server(inside, (const uint8_t[]){255, 255, 255, 224});
+    CHECK(server.num_leases == 31 - DHCPS_BASE_IP && server.lease[4].state == LEASE_RESERVED);
+    check_tables();
+    dhcp_server_deinit(&server);
+
+    // Bigger than a /24, so the pool starts in the first /24 of it
+    start_server((const uint8_t[]){10, 0, 3, 250}, (const uint8_t[]){255, 255, 252, 0});
+    CHECK(server.num_leases == DHCPS_MAX_IP && server.first_ip == (10u << 24 | DHCPS_BASE_IP));
+    dhcp_server_deinit(&server);
+    section_end("pools");
+}
+
+int main() {
+    section_ok = true;
+    test_exchanges();
+    test_storm();
+    test_pools();
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
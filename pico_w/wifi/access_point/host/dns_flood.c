@@ -0,0 +1,221 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// A flood of DNS queries at the server, as a room of phones joining the
+// access point sends: A and AAAA queries for the names in the table and for
+// everything else, some with more than one question, mixed with junk. For
+// each kind, and for the mix, it reports how many queries a second get
+// through on the build machine and what each reply costs in pbufs.
+//
+// Exits with 0 if every query that should be answered is, correctly, and
+// single answers need nothing from the heap.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dnsserver.h"
+#include "lwip_standin.h"
+
+#define QUERIES 1000000
+#define CLIENTS 64
+#define NUM_NAMES DNS_SERVER_MAX_NAMES
+
+#define TYPE_A 1
+#define TYPE_AAAA 28
+
+typedef enum {
+    KIND_NAME_A,
+    KIND_NAME_AAAA,
+    KIND_PORTAL_A,
+    KIND_PORTAL_AAAA,
+    KIND_TWO_QUESTIONS,
+    KIND_JUNK,
+    NUM_KINDS
+} kind_t;
+
+static const char *kind_names[NUM_KINDS] = {
+        "A, name in the table",
+        "AAAA, name in the table",
+        "A, any other name",
+        "AAAA, any other name",
+        "A and AAAA together",
+        "junk",
+};
+
+// Replies expected, and their answer counts
+static const int kind_answers[NUM_KINDS] = {1, 1, 1, 0, 2, -1};
+
+// Some of what phones ask on joining a network
+static const char *portal_names[] = {
+        "connectivitycheck.gstatic.com",
+        "captive.apple.com",
+        "www.msftconnecttest.com",
+        "detectportal.firefox.com",
+        "clients3.google.com",
+        "time.android.com",
+        "mtalk.google.com",
+        "www.google.com",
+};
+
+typedef struct {
+    uint8_t data[128];
+    uint8_t len;
+    kind_t kind;
+} query_t;
+
+static dns_server_t server;
+static char names_buf[NUM_NAMES][32];
+static dns_server_name_t names[NUM_NAMES];
+static const uint8_t ip6[16] = {0xfd, 0x00, [15] = 0x01};
+static query_t queries[4096];
+static bool ok = true;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static size_t add_question(uint8_t *msg, size_t len, const char *name, uint16_t type) {
+    for (const char *label = name; *label;) {
+        size_t label_len = strcspn(label, ".");
+        msg[len++] = label_len;
+        memcpy(&msg[len], label, label_len);
+        len += label_len;
+        label += label_len + (label[label_len] == '.');
+    }
+    msg[len++] = 0;
+    msg[len++] = type >> 8;
+    msg[len++] = type;
+    msg[len++] = 0;
+    msg[len++] = 1;
+    return len;
+}
+
+static void make_query(query_t *q, kind_t kind, uint16_t id) {
+    static const uint8_t header[12] = {0, 0, 0x01, 0x00, 0, 1};
+    const char *name = names[rand() % NUM_NAMES].name;
+    const char *other = portal_names[rand() % (sizeof(portal_names) / sizeof(portal_names[0]))];
+    size_t len = sizeof(header);
+    memcpy(q->data, header, sizeof(header));
+    q->data[0] = id >> 8;
+    q->data[1] = id;
+    switch (kind) {
+        case KIND_NAME_A:
+            len = add_question(q->data, len, name, TYPE_A);
+            break;
+        case KIND_NAME_AAAA:
+            // Every name has an IPv6 address
+            len = add_question(q->data, len, name, TYPE_AAAA);
+            break;
+        case KIND_PORTAL_A:
+            len = add_question(q->data, len, other, TYPE_A);
+            break;
+        case KIND_PORTAL_AAAA:
+            len = add_question(q->data, len, other, TYPE_AAAA);
+            break;
+        case KIND_TWO_QUESTIONS:
+            q->data[5] = 2;
+            len = add_question(q->data, len, name, TYPE_A);
+            len = add_question(q->data, len, name, TYPE_AAAA);
+            break;
+        default:
+            len = 12 + rand() % 100;
+            for (size_t i = 2; i < len; i++) {
+                q->data[i] = rand();
+            }
+            // A header that gets as far as the questions
+            q->data[2] = 0x01;
+            q->data[4] = 0;
+            q->data[5] = 1;
+            q->data[12] = 64 + rand() % 192;
+            break;
+    }
+    q->len = len;
+    q->kind = kind;
+}
+
+// Send count queries of the kinds in mask, from CLIENTS ports, and check
+// every reply
+static void flood(const char *name, unsigned int mask, uint32_t count, double max_heap_allocs) {
+    int n = 0;
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        kind_t kind;
+        do {
+            kind = rand() % NUM_KINDS;
+        } while (!(mask & 1u << kind));
+        make_query(&queries[i], kind, i);
+        n++;
+    }
+
+    lwip_standin_stats_t before = lwip_standin_stats;
+    uint32_t expected = 0, wrong = 0;
+    double start = now();
+    for (uint32_t i = 0; i < count; i++) {
+        const query_t *q = &queries[i % n];
+        uint32_t sent = lwip_standin_stats.datagrams_sent;
+        lwip_standin_udp_deliver(server.udp, q->data, q->len, IP_ADDR_ANY, 1024 + i % CLIENTS);
+        int answers = kind_answers[q->kind];
+        if (answers < 0) {
+            continue;
+        }
+        expected++;
+        const uint8_t *reply = lwip_standin_sent.data;
+        if (lwip_standin_stats.datagrams_sent != sent + 1 || reply[0] != q->data[0] || reply[1] != q->data[1] ||
+            reply[7] != answers || (reply[3] & 0xf) != 0 ||
+            lwip_standin_sent.port != 1024 + i % CLIENTS) {
+            wrong++;
+        }
+    }
+    double seconds = now() - start;
+
+    const lwip_standin_stats_t *after = &lwip_standin_stats;
+    uint32_t replies = after->datagrams_sent - before.datagrams_sent;
+    double heap = replies ? (double)(after->heap_allocs - before.heap_allocs) / replies : 0;
+    double memp = replies ? (double)(after->memp_allocs - before.memp_allocs) / replies : 0;
+    printf("%-24s %9.0f queries/s, %7lu replies, per reply %.2f heap + %.2f memp allocations\n", name,
+           count / seconds, (unsigned long)replies, heap, memp);
+    if (wrong || replies < expected) {
+        printf("%s: %lu of %lu replies missing or wrong\n", name, (unsigned long)wrong, (unsigned long)expected);
+        ok = false;
+    }
+    if (heap > max_heap_allocs) {
+        printf("%s: more allocations than expected\n", name);
+        ok = false;
+    }
+}
+
+int main() {
+    ip_addr_t ip;
+    IP4_ADDR(&ip, 192, 168, 4, 1);
+    dns_server_init(&server, &ip);
+    for (int i = 0; i < NUM_NAMES; i++) {
+        snprintf(names_buf[i], sizeof(names_buf[i]), "sensor%d.picow.lan", i);
+        names[i].name = names_buf[i];
+        IP4_ADDR(&names[i].ip4, 192, 168, 4, 100 + i);
+        names[i].ip6 = ip6;
+    }
+    if (!dns_server_set_names(&server, names, NUM_NAMES, true)) {
+        printf("no hash seed for the names\n");
+        return 1;
+    }
+
+    srand(1);
+    for (kind_t kind = 0; kind < NUM_KINDS; kind++) {
+        flood(kind_names[kind], 1u << kind, QUERIES, kind == KIND_TWO_QUESTIONS ? 1 : 0);
+    }
+    flood("all together", (1u << NUM_KINDS) - 1, QUERIES, 1);
+
+    dns_server_deinit(&server);
+    if (lwip_standin_stats.live_pbufs) {
+        printf("%d pbufs leaked\n", lwip_standin_stats.live_pbufs);
+        ok = false;
+    }
+    printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
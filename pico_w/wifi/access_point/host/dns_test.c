@@ -0,0 +1,375 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the DNS server against the lwIP stand-in, built with
+// AddressSanitizer so a read past the end of a query shows up:
+//
+// - the seed search for the perfect hash of the name table, and lookups of
+//   every name in it, in any case
+// - A and AAAA answers, with and without an IPv6 address
+// - NXDOMAIN for names not in the table, unless answering as a captive
+//   portal, and no error for a known name with no address of that type
+// - queries with several questions, each answer pointing at its own
+//   question's name
+// - malformed queries, and random ones, which must get no reply or a
+//   well-formed one, and leak nothing
+//
+// Exits with 0 if every check passes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dnsserver.h"
+#include "lwip_standin.h"
+
+#define TYPE_A 1
+#define TYPE_MX 15
+#define TYPE_AAAA 28
+#define RCODE_NXDOMAIN 3
+
+#define RANDOM_QUERIES 200000
+
+static dns_server_t server;
+static int failures;
+static bool section_ok;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        section_ok = false; \
+    } \
+} while (0)
+
+static void section_end(const char *name) {
+    printf("%-32s %s\n", name, section_ok ? "ok" : "FAILED");
+    if (!section_ok) {
+        failures++;
+    }
+    section_ok = true;
+}
+
+typedef struct {
+    const char *name;
+    uint16_t type;
+} question_t;
+
+// Write a query for the questions into msg, noting where each name starts,
+// and return its length
+static size_t make_query(uint8_t *msg, const question_t *questions, int count, uint16_t *name_offsets) {
+    static const uint8_t header[12] = {0xab, 0xcd, 0x01, 0x00};
+    memcpy(msg, header, sizeof(header));
+    msg[5] = count;
+    size_t len = sizeof(header);
+    for (int i = 0; i < count; i++) {
+        if (name_offsets) {
+            name_offsets[i] = len;
+        }
+        for (const char *label = questions[i].name; *label;) {
+            size_t label_len = strcspn(label, ".");
+            msg[len++] = label_len;
+            memcpy(&msg[len], label, label_len);
+            len += label_len;
+            label += label_len;
+            if (*label) {
+                label++;
+            }
+        }
+        msg[len++] = 0;
+        msg[len++] = questions[i].type >> 8;
+        msg[len++] = questions[i].type;
+        msg[len++] = 0;
+        msg[len++] = 1;
+    }
+    return len;
+}
+
+// Deliver a query, and return the reply's rcode, or -1 if there was no reply
+static int deliver(const uint8_t *msg, size_t len) {
+    uint32_t sent = lwip_standin_stats.datagrams_sent;
+    lwip_standin_udp_deliver(server.udp, msg, len, IP_ADDR_ANY, 5353);
+    if (lwip_standin_stats.datagrams_sent == sent) {
+        return -1;
+    }
+    const uint8_t *reply = lwip_standin_sent.data;
+    // A response from an authority, with the id and recursion desired flag
+    // kept, and no recursion available
+    CHECK(lwip_standin_sent.len >= 12 && reply[0] == msg[0] && reply[1] == msg[1]);
+    CHECK((reply[2] & 0xfe) == 0x84 && (reply[2] & 1) == (msg[2] & 1) && (reply[3] & 0xf0) == 0);
+    return reply[3] & 0xf;
+}
+
+static int query(const question_t *questions, int count) {
+    uint8_t msg[512];
+    return deliver(msg, make_query(msg, questions, count, NULL));
+}
+
+static int answer_count(void) {
+    return lwip_standin_sent.data[6] << 8 | lwip_standin_sent.data[7];
+}
+
+// The answers start straight after the questions, which are sent back as
+// they came
+static const uint8_t *answers(const question_t *questions, int count) {
+    uint8_t msg[512];
+    return lwip_standin_sent.data + make_query(msg, questions, count, NULL);
+}
+
+// Check an answer record, and return a pointer past it
+static const uint8_t *check_answer(const uint8_t *answer, uint16_t name_offset, uint16_t type,
+                                   const void *addr, size_t addr_len) {
+    CHECK(answer[0] == (0xc0 | name_offset >> 8) && answer[1] == (name_offset & 0xff));
+    CHECK(answer[2] == type >> 8 && answer[3] == (type & 0xff) && answer[4] == 0 && answer[5] == 1);
+    CHECK(answer[10] == 0 && answer[11] == addr_len && !memcmp(&answer[12], addr, addr_len));
+    return answer + 12 + addr_len;
+}
+
+#define NUM_NAMES DNS_SERVER_MAX_NAMES
+
+static char names_buf[NUM_NAMES][32];
+static dns_server_name_t names[NUM_NAMES];
+static const uint8_t ip6[16] = {0xfd, 0x00, [15] = 0x01};
+
+static void make_names(void) {
+    for (int i = 0; i < NUM_NAMES; i++) {
+        snprintf(names_buf[i], sizeof(names_buf[i]), "host%d.picow.lan", i);
+        names[i].name = names_buf[i];
+        IP4_ADDR(&names[i].ip4, 192, 168, 4, 100 + i);
+        names[i].ip6 = i % 4 == 0 ? ip6 : NULL;
+    }
+}
+
+static void test_names(void) {
+    // Every name gets a hash slot of its own
+    CHECK(dns_server_set_names(&server, names, NUM_NAMES, false));
+    CHECK(server.num_names == NUM_NAMES);
+    int used = 0;
+    bool seen[NUM_NAMES] = {false};
+    for (int slot = 0; slot < DNS_SERVER_HASH_SIZE; slot++) {
+        if (server.hash[slot]) {
+            used++;
+            CHECK(server.hash[slot] <= NUM_NAMES && !seen[server.hash[slot] - 1]);
+            seen[server.hash[slot] - 1] = true;
+        }
+    }
+    CHECK(used == NUM_NAMES);
+    printf("hash seed for %d names: %u\n", NUM_NAMES, server.hash_seed);
+
+    for (int i = 0; i < NUM_NAMES; i++) {
+        question_t q = {names[i].name, TYPE_A};
+        CHECK(query(&q, 1) == 0 && answer_count() == 1);
+        check_answer(answers(&q, 1), 12, TYPE_A, &names[i].ip4.addr, 4);
+    }
+    // In any case
+    question_t upper = {"HOST5.Picow.LAN", TYPE_A};
+    CHECK(query(&upper, 1) == 0 && answer_count() == 1);
+    CHECK(lwip_standin_sent.data[lwip_standin_sent.len - 1] == 105);
+
+    // Fewer names, which may need another seed, and a table that empties
+    for (int count = 1; count < NUM_NAMES; count += 5) {
+        CHECK(dns_server_set_names(&server, names + NUM_NAMES - count, count, false));
+        question_t first = {names[NUM_NAMES - count].name, TYPE_A};
+        question_t dropped = {names[0].name, TYPE_A};
+        CHECK(query(&first, 1) == 0 && answer_count() == 1);
+        CHECK(query(&dropped, 1) == RCODE_NXDOMAIN);
+    }
+    CHECK(dns_server_set_names(&server, NULL, 0, false));
+    question_t any = {names[0].name, TYPE_A};
+    CHECK(query(&any, 1) == RCODE_NXDOMAIN);
+
+    // Too many, or the same name twice, leave the names as they were
+    CHECK(dns_server_set_names(&server, names, 2, false));
+    static dns_server_name_t too_many[NUM_NAMES + 1];
+    memcpy(too_many, names, sizeof(names));
+    too_many[NUM_NAMES] = (dns_server_name_t){.name = "extra.lan"};
+    CHECK(!dns_server_set_names(&server, too_many, NUM_NAMES + 1, true));
+    dns_server_name_t twice[2] = {{.name = "a.lan"}, {.name = "A.LAN"}};
+    CHECK(!dns_server_set_names(&server, twice, 2, true));
+    CHECK(server.num_names == 2 && !server.answer_others);
+    question_t kept = {names[1].name, TYPE_A};
+    CHECK(query(&kept, 1) == 0 && answer_count() == 1);
+    check_answer(answers(&kept, 1), 12, TYPE_A, &names[1].ip4, 4);
+    question_t unknown = {"nothere.example.com", TYPE_A};
+    CHECK(query(&unknown, 1) == RCODE_NXDOMAIN);
+    section_end("name table and hash seed");
+}
+
+static void test_types(void) {
+    CHECK(dns_server_set_names(&server, names, NUM_NAMES, false));
+    question_t with_ip6 = {names[4].name, TYPE_AAAA};
+    CHECK(query(&with_ip6, 1) == 0 && answer_count() == 1);
+    check_answer(answers(&with_ip6, 1), 12, TYPE_AAAA, ip6, 16);
+
+    // Known names without that type of address get an empty answer, which
+    // isn't an error
+    question_t without_ip6 = {names[5].name, TYPE_AAAA};
+    CHECK(query(&without_ip6, 1) == 0 && answer_count() == 0);
+    question_t mx = {names[5].name, TYPE_MX};
+    CHECK(query(&mx, 1) == 0 && answer_count() == 0);
+
+    // Unknown names don't exist...
+    question_t unknown = {"connectivitycheck.gstatic.com", TYPE_A};
+    CHECK(query(&unknown, 1) == RCODE_NXDOMAIN && answer_count() == 0);
+    question_t unknown6 = {"connectivitycheck.gstatic.com", TYPE_AAAA};
+    CHECK(query(&unknown6, 1) == RCODE_NXDOMAIN);
+
+    // ...unless answering as a captive portal, which gives our own address
+    // for A queries, and nothing for AAAA
+    CHECK(dns_server_set_names(&server, names, NUM_NAMES, true));
+    static const uint8_t own[4] = {192, 168, 4, 1};
+    CHECK(query(&unknown, 1) == 0 && answer_count() == 1);
+    check_answer(answers(&unknown, 1), 12, TYPE_A, own, 4);
+    CHECK(query(&unknown6, 1) == 0 && answer_count() == 0);
+    question_t known = {names[3].name, TYPE_A};
+    CHECK(query(&known, 1) == 0 && answer_count() == 1);
+    check_answer(answers(&known, 1), 12, TYPE_A, &names[3].ip4.addr, 4);
+
+    // The shared answer pbuf is still held by a reply that hasn't gone, so
+    // the next reply needs one of its own
+    uint32_t memp = lwip_standin_stats.memp_allocs;
+    pbuf_ref(server.answer_pbuf);
+    CHECK(query(&known, 1) == 0 && answer_count() == 1);
+    check_answer(answers(&known, 1), 12, TYPE_A, &names[3].ip4.addr, 4);
+    CHECK(lwip_standin_stats.memp_allocs == memp + 1);
+    pbuf_free(server.answer_pbuf);
+    CHECK(query(&known, 1) == 0 && lwip_standin_stats.memp_allocs == memp + 1);
+    section_end("A, AAAA and NXDOMAIN");
+}
+
+static void test_questions(void) {
+    CHECK(dns_server_set_names(&server, names, NUM_NAMES, false));
+    question_t questions[4] = {
+            {names[1].name, TYPE_A},
+            {"nothere.example.com", TYPE_A},
+            {names[8].name, TYPE_AAAA},
+            {names[8].name, TYPE_A},
+    };
+    uint8_t msg[512];
+    uint16_t offsets[4];
+    size_t len = make_query(msg, questions, 4, offsets);
+    // Only one name not found, so not NXDOMAIN
+    CHECK(deliver(msg, len) == 0 && answer_count() == 3);
+    CHECK(lwip_standin_sent.data[5] == 4 && !memcmp(lwip_standin_sent.data + 12, msg + 12, len - 12));
+    const uint8_t *answer = lwip_standin_sent.data + len;
+    answer = check_answer(answer, offsets[0], TYPE_A, &names[1].ip4.addr, 4);
+    answer = check_answer(answer, offsets[2], TYPE_AAAA, ip6, 16);
+    answer = check_answer(answer, offsets[3], TYPE_A, &names[8].ip4.addr, 4);
+    CHECK(answer == lwip_standin_sent.data + lwip_standin_sent.len);
+
+    // All unknown
+    question_t unknown[2] = {{"a.example.com", TYPE_A}, {"b.example.com", TYPE_AAAA}};
+    CHECK(query(unknown, 2) == RCODE_NXDOMAIN && answer_count() == 0);
+    // More than the server answers
+    question_t many[5] = {questions[0], questions[0], questions[0], questions[0], questions[0]};
+    CHECK(query(many, 5) == -1);
+    CHECK(lwip_standin_stats.live_pbufs == 1);
+    section_end("several questions");
+}
+
+static void test_malformed(void) {
+    CHECK(dns_server_set_names(&server, names, NUM_NAMES, true));
+    question_t q = {names[2].name, TYPE_A};
+    uint8_t msg[600];
+    size_t len = make_query(msg, &q, 1, NULL);
+
+    // Cut short anywhere
+    for (size_t cut = 0; cut < len; cut++) {
+        CHECK(deliver(msg, cut) == -1);
+    }
+    // Anything after the question is dropped from the reply
+    memset(msg + len, 0x55, 20);
+    CHECK(deliver(msg, len + 20) == 0 && lwip_standin_sent.len == len + DNS_ANSWER_SIZE);
+
+    // Responses, other opcodes, and no questions
+    uint8_t bad[sizeof(msg)];
+    memcpy(bad, msg, len);
+    bad[2] |= 0x80;
+    CHECK(deliver(bad, len) == -1);
+    memcpy(bad, msg, len);
+    bad[2] |= 0x10;
+    CHECK(deliver(bad, len) == -1);
+    memcpy(bad, msg, len);
+    bad[5] = 0;
+    CHECK(deliver(bad, len) == -1);
+    // More questions than there are
+    memcpy(bad, msg, len);
+    bad[5] = 2;
+    CHECK(deliver(bad, len) == -1);
+    // A compression pointer, which queries don't use
+    memcpy(bad, msg, len);
+    bad[12] = 0xc0;
+    CHECK(deliver(bad, len) == -1);
+    // A name longer than 255 bytes
+    size_t long_len = 12;
+    memcpy(bad, msg, 12);
+    for (int label = 0; label < 4; label++) {
+        bad[long_len++] = 63;
+        memset(&bad[long_len], 'a', 63);
+        long_len += 63;
+    }
+    bad[long_len++] = 0;
+    memcpy(&bad[long_len], "\0\1\0\1", 4);
+    CHECK(deliver(bad, long_len + 4) == -1);
+    CHECK(lwip_standin_stats.live_pbufs == 1);
+    section_end("malformed queries");
+}
+
+static void test_random(void) {
+    CHECK(dns_server_set_names(&server, names, NUM_NAMES, true));
+    srand(1);
+    uint32_t replies = 0;
+    for (int i = 0; i < RANDOM_QUERIES; i++) {
+        uint8_t msg[400];
+        size_t len;
+        if (i & 1) {
+            // Random bytes after a plausible header
+            len = 12 + rand() % (sizeof(msg) - 12);
+            for (size_t j = 0; j < len; j++) {
+                msg[j] = rand();
+            }
+            msg[2] = 0x01;
+            msg[4] = 0;
+            msg[5] = 1 + rand() % 4;
+        } else {
+            // A real query with a few bytes changed
+            question_t q[2] = {{names[rand() % NUM_NAMES].name, TYPE_A}, {"x.example.com", TYPE_AAAA}};
+            len = make_query(msg, q, 1 + rand() % 2, NULL);
+            for (int j = rand() % 4; j > 0; j--) {
+                msg[12 + rand() % (len - 12)] = rand();
+            }
+            len -= rand() % 3;
+        }
+        replies += deliver(msg, len) >= 0;
+    }
+    printf("random queries: %lu of %d answered\n", (unsigned long)replies, RANDOM_QUERIES);
+    CHECK(replies > 0 && lwip_standin_stats.live_pbufs == 1);
+    section_end("random queries");
+}
+
+int main() {
+    section_ok = true;
+    ip_addr_t ip;
+    IP4_ADDR(&ip, 192, 168, 4, 1);
+    dns_server_init(&server, &ip);
+    make_names();
+
+    // To start with, every A query gets our address
+    question_t portal = {"connectivitycheck.gstatic.com", TYPE_A};
+    CHECK(query(&portal, 1) == 0 && answer_count() == 1);
+    section_end("captive portal by default");
+
+    test_names();
+    test_types();
+    test_questions();
+    test_malformed();
+    test_random();
+
+    dns_server_deinit(&server);
+    CHECK(lwip_standin_stats.live_pbufs == 0);
+    section_end("no pbufs leaked");
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Microbenchmark of the HTTP server against the lwIP stand-in: how many
+// requests a second it answers on the build machine, opening a connection
+// for each request, keeping one open, and pipelining eight at a time, for a
+// page built by a handler and for static content. http_bench.py measures
+// the same over Wi-Fi.
+//
+// For each it reports the tcp_write calls per request that lwIP copies the
+// data for, and those that only reference it. The rate is only a guide to
+// the device, but the writes are the same as with lwIP.
+//
+// Exits with 0 if every request is answered, and static content is never
+// copied.
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "httpserver.h"
+#include "lwip_standin.h"
+
+#define PORT 80
+#define REQUESTS 400000
+#define PIPELINE 8
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+static char css[1200];
+static http_server_t server;
+static bool ok = true;
+
+static void led_test(void *arg, const http_request_t *request, http_response_t *response) {
+    response->body_len = snprintf(response->body, HTTP_MAX_BODY_LEN,
+                                  "<html><body><h1>Hello from Pico W.</h1><p>Led is %s</p>"
+                                  "<p><a href=\"?led=%d\">Turn led %s</a></body></html>", "ON", 0, "OFF");
+}
+
+static const http_route_t routes[] = {
+    { .path = "/ledtest", .prefix = true, .handler = led_test },
+    { .path = "/style.css", .content_type = "text/css", .content = css, .content_len = sizeof(css) },
+};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Send requests, pipeline at a time, on as many connections as it takes
+static void bench(const char *name, const char *path, bool keep_alive, int pipeline, bool static_content) {
+    char request[128];
+    snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: 192.168.4.1\r\n%s\r\n", path,
+             keep_alive ? "" : "Connection: close\r\n");
+    char requests[PIPELINE * sizeof(request)];
+    size_t len = 0;
+    for (int i = 0; i < pipeline; ++i) {
+        len += snprintf(requests + len, sizeof(requests) - len, "%s", request);
+    }
+
+    lwip_standin_stats_t before = lwip_standin_stats;
+    uint32_t responses = 0;
+    struct tcp_pcb *pcb = NULL;
+    err_t err;
+    double start = now();
+    for (int i = 0; i < REQUESTS / pipeline; ++i) {
+        if (!pcb) {
+            pcb = lwip_standin_tcp_connect(PORT, &err);
+        }
+        lwip_standin_tcp_deliver(pcb, requests, len, TCP_MSS);
+        lwip_standin_tcp_ack_all(pcb);
+        // Every response starts with the status line
+        if (pcb->out_len >= 15 && !memcmp(pcb->out, "HTTP/1.1 200 OK", 15)) {
+            responses += keep_alive ? pipeline : 1;
+        }
+        pcb->out_len = 0;
+        if (pcb->closed) {
+            lwip_standin_tcp_free(pcb);
+            pcb = NULL;
+        }
+    }
+    double seconds = now() - start;
+    if (pcb) {
+        lwip_standin_tcp_error(pcb, ERR_RST);
+    }
+
+    uint32_t requests_sent = REQUESTS / pipeline * pipeline;
+    double copied = (double)(lwip_standin_stats.tcp_copied_writes - before.tcp_copied_writes) / responses;
+    double refs = (double)(lwip_standin_stats.tcp_ref_writes - before.tcp_ref_writes) / responses;
+    printf("%-28s %9.0f requests/s, per response %.2f copied + %.2f referenced writes\n", name,
+           (keep_alive ? requests_sent : responses) / seconds, copied, refs);
+    if (responses != (keep_alive ? requests_sent : REQUESTS / pipeline)) {
+        printf("%s: not every request was answered\n", name);
+        ok = false;
+    }
+    if (static_content && copied > 0) {
+        printf("%s: static content was copied\n", name);
+        ok = false;
+    }
+}
+
+int main() {
+    memset(css, 'x', sizeof(css));
+    if (!http_server_init(&server, PORT, routes, count_of(routes), NULL, NULL)) {
+        printf("failed to start the server\n");
+        return 1;
+    }
+    bench("dynamic, close", "/ledtest", false, 1, false);
+    bench("dynamic, keep-alive", "/ledtest", true, 1, false);
+    bench("dynamic, pipelined x8", "/ledtest?led=1", true, PIPELINE, false);
+    bench("static, close", "/style.css", false, 1, true);
+    bench("static, keep-alive", "/style.css", true, 1, true);
+    bench("static, pipelined x8", "/style.css", true, PIPELINE, true);
+    http_server_deinit(&server);
+
+    if (lwip_standin_stats.live_pbufs || lwip_standin_stats.tcp_live_pcbs) {
+        printf("%d pbufs and %d pcbs leaked\n", lwip_standin_stats.live_pbufs, lwip_standin_stats.tcp_live_pcbs);
+        ok = false;
+    }
+    printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
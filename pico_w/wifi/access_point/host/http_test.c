@@ -0,0 +1,339 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the HTTP server against the lwIP stand-in:
+//
+// - keep-alive, Connection: close, and HTTP/1.0 with and without keep-alive,
+//   which must be answered with Connection: keep-alive to stay open
+// - pipelined requests, split across pbufs at every size, answered in order
+// - routes matched exactly or by prefix, with the query split off
+// - static content sent without copying, through a small send buffer, and
+//   If-None-Match answered with 304
+// - 400, 431 and 501 for requests the server can't handle
+// - back pressure: what isn't yet read isn't passed to tcp_recved
+// - the connection pool: a full pool refuses connections, and idle
+//   connections time out and free their slot
+//
+// Exits with 0 if every check passes.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "httpserver.h"
+#include "lwip_standin.h"
+
+#define PORT 80
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+static char big[6000];
+static http_server_t server;
+static int failures;
+static bool section_ok;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        section_ok = false; \
+    } \
+} while (0)
+
+static void section_end(const char *name) {
+    printf("%-32s %s\n", name, section_ok ? "ok" : "FAILED");
+    if (!section_ok) {
+        failures++;
+    }
+    section_ok = true;
+}
+
+static void hello(void *arg, const http_request_t *request, http_response_t *response) {
+    response->body_len = snprintf(response->body, HTTP_MAX_BODY_LEN, "hello %s %s", request->path,
+                                  request->query ? request->query : "-");
+}
+
+static void redirect(void *arg, const http_request_t *request, http_response_t *response) {
+    response->status = 302;
+    response->location = "http://192.168.4.1/";
+}
+
+static const http_route_t routes[] = {
+    { .path = "/hello", .handler = hello },
+    { .path = "/ledtest", .prefix = true, .handler = hello },
+    { .path = "/style.css", .content_type = "text/css", .content = "body{}", .content_len = 6 },
+    { .path = "/big", .content_type = "application/octet-stream", .content = big, .content_len = sizeof(big) },
+};
+
+// The output so far, as a string
+static const char *out(struct tcp_pcb *pcb) {
+    pcb->out[LWIP_MIN(pcb->out_len, sizeof(pcb->out) - 1)] = 0;
+    return pcb->out;
+}
+
+static int count(const struct tcp_pcb *pcb, const char *needle) {
+    int n = 0;
+    size_t len = strlen(needle);
+    for (size_t i = 0; i + len <= pcb->out_len; ++i) {
+        n += !memcmp(pcb->out + i, needle, len);
+    }
+    return n;
+}
+
+static err_t send_str(struct tcp_pcb *pcb, const char *request, size_t segment_len) {
+    return lwip_standin_tcp_deliver(pcb, request, strlen(request), segment_len);
+}
+
+// Send a request and take the whole response
+static const char *get(struct tcp_pcb *pcb, const char *request) {
+    pcb->out_len = 0;
+    send_str(pcb, request, TCP_MSS);
+    lwip_standin_tcp_ack_all(pcb);
+    return out(pcb);
+}
+
+static struct tcp_pcb *open_connection(void) {
+    err_t err;
+    struct tcp_pcb *pcb = lwip_standin_tcp_connect(PORT, &err);
+    CHECK(pcb && err == ERR_OK);
+    return pcb;
+}
+
+static int open_connections(void) {
+    int n = 0;
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; ++i) {
+        n += server.connections[i].pcb != NULL;
+    }
+    return n;
+}
+
+static void test_keep_alive(void) {
+    struct tcp_pcb *c = open_connection();
+    CHECK(c->nagle_disabled);
+    get(c, "GET /hello?x=1 HTTP/1.1\r\nHost: a\r\n\r\n");
+    CHECK(strstr(out(c), "HTTP/1.1 200 OK\r\n") && strstr(out(c), "Content-Length: 16\r\n\r\nhello /hello x=1"));
+    CHECK(!strstr(out(c), "Connection:") && !c->closed);
+
+    // Closes once the response is acknowledged, ignoring what follows
+    c->out_len = 0;
+    send_str(c, "GET /hello HTTP/1.1\r\nConnection: close\r\n\r\nGET /hello HTTP/1.1\r\n\r\n", TCP_MSS);
+    CHECK(!c->closed);
+    lwip_standin_tcp_ack_all(c);
+    CHECK(c->closed && count(c, "HTTP/1.1 ") == 1 && strstr(out(c), "Connection: close\r\n\r\n"));
+    CHECK(open_connections() == 0);
+    lwip_standin_tcp_free(c);
+
+    // HTTP/1.0 closes unless it asks for keep-alive, and then it has to be
+    // told the connection stays open
+    c = open_connection();
+    get(c, "GET /hello HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+    CHECK(strstr(out(c), "\r\nConnection: keep-alive\r\n\r\nhello") && !c->closed);
+    get(c, "GET /hello HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n");
+    CHECK(strstr(out(c), "\r\nConnection: keep-alive\r\n\r\n") && !c->closed);
+    get(c, "GET /style.css HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+    CHECK(strstr(out(c), "\r\nConnection: keep-alive\r\n\r\nbody{}") && !c->closed);
+    get(c, "GET /hello HTTP/1.0\r\n\r\n");
+    CHECK(strstr(out(c), "\r\nConnection: close\r\n\r\n") && c->closed);
+    lwip_standin_tcp_free(c);
+    CHECK(lwip_standin_stats.tcp_resets == 0);
+    section_end("keep-alive and close");
+}
+
+static void test_pipelining(void) {
+    struct tcp_pcb *c = open_connection();
+    const char *requests = "GET /hello HTTP/1.1\r\n\r\n"
+                           "GET /style.css HTTP/1.1\nHost: a\n\n"
+                           "HEAD /style.css HTTP/1.1\r\n\r\n\r\n"
+                           "GET /nowhere HTTP/1.1\r\n\r\n";
+    for (size_t segment_len = 1; segment_len < 40; ++segment_len) {
+        c->out_len = 0;
+        CHECK(send_str(c, requests, segment_len) == ERR_OK);
+        lwip_standin_tcp_ack_all(c);
+        CHECK(count(c, "HTTP/1.1 ") == 4);
+        const char *hello = strstr(out(c), "hello /hello -");
+        const char *css = strstr(out(c), "body{}");
+        const char *found = strstr(out(c), "302 Found");
+        CHECK(hello && css && found && hello < css && css < found);
+        // No body for HEAD
+        CHECK(count(c, "body{}") == 1);
+        CHECK(strstr(out(c), "Location: http://192.168.4.1/\r\n"));
+        CHECK(c->rcv_unrecved == 0 && !c->closed);
+    }
+    http_server_deinit(&server);
+    CHECK(c->closed && open_connections() == 0);
+    lwip_standin_tcp_free(c);
+    CHECK(http_server_init(&server, PORT, routes, count_of(routes), redirect, NULL));
+    section_end("pipelining");
+}
+
+static void test_routes(void) {
+    struct tcp_pcb *c = open_connection();
+    CHECK(strstr(get(c, "GET /ledtest?led=1 HTTP/1.1\r\n\r\n"), "hello /ledtest led=1"));
+    CHECK(strstr(get(c, "GET /ledtest HTTP/1.1\r\n\r\n"), "hello /ledtest -"));
+    CHECK(strstr(get(c, "GET /ledtest/more?led=0 HTTP/1.1\r\n\r\n"), "hello /ledtest/more led=0"));
+    CHECK(strstr(get(c, "GET http://192.168.4.1/ledtest?led=0 HTTP/1.1\r\n\r\n"), "hello /ledtest led=0"));
+    // Exact routes don't match longer paths, or shorter ones
+    CHECK(strstr(get(c, "GET /hello/ HTTP/1.1\r\n\r\n"), "302 Found"));
+    CHECK(strstr(get(c, "GET /led HTTP/1.1\r\n\r\n"), "302 Found"));
+    CHECK(strstr(get(c, "GET /style.css?v=2 HTTP/1.1\r\n\r\n"), "body{}"));
+    http_server_deinit(&server);
+    lwip_standin_tcp_free(c);
+
+    // With no fallback, everything else is 404
+    CHECK(http_server_init(&server, PORT, routes, count_of(routes), NULL, NULL));
+    c = open_connection();
+    CHECK(strstr(get(c, "GET /nowhere HTTP/1.1\r\n\r\n"), "HTTP/1.1 404 Not Found\r\n") && !c->closed);
+    http_server_deinit(&server);
+    lwip_standin_tcp_free(c);
+    CHECK(http_server_init(&server, PORT, routes, count_of(routes), redirect, NULL));
+    section_end("routes");
+}
+
+static void test_static(void) {
+    struct tcp_pcb *c = open_connection();
+    char etag[16] = "";
+    const char *e = strstr(get(c, "GET /style.css HTTP/1.1\r\n\r\n"), "ETag: ");
+    CHECK(e && sscanf(e + 6, "%15s", etag) == 1);
+    char request[128];
+    snprintf(request, sizeof(request), "GET /style.css HTTP/1.1\r\nIf-None-Match: %s\r\n\r\n", etag);
+    CHECK(strstr(get(c, request), "304 Not Modified") && !strstr(out(c), "body{}"));
+    CHECK(strstr(get(c, "GET /style.css HTTP/1.1\r\nIf-None-Match: \"0\"\r\n\r\n"), "body{}"));
+
+    // Big content through a small send buffer, referenced rather than copied
+    lwip_standin_stats_t before = lwip_standin_stats;
+    c->snd_buf_size = 1000;
+    c->out_len = 0;
+    send_str(c, "GET /big HTTP/1.1\r\n\r\n", TCP_MSS);
+    while (c->snd_queuelen) {
+        CHECK(tcp_sndbuf(c) < 1000);
+        lwip_standin_tcp_ack(c, 1000);
+    }
+    CHECK(c->out_len > sizeof(big) && !memcmp(c->out + c->out_len - sizeof(big), big, sizeof(big)));
+    CHECK(lwip_standin_stats.tcp_copied_writes == before.tcp_copied_writes);
+    CHECK(lwip_standin_stats.tcp_ref_writes > before.tcp_ref_writes + 5);
+    c->snd_buf_size = TCP_SND_BUF;
+    http_server_deinit(&server);
+    lwip_standin_tcp_free(c);
+    CHECK(http_server_init(&server, PORT, routes, count_of(routes), redirect, NULL));
+    section_end("static content");
+}
+
+static void test_errors(void) {
+    struct tcp_pcb *c = open_connection();
+    CHECK(strstr(get(c, "POST /hello HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc"), "501 Not Implemented"));
+    CHECK(c->closed);
+    lwip_standin_tcp_free(c);
+    c = open_connection();
+    CHECK(strstr(get(c, "garbage\r\n\r\n"), "400 Bad Request") && c->closed);
+    lwip_standin_tcp_free(c);
+    c = open_connection();
+    CHECK(strstr(get(c, "GET hello HTTP/1.1\r\n\r\n"), "400 Bad Request") && c->closed);
+    lwip_standin_tcp_free(c);
+
+    c = open_connection();
+    static char huge[2000];
+    memset(huge, 'x', sizeof(huge));
+    memcpy(huge, "GET /", 5);
+    c->out_len = 0;
+    lwip_standin_tcp_deliver(c, huge, sizeof(huge), 100);
+    lwip_standin_tcp_ack_all(c);
+    CHECK(strstr(out(c), "431 ") && c->closed);
+    lwip_standin_tcp_free(c);
+    CHECK(open_connections() == 0 && lwip_standin_stats.tcp_resets == 0);
+    section_end("bad requests");
+}
+
+static void test_flow(void) {
+    // Half closed after pipelining: everything is answered, then closed
+    struct tcp_pcb *c = open_connection();
+    c->out_len = 0;
+    send_str(c, "GET /hello HTTP/1.1\r\n\r\nGET /hello HTTP/1.1\r\n\r\n", TCP_MSS);
+    lwip_standin_tcp_fin(c);
+    lwip_standin_tcp_ack_all(c);
+    CHECK(count(c, "hello /hello -") == 2 && c->closed);
+    lwip_standin_tcp_free(c);
+
+    // While a response is held up, what comes after isn't read past the
+    // request buffer
+    c = open_connection();
+    c->snd_buf_size = 100;
+    static char many[4000];
+    const char *request = "GET /hello HTTP/1.1\r\n\r\n";
+    size_t len = 0;
+    while (len + strlen(request) < sizeof(many)) {
+        memcpy(many + len, request, strlen(request));
+        len += strlen(request);
+    }
+    c->out_len = 0;
+    lwip_standin_tcp_deliver(c, many, len, 500);
+    CHECK(c->rcv_unrecved >= len - HTTP_MAX_REQUEST_LEN);
+    c->snd_buf_size = TCP_SND_BUF;
+    lwip_standin_tcp_ack_all(c);
+    CHECK(c->rcv_unrecved == 0 && count(c, "hello /hello -") == (int)(len / strlen(request)));
+
+    // Closing with requests still unread mustn't reset the connection
+    lwip_standin_tcp_deliver(c, many, len, 500);
+    http_server_deinit(&server);
+    CHECK(c->closed && c->rcv_unrecved == 0 && lwip_standin_stats.tcp_resets == 0);
+    lwip_standin_tcp_free(c);
+    CHECK(http_server_init(&server, PORT, routes, count_of(routes), redirect, NULL));
+    section_end("flow control");
+}
+
+static void test_pool(void) {
+    struct tcp_pcb *pcbs[HTTP_MAX_CONNECTIONS];
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; ++i) {
+        pcbs[i] = open_connection();
+    }
+    err_t err;
+    CHECK(!lwip_standin_tcp_connect(PORT, &err) && err == ERR_MEM);
+
+    // An idle connection times out, and its slot is free again
+    struct tcp_pcb *last = pcbs[HTTP_MAX_CONNECTIONS - 1];
+    int polls = 0;
+    while (!last->closed && polls <= HTTP_IDLE_TIMEOUT_S * 2) {
+        lwip_standin_tcp_poll(last);
+        polls++;
+    }
+    CHECK(last->closed && polls > HTTP_IDLE_TIMEOUT_S / 2);
+    lwip_standin_tcp_free(last);
+    pcbs[HTTP_MAX_CONNECTIONS - 1] = open_connection();
+
+    // So does one that fails, partway through a request
+    send_str(pcbs[0], "GET /hel", TCP_MSS);
+    lwip_standin_tcp_error(pcbs[0], ERR_RST);
+    pcbs[0] = open_connection();
+    CHECK(strstr(get(pcbs[0], "GET /hello HTTP/1.1\r\n\r\n"), "hello /hello -"));
+
+    http_server_deinit(&server);
+    CHECK(open_connections() == 0);
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; ++i) {
+        CHECK(pcbs[i]->closed);
+        lwip_standin_tcp_free(pcbs[i]);
+    }
+    CHECK(lwip_standin_stats.tcp_live_pcbs == 0);
+    section_end("connection pool");
+}
+
+int main() {
+    section_ok = true;
+    for (size_t i = 0; i < sizeof(big); ++i) {
+        big[i] = 'a' + i % 26;
+    }
+    CHECK(http_server_init(&server, PORT, routes, count_of(routes), redirect, NULL));
+    section_end("init");
+
+    test_keep_alive();
+    test_pipelining();
+    test_routes();
+    test_static();
+    test_errors();
+    test_flow();
+    test_pool();
+
+    CHECK(lwip_standin_stats.live_pbufs == 0);
+    section_end("no pbufs leaked");
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
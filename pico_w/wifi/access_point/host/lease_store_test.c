@@ -0,0 +1,311 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the DHCP lease store on its simulated flash, which behaves as
+// NOR flash does: erasing sets every bit, and programming can only clear
+// them. A reboot is a fresh dhcp_lease_store_load(), as at boot.
+//
+// - snapshots rotate through every slot, erasing each sector only once per
+//   pass, and the newest always survives a power cut during an erase
+// - a write cut short, or a snapshot with a bad CRC, falls back to the one
+//   before, and the next write goes round the damage
+// - leases come back through the DHCP server after a reboot, and changes
+//   waiting to be written are written when the server stops
+//
+// Exits with 0 if every check passes.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dhcpserver.h"
+#include "dhcp_lease_store.h"
+#include "lwip_standin.h"
+
+// From dhcp_lease_store.c
+#define FLASH_PAGE_SIZE 256
+#define FLASH_SECTOR_SIZE 4096
+#define SNAPSHOT_HEADER_SIZE 20
+#define SLOT_SIZE ((SNAPSHOT_HEADER_SIZE + DHCPS_MAX_IP * 8 + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1))
+#define SLOTS_PER_SECTOR (FLASH_SECTOR_SIZE / SLOT_SIZE)
+#define NUM_SLOTS (DHCPS_STORE_SECTORS * SLOTS_PER_SECTOR)
+#define STORE_SIZE (DHCPS_STORE_SECTORS * FLASH_SECTOR_SIZE)
+
+#define FIRST_IP (192u << 24 | 168 << 16 | 4 << 8 | DHCPS_BASE_IP)
+
+static int failures;
+static bool section_ok;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        section_ok = false; \
+    } \
+} while (0)
+
+static void section_end(const char *name) {
+    printf("%-32s %s\n", name, section_ok ? "ok" : "FAILED");
+    if (!section_ok) {
+        failures++;
+    }
+    section_ok = true;
+}
+
+static void erase_all(void) {
+    memset(dhcp_lease_store_sim_flash, 0xff, STORE_SIZE);
+    dhcp_lease_store_sim_erases = 0;
+}
+
+// Snapshot n holds a different set of leases for each n
+static size_t make_snapshot(uint32_t n, dhcp_lease_record_t *records) {
+    size_t count = 1 + n % DHCPS_MAX_IP;
+    for (size_t i = 0; i < count; i++) {
+        memset(&records[i], 0, sizeof(records[i]));
+        records[i].mac[0] = 0x02;
+        records[i].mac[2] = n >> 8;
+        records[i].mac[3] = n;
+        records[i].mac[5] = i;
+        records[i].index = (n + i) % DHCPS_MAX_IP;
+    }
+    return count;
+}
+
+static void save(uint32_t n) {
+    dhcp_lease_record_t records[DHCPS_MAX_IP];
+    dhcp_lease_store_save(FIRST_IP, DHCPS_MAX_IP, records, make_snapshot(n, records));
+}
+
+// Reboot, and check snapshot n is the one found
+static bool loads(uint32_t n) {
+    dhcp_lease_record_t want[DHCPS_MAX_IP], got[DHCPS_MAX_IP];
+    size_t count = make_snapshot(n, want);
+    return dhcp_lease_store_load(FIRST_IP, DHCPS_MAX_IP, got, DHCPS_MAX_IP) == count &&
+           !memcmp(want, got, count * sizeof(got[0]));
+}
+
+// The first slot that differs between two copies of the flash, or -1
+static int changed_slot(const uint8_t *before) {
+    for (int offset = 0; offset < STORE_SIZE; offset++) {
+        if (before[offset] != dhcp_lease_store_sim_flash[offset]) {
+            return offset / FLASH_SECTOR_SIZE * SLOTS_PER_SECTOR + offset % FLASH_SECTOR_SIZE / SLOT_SIZE;
+        }
+    }
+    return -1;
+}
+
+static uint32_t slot_offset(int slot) {
+    return slot / SLOTS_PER_SECTOR * FLASH_SECTOR_SIZE + slot % SLOTS_PER_SECTOR * SLOT_SIZE;
+}
+
+static void test_rotation(void) {
+    static uint8_t before[STORE_SIZE];
+    erase_all();
+    CHECK(dhcp_lease_store_load(FIRST_IP, DHCPS_MAX_IP, NULL, 0) == 0);
+    int passes = 4;
+    for (uint32_t n = 0; n < passes * NUM_SLOTS; n++) {
+        memcpy(before, dhcp_lease_store_sim_flash, STORE_SIZE);
+        uint32_t erases = dhcp_lease_store_sim_erases;
+        save(n);
+        // One slot after another
+        CHECK(changed_slot(before) == (int)(n % NUM_SLOTS));
+        CHECK(loads(n));
+        if (dhcp_lease_store_sim_erases != erases) {
+            // The power goes while the sector is being erased, or just after:
+            // the snapshot before is still there, in the other sector
+            uint32_t sector = n % NUM_SLOTS / SLOTS_PER_SECTOR * FLASH_SECTOR_SIZE;
+            memcpy(dhcp_lease_store_sim_flash, before, STORE_SIZE);
+            memset(&dhcp_lease_store_sim_flash[sector], 0xff, FLASH_SECTOR_SIZE / 2);
+            CHECK(n > 0 && loads(n - 1));
+            memset(&dhcp_lease_store_sim_flash[sector], 0xff, FLASH_SECTOR_SIZE);
+            CHECK(loads(n - 1));
+            // Carry on from where the power went
+            save(n);
+            CHECK(loads(n));
+        }
+    }
+    // No erase on the first pass, as the flash started blank, then one for
+    // each sector on each pass after
+    CHECK(dhcp_lease_store_sim_erases == (passes - 1) * DHCPS_STORE_SECTORS);
+
+    // Nothing is written if nothing has changed
+    memcpy(before, dhcp_lease_store_sim_flash, STORE_SIZE);
+    save(passes * NUM_SLOTS - 1);
+    CHECK(changed_slot(before) < 0);
+
+    // A snapshot for a different pool isn't used, but isn't written over
+    // either
+    dhcp_lease_record_t records[DHCPS_MAX_IP];
+    CHECK(dhcp_lease_store_load(FIRST_IP + 256, DHCPS_MAX_IP, records, DHCPS_MAX_IP) == 0);
+    CHECK(dhcp_lease_store_load(FIRST_IP, DHCPS_MAX_IP - 1, records, DHCPS_MAX_IP) == 0);
+    save(1000);
+    CHECK(loads(1000));
+    save(passes * NUM_SLOTS - 1);
+    CHECK(loads(passes * NUM_SLOTS - 1));
+    section_end("rotation across erases");
+}
+
+static void test_damage(void) {
+    static uint8_t before[STORE_SIZE];
+    erase_all();
+    loads(0);
+    for (uint32_t n = 0; n < 3; n++) {
+        save(n);
+    }
+
+    // The power goes while snapshot 3 is being programmed, so only its
+    // first few bytes are written
+    memcpy(before, dhcp_lease_store_sim_flash, STORE_SIZE);
+    save(3);
+    int torn = changed_slot(before);
+    CHECK(torn == 3);
+    memset(&dhcp_lease_store_sim_flash[slot_offset(torn) + 8], 0xff, SLOT_SIZE - 8);
+    CHECK(loads(2));
+    // The torn slot can't be programmed again without an erase, which would
+    // take the newest snapshot with it, so the next write starts the other
+    // sector, which is still blank
+    uint32_t erases = dhcp_lease_store_sim_erases;
+    memcpy(before, dhcp_lease_store_sim_flash, STORE_SIZE);
+    save(4);
+    CHECK(changed_slot(before) == SLOTS_PER_SECTOR);
+    CHECK(dhcp_lease_store_sim_erases == erases);
+    CHECK(loads(4));
+    save(5);
+    CHECK(loads(5));
+
+    // A bit lost from a lease in the newest snapshot: the CRC doesn't match,
+    // so the snapshot before is used
+    int newest = SLOTS_PER_SECTOR + 1;
+    dhcp_lease_store_sim_flash[slot_offset(newest) + SNAPSHOT_HEADER_SIZE] &= ~0x02;
+    CHECK(loads(4));
+    // Damage to the magic number, and to the sequence number
+    dhcp_lease_store_sim_flash[slot_offset(newest - 1)] = 0;
+    CHECK(loads(2));
+    dhcp_lease_store_sim_flash[slot_offset(2) + 8] &= ~0x01;
+    CHECK(loads(1));
+    // The next write still goes after the newest valid snapshot, and skips
+    // the damaged slots, erasing the other sector
+    save(6);
+    CHECK(dhcp_lease_store_sim_erases == erases + 1);
+    CHECK(loads(6));
+    save(7);
+    CHECK(loads(7));
+
+    // Nothing valid at all
+    memset(dhcp_lease_store_sim_flash, 0, STORE_SIZE);
+    dhcp_lease_record_t records[DHCPS_MAX_IP];
+    CHECK(dhcp_lease_store_load(FIRST_IP, DHCPS_MAX_IP, records, DHCPS_MAX_IP) == 0);
+    save(8);
+    CHECK(loads(8));
+    section_end("torn writes and bad CRCs");
+}
+
+static dhcp_server_t server;
+
+static void boot(const uint8_t *ip) {
+    ip_addr_t addr, nm;
+    IP4_ADDR(&addr, ip[0], ip[1], ip[2], ip[3]);
+    IP4_ADDR(&nm, 255, 255, 255, 0);
+    // Nothing survives in RAM, not even a write waiting to happen
+    lwip_standin_reboot();
+    memset(&server, 0x5a, sizeof(server));
+    dhcp_server_init(&server, &addr, &nm);
+}
+
+// DISCOVER and REQUEST, or RELEASE, and return the last byte of the address
+// in the reply
+static int send_msg(uint8_t type, uint32_t client, uint8_t ip) {
+    uint8_t msg[300] = {1, 1, 6, 0};
+    msg[28] = 0x02;
+    msg[33] = client;
+    uint8_t *opt = &msg[236];
+    memcpy(opt, "\x63\x82\x53\x63\x35\x01", 6);
+    opt[6] = type;
+    opt += 7;
+    if (type == 7) {
+        uint8_t ciaddr[4] = {192, 168, 4, ip};
+        memcpy(&msg[12], ciaddr, 4);
+    } else if (ip) {
+        uint8_t requested[6] = {50, 4, 192, 168, 4, ip};
+        memcpy(opt, requested, 6);
+        opt += 6;
+    }
+    *opt = 255;
+    uint32_t sent = lwip_standin_stats.datagrams_sent;
+    lwip_standin_udp_deliver(server.udp, msg, sizeof(msg), IP_ADDR_ANY, 68);
+    return lwip_standin_stats.datagrams_sent == sent ? -1 : lwip_standin_sent.data[19];
+}
+
+static int bind_client(uint32_t client) {
+    int ip = send_msg(1, client, 0);
+    return ip > 0 ? send_msg(3, client, ip) : -1;
+}
+
+static void test_reboot(void) {
+    static const uint8_t server_ip[4] = {192, 168, 4, 1};
+    erase_all();
+    // Not erased, and no valid snapshots
+    memset(dhcp_lease_store_sim_flash, 0x5a, STORE_SIZE);
+    boot(server_ip);
+    CHECK(server.heap_len == 0);
+
+    int ips[10];
+    for (int client = 0; client < 10; client++) {
+        ips[client] = bind_client(client);
+        CHECK(ips[client] >= DHCPS_BASE_IP);
+    }
+    // All ten go in one write, once the delay is up
+    CHECK(server.store_pending);
+    lwip_standin_advance(DHCPS_STORE_DELAY_MS - 1);
+    CHECK(dhcp_lease_store_sim_erases == 0 && server.store_pending);
+    lwip_standin_advance(1);
+    CHECK(!server.store_pending);
+    CHECK(dhcp_lease_store_sim_erases == 1);
+    // Renewing changes nothing, so schedules no write
+    for (int client = 0; client < 10; client++) {
+        CHECK(bind_client(client) == ips[client]);
+    }
+    CHECK(!server.store_pending && lwip_standin_pending_timeouts() == 0);
+
+    // After a reboot each client is offered its address again, and a new
+    // client gets another one
+    boot(server_ip);
+    CHECK(server.heap_len == 10);
+    for (int client = 0; client < 10; client++) {
+        CHECK(send_msg(1, client, 0) == ips[client]);
+    }
+    int new_ip = bind_client(99);
+    for (int client = 0; client < 10; client++) {
+        CHECK(new_ip != ips[client]);
+    }
+    // Released before the write, so never written
+    CHECK(send_msg(7, 99, new_ip) == -1);
+    lwip_standin_advance(DHCPS_STORE_DELAY_MS);
+    boot(server_ip);
+    CHECK(server.heap_len == 10);
+
+    // Stopping the server writes what's waiting
+    bind_client(50);
+    CHECK(server.store_pending);
+    dhcp_server_deinit(&server);
+    CHECK(lwip_standin_pending_timeouts() == 0);
+    boot(server_ip);
+    CHECK(server.heap_len == 11);
+    dhcp_server_deinit(&server);
+
+    // A different subnet gets none of them
+    boot((const uint8_t[]){192, 168, 5, 1});
+    CHECK(server.heap_len == 0);
+    dhcp_server_deinit(&server);
+    section_end("restore after reboot");
+}
+
+int main() {
+    section_ok = true;
+    test_rotation();
+    test_damage();
+    test_reboot();
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,16 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Stand-in for lwIP's header of the same name, for building the access
+// point's servers on the host; see lwip_standin.h. The byte order macros
+// are in ip_addr.h.
+
+#ifndef _LWIP_DEF_H
+#define _LWIP_DEF_H
+
+#include "lwip/ip_addr.h"
+
+#endif
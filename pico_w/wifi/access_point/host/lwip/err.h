@@ -0,0 +1,30 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Stand-in for lwIP's header of the same name, for building the access
+// point's servers on the host; see lwip_standin.h
+
+#ifndef _LWIP_ERR_H
+#define _LWIP_ERR_H
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+
+#define ERR_OK         0
+#define ERR_MEM        -1
+#define ERR_BUF        -2
+#define ERR_TIMEOUT    -3
+#define ERR_INPROGRESS -5
+#define ERR_VAL        -6
+#define ERR_USE        -8
+#define ERR_CONN       -11
+#define ERR_ABRT       -13
+#define ERR_RST        -14
+#define ERR_CLSD       -15
+#define ERR_ARG        -16
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Stand-in for lwIP's header of the same name, for building the access
+// point's servers on the host; see lwip_standin.h. As lwIP built without
+// IPv6, an ip_addr_t is just an IPv4 address.
+
+#ifndef _LWIP_IP_ADDR_H
+#define _LWIP_IP_ADDR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+
+#include "lwip/err.h"
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+
+#define LWIP_MAX(x, y) (((x) > (y)) ? (x) : (y))
+#define LWIP_MIN(x, y) (((x) < (y)) ? (x) : (y))
+
+#define lwip_htons(x) htons(x)
+#define lwip_ntohs(x) ntohs(x)
+#define lwip_htonl(x) htonl(x)
+#define lwip_ntohl(x) ntohl(x)
+
+typedef struct ip4_addr {
+    // In network order
+    u32_t addr;
+} ip4_addr_t;
+
+typedef ip4_addr_t ip_addr_t;
+
+#define IPADDR_TYPE_V4  0U
+#define IPADDR_TYPE_ANY 46U
+
+#define IP4_ADDR(ipaddr, a, b, c, d) \
+        ((ipaddr)->addr = htonl((u32_t)((a) & 0xff) << 24 | (u32_t)((b) & 0xff) << 16 | \
+                                (u32_t)((c) & 0xff) << 8 | (u32_t)((d) & 0xff)))
+#define ip4_addr_get_u32(src_ipaddr) ((src_ipaddr)->addr)
+#define ip_2_ip4(ipaddr) (ipaddr)
+#define ip_addr_copy(dest, src) ((dest) = (src))
+#define ip_addr_cmp(addr1, addr2) ((addr1)->addr == (addr2)->addr)
+// Only IPv4 is stood in for
+#define IP_GET_TYPE(ipaddr) IPADDR_TYPE_V4
+
+extern const ip_addr_t ip_addr_any;
+#define IP_ADDR_ANY (&ip_addr_any)
+#define IP_ANY_TYPE IP_ADDR_ANY
+
+// Formats into a static buffer, so only the last result is valid
+char *ipaddr_ntoa(const ip_addr_t *addr);
+
+#endif
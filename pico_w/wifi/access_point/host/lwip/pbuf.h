@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Stand-in for lwIP's header of the same name, for building the access
+// point's servers on the host; see lwip_standin.h
+
+#ifndef _LWIP_PBUF_H
+#define _LWIP_PBUF_H
+
+#include "lwip/ip_addr.h"
+
+// Room left in front of the payload for the headers of lower layers, as
+// lwIP works them out for an Ethernet link
+typedef enum {
+    PBUF_TRANSPORT = 14 + 20 + 20,
+    PBUF_IP = 14 + 20,
+    PBUF_LINK = 14,
+    PBUF_RAW_TX = 0,
+    PBUF_RAW = 0,
+} pbuf_layer;
+
+typedef enum {
+    // Payload in the same heap allocation as the pbuf
+    PBUF_RAM,
+    // Payload in memory that never changes, e.g. flash
+    PBUF_ROM,
+    // Payload in memory owned by someone else
+    PBUF_REF,
+    // Payload in a fixed-size buffer from the pool, as received packets are
+    PBUF_POOL,
+} pbuf_type;
+
+struct pbuf {
+    struct pbuf *next;
+    void *payload;
+    // Length of this pbuf and all the ones chained after it
+    u16_t tot_len;
+    u16_t len;
+    u8_t type;
+    u16_t ref;
+    // The stand-in's own: the buffer the payload is in, for PBUF_RAM and
+    // PBUF_POOL, so the headroom in front of the payload can be checked
+    u8_t *mem;
+};
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type);
+void pbuf_realloc(struct pbuf *p, u16_t size);
+struct pbuf *pbuf_free_header(struct pbuf *q, u16_t size);
+u8_t pbuf_add_header(struct pbuf *p, size_t header_size_increment);
+u8_t pbuf_remove_header(struct pbuf *p, size_t header_size_decrement);
+void pbuf_ref(struct pbuf *p);
+u8_t pbuf_free(struct pbuf *p);
+void pbuf_cat(struct pbuf *head, struct pbuf *tail);
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset);
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Stand-in for lwIP's header of the same name, for building the access
+// point's servers on the host; see lwip_standin.h. Nothing goes on the wire:
+// what the code under test writes is queued on the pcb, and moves to its
+// output buffer when the test acknowledges it.
+
+#ifndef _LWIP_TCP_H
+#define _LWIP_TCP_H
+
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+
+#define TCP_WRITE_FLAG_COPY 0x01
+#define TCP_WRITE_FLAG_MORE 0x02
+
+#define TCP_MSS 1460
+#define TCP_SND_BUF (8 * TCP_MSS)
+#define TCP_SND_QUEUELEN ((4 * TCP_SND_BUF + TCP_MSS - 1) / TCP_MSS)
+
+// Bytes of output a pcb keeps for the test to read
+#define LWIP_STANDIN_TCP_OUT_SIZE 65536
+
+struct tcp_pcb;
+
+typedef err_t (*tcp_accept_fn)(void *arg, struct tcp_pcb *newpcb, err_t err);
+typedef err_t (*tcp_recv_fn)(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
+typedef err_t (*tcp_sent_fn)(void *arg, struct tcp_pcb *tpcb, u16_t len);
+typedef err_t (*tcp_poll_fn)(void *arg, struct tcp_pcb *tpcb);
+typedef void (*tcp_err_fn)(void *arg, err_t err);
+
+// A write queued and not yet acknowledged
+typedef struct lwip_standin_tcp_seg_t_ {
+    const void *data;
+    // The copy, for TCP_WRITE_FLAG_COPY
+    void *copy;
+    u16_t len;
+} lwip_standin_tcp_seg_t;
+
+struct tcp_pcb {
+    struct tcp_pcb *next;
+    u16_t local_port;
+    bool listening;
+    // A connection from lwip_standin_tcp_connect
+    bool connected;
+    void *callback_arg;
+    tcp_accept_fn accept;
+    tcp_recv_fn recv;
+    tcp_sent_fn sent;
+    tcp_poll_fn poll;
+    tcp_err_fn errf;
+    u8_t pollinterval;
+    bool nagle_disabled;
+    // Closed or aborted by the code under test. The test frees the pcb with
+    // lwip_standin_tcp_free once it is done with it.
+    bool closed;
+    bool aborted;
+    // Bytes delivered that the code under test hasn't passed to tcp_recved
+    u32_t rcv_unrecved;
+    // Send buffer size, and what is queued in it; a test can shrink the
+    // buffer to see how the code copes
+    u16_t snd_buf_size;
+    u16_t snd_queued;
+    u16_t snd_queuelen_max;
+    u16_t snd_queuelen;
+    lwip_standin_tcp_seg_t segs[TCP_SND_QUEUELEN];
+    // Calls to tcp_output
+    u32_t outputs;
+    // What has been acknowledged, in order; the test can empty it by
+    // setting out_len to 0
+    size_t out_len;
+    char out[LWIP_STANDIN_TCP_OUT_SIZE];
+};
+
+struct tcp_pcb *tcp_new(void);
+struct tcp_pcb *tcp_new_ip_type(u8_t type);
+err_t tcp_bind(struct tcp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port);
+struct tcp_pcb *tcp_listen_with_backlog(struct tcp_pcb *pcb, u8_t backlog);
+void tcp_arg(struct tcp_pcb *pcb, void *arg);
+void tcp_accept(struct tcp_pcb *pcb, tcp_accept_fn accept);
+void tcp_recv(struct tcp_pcb *pcb, tcp_recv_fn recv);
+void tcp_sent(struct tcp_pcb *pcb, tcp_sent_fn sent);
+void tcp_poll(struct tcp_pcb *pcb, tcp_poll_fn poll, u8_t interval);
+void tcp_err(struct tcp_pcb *pcb, tcp_err_fn err);
+void tcp_nagle_disable(struct tcp_pcb *pcb);
+err_t tcp_write(struct tcp_pcb *pcb, const void *dataptr, u16_t len, u8_t apiflags);
+err_t tcp_output(struct tcp_pcb *pcb);
+void tcp_recved(struct tcp_pcb *pcb, u16_t len);
+u16_t tcp_sndbuf(const struct tcp_pcb *pcb);
+u16_t tcp_sndqueuelen(const struct tcp_pcb *pcb);
+err_t tcp_close(struct tcp_pcb *pcb);
+void tcp_abort(struct tcp_pcb *pcb);
+
+#endif
@@ -0,0 +1,21 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Stand-in for lwIP's header of the same name, for building the access
+// point's servers on the host; see lwip_standin.h. Timeouts fire when the
+// test moves the clock on past them.
+
+#ifndef _LWIP_TIMEOUTS_H
+#define _LWIP_TIMEOUTS_H
+
+#include "lwip/ip_addr.h"
+
+typedef void (*sys_timeout_handler)(void *arg);
+
+void sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg);
+void sys_untimeout(sys_timeout_handler handler, void *arg);
+
+#endif
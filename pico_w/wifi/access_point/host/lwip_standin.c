@@ -0,0 +1,645 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/asan_interface.h>
+#else
+#define ASAN_POISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#define ASAN_UNPOISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#endif
+
+#include "cyw43_config.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "lwip_standin.h"
+
+// As lwIP works them out for a TCP_MSS of 1460 on an Ethernet link
+#define POOL_BUFSIZE (1460 + 40 + 14)
+#define UDP_HLEN 8
+#define IP_HLEN 20
+#define LINK_HLEN 14
+#define TCP_HLEN 20
+
+#define MAX_TIMEOUTS 16
+#define MAX_HELD 16
+
+lwip_standin_stats_t lwip_standin_stats;
+lwip_standin_datagram_t lwip_standin_sent;
+
+const ip_addr_t ip_addr_any;
+
+static uint32_t now_ms;
+
+char *ipaddr_ntoa(const ip_addr_t *addr) {
+    static char buf[16];
+    return (char *)inet_ntop(AF_INET, &addr->addr, buf, sizeof(buf));
+}
+
+// pbufs
+
+static struct pbuf *pbuf_new(pbuf_type type, u16_t len, size_t mem_size, size_t offset) {
+    struct pbuf *p = calloc(1, sizeof(*p));
+    assert(p);
+    p->type = type;
+    p->ref = 1;
+    p->len = p->tot_len = len;
+    if (mem_size) {
+        p->mem = malloc(mem_size);
+        assert(p->mem);
+        p->payload = p->mem + offset;
+    }
+    ++lwip_standin_stats.live_pbufs;
+    return p;
+}
+
+// A chain of pool buffers, the first with room for the headers in front
+static struct pbuf *pool_chain(u16_t layer, u16_t length) {
+    u16_t first = LWIP_MIN(length, POOL_BUFSIZE - layer);
+    struct pbuf *p = pbuf_new(PBUF_POOL, first, POOL_BUFSIZE, layer);
+    for (u16_t done = first; done < length;) {
+        u16_t n = LWIP_MIN(length - done, POOL_BUFSIZE);
+        pbuf_cat(p, pbuf_new(PBUF_POOL, n, POOL_BUFSIZE, 0));
+        done += n;
+    }
+    // Under AddressSanitizer, reading past the data into the rest of the
+    // buffer is caught as it would be past the end of a malloc
+    for (struct pbuf *q = p; q; q = q->next) {
+        u8_t *end = (u8_t *)q->payload + q->len;
+        ASAN_POISON_MEMORY_REGION(end, q->mem + POOL_BUFSIZE - end);
+    }
+    return p;
+}
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type) {
+    struct pbuf *p;
+    switch (type) {
+        case PBUF_RAM:
+            p = pbuf_new(type, length, layer + length, layer);
+            ++lwip_standin_stats.heap_allocs;
+            break;
+        case PBUF_POOL:
+            p = pool_chain(layer, length);
+            for (struct pbuf *q = p; q; q = q->next) {
+                ++lwip_standin_stats.pool_allocs;
+            }
+            break;
+        case PBUF_REF:
+        case PBUF_ROM:
+            p = pbuf_new(type, length, 0, 0);
+            ++lwip_standin_stats.memp_allocs;
+            break;
+        default:
+            return NULL;
+    }
+    return p;
+}
+
+void pbuf_realloc(struct pbuf *p, u16_t new_len) {
+    if (new_len >= p->tot_len) {
+        // Only ever shrinks
+        return;
+    }
+    u16_t shrink = p->tot_len - new_len;
+    u16_t rem_len = new_len;
+    struct pbuf *q = p;
+    while (rem_len > q->len) {
+        rem_len -= q->len;
+        q->tot_len -= shrink;
+        q = q->next;
+    }
+    q->len = q->tot_len = rem_len;
+    if (q->next) {
+        pbuf_free(q->next);
+        q->next = NULL;
+    }
+}
+
+struct pbuf *pbuf_free_header(struct pbuf *q, u16_t size) {
+    struct pbuf *p = q;
+    u16_t free_left = size;
+    while (free_left && p) {
+        if (free_left >= p->len) {
+            struct pbuf *f = p;
+            free_left -= p->len;
+            p = p->next;
+            f->next = NULL;
+            pbuf_free(f);
+        } else {
+            p->payload = (u8_t *)p->payload + free_left;
+            p->len -= free_left;
+            p->tot_len -= free_left;
+            free_left = 0;
+        }
+    }
+    return p;
+}
+
+u8_t pbuf_add_header(struct pbuf *p, size_t header_size_increment) {
+    // Only the heap and pool buffers have room in front of the payload
+    if ((p->type != PBUF_RAM && p->type != PBUF_POOL) ||
+        (size_t)((u8_t *)p->payload - p->mem) < header_size_increment ||
+        p->tot_len + header_size_increment > 0xffff) {
+        return 1;
+    }
+    p->payload = (u8_t *)p->payload - header_size_increment;
+    p->len += header_size_increment;
+    p->tot_len += header_size_increment;
+    return 0;
+}
+
+u8_t pbuf_remove_header(struct pbuf *p, size_t header_size_decrement) {
+    if (header_size_decrement > p->len) {
+        return 1;
+    }
+    p->payload = (u8_t *)p->payload + header_size_decrement;
+    p->len -= header_size_decrement;
+    p->tot_len -= header_size_decrement;
+    return 0;
+}
+
+void pbuf_ref(struct pbuf *p) {
+    assert(p->ref > 0);
+    ++p->ref;
+}
+
+u8_t pbuf_free(struct pbuf *p) {
+    assert(p);
+    u8_t count = 0;
+    while (p) {
+        assert(p->ref > 0);
+        if (--p->ref) {
+            break;
+        }
+        struct pbuf *next = p->next;
+        if (p->type == PBUF_POOL) {
+            ASAN_UNPOISON_MEMORY_REGION(p->mem, POOL_BUFSIZE);
+        }
+        free(p->mem);
+        free(p);
+        --lwip_standin_stats.live_pbufs;
+        ++count;
+        p = next;
+    }
+    return count;
+}
+
+void pbuf_cat(struct pbuf *head, struct pbuf *tail) {
+    struct pbuf *p = head;
+    for (; p->next; p = p->next) {
+        p->tot_len += tail->tot_len;
+    }
+    p->tot_len += tail->tot_len;
+    p->next = tail;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset) {
+    u16_t copied = 0;
+    for (; p && len; p = p->next) {
+        if (offset >= p->len) {
+            offset -= p->len;
+            continue;
+        }
+        u16_t n = LWIP_MIN(p->len - offset, len);
+        memcpy((u8_t *)dataptr + copied, (const u8_t *)p->payload + offset, n);
+        copied += n;
+        len -= n;
+        offset = 0;
+    }
+    return copied;
+}
+
+// UDP
+
+struct udp_pcb {
+    struct udp_pcb *next;
+    u16_t local_port;
+    udp_recv_fn recv;
+    void *recv_arg;
+};
+
+static struct udp_pcb *udp_pcbs;
+
+struct udp_pcb *udp_new(void) {
+    struct udp_pcb *pcb = calloc(1, sizeof(*pcb));
+    assert(pcb);
+    pcb->next = udp_pcbs;
+    udp_pcbs = pcb;
+    return pcb;
+}
+
+struct udp_pcb *udp_new_ip_type(u8_t type) {
+    (void)type;
+    return udp_new();
+}
+
+void udp_remove(struct udp_pcb *pcb) {
+    struct udp_pcb **p = &udp_pcbs;
+    while (*p != pcb) {
+        assert(*p);
+        p = &(*p)->next;
+    }
+    *p = pcb->next;
+    free(pcb);
+}
+
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port) {
+    (void)ipaddr;
+    for (struct udp_pcb *other = udp_pcbs; other; other = other->next) {
+        if (other != pcb && port && other->local_port == port) {
+            return ERR_USE;
+        }
+    }
+    pcb->local_port = port;
+    return ERR_OK;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg) {
+    pcb->recv = recv;
+    pcb->recv_arg = recv_arg;
+}
+
+// Datagrams lwIP is holding on to, as it would while waiting for ARP
+static struct pbuf *udp_held[MAX_HELD];
+static int num_udp_held;
+bool lwip_standin_udp_hold;
+
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port) {
+    (void)pcb;
+    if (p->tot_len > LWIP_STANDIN_MAX_DATAGRAM) {
+        return ERR_VAL;
+    }
+    // The driver copies the frame out before returning
+    lwip_standin_sent.len = pbuf_copy_partial(p, lwip_standin_sent.data, p->tot_len, 0);
+    lwip_standin_sent.addr = *dst_ip;
+    lwip_standin_sent.port = dst_port;
+    ++lwip_standin_stats.datagrams_sent;
+
+    // lwIP puts the headers in front of the payload if the pbuf has room,
+    // and leaves them there, or else in a pbuf of their own, chained in front
+    struct pbuf *q = p;
+    if (pbuf_add_header(p, UDP_HLEN + IP_HLEN + LINK_HLEN)) {
+        q = pbuf_alloc(PBUF_IP, UDP_HLEN, PBUF_RAM);
+        pbuf_ref(p);
+        pbuf_cat(q, p);
+        ++lwip_standin_stats.header_pbufs;
+    }
+    if (lwip_standin_udp_hold) {
+        // etharp queues a reference to the frame rather than a copy
+        assert(num_udp_held < MAX_HELD);
+        if (q == p) {
+            pbuf_ref(p);
+        }
+        udp_held[num_udp_held++] = q;
+    } else if (q != p) {
+        pbuf_free(q);
+    }
+    return ERR_OK;
+}
+
+void lwip_standin_udp_release(void) {
+    for (int i = 0; i < num_udp_held; ++i) {
+        pbuf_free(udp_held[i]);
+    }
+    num_udp_held = 0;
+}
+
+void lwip_standin_udp_deliver(struct udp_pcb *pcb, const void *data, size_t len, const ip_addr_t *src,
+                              u16_t src_port) {
+    assert(pcb->recv && len <= 0xffff);
+    struct pbuf *p = pool_chain(LINK_HLEN + IP_HLEN + UDP_HLEN, len);
+    u16_t offset = 0;
+    for (struct pbuf *q = p; q; offset += q->len, q = q->next) {
+        memcpy(q->payload, (const u8_t *)data + offset, q->len);
+    }
+    pcb->recv(pcb->recv_arg, pcb, p, src, src_port);
+}
+
+// TCP
+
+static struct tcp_pcb *tcp_pcbs;
+
+struct tcp_pcb *tcp_new(void) {
+    struct tcp_pcb *pcb = calloc(1, sizeof(*pcb));
+    assert(pcb);
+    pcb->snd_buf_size = TCP_SND_BUF;
+    pcb->snd_queuelen_max = TCP_SND_QUEUELEN;
+    pcb->next = tcp_pcbs;
+    tcp_pcbs = pcb;
+    ++lwip_standin_stats.tcp_live_pcbs;
+    return pcb;
+}
+
+struct tcp_pcb *tcp_new_ip_type(u8_t type) {
+    (void)type;
+    return tcp_new();
+}
+
+static void tcp_pcb_free(struct tcp_pcb *pcb) {
+    struct tcp_pcb **p = &tcp_pcbs;
+    while (*p != pcb) {
+        assert(*p);
+        p = &(*p)->next;
+    }
+    *p = pcb->next;
+    for (int i = 0; i < pcb->snd_queuelen; ++i) {
+        free(pcb->segs[i].copy);
+    }
+    free(pcb);
+    --lwip_standin_stats.tcp_live_pcbs;
+}
+
+err_t tcp_bind(struct tcp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port) {
+    (void)ipaddr;
+    for (struct tcp_pcb *other = tcp_pcbs; other; other = other->next) {
+        if (other != pcb && port && other->listening && other->local_port == port) {
+            return ERR_USE;
+        }
+    }
+    pcb->local_port = port;
+    return ERR_OK;
+}
+
+struct tcp_pcb *tcp_listen_with_backlog(struct tcp_pcb *pcb, u8_t backlog) {
+    (void)backlog;
+    pcb->listening = true;
+    return pcb;
+}
+
+void tcp_arg(struct tcp_pcb *pcb, void *arg) {
+    pcb->callback_arg = arg;
+}
+
+void tcp_accept(struct tcp_pcb *pcb, tcp_accept_fn accept) {
+    pcb->accept = accept;
+}
+
+void tcp_recv(struct tcp_pcb *pcb, tcp_recv_fn recv) {
+    pcb->recv = recv;
+}
+
+void tcp_sent(struct tcp_pcb *pcb, tcp_sent_fn sent) {
+    pcb->sent = sent;
+}
+
+void tcp_poll(struct tcp_pcb *pcb, tcp_poll_fn poll, u8_t interval) {
+    pcb->poll = poll;
+    pcb->pollinterval = interval;
+}
+
+void tcp_err(struct tcp_pcb *pcb, tcp_err_fn err) {
+    pcb->errf = err;
+}
+
+void tcp_nagle_disable(struct tcp_pcb *pcb) {
+    pcb->nagle_disabled = true;
+}
+
+u16_t tcp_sndbuf(const struct tcp_pcb *pcb) {
+    return pcb->snd_buf_size - pcb->snd_queued;
+}
+
+u16_t tcp_sndqueuelen(const struct tcp_pcb *pcb) {
+    return pcb->snd_queuelen;
+}
+
+err_t tcp_write(struct tcp_pcb *pcb, const void *dataptr, u16_t len, u8_t apiflags) {
+    assert(!pcb->aborted);
+    if (pcb->closed) {
+        return ERR_CONN;
+    }
+    if (len > tcp_sndbuf(pcb) || pcb->snd_queuelen >= pcb->snd_queuelen_max) {
+        return ERR_MEM;
+    }
+    lwip_standin_tcp_seg_t *seg = &pcb->segs[pcb->snd_queuelen++];
+    seg->len = len;
+    if (apiflags & TCP_WRITE_FLAG_COPY) {
+        seg->copy = malloc(len ? len : 1);
+        assert(seg->copy);
+        memcpy(seg->copy, dataptr, len);
+        seg->data = seg->copy;
+        ++lwip_standin_stats.tcp_copied_writes;
+        lwip_standin_stats.tcp_copied_bytes += len;
+    } else {
+        seg->copy = NULL;
+        seg->data = dataptr;
+        ++lwip_standin_stats.tcp_ref_writes;
+    }
+    pcb->snd_queued += len;
+    return ERR_OK;
+}
+
+err_t tcp_output(struct tcp_pcb *pcb) {
+    ++pcb->outputs;
+    return ERR_OK;
+}
+
+void tcp_recved(struct tcp_pcb *pcb, u16_t len) {
+    assert(len <= pcb->rcv_unrecved);
+    pcb->rcv_unrecved -= len;
+}
+
+err_t tcp_close(struct tcp_pcb *pcb) {
+    if (!pcb->connected) {
+        // Nothing to shut down, so lwIP frees it straight away
+        tcp_pcb_free(pcb);
+        return ERR_OK;
+    }
+    // lwIP resets rather than closes a connection with data it was never
+    // told was read
+    if (pcb->rcv_unrecved) {
+        ++lwip_standin_stats.tcp_resets;
+    }
+    pcb->closed = true;
+    return ERR_OK;
+}
+
+void tcp_abort(struct tcp_pcb *pcb) {
+    pcb->aborted = true;
+    ++lwip_standin_stats.tcp_resets;
+}
+
+struct tcp_pcb *lwip_standin_tcp_connect(u16_t port, err_t *err) {
+    struct tcp_pcb *listener = tcp_pcbs;
+    while (listener && !(listener->listening && listener->local_port == port)) {
+        listener = listener->next;
+    }
+    if (!listener || !listener->accept) {
+        *err = ERR_CONN;
+        return NULL;
+    }
+    struct tcp_pcb *pcb = tcp_new();
+    pcb->connected = true;
+    pcb->local_port = port;
+    *err = listener->accept(listener->callback_arg, pcb, ERR_OK);
+    if (*err != ERR_OK) {
+        // lwIP aborts a connection that isn't accepted
+        assert(*err != ERR_ABRT || pcb->aborted);
+        tcp_pcb_free(pcb);
+        return NULL;
+    }
+    return pcb;
+}
+
+err_t lwip_standin_tcp_deliver(struct tcp_pcb *pcb, const void *data, size_t len, size_t segment_len) {
+    assert(pcb->recv && !pcb->closed && !pcb->aborted && segment_len);
+    struct pbuf *p = NULL;
+    for (size_t offset = 0; offset < len; offset += segment_len) {
+        u16_t n = LWIP_MIN(len - offset, segment_len);
+        struct pbuf *segment = pool_chain(LINK_HLEN + IP_HLEN + TCP_HLEN, n);
+        u16_t done = 0;
+        for (struct pbuf *q = segment; q; done += q->len, q = q->next) {
+            memcpy(q->payload, (const u8_t *)data + offset + done, q->len);
+        }
+        if (p) {
+            pbuf_cat(p, segment);
+        } else {
+            p = segment;
+        }
+    }
+    pcb->rcv_unrecved += len;
+    err_t err = pcb->recv(pcb->callback_arg, pcb, p, ERR_OK);
+    if (err != ERR_OK && err != ERR_ABRT) {
+        // lwIP would hold on to the data and offer it again later
+        pcb->rcv_unrecved -= len;
+        pbuf_free(p);
+    }
+    return err;
+}
+
+err_t lwip_standin_tcp_fin(struct tcp_pcb *pcb) {
+    assert(pcb->recv && !pcb->closed && !pcb->aborted);
+    return pcb->recv(pcb->callback_arg, pcb, NULL, ERR_OK);
+}
+
+err_t lwip_standin_tcp_ack(struct tcp_pcb *pcb, size_t len) {
+    assert(!pcb->aborted);
+    u16_t acked = 0;
+    while (pcb->snd_queuelen && acked + pcb->segs[0].len <= len) {
+        lwip_standin_tcp_seg_t *seg = &pcb->segs[0];
+        assert(pcb->out_len + seg->len <= sizeof(pcb->out));
+        memcpy(pcb->out + pcb->out_len, seg->data, seg->len);
+        pcb->out_len += seg->len;
+        acked += seg->len;
+        free(seg->copy);
+        --pcb->snd_queuelen;
+        memmove(&pcb->segs[0], &pcb->segs[1], pcb->snd_queuelen * sizeof(pcb->segs[0]));
+    }
+    pcb->snd_queued -= acked;
+    if (!acked || !pcb->sent || pcb->closed) {
+        return ERR_OK;
+    }
+    return pcb->sent(pcb->callback_arg, pcb, acked);
+}
+
+err_t lwip_standin_tcp_ack_all(struct tcp_pcb *pcb) {
+    err_t err = ERR_OK;
+    while (pcb->snd_queuelen && err == ERR_OK && !pcb->aborted) {
+        err = lwip_standin_tcp_ack(pcb, SIZE_MAX);
+    }
+    return err;
+}
+
+err_t lwip_standin_tcp_poll(struct tcp_pcb *pcb) {
+    assert(!pcb->aborted);
+    if (!pcb->poll || pcb->closed) {
+        return ERR_OK;
+    }
+    return pcb->poll(pcb->callback_arg, pcb);
+}
+
+void lwip_standin_tcp_error(struct tcp_pcb *pcb, err_t err) {
+    assert(!pcb->closed && !pcb->aborted);
+    if (pcb->errf) {
+        pcb->errf(pcb->callback_arg, err);
+    }
+    tcp_pcb_free(pcb);
+}
+
+void lwip_standin_tcp_free(struct tcp_pcb *pcb) {
+    assert(pcb->closed || pcb->aborted);
+    tcp_pcb_free(pcb);
+}
+
+// Time
+
+static struct {
+    uint32_t due;
+    sys_timeout_handler handler;
+    void *arg;
+} timeouts[MAX_TIMEOUTS];
+static int num_timeouts;
+
+uint32_t cyw43_hal_ticks_ms(void) {
+    return now_ms;
+}
+
+void sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg) {
+    assert(num_timeouts < MAX_TIMEOUTS);
+    timeouts[num_timeouts].due = now_ms + msecs;
+    timeouts[num_timeouts].handler = handler;
+    timeouts[num_timeouts].arg = arg;
+    ++num_timeouts;
+}
+
+static void timeout_remove(int i) {
+    memmove(&timeouts[i], &timeouts[i + 1], (num_timeouts - i - 1) * sizeof(timeouts[0]));
+    --num_timeouts;
+}
+
+void sys_untimeout(sys_timeout_handler handler, void *arg) {
+    for (int i = 0; i < num_timeouts; ++i) {
+        if (timeouts[i].handler == handler && timeouts[i].arg == arg) {
+            timeout_remove(i);
+            return;
+        }
+    }
+}
+
+void lwip_standin_set_time(uint32_t ms) {
+    now_ms = ms;
+}
+
+void lwip_standin_advance(uint32_t ms) {
+    uint32_t end = now_ms + ms;
+    for (;;) {
+        int next = -1;
+        for (int i = 0; i < num_timeouts; ++i) {
+            if ((int32_t)(timeouts[i].due - end) <= 0 &&
+                (next < 0 || (int32_t)(timeouts[i].due - timeouts[next].due) < 0)) {
+                next = i;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        sys_timeout_handler handler = timeouts[next].handler;
+        void *arg = timeouts[next].arg;
+        if ((int32_t)(timeouts[next].due - now_ms) > 0) {
+            now_ms = timeouts[next].due;
+        }
+        timeout_remove(next);
+        handler(arg);
+    }
+    now_ms = end;
+}
+
+int lwip_standin_pending_timeouts(void) {
+    return num_timeouts;
+}
+
+void lwip_standin_reboot(void) {
+    while (udp_pcbs) {
+        udp_remove(udp_pcbs);
+    }
+    while (tcp_pcbs) {
+        tcp_pcb_free(tcp_pcbs);
+    }
+    num_timeouts = 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _LWIP_STANDIN_H
+#define _LWIP_STANDIN_H
+
+// A stand-in for the parts of lwIP and the cyw43 driver that the access
+// point's servers use, so they can be built and tested on the host. Like
+// lwIP with NO_SYS, it is single threaded, and nothing happens unless the
+// test makes it happen: packets arrive when the test delivers them, and the
+// clock only moves when the test moves it.
+//
+// pbufs come from the C heap, but are counted by where lwIP would take
+// them from, so a test can see what each request costs, and freed with
+// lwIP's reference counting, so leaks and double frees show up.
+
+#include "lwip/tcp.h"
+#include "lwip/udp.h"
+
+typedef struct lwip_standin_stats_t_ {
+    // pbufs allocated by the code under test: from the heap (PBUF_RAM), the
+    // pool (PBUF_POOL) and the pbuf memory pool (PBUF_REF and PBUF_ROM).
+    // Packets the test delivers aren't counted.
+    uint32_t heap_allocs;
+    uint32_t pool_allocs;
+    uint32_t memp_allocs;
+    // pbufs allocated and not yet freed, including delivered packets
+    int32_t live_pbufs;
+    // Datagrams sent, and how many of them had no room in front of their
+    // payload for the headers, so needed another pbuf from the heap
+    uint32_t datagrams_sent;
+    uint32_t header_pbufs;
+    // tcp_write calls with TCP_WRITE_FLAG_COPY, and the bytes they copied,
+    // and calls that only reference the data
+    uint32_t tcp_copied_writes;
+    uint64_t tcp_copied_bytes;
+    uint32_t tcp_ref_writes;
+    // Connections aborted, or closed with data not passed to tcp_recved,
+    // which lwIP resets
+    uint32_t tcp_resets;
+    // TCP pcbs not yet freed
+    int32_t tcp_live_pcbs;
+} lwip_standin_stats_t;
+
+extern lwip_standin_stats_t lwip_standin_stats;
+
+#define LWIP_STANDIN_MAX_DATAGRAM 1472
+
+// The last datagram sent, copied out as the driver would
+typedef struct lwip_standin_datagram_t_ {
+    uint8_t data[LWIP_STANDIN_MAX_DATAGRAM];
+    size_t len;
+    ip_addr_t addr;
+    u16_t port;
+} lwip_standin_datagram_t;
+
+extern lwip_standin_datagram_t lwip_standin_sent;
+
+// While set, lwIP holds on to each datagram sent, as it does while waiting
+// for ARP to find the destination, until lwip_standin_udp_release()
+extern bool lwip_standin_udp_hold;
+void lwip_standin_udp_release(void);
+
+// Pass a datagram to a UDP pcb's receive function, in a pool pbuf with
+// room for the headers in front, as a packet from the link would be
+void lwip_standin_udp_deliver(struct udp_pcb *pcb, const void *data, size_t len, const ip_addr_t *src,
+                              u16_t src_port);
+
+// Open a connection to the pcb listening on port, as a client would. Returns
+// the new pcb, or NULL with the error its accept function returned.
+struct tcp_pcb *lwip_standin_tcp_connect(u16_t port, err_t *err);
+
+// Pass data from the client to the pcb's receive function, as a chain of
+// pool pbufs of up to segment_len bytes each. Returns what the receive
+// function did.
+err_t lwip_standin_tcp_deliver(struct tcp_pcb *pcb, const void *data, size_t len, size_t segment_len);
+
+// The client closes its side of the connection
+err_t lwip_standin_tcp_fin(struct tcp_pcb *pcb);
+
+// The client acknowledges up to len bytes, in whole writes, which move to
+// the pcb's output buffer. Returns what the sent function did.
+err_t lwip_standin_tcp_ack(struct tcp_pcb *pcb, size_t len);
+
+// Acknowledge everything written, including what the sent function writes,
+// until there is nothing left or the connection is aborted
+err_t lwip_standin_tcp_ack_all(struct tcp_pcb *pcb);
+
+// Call the pcb's poll function, as lwIP does every pollinterval half seconds
+err_t lwip_standin_tcp_poll(struct tcp_pcb *pcb);
+
+// The connection fails, e.g. with ERR_RST. The pcb's error function is
+// called and the pcb freed, as lwIP does.
+void lwip_standin_tcp_error(struct tcp_pcb *pcb, err_t err);
+
+// Free a pcb that the code under test closed or aborted, once the test is
+// done with it
+void lwip_standin_tcp_free(struct tcp_pcb *pcb);
+
+// Set the clock, without running any timeouts
+void lwip_standin_set_time(uint32_t ms);
+
+// Move the clock on, running each timeout that falls due on the way, in
+// order, at its time
+void lwip_standin_advance(uint32_t ms);
+
+// Timeouts waiting to fire
+int lwip_standin_pending_timeouts(void);
+
+// Forget every pcb and timeout, as a reboot would, leaving the clock alone
+void lwip_standin_reboot(void);
+
+#endif
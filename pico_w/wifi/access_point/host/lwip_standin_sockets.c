@@ -0,0 +1,214 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lwip_standin_sockets.h"
+
+#define MAX_CLIENTS 64
+// lwIP's slow timer, which drives tcp_poll
+#define POLL_TICK_MS 500
+
+typedef struct client_t_ {
+    int fd;
+    struct tcp_pcb *pcb;
+    // The client has closed its side
+    bool fin;
+    u8_t ticks;
+} client_t;
+
+static client_t clients[MAX_CLIENTS];
+
+static uint32_t host_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t)(t.tv_sec * 1000 + t.tv_nsec / 1000000);
+}
+
+static void close_fd(int fd, bool reset) {
+    if (reset) {
+        struct linger linger = { .l_onoff = 1, .l_linger = 0 };
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    }
+    close(fd);
+}
+
+static bool write_all(int fd, const char *data, size_t len) {
+    while (len) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void client_drop(client_t *c, bool reset) {
+    close_fd(c->fd, reset);
+    c->fd = -1;
+    c->pcb = NULL;
+}
+
+// Send what the server has written, acknowledging it as the socket takes
+// it, which may make the server write more. Then finish with the
+// connection if the server has closed or aborted it.
+static void client_flush(client_t *c) {
+    struct tcp_pcb *pcb = c->pcb;
+    while (pcb->snd_queuelen && !pcb->aborted) {
+        lwip_standin_tcp_ack(pcb, SIZE_MAX);
+        if (pcb->aborted) {
+            break;
+        }
+        bool ok = write_all(c->fd, pcb->out, pcb->out_len);
+        pcb->out_len = 0;
+        if (!ok) {
+            if (pcb->closed) {
+                lwip_standin_tcp_free(pcb);
+            } else {
+                lwip_standin_tcp_error(pcb, ERR_RST);
+            }
+            client_drop(c, true);
+            return;
+        }
+    }
+    if (pcb->aborted || pcb->closed) {
+        // lwIP resets a connection closed with data it was never told was read
+        bool reset = pcb->aborted || pcb->rcv_unrecved;
+        lwip_standin_tcp_free(pcb);
+        client_drop(c, reset);
+    }
+}
+
+static void client_accept(int listen_fd, u16_t port) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    client_t *c = NULL;
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+        if (clients[i].fd < 0) {
+            c = &clients[i];
+            break;
+        }
+    }
+    err_t err;
+    struct tcp_pcb *pcb = c ? lwip_standin_tcp_connect(port, &err) : NULL;
+    if (!pcb) {
+        close_fd(fd, true);
+        return;
+    }
+    *c = (client_t) { .fd = fd, .pcb = pcb };
+    client_flush(c);
+}
+
+static void client_read(client_t *c) {
+    static char buf[16384];
+    ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+    if (n < 0 && errno == EINTR) {
+        return;
+    }
+    if (n < 0) {
+        lwip_standin_tcp_error(c->pcb, ERR_RST);
+        client_drop(c, true);
+        return;
+    }
+    if (n == 0) {
+        c->fin = true;
+        lwip_standin_tcp_fin(c->pcb);
+    } else {
+        lwip_standin_tcp_deliver(c->pcb, buf, n, TCP_MSS);
+    }
+    client_flush(c);
+}
+
+static void clients_tick(void) {
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+        client_t *c = &clients[i];
+        if (c->fd >= 0 && c->pcb->pollinterval && ++c->ticks >= c->pcb->pollinterval) {
+            c->ticks = 0;
+            lwip_standin_tcp_poll(c->pcb);
+            client_flush(c);
+        }
+    }
+}
+
+bool lwip_standin_sockets_run(u16_t port, volatile sig_atomic_t *stop) {
+    int listen_fd = socket(AF_INET6, SOCK_STREAM, 0);
+    int no = 0, yes = 1;
+    if (listen_fd < 0 ||
+        setsockopt(listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &no, sizeof(no)) ||
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes))) {
+        perror("socket");
+        return false;
+    }
+    struct sockaddr_in6 addr = { .sin6_family = AF_INET6, .sin6_port = htons(port), .sin6_addr = in6addr_any };
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(listen_fd, 16)) {
+        perror("bind");
+        close(listen_fd);
+        return false;
+    }
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+        clients[i].fd = -1;
+    }
+
+    uint32_t last_tick = host_ms();
+    while (!*stop) {
+        struct pollfd fds[MAX_CLIENTS + 1] = { { .fd = listen_fd, .events = POLLIN } };
+        for (int i = 0; i < MAX_CLIENTS; ++i) {
+            // Once the client has closed its side there's nothing more to read
+            fds[i + 1].fd = clients[i].fin ? -1 : clients[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+        uint32_t since_tick = host_ms() - last_tick;
+        int timeout = since_tick < POLL_TICK_MS ? (int)(POLL_TICK_MS - since_tick) : 0;
+        if (poll(fds, MAX_CLIENTS + 1, timeout) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            client_accept(listen_fd, port);
+        }
+        for (int i = 0; i < MAX_CLIENTS; ++i) {
+            // A slot freed and reused by an accept above has nothing to read yet
+            if (clients[i].fd >= 0 && clients[i].fd == fds[i + 1].fd && fds[i + 1].revents) {
+                client_read(&clients[i]);
+            }
+        }
+        uint32_t now = host_ms();
+        if (now - last_tick >= POLL_TICK_MS) {
+            lwip_standin_advance(now - last_tick);
+            last_tick = now;
+            clients_tick();
+        }
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+        if (clients[i].fd >= 0) {
+            if (clients[i].pcb->closed || clients[i].pcb->aborted) {
+                lwip_standin_tcp_free(clients[i].pcb);
+            } else {
+                lwip_standin_tcp_error(clients[i].pcb, ERR_ABRT);
+            }
+            client_drop(&clients[i], true);
+        }
+    }
+    close(listen_fd);
+    return true;
+}
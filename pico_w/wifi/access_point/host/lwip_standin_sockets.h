@@ -0,0 +1,30 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _LWIP_STANDIN_SOCKETS_H
+#define _LWIP_STANDIN_SOCKETS_H
+
+// Connects the stand-in's TCP to the host's, so a server built against it
+// can be tried with real clients, e.g. a load generator on the same
+// machine. Each client the host accepts is offered to the listening pcb with
+// lwip_standin_tcp_connect, and refused with a reset if that fails. What the
+// client sends is delivered in TCP_MSS segments, and what the server writes
+// is acknowledged as soon as the host's socket takes it.
+//
+// The stand-in's clock follows the host's, and pcbs are polled every
+// pollinterval half seconds, as lwIP would.
+
+#include <signal.h>
+#include <stdbool.h>
+
+#include "lwip_standin.h"
+
+// Serve the pcb listening on port to clients on the same port of every host
+// address, until *stop is set, e.g. by a signal handler. Connections still
+// open then fail with ERR_ABRT. Returns false if the port can't be opened.
+bool lwip_standin_sockets_run(u16_t port, volatile sig_atomic_t *stop);
+
+#endif
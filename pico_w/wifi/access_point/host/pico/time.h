@@ -0,0 +1,22 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Stand-in for the SDK's header of the same name, for code built against
+// the lwIP stand-in that reads the time. The time is the stand-in's clock,
+// which only moves when the test moves it.
+
+#ifndef _PICO_TIME_H
+#define _PICO_TIME_H
+
+#include <stdint.h>
+
+#include "cyw43_config.h"
+
+static inline uint64_t time_us_64(void) {
+    return (uint64_t)cyw43_hal_ticks_ms() * 1000;
+}
+
+#endif
@@ -0,0 +1,242 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the web bundle built from web/ by make_web_bundle.py, served by
+// the HTTP server against the lwIP stand-in:
+//
+// - every file is found by its path, and a directory by its index.html; the
+//   uncompressed copies match the files, and the gzipped ones are gzip
+// - headers give the right length and encoding, and every response says
+//   Vary: Accept-Encoding
+// - clients get gzip only if their Accept-Encoding takes it, with q-values
+//   and "*" respected, and otherwise the uncompressed copy, or 406 Not
+//   Acceptable from a bundle built with no uncompressed copies
+// - each encoding has its own ETag, for If-None-Match
+//
+// Exits with 0 if every check passes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "httpserver.h"
+#include "lwip_standin.h"
+#include "web_bundle.h"
+
+#define PORT 80
+
+// The same files, built with --identity-max 0
+extern const web_bundle_t web_bundle_gzip_only;
+
+static const web_bundle_t *bundle;
+static http_server_t server;
+static int failures;
+static bool section_ok;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        section_ok = false; \
+    } \
+} while (0)
+
+static void section_end(const char *name) {
+    printf("%-32s %s\n", name, section_ok ? "ok" : "FAILED");
+    if (!section_ok) {
+        failures++;
+    }
+    section_ok = true;
+}
+
+// As picow_access_point.c serves it
+static bool bundle_lookup(const http_request_t *request, http_static_t *response) {
+    const web_bundle_entry_t *entry = web_bundle_find(bundle, request->path);
+    if (!entry) {
+        return false;
+    }
+    const web_bundle_variant_t *variant = web_bundle_variant(entry, request->accept_gzip);
+    *response = (http_static_t) {
+        .headers = variant->headers,
+        .headers_len = variant->headers_len,
+        .not_modified = variant->not_modified,
+        .not_modified_len = variant->not_modified_len,
+        .etag = variant->etag,
+        .content = web_bundle_content(bundle, variant),
+        .content_len = variant->length,
+        .gzip = variant == &entry->gzip,
+    };
+    return true;
+}
+
+static uint8_t *read_file(const char *path, size_t *len) {
+    char full[256];
+    snprintf(full, sizeof(full), "%s%s", WEB_DIR, path);
+    FILE *f = fopen(full, "rb");
+    if (!f) {
+        return NULL;
+    }
+    static uint8_t buf[65536];
+    *len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    return buf;
+}
+
+static void check_variant(const web_bundle_t *b, const web_bundle_variant_t *variant, bool gzip) {
+    char length[32];
+    snprintf(length, sizeof(length), "Content-Length: %lu\r\n", (unsigned long)variant->length);
+    CHECK(strlen(variant->headers) == variant->headers_len && strstr(variant->headers, length));
+    CHECK(strlen(variant->not_modified) == variant->not_modified_len);
+    CHECK(strstr(variant->headers, "\r\nVary: Accept-Encoding\r\n"));
+    CHECK(strstr(variant->not_modified, "\r\nVary: Accept-Encoding\r\n"));
+    CHECK(!strstr(variant->headers, "Content-Encoding: gzip") == !gzip);
+    CHECK(strstr(variant->headers, variant->etag) && strstr(variant->not_modified, variant->etag));
+    CHECK(variant->offset + variant->length <= b->data_len);
+    if (gzip) {
+        const uint8_t *content = web_bundle_content(b, variant);
+        CHECK(variant->length > 18 && content[0] == 0x1f && content[1] == 0x8b);
+    }
+}
+
+static void check_bundle(const web_bundle_t *b, bool identity_copies) {
+    CHECK(b->num_entries >= 3);
+    for (size_t i = 0; i < b->num_entries; ++i) {
+        const web_bundle_entry_t *entry = &b->entries[i];
+        CHECK(web_bundle_find(b, entry->path) == entry);
+        CHECK(entry->has_gzip || entry->has_identity);
+        if (entry->has_gzip) {
+            check_variant(b, &entry->gzip, true);
+            CHECK(identity_copies == entry->has_identity);
+        }
+        if (entry->has_identity) {
+            check_variant(b, &entry->identity, false);
+            // A directory's index.html stands for it
+            char path[128];
+            snprintf(path, sizeof(path), "%s%s", entry->path,
+                     entry->path[strlen(entry->path) - 1] == '/' ? "index.html" : "");
+            size_t len = 0;
+            const uint8_t *file = read_file(path, &len);
+            CHECK(file && len == entry->identity.length &&
+                  !memcmp(web_bundle_content(b, &entry->identity), file, len));
+        }
+        if (entry->has_gzip && entry->has_identity) {
+            CHECK(strcmp(entry->gzip.etag, entry->identity.etag) != 0);
+        }
+    }
+    CHECK(web_bundle_find(b, "/"));
+    CHECK(!web_bundle_find(b, "/nowhere.html") && !web_bundle_find(b, "") && !web_bundle_find(b, "/index.htm"));
+}
+
+static const char *get(struct tcp_pcb *pcb, const char *path, const char *headers) {
+    char request[256];
+    snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\n%s\r\n", path, headers);
+    pcb->out_len = 0;
+    lwip_standin_tcp_deliver(pcb, request, strlen(request), TCP_MSS);
+    lwip_standin_tcp_ack_all(pcb);
+    pcb->out[LWIP_MIN(pcb->out_len, sizeof(pcb->out) - 1)] = 0;
+    return pcb->out;
+}
+
+// Whether the response is the gzipped copy, and has the right body
+static bool got_gzip(struct tcp_pcb *pcb, const web_bundle_entry_t *entry) {
+    bool gzip = strstr(pcb->out, "Content-Encoding: gzip\r\n") != NULL;
+    const web_bundle_variant_t *variant = gzip ? &entry->gzip : &entry->identity;
+    CHECK(strstr(pcb->out, "HTTP/1.1 200 OK\r\n") && strstr(pcb->out, "Vary: Accept-Encoding\r\n"));
+    CHECK(pcb->out_len > variant->length &&
+          !memcmp(pcb->out + pcb->out_len - variant->length, web_bundle_content(bundle, variant), variant->length));
+    return gzip;
+}
+
+static void test_negotiation(void) {
+    bundle = &web_bundle;
+    err_t err;
+    struct tcp_pcb *c = lwip_standin_tcp_connect(PORT, &err);
+    const web_bundle_entry_t *index = web_bundle_find(bundle, "/");
+    CHECK(index->has_gzip && index->has_identity);
+
+    static const struct {
+        const char *headers;
+        bool gzip;
+    } cases[] = {
+        {"", false},
+        {"Accept-Encoding: gzip\r\n", true},
+        {"Accept-Encoding: gzip, deflate, br\r\n", true},
+        {"accept-encoding: GZIP\r\n", true},
+        {"Accept-Encoding: x-gzip\r\n", true},
+        {"Accept-Encoding: deflate;q=1.0, gzip;q=0.5\r\n", true},
+        {"Accept-Encoding: br,gzip\r\n", true},
+        {"Accept-Encoding: *\r\n", true},
+        {"Accept-Encoding: br, *;q=0.1\r\n", true},
+        {"Accept-Encoding: identity\r\n", false},
+        {"Accept-Encoding: deflate, br\r\n", false},
+        {"Accept-Encoding: gzip;q=0\r\n", false},
+        {"Accept-Encoding: gzip; q=0.000\r\n", false},
+        {"Accept-Encoding: *;q=0\r\n", false},
+        {"Accept-Encoding: gzip;q=0, *\r\n", false},
+        {"Accept-Encoding: *;q=0, gzip\r\n", true},
+        {"Accept-Encoding: gzipx, xgzip\r\n", false},
+        {"Accept-Encoding: \r\n", false},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        get(c, "/", cases[i].headers);
+        if (got_gzip(c, index) != cases[i].gzip) {
+            printf("wrong encoding for \"%s\"\n", cases[i].headers);
+            section_ok = false;
+        }
+    }
+
+    // Each encoding has its own ETag
+    char headers[128];
+    snprintf(headers, sizeof(headers), "If-None-Match: %s\r\n", index->identity.etag);
+    CHECK(strstr(get(c, "/", headers), "HTTP/1.1 304 Not Modified\r\n") && strstr(c->out, "Vary: Accept-Encoding"));
+    snprintf(headers, sizeof(headers), "Accept-Encoding: gzip\r\nIf-None-Match: %s\r\n", index->identity.etag);
+    get(c, "/", headers);
+    CHECK(got_gzip(c, index));
+    snprintf(headers, sizeof(headers), "Accept-Encoding: gzip\r\nIf-None-Match: %s\r\n", index->gzip.etag);
+    CHECK(strstr(get(c, "/", headers), "HTTP/1.1 304 Not Modified\r\n") && strstr(c->out, index->gzip.etag));
+    http_server_deinit(&server);
+    lwip_standin_tcp_free(c);
+    section_end("Accept-Encoding");
+}
+
+static void test_gzip_only(void) {
+    bundle = &web_bundle_gzip_only;
+    CHECK(http_server_init(&server, PORT, NULL, 0, NULL, NULL));
+    http_server_set_static_lookup(&server, bundle_lookup);
+    err_t err;
+    struct tcp_pcb *c = lwip_standin_tcp_connect(PORT, &err);
+    const web_bundle_entry_t *index = web_bundle_find(bundle, "/");
+    CHECK(index->has_gzip && !index->has_identity);
+    get(c, "/", "Accept-Encoding: gzip\r\n");
+    CHECK(got_gzip(c, index));
+
+    // Without gzip there's nothing to send, but the connection stays open
+    CHECK(strstr(get(c, "/", ""), "HTTP/1.1 406 Not Acceptable\r\nContent-Length: 0\r\n"));
+    CHECK(strstr(c->out, "Vary: Accept-Encoding\r\n") && !c->closed);
+    CHECK(strstr(get(c, "/", "Accept-Encoding: gzip;q=0\r\n"), "HTTP/1.1 406 "));
+    get(c, "/", "Accept-Encoding: *\r\n");
+    CHECK(got_gzip(c, index));
+    CHECK(strstr(get(c, "/nowhere", ""), "HTTP/1.1 404 "));
+    http_server_deinit(&server);
+    lwip_standin_tcp_free(c);
+    section_end("gzip only");
+}
+
+int main() {
+    section_ok = true;
+    check_bundle(&web_bundle, true);
+    check_bundle(&web_bundle_gzip_only, false);
+    section_end("bundle contents");
+
+    CHECK(http_server_init(&server, PORT, NULL, 0, NULL, NULL));
+    http_server_set_static_lookup(&server, bundle_lookup);
+    test_negotiation();
+    test_gzip_only();
+
+    CHECK(lwip_standin_stats.live_pbufs == 0 && lwip_standin_stats.tcp_live_pcbs == 0);
+    section_end("nothing leaked");
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
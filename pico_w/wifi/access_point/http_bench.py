@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+
+# Benchmark for the access point's web server.
+#
+# usage: python3 http_bench.py [--server 192.168.4.1] [--path /] [--clients N] [--seconds N] [--pipeline N]
+#
+# Run it on a computer connected to the picow_test access point. Each client
+# fetches the page over and over for the given time, first opening a new
+# connection for every request (Connection: close), then reusing one
+# connection (keep-alive), then sending --pipeline requests at a time on one
+# connection. For each it reports requests per second and the median and
+# 99th percentile time to answer a request.
+
+import argparse
+import socket
+import sys
+import threading
+import time
+
+
+def read_response(sock, buf):
+    """Read one response from sock. Returns (status, keep_alive, leftover data)."""
+    while b"\r\n\r\n" not in buf:
+        data = sock.recv(4096)
+        if not data:
+            raise ConnectionError("connection closed in headers")
+        buf += data
+    head, buf = buf.split(b"\r\n\r\n", 1)
+    lines = head.decode("latin-1").split("\r\n")
+    status = int(lines[0].split()[1])
+    length = 0
+    keep_alive = True
+    for line in lines[1:]:
+        name, _, value = line.partition(":")
+        name = name.strip().lower()
+        if name == "content-length":
+            length = int(value)
+        elif name == "connection" and value.strip().lower() == "close":
+            keep_alive = False
+    while len(buf) < length:
+        data = sock.recv(4096)
+        if not data:
+            raise ConnectionError("connection closed in body")
+        buf += data
+    return status, keep_alive, buf[length:]
+
+
+class Client(threading.Thread):
+    def __init__(self, args, mode, stop):
+        super().__init__()
+        self.args = args
+        self.mode = mode
+        self.stop = stop
+        self.latencies = []
+        self.errors = 0
+
+    def connect(self):
+        return socket.create_connection((self.args.server, 80), timeout=self.args.timeout)
+
+    def request(self, close):
+        return (f"GET {self.args.path} HTTP/1.1\r\nHost: {self.args.server}\r\nAccept-Encoding: gzip\r\n"
+                + ("Connection: close\r\n" if close else "") + "\r\n").encode()
+
+    def run(self):
+        sock = None
+        depth = self.args.pipeline if self.mode == "pipelined" else 1
+        while not self.stop.is_set():
+            try:
+                if sock is None:
+                    sock = self.connect()
+                start = time.monotonic()
+                sock.sendall(self.request(self.mode == "close") * depth)
+                buf = b""
+                for _ in range(depth):
+                    status, keep_alive, buf = read_response(sock, buf)
+                    if status >= 400:
+                        self.errors += 1
+                    self.latencies.append(time.monotonic() - start)
+                if self.mode == "close" or not keep_alive:
+                    sock.close()
+                    sock = None
+            except (OSError, ConnectionError, ValueError, IndexError):
+                self.errors += 1
+                if sock:
+                    sock.close()
+                sock = None
+        if sock:
+            sock.close()
+
+
+def bench(args, mode):
+    stop = threading.Event()
+    clients = [Client(args, mode, stop) for _ in range(args.clients)]
+    for client in clients:
+        client.start()
+    time.sleep(args.seconds)
+    stop.set()
+    for client in clients:
+        client.join()
+    latencies = sorted(l for client in clients for l in client.latencies)
+    errors = sum(client.errors for client in clients)
+    if not latencies:
+        print(f"{mode:>10}: no responses, {errors} errors")
+        return 0
+    print(f"{mode:>10}: {len(latencies) / args.seconds:7.1f} requests/s, "
+          f"median {latencies[len(latencies) // 2] * 1000:6.1f} ms, "
+          f"99th percentile {latencies[len(latencies) * 99 // 100] * 1000:6.1f} ms, {errors} errors")
+    return len(latencies)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Requests per second from a web server")
+    parser.add_argument("--server", default="192.168.4.1", help="address of the web server")
+    parser.add_argument("--path", default="/", help="page to fetch")
+    parser.add_argument("--clients", type=int, default=2, help="clients running at once")
+    parser.add_argument("--seconds", type=float, default=5, help="how long to run each test")
+    parser.add_argument("--pipeline", type=int, default=4, help="requests sent at a time when pipelining")
+    parser.add_argument("--timeout", type=float, default=5.0, help="seconds to wait for the server")
+    args = parser.parse_args()
+    total = 0
+    for mode in ("close", "keep-alive", "pipelined"):
+        total += bench(args, mode)
+    if not total:
+        sys.exit("No responses; is this computer connected to the access point?")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,589 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// A small HTTP/1.1 server. Connections are kept open between requests, and
+// requests can be pipelined: they are answered in order, each one once the
+// response to the one before has been handed to lwIP. Received data is only
+// acknowledged to lwIP as it is copied into a connection's request buffer,
+// so a client sending faster than we answer sees the TCP window close.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "httpserver.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+
+#define DEBUG_printf(...)
+#define ERROR_printf printf
+
+// tcp_poll interval, in lwIP's half second ticks
+#define POLL_INTERVAL 2
+#define POLLS_PER_SECOND 1
+
+#define DEFAULT_CONTENT_TYPE "text/html; charset=utf-8"
+#define HEADER_END "\r\n"
+#define HEADER_END_CLOSE "Connection: close\r\n\r\n"
+#define HEADER_END_KEEP_ALIVE "Connection: keep-alive\r\n\r\n"
+#define NOT_ACCEPTABLE "HTTP/1.1 406 Not Acceptable\r\nContent-Length: 0\r\nVary: Accept-Encoding\r\n"
+
+static const char *status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 406: return "Not Acceptable";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        default: return "";
+    }
+}
+
+static uint32_t etag_hash(const uint8_t *data, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool tx_pending(const http_connection_t *con) {
+    return con->tx_len[0] || con->tx_len[1] || con->tx_len[2];
+}
+
+static void connection_free(http_connection_t *con) {
+    if (con->rx_pending) {
+        pbuf_free(con->rx_pending);
+        con->rx_pending = NULL;
+    }
+    con->pcb = NULL;
+}
+
+// Returns ERR_ABRT if the connection had to be aborted, which callbacks must
+// pass back to lwIP
+static err_t connection_close(http_connection_t *con) {
+    struct tcp_pcb *pcb = con->pcb;
+    DEBUG_printf("HTTP: closing connection %d\n", (int)(con - con->server->connections));
+    tcp_arg(pcb, NULL);
+    tcp_poll(pcb, NULL, 0);
+    tcp_sent(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_err(pcb, NULL);
+    if (con->rx_pending) {
+        // lwIP resets rather than closes a connection with data it was never
+        // told we read
+        tcp_recved(pcb, con->rx_pending->tot_len);
+    }
+    connection_free(con);
+    err_t err = tcp_close(pcb);
+    if (err != ERR_OK) {
+        ERROR_printf("HTTP: close failed %d, calling abort\n", err);
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
+}
+
+// Hand as much of the response to lwIP as it will take. The rest is written
+// from the sent callback as the client acknowledges data.
+static err_t send_pending(http_connection_t *con) {
+    for (int i = 0; i < 3; ++i) {
+        while (con->tx_len[i]) {
+            uint16_t len = tcp_sndbuf(con->pcb);
+            if (len == 0) {
+                return ERR_OK;
+            }
+            if (len > con->tx_len[i]) {
+                len = con->tx_len[i];
+            }
+            uint8_t flags = con->tx_copy[i] ? TCP_WRITE_FLAG_COPY : 0;
+            if (len < con->tx_len[i] || (i < 2 && (con->tx_len[i + 1] || (i == 0 && con->tx_len[2])))) {
+                flags |= TCP_WRITE_FLAG_MORE;
+            }
+            err_t err = tcp_write(con->pcb, con->tx[i], len, flags);
+            if (err == ERR_MEM) {
+                // Out of queue space; try again once some is acknowledged
+                return ERR_OK;
+            }
+            if (err != ERR_OK) {
+                return err;
+            }
+            con->tx[i] = (const uint8_t *)con->tx[i] + len;
+            con->tx_len[i] -= len;
+            con->queued_len += len;
+        }
+    }
+    return ERR_OK;
+}
+
+// Offset of the end of the headers in buf, just after the blank line, or 0
+// if they are not all there yet. Bare LF line endings are accepted.
+static size_t find_headers_end(const char *buf, size_t len) {
+    for (size_t i = 0; i + 1 < len; ++i) {
+        if (buf[i] == '\n') {
+            if (buf[i + 1] == '\n') {
+                return i + 2;
+            }
+            if (i + 2 < len && buf[i + 1] == '\r' && buf[i + 2] == '\n') {
+                return i + 3;
+            }
+        }
+    }
+    return 0;
+}
+
+// Split off the next line in *buf, without its line ending
+static char *next_line(char **buf) {
+    char *line = *buf;
+    char *end = strchr(line, '\n');
+    if (end) {
+        *buf = end + 1;
+        if (end > line && end[-1] == '\r') {
+            --end;
+        }
+        *end = 0;
+    } else {
+        *buf = line + strlen(line);
+    }
+    return line;
+}
+
+// Whether an Accept-Encoding value takes gzip: it is listed, or "*" is and
+// gzip isn't, without q=0
+static bool accepts_gzip(const char *value) {
+    int gzip = -1;
+    int any = -1;
+    while (*value) {
+        value += strspn(value, " \t,");
+        size_t name_len = strcspn(value, " \t,;");
+        size_t len = strcspn(value, ",");
+        bool acceptable = true;
+        for (const char *param = value + name_len; param + 1 < value + len; ++param) {
+            if ((*param == 'q' || *param == 'Q') && param[1] == '=') {
+                acceptable = strtod(param + 2, NULL) > 0;
+                break;
+            }
+        }
+        if ((name_len == 4 && strncasecmp(value, "gzip", 4) == 0) ||
+            (name_len == 6 && strncasecmp(value, "x-gzip", 6) == 0)) {
+            gzip = acceptable;
+        } else if (name_len == 1 && value[0] == '*') {
+            any = acceptable;
+        }
+        value += len;
+    }
+    return gzip >= 0 ? gzip : any > 0;
+}
+
+// Parse the NUL terminated request in buf, in place. Returns 0, or the status
+// to answer a request we can't handle with.
+static int parse_request(char *buf, http_request_t *request, bool *http_1_0, bool *keep_alive,
+                         const char **if_none_match) {
+    char *line = next_line(&buf);
+    char *target = strchr(line, ' ');
+    if (!target) {
+        return 400;
+    }
+    *target++ = 0;
+    char *version = strchr(target, ' ');
+    if (!version) {
+        return 400;
+    }
+    *version++ = 0;
+    if (strncmp(version, "HTTP/1.", 7) != 0) {
+        return 400;
+    }
+    // HTTP/1.1 connections stay open unless they say otherwise, HTTP/1.0
+    // ones close
+    *http_1_0 = version[7] == '0';
+    *keep_alive = !*http_1_0;
+
+    if (strcmp(line, "HEAD") == 0) {
+        request->head = true;
+    } else if (strcmp(line, "GET") == 0) {
+        request->head = false;
+    } else {
+        return 501;
+    }
+
+    if (strncasecmp(target, "http://", 7) == 0) {
+        static char root_path[] = "/";
+        target = strchr(target + 7, '/');
+        if (!target) {
+            target = root_path;
+        }
+    }
+    if (target[0] != '/') {
+        return 400;
+    }
+    char *query = strchr(target, '?');
+    if (query) {
+        *query++ = 0;
+    }
+    request->path = target;
+    request->query = query;
+
+    request->accept_gzip = false;
+    *if_none_match = NULL;
+    while (*buf) {
+        char *name = next_line(&buf);
+        char *value = strchr(name, ':');
+        if (!value) {
+            continue;
+        }
+        *value++ = 0;
+        value += strspn(value, " \t");
+        if (strcasecmp(name, "Connection") == 0) {
+            if (strncasecmp(value, "close", 5) == 0) {
+                *keep_alive = false;
+            } else if (strncasecmp(value, "keep-alive", 10) == 0) {
+                *keep_alive = true;
+            }
+        } else if (strcasecmp(name, "If-None-Match") == 0) {
+            *if_none_match = value;
+        } else if (strcasecmp(name, "Accept-Encoding") == 0) {
+            request->accept_gzip = accepts_gzip(value);
+        }
+    }
+    return 0;
+}
+
+static void respond_static(http_connection_t *con, const http_static_t *response, const http_request_t *request,
+                           const char *if_none_match) {
+    if (response->gzip && !request->accept_gzip) {
+        con->tx[0] = NOT_ACCEPTABLE;
+        con->tx_len[0] = sizeof(NOT_ACCEPTABLE) - 1;
+    } else if (if_none_match && (strstr(if_none_match, response->etag) || strcmp(if_none_match, "*") == 0)) {
+        con->tx[0] = response->not_modified;
+        con->tx_len[0] = response->not_modified_len;
+    } else {
+        con->tx[0] = response->headers;
+        con->tx_len[0] = response->headers_len;
+        if (!request->head) {
+            con->tx[2] = response->content;
+            con->tx_len[2] = response->content_len;
+        }
+    }
+    con->tx_copy[0] = false;
+    con->tx_copy[2] = false;
+}
+
+static void respond_dynamic(http_connection_t *con, const http_response_t *response, bool head) {
+    size_t body_len = response->body_len < HTTP_MAX_BODY_LEN ? response->body_len : HTTP_MAX_BODY_LEN;
+    int len = snprintf(con->header, sizeof(con->header), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n%s%s%s",
+        response->status, status_text(response->status), response->content_type, (unsigned int)body_len,
+        response->location ? "Location: " : "", response->location ? response->location : "",
+        response->location ? "\r\n" : "");
+    if (len < 0 || len >= (int)sizeof(con->header)) {
+        ERROR_printf("HTTP: response headers too long\n");
+        len = snprintf(con->header, sizeof(con->header), "HTTP/1.1 500 %s\r\nContent-Length: 0\r\n", status_text(500));
+        body_len = 0;
+    }
+    con->tx[0] = con->header;
+    con->tx_len[0] = len;
+    con->tx_copy[0] = true;
+    if (!head && body_len) {
+        con->tx[2] = response->body;
+        con->tx_len[2] = body_len;
+        con->tx_copy[2] = true;
+    }
+}
+
+static void respond_error(http_connection_t *con, int status) {
+    http_response_t response = {
+        .status = status,
+        .content_type = DEFAULT_CONTENT_TYPE,
+    };
+    respond_dynamic(con, &response, false);
+}
+
+// Every response's headers leave off the end, so this can say whether the
+// connection stays open. HTTP/1.0 clients assume it doesn't unless told.
+static void end_headers(http_connection_t *con, bool keep_alive, bool http_1_0) {
+    if (keep_alive && http_1_0) {
+        con->tx[1] = HEADER_END_KEEP_ALIVE;
+        con->tx_len[1] = sizeof(HEADER_END_KEEP_ALIVE) - 1;
+    } else if (keep_alive) {
+        con->tx[1] = HEADER_END;
+        con->tx_len[1] = sizeof(HEADER_END) - 1;
+    } else {
+        con->tx[1] = HEADER_END_CLOSE;
+        con->tx_len[1] = sizeof(HEADER_END_CLOSE) - 1;
+        con->close_when_sent = true;
+    }
+    con->tx_copy[1] = false;
+}
+
+// Answer the request at the start of the request buffer, whose headers are
+// len bytes long
+static void handle_request(http_connection_t *con, size_t len) {
+    http_server_t *server = con->server;
+    char saved = con->request[len];
+    con->request[len] = 0;
+
+    http_request_t request;
+    bool http_1_0 = false;
+    bool keep_alive = false;
+    const char *if_none_match = NULL;
+    int status = parse_request(con->request, &request, &http_1_0, &keep_alive, &if_none_match);
+    if (status) {
+        DEBUG_printf("HTTP: bad request, status %d\n", status);
+        respond_error(con, status);
+        // We can't be sure where the next request starts
+        keep_alive = false;
+    } else {
+        DEBUG_printf("HTTP: %s %s\n", request.head ? "HEAD" : "GET", request.path);
+        const http_route_t *route = NULL;
+        for (size_t i = 0; i < server->num_routes; ++i) {
+            const http_route_t *r = &server->routes[i];
+            if (r->prefix ? strncmp(r->path, request.path, strlen(r->path)) == 0 : strcmp(r->path, request.path) == 0) {
+                route = r;
+                break;
+            }
+        }
+        http_static_t found;
+        if (route && route->content) {
+            respond_static(con, &server->headers[route - server->routes].response, &request, if_none_match);
+        } else if (!route && server->static_lookup && server->static_lookup(&request, &found)) {
+            respond_static(con, &found, &request, if_none_match);
+        } else {
+            http_handler_fn handler = route ? route->handler : server->fallback;
+            http_response_t response = {
+                .status = handler ? 200 : 404,
+                .content_type = route && route->content_type ? route->content_type : DEFAULT_CONTENT_TYPE,
+                .body = con->body,
+            };
+            if (handler) {
+                handler(server->arg, &request, &response);
+            }
+            respond_dynamic(con, &response, request.head);
+        }
+    }
+    end_headers(con, keep_alive, http_1_0);
+    con->request[len] = saved;
+}
+
+static void consume_request(http_connection_t *con, size_t len) {
+    con->request_len -= len;
+    memmove(con->request, con->request + len, con->request_len);
+}
+
+// Answer whatever requests we can, and close the connection if it's done
+static err_t connection_process(http_connection_t *con) {
+    while (!tx_pending(con) && !con->close_when_sent) {
+        // Take in as much of what has arrived as fits
+        if (con->rx_pending) {
+            uint16_t len = HTTP_MAX_REQUEST_LEN - con->request_len;
+            if (len > con->rx_pending->tot_len) {
+                len = con->rx_pending->tot_len;
+            }
+            if (len) {
+                pbuf_copy_partial(con->rx_pending, con->request + con->request_len, len, 0);
+                con->rx_pending = pbuf_free_header(con->rx_pending, len);
+                con->request_len += len;
+                tcp_recved(con->pcb, len);
+            }
+        }
+        // Clients may send blank lines between requests
+        size_t blank = 0;
+        while (blank < con->request_len && (con->request[blank] == '\r' || con->request[blank] == '\n')) {
+            ++blank;
+        }
+        consume_request(con, blank);
+
+        size_t len = find_headers_end(con->request, con->request_len);
+        if (len) {
+            handle_request(con, len);
+            consume_request(con, len);
+        } else if (con->request_len == HTTP_MAX_REQUEST_LEN) {
+            respond_error(con, 431);
+            end_headers(con, false, false);
+        } else {
+            if (con->rx_closed) {
+                // Nothing more is coming
+                con->close_when_sent = true;
+            }
+            break;
+        }
+    }
+
+    err_t err = send_pending(con);
+    if (err != ERR_OK) {
+        ERROR_printf("HTTP: failed to write response %d\n", err);
+        tcp_abort(con->pcb);
+        connection_free(con);
+        return ERR_ABRT;
+    }
+    if (con->close_when_sent && !tx_pending(con) && con->acked_len == con->queued_len) {
+        return connection_close(con);
+    }
+    tcp_output(con->pcb);
+    return ERR_OK;
+}
+
+static err_t http_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    http_connection_t *con = (http_connection_t *)arg;
+    con->acked_len += len;
+    con->idle_polls = 0;
+    return connection_process(con);
+}
+
+static err_t http_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    http_connection_t *con = (http_connection_t *)arg;
+    if (!p) {
+        DEBUG_printf("HTTP: client closed\n");
+        con->rx_closed = true;
+    } else if (err != ERR_OK || con->rx_closed) {
+        pbuf_free(p);
+        return ERR_OK;
+    } else if (con->rx_pending) {
+        pbuf_cat(con->rx_pending, p);
+    } else {
+        con->rx_pending = p;
+    }
+    con->idle_polls = 0;
+    return connection_process(con);
+}
+
+static err_t http_poll(void *arg, struct tcp_pcb *pcb) {
+    http_connection_t *con = (http_connection_t *)arg;
+    if (++con->idle_polls > HTTP_IDLE_TIMEOUT_S * POLLS_PER_SECOND) {
+        DEBUG_printf("HTTP: idle timeout\n");
+        return connection_close(con);
+    }
+    // Picks up writes that lwIP had no room for
+    return connection_process(con);
+}
+
+static void http_err(void *arg, err_t err) {
+    http_connection_t *con = (http_connection_t *)arg;
+    if (con) {
+        // lwIP has already freed the pcb
+        DEBUG_printf("HTTP: connection error %d\n", err);
+        connection_free(con);
+    }
+}
+
+static err_t http_accept(void *arg, struct tcp_pcb *pcb, err_t err) {
+    http_server_t *server = (http_server_t *)arg;
+    if (err != ERR_OK || !pcb) {
+        ERROR_printf("HTTP: failure in accept\n");
+        return ERR_VAL;
+    }
+    http_connection_t *con = NULL;
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; ++i) {
+        if (!server->connections[i].pcb) {
+            con = &server->connections[i];
+            break;
+        }
+    }
+    if (!con) {
+        // lwIP aborts the connection
+        DEBUG_printf("HTTP: too many connections\n");
+        return ERR_MEM;
+    }
+    memset(con, 0, offsetof(http_connection_t, header));
+    con->pcb = pcb;
+    con->server = server;
+
+    tcp_arg(pcb, con);
+    tcp_sent(pcb, http_sent);
+    tcp_recv(pcb, http_recv);
+    tcp_poll(pcb, http_poll, POLL_INTERVAL);
+    tcp_err(pcb, http_err);
+    // Responses are written whole, so there's nothing for Nagle to gather
+    tcp_nagle_disable(pcb);
+    return ERR_OK;
+}
+
+static bool build_route_headers(const http_route_t *route, http_route_headers_t *headers) {
+    snprintf(headers->etag, sizeof(headers->etag), "\"%08lx\"",
+        (unsigned long)etag_hash(route->content, route->content_len));
+    int ok_len = snprintf(headers->ok, sizeof(headers->ok),
+        "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %u\r\nETag: %s\r\nCache-Control: no-cache\r\n",
+        route->content_type ? route->content_type : DEFAULT_CONTENT_TYPE, (unsigned int)route->content_len,
+        headers->etag);
+    int not_modified_len = snprintf(headers->not_modified, sizeof(headers->not_modified),
+        "HTTP/1.1 304 Not Modified\r\nETag: %s\r\n", headers->etag);
+    if (ok_len < 0 || ok_len >= (int)sizeof(headers->ok) ||
+        not_modified_len < 0 || not_modified_len >= (int)sizeof(headers->not_modified)) {
+        return false;
+    }
+    headers->response = (http_static_t) {
+        .headers = headers->ok,
+        .headers_len = ok_len,
+        .not_modified = headers->not_modified,
+        .not_modified_len = not_modified_len,
+        .etag = headers->etag,
+        .content = route->content,
+        .content_len = route->content_len,
+    };
+    return true;
+}
+
+bool http_server_init(http_server_t *server, uint16_t port, const http_route_t *routes, size_t num_routes,
+                      http_handler_fn fallback, void *arg) {
+    memset(server, 0, sizeof(*server));
+    if (num_routes > HTTP_MAX_ROUTES) {
+        ERROR_printf("HTTP: too many routes\n");
+        return false;
+    }
+    server->routes = routes;
+    server->num_routes = num_routes;
+    server->fallback = fallback;
+    server->arg = arg;
+    for (size_t i = 0; i < num_routes; ++i) {
+        if (routes[i].content && !build_route_headers(&routes[i], &server->headers[i])) {
+            ERROR_printf("HTTP: headers too long for %s\n", routes[i].path);
+            return false;
+        }
+    }
+
+    struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb) {
+        ERROR_printf("HTTP: failed to create pcb\n");
+        return false;
+    }
+    err_t err = tcp_bind(pcb, IP_ANY_TYPE, port);
+    if (err != ERR_OK) {
+        ERROR_printf("HTTP: failed to bind to port %u\n", port);
+        tcp_close(pcb);
+        return false;
+    }
+    server->pcb = tcp_listen_with_backlog(pcb, HTTP_MAX_CONNECTIONS);
+    if (!server->pcb) {
+        ERROR_printf("HTTP: failed to listen\n");
+        tcp_close(pcb);
+        return false;
+    }
+    tcp_arg(server->pcb, server);
+    tcp_accept(server->pcb, http_accept);
+    return true;
+}
+
+void http_server_set_static_lookup(http_server_t *server, http_static_fn lookup) {
+    server->static_lookup = lookup;
+}
+
+void http_server_deinit(http_server_t *server) {
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; ++i) {
+        if (server->connections[i].pcb) {
+            connection_close(&server->connections[i]);
+        }
+    }
+    if (server->pcb) {
+        tcp_arg(server->pcb, NULL);
+        tcp_close(server->pcb);
+        server->pcb = NULL;
+    }
+}
@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HTTPSERVER_H_
+#define _HTTPSERVER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lwip/ip_addr.h"
+
+// Connections served at once; more are refused. Each one takes a TCP pcb, so
+// MEMP_NUM_TCP_PCB needs to allow for them.
+#ifndef HTTP_MAX_CONNECTIONS
+#define HTTP_MAX_CONNECTIONS 4
+#endif
+// Longest request line and headers
+#ifndef HTTP_MAX_REQUEST_LEN
+#define HTTP_MAX_REQUEST_LEN 512
+#endif
+// Longest body a handler can give
+#ifndef HTTP_MAX_BODY_LEN
+#define HTTP_MAX_BODY_LEN 512
+#endif
+// Routes with static content get their headers built at init
+#ifndef HTTP_MAX_ROUTES
+#define HTTP_MAX_ROUTES 8
+#endif
+#ifndef HTTP_MAX_HEADER_LEN
+#define HTTP_MAX_HEADER_LEN 192
+#endif
+// Connections with nothing happening are closed after this long
+#ifndef HTTP_IDLE_TIMEOUT_S
+#define HTTP_IDLE_TIMEOUT_S 10
+#endif
+
+typedef struct http_request_t_ {
+    // The path, without the query
+    const char *path;
+    // What follows '?' in the URL, or NULL
+    const char *query;
+    // A HEAD request, so any body will not be sent
+    bool head;
+    // The client's Accept-Encoding takes gzip
+    bool accept_gzip;
+} http_request_t;
+
+typedef struct http_response_t_ {
+    // 200 unless the handler changes it
+    int status;
+    // "text/html; charset=utf-8" unless the handler changes it
+    const char *content_type;
+    // Sent as a Location header, for redirects
+    const char *location;
+    // Buffer of HTTP_MAX_BODY_LEN bytes for the body, and how much of it the
+    // handler filled
+    char *body;
+    size_t body_len;
+} http_response_t;
+
+typedef void (*http_handler_fn)(void *arg, const http_request_t *request, http_response_t *response);
+
+// A response whose headers and content stay put for as long as the server
+// runs, so they are sent without being copied. The headers leave out the
+// blank line at the end, so Connection: close can follow.
+typedef struct http_static_t_ {
+    // Headers for 200 OK, and for 304 Not Modified
+    const char *headers;
+    uint16_t headers_len;
+    const char *not_modified;
+    uint16_t not_modified_len;
+    // Quoted, as it appears in the headers
+    const char *etag;
+    const void *content;
+    size_t content_len;
+    // The content is gzipped, so clients that don't accept gzip get 406 Not
+    // Acceptable instead
+    bool gzip;
+} http_static_t;
+
+// Finds static content for the request's path, e.g. in a bundle of files
+// built into the program, in an encoding the client accepts if there is one.
+// Returns false if there is none.
+typedef bool (*http_static_fn)(const http_request_t *request, http_static_t *response);
+
+// A path, with either content that stays put for as long as the server
+// runs (e.g. const data in flash), which is sent without being copied, or a
+// handler to generate a response for each request
+typedef struct http_route_t_ {
+    const char *path;
+    // Also match any path that starts with path, e.g. "/ledtest" matches
+    // "/ledtest/" and "/ledtest.html"
+    bool prefix;
+    const char *content_type;
+    const void *content;
+    size_t content_len;
+    http_handler_fn handler;
+} http_route_t;
+
+typedef struct http_connection_t_ {
+    struct tcp_pcb *pcb;
+    struct http_server_t_ *server;
+    // Data received but not yet copied to the request buffer
+    struct pbuf *rx_pending;
+    // Requests received, and how much of the buffer they fill
+    char request[HTTP_MAX_REQUEST_LEN + 1];
+    size_t request_len;
+    // The response still to be written to lwIP, in up to three pieces. Pieces
+    // in buffers that are reused before the client acknowledges them are
+    // copied by lwIP, the rest are only referenced.
+    const void *tx[3];
+    size_t tx_len[3];
+    bool tx_copy[3];
+    // Bytes given to lwIP and acknowledged by the client so far
+    uint32_t queued_len;
+    uint32_t acked_len;
+    // The client has finished sending
+    bool rx_closed;
+    // Close once everything queued is acknowledged
+    bool close_when_sent;
+    uint8_t idle_polls;
+    char header[HTTP_MAX_HEADER_LEN];
+    char body[HTTP_MAX_BODY_LEN];
+} http_connection_t;
+
+// Headers for a route with static content, and its ETag, built at init
+typedef struct http_route_headers_t_ {
+    http_static_t response;
+    char ok[HTTP_MAX_HEADER_LEN];
+    char not_modified[80];
+    char etag[12];
+} http_route_headers_t;
+
+typedef struct http_server_t_ {
+    struct tcp_pcb *pcb;
+    const http_route_t *routes;
+    size_t num_routes;
+    // Looks up paths that aren't routes, or NULL
+    http_static_fn static_lookup;
+    // Handles requests for any other path, or NULL to send 404
+    http_handler_fn fallback;
+    void *arg;
+    http_route_headers_t headers[HTTP_MAX_ROUTES];
+    http_connection_t connections[HTTP_MAX_CONNECTIONS];
+} http_server_t;
+
+// Start serving the routes on port. The routes are not copied. Returns false
+// if the server could not be started.
+bool http_server_init(http_server_t *server, uint16_t port, const http_route_t *routes, size_t num_routes,
+                      http_handler_fn fallback, void *arg);
+
+// Serve static content found by lookup for paths that aren't in the route
+// table, before trying the fallback handler
+void http_server_set_static_lookup(http_server_t *server, http_static_fn lookup);
+
+void http_server_deinit(http_server_t *server);
+
+#endif
@@ -7,4 +7,11 @@
 // This example uses a common include to avoid repetition
 #include "lwipopts_examples_common.h"
 
+// The web server keeps up to 4 connections open, and connections closed by
+// the server wait in TIME_WAIT for a while
+#define MEMP_NUM_TCP_PCB            8
+// Pages served straight from flash take a pbuf for each segment they're sent
+// in, rather than space in the heap
+#define MEMP_NUM_PBUF               32
+
 #endif
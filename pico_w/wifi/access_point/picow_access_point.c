@@ -9,264 +9,103 @@
 #include "pico/cyw43_arch.h"
 #include "pico/stdlib.h"
 
-#include "lwip/pbuf.h"
-#include "lwip/tcp.h"
-
 #include "dhcpserver.h"
 #include "dnsserver.h"
+#include "httpserver.h"
+#include "web_bundle.h"
 
 #define TCP_PORT 80
 #define DEBUG_printf printf
-#define POLL_TIME_S 5
-#define HTTP_GET "GET"
-#define HTTP_RESPONSE_HEADERS "HTTP/1.1 %d OK\nContent-Length: %d\nContent-Type: text/html; charset=utf-8\nConnection: close\n\n"
 #define LED_TEST_BODY "<html><body><h1>Hello from Pico W.</h1><p>Led is %s</p><p><a href=\"?led=%d\">Turn led %s</a></body></html>"
 #define LED_PARAM "led=%d"
+#define LED_PATH "/led"
 #define LED_TEST "/ledtest"
 #define LED_GPIO 0
-#define HTTP_RESPONSE_REDIRECT "HTTP/1.1 302 Redirect\nLocation: http://%s" LED_TEST "\n\n"
 
 typedef struct TCP_SERVER_T_ {
-    struct tcp_pcb *server_pcb;
+    http_server_t http;
     bool complete;
     ip_addr_t gw;
+    // Where requests for any other page are sent
+    char redirect[32];
 } TCP_SERVER_T;
 
-typedef struct TCP_CONNECT_STATE_T_ {
-    struct tcp_pcb *pcb;
-    int sent_len;
-    char headers[128];
-    char result[256];
-    int header_len;
-    int result_len;
-    ip_addr_t *gw;
-} TCP_CONNECT_STATE_T;
-
-static err_t tcp_close_client_connection(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *client_pcb, err_t close_err) {
-    if (client_pcb) {
-        assert(con_state && con_state->pcb == client_pcb);
-        tcp_arg(client_pcb, NULL);
-        tcp_poll(client_pcb, NULL, 0);
-        tcp_sent(client_pcb, NULL);
-        tcp_recv(client_pcb, NULL);
-        tcp_err(client_pcb, NULL);
-        err_t err = tcp_close(client_pcb);
-        if (err != ERR_OK) {
-            DEBUG_printf("close failed %d, calling abort\n", err);
-            tcp_abort(client_pcb);
-            close_err = ERR_ABRT;
-        }
-        if (con_state) {
-            free(con_state);
-        }
-    }
-    return close_err;
-}
-
-static void tcp_server_close(TCP_SERVER_T *state) {
-    if (state->server_pcb) {
-        tcp_arg(state->server_pcb, NULL);
-        tcp_close(state->server_pcb);
-        state->server_pcb = NULL;
-    }
-}
-
-static err_t tcp_server_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
-    TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg;
-    DEBUG_printf("tcp_server_sent %u\n", len);
-    con_state->sent_len += len;
-    if (con_state->sent_len >= con_state->header_len + con_state->result_len) {
-        DEBUG_printf("all done\n");
-        return tcp_close_client_connection(con_state, pcb, ERR_OK);
-    }
-    return ERR_OK;
-}
-
-static int test_server_content(const char *request, const char *params, char *result, size_t max_result_len) {
-    int len = 0;
-    if (strncmp(request, LED_TEST, sizeof(LED_TEST) - 1) == 0) {
-        // Get the state of the led
-        bool value;
-        cyw43_gpio_get(&cyw43_state, LED_GPIO, &value);
-        int led_state = value;
-
-        // See if the user changed it
-        if (params) {
-            int led_param = sscanf(params, LED_PARAM, &led_state);
-            if (led_param == 1) {
-                if (led_state) {
-                    // Turn led on
-                    cyw43_gpio_set(&cyw43_state, 0, true);
-                } else {
-                    // Turn led off
-                    cyw43_gpio_set(&cyw43_state, 0, false);
-                }
-            }
-        }
-        // Generate result
-        if (led_state) {
-            len = snprintf(result, max_result_len, LED_TEST_BODY, "ON", 0, "OFF");
-        } else {
-            len = snprintf(result, max_result_len, LED_TEST_BODY, "OFF", 1, "ON");
-        }
-    }
-    return len;
-}
-
-err_t tcp_server_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
-    TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg;
-    if (!p) {
-        DEBUG_printf("connection closed\n");
-        return tcp_close_client_connection(con_state, pcb, ERR_OK);
-    }
-    assert(con_state && con_state->pcb == pcb);
-    if (p->tot_len > 0) {
-        DEBUG_printf("tcp_server_recv %d err %d\n", p->tot_len, err);
-#if 0
-        for (struct pbuf *q = p; q != NULL; q = q->next) {
-            DEBUG_printf("in: %.*s\n", q->len, q->payload);
-        }
-#endif
-        // Copy the request into the buffer
-        pbuf_copy_partial(p, con_state->headers, p->tot_len > sizeof(con_state->headers) - 1 ? sizeof(con_state->headers) - 1 : p->tot_len, 0);
-
-        // Handle GET request
-        if (strncmp(HTTP_GET, con_state->headers, sizeof(HTTP_GET) - 1) == 0) {
-            char *request = con_state->headers + sizeof(HTTP_GET); // + space
-            char *params = strchr(request, '?');
-            if (params) {
-                if (*params) {
-                    char *space = strchr(request, ' ');
-                    *params++ = 0;
-                    if (space) {
-                        *space = 0;
-                    }
-                } else {
-                    params = NULL;
-                }
-            }
-
-            // Generate content
-            con_state->result_len = test_server_content(request, params, con_state->result, sizeof(con_state->result));
-            DEBUG_printf("Request: %s?%s\n", request, params);
-            DEBUG_printf("Result: %d\n", con_state->result_len);
-
-            // Check we had enough buffer space
-            if (con_state->result_len > sizeof(con_state->result) - 1) {
-                DEBUG_printf("Too much result data %d\n", con_state->result_len);
-                return tcp_close_client_connection(con_state, pcb, ERR_CLSD);
-            }
-
-            // Generate web page
-            if (con_state->result_len > 0) {
-                con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_HEADERS,
-                    200, con_state->result_len);
-                if (con_state->header_len > sizeof(con_state->headers) - 1) {
-                    DEBUG_printf("Too much header data %d\n", con_state->header_len);
-                    return tcp_close_client_connection(con_state, pcb, ERR_CLSD);
-                }
+// Get the state of the led, changing it first if the query asks to
+static bool led_update(const char *query) {
+    bool value;
+    cyw43_gpio_get(&cyw43_state, LED_GPIO, &value);
+    int led_state = value;
+
+    // See if the user changed it
+    if (query) {
+        int led_param = sscanf(query, LED_PARAM, &led_state);
+        if (led_param == 1) {
+            if (led_state) {
+                // Turn led on
+                cyw43_gpio_set(&cyw43_state, 0, true);
             } else {
-                // Send redirect
-                con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), HTTP_RESPONSE_REDIRECT,
-                    ipaddr_ntoa(con_state->gw));
-                DEBUG_printf("Sending redirect %s", con_state->headers);
-            }
-
-            // Send the headers to the client
-            con_state->sent_len = 0;
-            err_t err = tcp_write(pcb, con_state->headers, con_state->header_len, 0);
-            if (err != ERR_OK) {
-                DEBUG_printf("failed to write header data %d\n", err);
-                return tcp_close_client_connection(con_state, pcb, err);
-            }
-
-            // Send the body to the client
-            if (con_state->result_len) {
-                err = tcp_write(pcb, con_state->result, con_state->result_len, 0);
-                if (err != ERR_OK) {
-                    DEBUG_printf("failed to write result data %d\n", err);
-                    return tcp_close_client_connection(con_state, pcb, err);
-                }
+                // Turn led off
+                cyw43_gpio_set(&cyw43_state, 0, false);
             }
         }
-        tcp_recved(pcb, p->tot_len);
     }
-    pbuf_free(p);
-    return ERR_OK;
+    return led_state;
 }
 
-static err_t tcp_server_poll(void *arg, struct tcp_pcb *pcb) {
-    TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg;
-    DEBUG_printf("tcp_server_poll_fn\n");
-    return tcp_close_client_connection(con_state, pcb, ERR_OK); // Just disconnect clent?
+// The page itself is in web/, built into the program by make_web_bundle.py.
+// Its script fetches the led state from here, and changes it.
+static void led_handler(void *arg, const http_request_t *request, http_response_t *response) {
+    bool led_state = led_update(request->query);
+    response->content_type = "text/plain; charset=utf-8";
+    response->body_len = snprintf(response->body, HTTP_MAX_BODY_LEN, "%s", led_state ? "ON" : "OFF");
 }
 
-static void tcp_server_err(void *arg, err_t err) {
-    TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg;
-    if (err != ERR_ABRT) {
-        DEBUG_printf("tcp_client_err_fn %d\n", err);
-        tcp_close_client_connection(con_state, con_state->pcb, err);
+// The plain page from before there was a web bundle, for clients without
+// scripts, e.g. /ledtest?led=1
+static void led_test_handler(void *arg, const http_request_t *request, http_response_t *response) {
+    bool led_state = led_update(request->query);
+    if (led_state) {
+        response->body_len = snprintf(response->body, HTTP_MAX_BODY_LEN, LED_TEST_BODY, "ON", 0, "OFF");
+    } else {
+        response->body_len = snprintf(response->body, HTTP_MAX_BODY_LEN, LED_TEST_BODY, "OFF", 1, "ON");
     }
 }
 
-static err_t tcp_server_accept(void *arg, struct tcp_pcb *client_pcb, err_t err) {
-    TCP_SERVER_T *state = (TCP_SERVER_T*)arg;
-    if (err != ERR_OK || client_pcb == NULL) {
-        DEBUG_printf("failure in accept\n");
-        return ERR_VAL;
-    }
-    DEBUG_printf("client connected\n");
-
-    // Create the state for the connection
-    TCP_CONNECT_STATE_T *con_state = calloc(1, sizeof(TCP_CONNECT_STATE_T));
-    if (!con_state) {
-        DEBUG_printf("failed to allocate connect state\n");
-        return ERR_MEM;
+// Serve the files in the web bundle. They are sent straight from flash,
+// gzipped to clients that accept that, with headers built at compile time.
+static bool web_bundle_lookup(const http_request_t *request, http_static_t *response) {
+    const web_bundle_entry_t *entry = web_bundle_find(&web_bundle, request->path);
+    if (!entry) {
+        return false;
     }
-    con_state->pcb = client_pcb; // for checking
-    con_state->gw = &state->gw;
-
-    // setup connection to client
-    tcp_arg(client_pcb, con_state);
-    tcp_sent(client_pcb, tcp_server_sent);
-    tcp_recv(client_pcb, tcp_server_recv);
-    tcp_poll(client_pcb, tcp_server_poll, POLL_TIME_S * 2);
-    tcp_err(client_pcb, tcp_server_err);
-
-    return ERR_OK;
+    const web_bundle_variant_t *variant = web_bundle_variant(entry, request->accept_gzip);
+    *response = (http_static_t) {
+        .headers = variant->headers,
+        .headers_len = variant->headers_len,
+        .not_modified = variant->not_modified,
+        .not_modified_len = variant->not_modified_len,
+        .etag = variant->etag,
+        .content = web_bundle_content(&web_bundle, variant),
+        .content_len = variant->length,
+        .gzip = variant == &entry->gzip,
+    };
+    return true;
 }
 
-static bool tcp_server_open(void *arg) {
+// Anything else gets sent to the front page, so whatever a client asks for
+// after joining the access point shows it
+static void redirect_handler(void *arg, const http_request_t *request, http_response_t *response) {
     TCP_SERVER_T *state = (TCP_SERVER_T*)arg;
-    DEBUG_printf("starting server on port %u\n", TCP_PORT);
-
-    struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY);
-    if (!pcb) {
-        DEBUG_printf("failed to create pcb\n");
-        return false;
-    }
-
-    err_t err = tcp_bind(pcb, IP_ANY_TYPE, TCP_PORT);
-    if (err) {
-        DEBUG_printf("failed to bind to port %d\n");
-        return false;
-    }
-
-    state->server_pcb = tcp_listen_with_backlog(pcb, 1);
-    if (!state->server_pcb) {
-        DEBUG_printf("failed to listen\n");
-        if (pcb) {
-            tcp_close(pcb);
-        }
-        return false;
-    }
-
-    tcp_arg(state->server_pcb, state);
-    tcp_accept(state->server_pcb, tcp_server_accept);
-
-    return true;
+    DEBUG_printf("Sending redirect for %s\n", request->path);
+    response->status = 302;
+    response->location = state->redirect;
 }
 
+static const http_route_t http_routes[] = {
+    { .path = LED_PATH, .handler = led_handler },
+    { .path = LED_TEST, .prefix = true, .handler = led_test_handler },
+};
+
 int main() {
     stdio_init_all();
 
@@ -294,17 +133,29 @@ int main() {
     IP4_ADDR(ip_2_ip4(&mask), 255, 255, 255, 0);
 
     // Start the dhcp server
-    dhcp_server_t dhcp_server;
+    // The lease table is too big for the stack
+    static dhcp_server_t dhcp_server;
     dhcp_server_init(&dhcp_server, &state->gw, &mask);
 
-    // Start the dns server
-    dns_server_t dns_server;
+    // Start the dns server. As well as its own name, it answers for every
+    // other name with its own address, so any page a client asks for brings
+    // it to us.
+    static dns_server_t dns_server;
     dns_server_init(&dns_server, &state->gw);
+    dns_server_name_t dns_names[] = {
+        { .name = "picow.lan", .ip4 = *ip_2_ip4(&state->gw) },
+    };
+    if (!dns_server_set_names(&dns_server, dns_names, count_of(dns_names), true)) {
+        DEBUG_printf("failed to set dns names\n");
+        return 1;
+    }
 
-    if (!tcp_server_open(state)) {
+    snprintf(state->redirect, sizeof(state->redirect), "http://%s/", ipaddr_ntoa(&state->gw));
+    if (!http_server_init(&state->http, TCP_PORT, http_routes, count_of(http_routes), redirect_handler, state)) {
         DEBUG_printf("failed to open server\n");
         return 1;
     }
+    http_server_set_static_lookup(&state->http, web_bundle_lookup);
 
     while(!state->complete) {
         // the following #ifdef is only here so this same example can be used in multiple modes;
@@ -323,6 +174,7 @@ int main() {
         sleep_ms(1000);
 #endif
     }
+    http_server_deinit(&state->http);
     dns_server_deinit(&dns_server);
     dhcp_server_deinit(&dhcp_server);
     cyw43_arch_deinit();
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+
+# Builds the files in a directory into a C source file holding a web bundle:
+# the files, gzipped where that makes them smaller, and an index to find them
+# by path with a single hash lookup. Each file's ETag and HTTP response
+# headers are worked out here too, so the device only has to send them.
+#
+# usage: python3 make_web_bundle.py [--identity-max BYTES] [--name NAME] <directory> <output.c>
+#
+# Gzipped files up to --identity-max bytes (1024 by default) are kept as they
+# are too, for clients that don't accept gzip. Larger ones are only sent to
+# clients that do.
+#
+# The bundle is const, so it stays in flash. See web_bundle.h for the format.
+
+import argparse
+import copy
+import gzip
+import os
+import sys
+import zlib
+
+CONTENT_TYPES = {
+    ".html": "text/html; charset=utf-8",
+    ".htm": "text/html; charset=utf-8",
+    ".css": "text/css; charset=utf-8",
+    ".js": "text/javascript; charset=utf-8",
+    ".json": "application/json",
+    ".txt": "text/plain; charset=utf-8",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".jpg": "image/jpeg",
+    ".jpeg": "image/jpeg",
+    ".gif": "image/gif",
+    ".ico": "image/x-icon",
+    ".woff2": "font/woff2",
+}
+
+# Tries at finding a seed that hashes every path to its own slot
+MAX_SEEDS = 1 << 16
+
+DEFAULT_IDENTITY_MAX = 1024
+
+
+def path_hash(seed, path):
+    """Must match web_bundle_hash in web_bundle.c"""
+    h = 2166136261 ^ seed
+    for b in path.encode():
+        h = ((h ^ b) * 16777619) & 0xffffffff
+    h ^= h >> 16
+    h = (h * 0x45d9f3b) & 0xffffffff
+    h ^= h >> 16
+    return h
+
+
+def c_string(s):
+    out = '"'
+    for c in s:
+        if c == '"' or c == "\\":
+            out += "\\" + c
+        elif c == "\r":
+            out += "\\r"
+        elif c == "\n":
+            out += "\\n"
+        elif " " <= c <= "~":
+            out += c
+        else:
+            sys.exit(f"can't put {c!r} in a C string")
+    return out + '"'
+
+
+class Variant:
+    """One encoding of a file, with its own ETag and headers"""
+    def __init__(self, data, content_type, etag, gzipped):
+        self.data = data
+        self.etag = etag
+        vary = "Vary: Accept-Encoding\r\n"
+        self.headers = (f"HTTP/1.1 200 OK\r\nContent-Type: {content_type}\r\n"
+                        + ("Content-Encoding: gzip\r\n" if gzipped else "")
+                        + f"Content-Length: {len(data)}\r\nETag: {etag}\r\nCache-Control: no-cache\r\n{vary}")
+        self.not_modified = f"HTTP/1.1 304 Not Modified\r\nETag: {etag}\r\n{vary}"
+        self.offset = None
+
+
+class Entry:
+    def __init__(self, path, data, identity_max):
+        self.path = path
+        self.content_type = CONTENT_TYPES.get(os.path.splitext(path)[1].lower(), "application/octet-stream")
+        crc = zlib.crc32(data)
+        # mtime=0 so the same files always build the same bundle
+        compressed = gzip.compress(data, compresslevel=9, mtime=0)
+        self.gzip = None
+        self.identity = None
+        if len(compressed) < len(data):
+            self.gzip = Variant(compressed, self.content_type, f'"{crc:08x}-gz"', True)
+        if not self.gzip or len(data) <= identity_max:
+            self.identity = Variant(data, self.content_type, f'"{crc:08x}"', False)
+        self.original_length = len(data)
+
+    def variants(self):
+        return [v for v in (self.gzip, self.identity) if v]
+
+
+def find_files(directory):
+    files = []
+    for root, dirs, names in os.walk(directory):
+        dirs.sort()
+        for name in sorted(names):
+            full = os.path.join(root, name)
+            files.append(("/" + os.path.relpath(full, directory).replace(os.sep, "/"), full))
+    return files
+
+
+def find_seed(entries, num_slots):
+    for seed in range(MAX_SEEDS):
+        slots = [0] * num_slots
+        for i, entry in enumerate(entries):
+            slot = path_hash(seed, entry.path) & (num_slots - 1)
+            if slots[slot]:
+                break
+            slots[slot] = i + 1
+        else:
+            return seed, slots
+    sys.exit("couldn't find a hash seed that gives every path its own slot")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build a directory of web files into a C web bundle")
+    parser.add_argument("--identity-max", type=int, default=DEFAULT_IDENTITY_MAX,
+                        help="keep gzipped files up to this size as they are too")
+    parser.add_argument("--name", default="web_bundle", help="name of the web_bundle_t to define")
+    parser.add_argument("directory", help="directory of files to serve")
+    parser.add_argument("output", help="C source file to write")
+    args = parser.parse_args()
+
+    entries = []
+    data = b""
+    for path, full in find_files(args.directory):
+        with open(full, "rb") as f:
+            entry = Entry(path, f.read(), args.identity_max)
+        for variant in entry.variants():
+            variant.offset = len(data)
+            data += variant.data
+        entries.append(entry)
+        if os.path.basename(path) == "index.html":
+            # Also serve it for the directory; it shares the same data
+            alias = copy.copy(entry)
+            alias.path = path[:-len("index.html")]
+            entries.append(alias)
+    if len(entries) >= 0xffff:
+        sys.exit("too many files")
+
+    num_slots = 1
+    while num_slots < 2 * len(entries):
+        num_slots *= 2
+    seed, slots = find_seed(entries, num_slots)
+
+    with open(args.output, "w") as out:
+        out.write(f"// Built by make_web_bundle.py from {os.path.basename(os.path.abspath(args.directory))}/; do not edit\n\n")
+        out.write('#include "web_bundle.h"\n\n')
+        out.write("static const uint8_t bundle_data[] = {\n")
+        for i in range(0, len(data), 16):
+            out.write("    " + ", ".join(f"0x{b:02x}" for b in data[i:i + 16]) + ",\n")
+        if not data:
+            out.write("    0\n")
+        out.write("};\n\n")
+        out.write("static const web_bundle_entry_t bundle_entries[] = {\n")
+        for entry in entries:
+            out.write("    {\n")
+            out.write(f"        .path = {c_string(entry.path)},\n")
+            out.write(f"        .path_hash = 0x{path_hash(seed, entry.path):08x},\n")
+            out.write(f"        .content_type = {c_string(entry.content_type)},\n")
+            for name, variant in (("gzip", entry.gzip), ("identity", entry.identity)):
+                if not variant:
+                    continue
+                out.write(f"        .has_{name} = true,\n")
+                out.write(f"        .{name} = {{\n")
+                out.write(f"            .offset = {variant.offset},\n")
+                out.write(f"            .length = {len(variant.data)}, // {entry.original_length} bytes before gzip\n"
+                          if variant is entry.gzip else f"            .length = {len(variant.data)},\n")
+                out.write(f"            .etag = {c_string(variant.etag)},\n")
+                out.write(f"            .headers = {c_string(variant.headers)},\n")
+                out.write(f"            .headers_len = {len(variant.headers)},\n")
+                out.write(f"            .not_modified = {c_string(variant.not_modified)},\n")
+                out.write(f"            .not_modified_len = {len(variant.not_modified)},\n")
+                out.write("        },\n")
+            out.write("    },\n")
+        out.write("};\n\n")
+        out.write(f"static const uint16_t bundle_slots[{num_slots}] = {{\n")
+        out.write("    " + ", ".join(str(s) for s in slots) + "\n")
+        out.write("};\n\n")
+        out.write(f"const web_bundle_t {args.name} = {{\n")
+        out.write(f"    .seed = {seed},\n")
+        out.write(f"    .num_slots = {num_slots},\n")
+        out.write("    .slots = bundle_slots,\n")
+        out.write("    .entries = bundle_entries,\n")
+        out.write(f"    .num_entries = {len(entries)},\n")
+        out.write("    .data = bundle_data,\n")
+        out.write(f"    .data_len = {len(data)},\n")
+        out.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
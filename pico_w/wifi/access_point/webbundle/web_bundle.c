@@ -0,0 +1,38 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "web_bundle.h"
+
+// Must match path_hash in make_web_bundle.py
+uint32_t web_bundle_hash(uint32_t seed, const char *path) {
+    uint32_t h = 2166136261u ^ seed;
+    for (; *path; ++path) {
+        h = (h ^ (uint8_t)*path) * 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    return h;
+}
+
+const web_bundle_entry_t *web_bundle_find(const web_bundle_t *bundle, const char *path) {
+    if (!bundle->num_entries) {
+        return NULL;
+    }
+    uint32_t hash = web_bundle_hash(bundle->seed, path);
+    uint16_t slot = bundle->slots[hash & (bundle->num_slots - 1)];
+    if (!slot) {
+        return NULL;
+    }
+    // Paths that aren't in the bundle can land in any slot
+    const web_bundle_entry_t *entry = &bundle->entries[slot - 1];
+    if (entry->path_hash != hash || strcmp(entry->path, path) != 0) {
+        return NULL;
+    }
+    return entry;
+}
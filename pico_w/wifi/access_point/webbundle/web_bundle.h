@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _WEB_BUNDLE_H_
+#define _WEB_BUNDLE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// One encoding of a file, with its own ETag, as they must differ
+typedef struct web_bundle_variant_t_ {
+    // Where the contents are in the bundle's data
+    uint32_t offset;
+    uint32_t length;
+    // Quoted, as it appears in the headers
+    const char *etag;
+    // HTTP response headers for 200 OK, and for 304 Not Modified, each
+    // without the blank line at the end. Both have Vary: Accept-Encoding.
+    const char *headers;
+    uint16_t headers_len;
+    const char *not_modified;
+    uint16_t not_modified_len;
+} web_bundle_variant_t;
+
+// A file in the bundle. Everything here is worked out by make_web_bundle.py
+// at build time, and lives in flash with the file contents.
+typedef struct web_bundle_entry_t_ {
+    // e.g. "/index.html"; a directory's index.html can also be found as "/"
+    const char *path;
+    uint32_t path_hash;
+    const char *content_type;
+    // The file gzipped, if that makes it smaller
+    bool has_gzip;
+    web_bundle_variant_t gzip;
+    // The file as it is, if it isn't gzipped or is small enough that a copy
+    // is kept for clients that don't accept gzip
+    bool has_identity;
+    web_bundle_variant_t identity;
+} web_bundle_entry_t;
+
+typedef struct web_bundle_t_ {
+    // Seed for web_bundle_hash, chosen so that each path has its own slot
+    uint32_t seed;
+    // A power of 2
+    uint32_t num_slots;
+    // Index plus one of the entry in each slot, or 0
+    const uint16_t *slots;
+    const web_bundle_entry_t *entries;
+    size_t num_entries;
+    const uint8_t *data;
+    size_t data_len;
+} web_bundle_t;
+
+// The bundle built from the web directory
+extern const web_bundle_t web_bundle;
+
+// The hash make_web_bundle.py uses for paths
+uint32_t web_bundle_hash(uint32_t seed, const char *path);
+
+// Find the file with this path, or return NULL
+const web_bundle_entry_t *web_bundle_find(const web_bundle_t *bundle, const char *path);
+
+// The encoding of the file to send: gzipped if the client accepts that,
+// otherwise as it is if there is a copy, otherwise gzipped anyway, for the
+// server to refuse
+static inline const web_bundle_variant_t *web_bundle_variant(const web_bundle_entry_t *entry, bool accept_gzip) {
+    if (entry->has_gzip && (accept_gzip || !entry->has_identity)) {
+        return &entry->gzip;
+    }
+    return &entry->identity;
+}
+
+static inline const uint8_t *web_bundle_content(const web_bundle_t *bundle, const web_bundle_variant_t *variant) {
+    return bundle->data + variant->offset;
+}
+
+#endif
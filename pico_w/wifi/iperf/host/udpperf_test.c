@@ -0,0 +1,216 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of udpperf against the access point's stand-in for lwIP:
+//
+// - the UDP server counts lost and out of order datagrams, and answers the
+//   end of a test with the report iperf 2 expects, again each time iperf
+//   repeats it
+// - while a test runs, datagrams from anyone else are ignored unless they
+//   start a new test
+// - the latency test sends a request every UDP_PERF_LATENCY_INTERVAL_MS and
+//   reports the round trip times of the replies
+//
+// Exits with 0 if every check passes.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cyw43_config.h"
+#include "lwip_standin.h"
+#include "udpperf.h"
+
+// These should match udpperf.c
+#define DATAGRAM_HEADER_LEN 12
+#define HEADER_VERSION1 0x80000000
+#define REQUEST_LEN 16
+
+#define DATAGRAM_LEN 1470
+
+static int failures;
+static bool section_ok;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        section_ok = false; \
+    } \
+} while (0)
+
+static void section_end(const char *name) {
+    printf("%-32s %s\n", name, section_ok ? "ok" : "FAILED");
+    if (!section_ok) {
+        failures++;
+    }
+    section_ok = true;
+}
+
+static udp_perf_server_t server;
+static udp_perf_report_t final_report;
+static int interval_reports;
+static int final_reports;
+
+static void server_report(void *arg, const udp_perf_report_t *report) {
+    if (report->final) {
+        final_report = *report;
+        final_reports++;
+    } else {
+        interval_reports++;
+    }
+}
+
+static ip_addr_t client_a;
+static ip_addr_t client_b;
+
+// An iperf 2 datagram, stamped with the stand-in's clock
+static void send_datagram(const ip_addr_t *addr, u16_t port, int32_t id) {
+    uint8_t data[DATAGRAM_LEN] = {0};
+    uint32_t ms = cyw43_hal_ticks_ms();
+    uint32_t header[3] = {
+        lwip_htonl((uint32_t)id),
+        lwip_htonl(ms / 1000),
+        lwip_htonl((ms % 1000) * 1000),
+    };
+    memcpy(data, header, sizeof(header));
+    lwip_standin_udp_deliver(server.pcb, data, sizeof(data), addr, port);
+}
+
+// A field of the server report in the last datagram sent
+static uint32_t ack_field(int field) {
+    uint32_t value;
+    memcpy(&value, lwip_standin_sent.data + DATAGRAM_HEADER_LEN + field * 4, 4);
+    return lwip_ntohl(value);
+}
+
+enum { FLAGS, TOTAL_LEN1, TOTAL_LEN2, STOP_SEC, STOP_USEC, ERROR_CNT, OUTORDER_CNT, DATAGRAMS };
+
+static void test_loss(void) {
+    // Datagram 6 is lost, and 3 arrives late
+    static const int32_t ids[] = {0, 1, 2, 4, 5, 3, -7};
+    final_reports = 0;
+    interval_reports = 0;
+    uint32_t sent = lwip_standin_stats.datagrams_sent;
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+        send_datagram(&client_a, 40000, ids[i]);
+        lwip_standin_advance(300);
+    }
+    CHECK(final_reports == 1 && !server.running);
+    CHECK(final_report.datagrams == 7 && final_report.bytes == 7 * DATAGRAM_LEN);
+    CHECK(final_report.lost == 1 && final_report.out_of_order == 1);
+    CHECK(final_report.ms_duration == 1800);
+    CHECK(interval_reports == 2);
+
+    CHECK(lwip_standin_stats.datagrams_sent == sent + 1);
+    CHECK(ip_addr_cmp(&lwip_standin_sent.addr, &client_a) && lwip_standin_sent.port == 40000);
+    CHECK(lwip_standin_sent.len == DATAGRAM_LEN);
+    CHECK(ack_field(FLAGS) == HEADER_VERSION1);
+    CHECK(ack_field(TOTAL_LEN1) == 0 && ack_field(TOTAL_LEN2) == 7 * DATAGRAM_LEN);
+    CHECK(ack_field(STOP_SEC) == 1 && ack_field(STOP_USEC) == 800000);
+    CHECK(ack_field(ERROR_CNT) == 1 && ack_field(OUTORDER_CNT) == 1);
+    CHECK(ack_field(DATAGRAMS) == 8);
+
+    // iperf repeats the end until it hears back, and gets the same answer
+    lwip_standin_datagram_t ack = lwip_standin_sent;
+    memset(&lwip_standin_sent, 0, sizeof(lwip_standin_sent));
+    send_datagram(&client_a, 40000, -7);
+    CHECK(lwip_standin_stats.datagrams_sent == sent + 2 && final_reports == 1);
+    CHECK(lwip_standin_sent.len == ack.len &&
+          !memcmp(lwip_standin_sent.data + DATAGRAM_HEADER_LEN, ack.data + DATAGRAM_HEADER_LEN,
+                  ack.len - DATAGRAM_HEADER_LEN));
+    section_end("loss and the final report");
+}
+
+static void test_strays(void) {
+    final_reports = 0;
+    uint32_t sent = lwip_standin_stats.datagrams_sent;
+    send_datagram(&client_a, 40001, 0);
+    send_datagram(&client_a, 40001, 1);
+
+    // The tail of the last test, and another client mid-test
+    send_datagram(&client_a, 40000, -7);
+    send_datagram(&client_b, 40000, 5);
+    CHECK(server.running && server.client_port == 40001 && ip_addr_cmp(&server.client_addr, &client_a));
+    CHECK(server.total.datagrams == 2 && server.total.lost == 0);
+    CHECK(lwip_standin_stats.datagrams_sent == sent && final_reports == 0);
+    send_datagram(&client_a, 40001, 2);
+    CHECK(server.total.datagrams == 3 && server.total.lost == 0 && server.total.out_of_order == 0);
+
+    // A new test takes over from one whose end never arrived
+    send_datagram(&client_b, 40000, 0);
+    CHECK(server.running && server.client_port == 40000 && ip_addr_cmp(&server.client_addr, &client_b));
+    CHECK(server.total.datagrams == 1);
+    send_datagram(&client_b, 40000, -1);
+    CHECK(final_reports == 1 && final_report.datagrams == 2 && final_report.lost == 0);
+    CHECK(lwip_standin_stats.datagrams_sent == sent + 1);
+    CHECK(ip_addr_cmp(&lwip_standin_sent.addr, &client_b) && lwip_standin_sent.port == 40000);
+    section_end("stray datagrams");
+}
+
+static udp_perf_latency_t latency;
+static udp_perf_latency_report_t latency_result;
+static int latency_reports;
+
+static void latency_report(void *arg, const udp_perf_latency_report_t *report) {
+    latency_result = *report;
+    latency_reports++;
+}
+
+static void test_latency(void) {
+    CHECK(udp_perf_latency_start(&latency, &client_a, UDP_PERF_ECHO_PORT, latency_report, NULL));
+    uint32_t sent = lwip_standin_stats.datagrams_sent;
+    // Each request is echoed 3ms after it was sent
+    int requests = 0;
+    lwip_standin_advance(UDP_PERF_LATENCY_INTERVAL_MS);
+    while (!latency_reports) {
+        CHECK(lwip_standin_stats.datagrams_sent == sent + requests + 1);
+        CHECK(ip_addr_cmp(&lwip_standin_sent.addr, &client_a));
+        CHECK(lwip_standin_sent.port == UDP_PERF_ECHO_PORT && lwip_standin_sent.len == REQUEST_LEN);
+        lwip_standin_datagram_t request = lwip_standin_sent;
+        lwip_standin_advance(3);
+        lwip_standin_udp_deliver(latency.pcb, request.data, request.len, &client_a, UDP_PERF_ECHO_PORT);
+        requests++;
+        lwip_standin_advance(UDP_PERF_LATENCY_INTERVAL_MS - 3);
+    }
+    CHECK(requests > 0);
+    CHECK(latency_result.sent == (uint32_t)requests && latency_result.received == (uint32_t)requests);
+    CHECK(latency_result.p50_us == 3000 && latency_result.p99_us == 3000 && latency_result.max_us == 3000);
+    CHECK(latency_result.jitter_us == 0);
+    // 3000us is in the bucket up to 4096us
+    CHECK(udp_perf_histogram_limit_us(6) == 4096);
+    CHECK(latency_result.rtt_histogram[6] == (uint32_t)requests);
+    CHECK(latency_result.jitter_histogram[0] == (uint32_t)requests - 1);
+
+    // Replies that aren't to our requests are ignored
+    uint8_t bogus[REQUEST_LEN];
+    memset(bogus, 0xff, sizeof(bogus));
+    lwip_standin_udp_deliver(latency.pcb, bogus, sizeof(bogus), &client_a, UDP_PERF_ECHO_PORT);
+    CHECK(latency.report.received == 0);
+
+    udp_perf_latency_stop(&latency);
+    CHECK(lwip_standin_pending_timeouts() == 0 && !latency.pcb);
+    section_end("latency");
+}
+
+int main() {
+    section_ok = true;
+    IP4_ADDR(&client_a, 192, 168, 4, 2);
+    IP4_ADDR(&client_b, 192, 168, 4, 3);
+    lwip_standin_set_time(5000);
+    if (!udp_perf_server_init(&server, UDP_PERF_PORT, server_report, NULL)) {
+        printf("failed to start the server\n");
+        return 1;
+    }
+
+    test_loss();
+    test_strays();
+    test_latency();
+
+    udp_perf_server_deinit(&server);
+    CHECK(lwip_standin_stats.live_pbufs == 0);
+    section_end("nothing leaked");
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
@@ -7,4 +7,10 @@
 // This example uses a common include to avoid repetition
 #include "lwipopts_examples_common.h"
 
+// Keep track of the peak use of the heap and pools, which iperf_report prints
+#undef MEM_STATS
+#define MEM_STATS                   1
+#undef MEMP_STATS
+#define MEMP_STATS                  1
+
 #endif
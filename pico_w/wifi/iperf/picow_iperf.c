@@ -9,13 +9,35 @@
 
 #include "lwip/netif.h"
 #include "lwip/ip4_addr.h"
+#include "lwip/memp.h"
+#include "lwip/stats.h"
 #include "lwip/apps/lwiperf.h"
 
+#include "udpperf.h"
+
 #ifndef USE_LED
 #define USE_LED 1
 #endif
 
-#if CLIENT_TEST && !defined(IPERF_SERVER_IP)
+// Record what the main loop is doing with system/trace, and dump the trace
+// in binary after each iperf report for trace_to_json.py
+#ifndef USE_TRACE
+#define USE_TRACE 0
+#endif
+
+#if !USE_TRACE
+#define TRACE_ENABLED 0
+#endif
+#include "trace.h"
+
+TRACE_NAME(trace_poll, "cyw43_arch_poll");
+TRACE_NAME(trace_wait, "wait for work");
+TRACE_NAME(trace_led, "led");
+TRACE_NAME(trace_bandwidth, "kbit/s");
+
+// Set LATENCY_TEST to time UDP round trips to IPERF_SERVER_IP, which should run
+// "udp_perf.py --echo", instead of running iperf
+#if (CLIENT_TEST || LATENCY_TEST) && !defined(IPERF_SERVER_IP)
 #error IPERF_SERVER_IP not defined
 #endif
 
@@ -34,8 +56,63 @@ static void iperf_report(void *arg, enum lwiperf_report_type report_type,
 #if CYW43_USE_STATS
     printf("packets in %u packets out %u\n", CYW43_STAT_GET(PACKET_IN_COUNT), CYW43_STAT_GET(PACKET_OUT_COUNT));
 #endif
+#if MEM_STATS && MEMP_STATS
+    // The most of each pool the transfers have needed, to see what the profile could do without
+    printf("lwIP %s profile peaks: heap %u bytes, pbuf pool %u of %u, TCP segments %u of %u\n",
+           LWIP_EXAMPLE_PROFILE_NAME, (unsigned)lwip_stats.mem.max,
+           lwip_stats.memp[MEMP_PBUF_POOL]->max, (unsigned)PBUF_POOL_SIZE,
+           lwip_stats.memp[MEMP_TCP_SEG]->max, (unsigned)MEMP_NUM_TCP_SEG);
+    // The heap's peak plus every pool's, which profile_bench.py records
+    uint32_t peak_bytes = lwip_stats.mem.max;
+    for (int i = 0; i < MEMP_MAX; i++) {
+        if (lwip_stats.memp[i]) {
+            peak_bytes += lwip_stats.memp[i]->max * memp_pools[i]->size;
+        }
+    }
+    printf("lwIP peak RAM %u bytes\n", (unsigned)peak_bytes);
+#endif
+    trace_counter(trace_bandwidth, bandwidth_kbitpsec);
+#if USE_TRACE
+    trace_dump();
+#endif
 }
 
+// Report UDP results, every second while a test runs and once at the end
+static void udp_report(void *arg, const udp_perf_report_t *report) {
+    uint32_t expected = report->datagrams + report->lost;
+    float mbits = report->ms_duration ? report->bytes * 8 / 1000.0 / report->ms_duration : 0;
+    printf("%s %.1f s: %u datagrams @ %.1f Mbits/sec, lost %u/%u (%.2f%%), %u out of order, jitter %.3f ms\n",
+           report->final ? "Completed udp test of" : "udp", report->ms_duration / 1000.0, report->datagrams, mbits,
+           report->lost, expected, expected ? 100.0 * report->lost / expected : 0.0, report->out_of_order,
+           report->jitter_us / 1000.0);
+}
+
+#if LATENCY_TEST
+static void print_histogram(const char *name, const uint32_t *histogram) {
+    printf("  %s:", name);
+    for (int i = 0; i < UDP_PERF_HISTOGRAM_BUCKETS; i++) {
+        if (histogram[i]) {
+            uint32_t limit = udp_perf_histogram_limit_us(i);
+            if (limit) {
+                printf(" <%uus %u", limit, histogram[i]);
+            } else {
+                printf(" more %u", histogram[i]);
+            }
+        }
+    }
+    printf("\n");
+}
+
+// Report round trip times each second
+static void latency_report(void *arg, const udp_perf_latency_report_t *report) {
+    printf("rtt p50 %.3f ms, p99 %.3f ms, max %.3f ms, jitter %.3f ms, %u/%u replies\n",
+           report->p50_us / 1000.0, report->p99_us / 1000.0, report->max_us / 1000.0, report->jitter_us / 1000.0,
+           report->received, report->sent);
+    print_histogram("rtt", report->rtt_histogram);
+    print_histogram("jitter", report->jitter_histogram);
+}
+#endif
+
 int main() {
     stdio_init_all();
 
@@ -53,7 +130,15 @@ int main() {
     }
 
     cyw43_arch_lwip_begin();
-#if CLIENT_TEST
+#if LATENCY_TEST
+    printf("\nReady, timing udp round trips to %s port %d\n", xstr(IPERF_SERVER_IP), UDP_PERF_ECHO_PORT);
+    ip_addr_t peeraddr;
+    ip4_addr_set_u32(&peeraddr, ipaddr_addr(xstr(IPERF_SERVER_IP)));
+    static udp_perf_latency_t latency;
+    if (!udp_perf_latency_start(&latency, &peeraddr, UDP_PERF_ECHO_PORT, latency_report, NULL)) {
+        printf("failed to start latency test\n");
+    }
+#elif CLIENT_TEST
     printf("\nReady, running iperf client\n");
     ip_addr_t clientaddr;
     ip4_addr_set_u32(&clientaddr, ipaddr_addr(xstr(IPERF_SERVER_IP)));
@@ -61,6 +146,11 @@ int main() {
 #else
     printf("\nReady, running iperf server at %s\n", ip4addr_ntoa(netif_ip4_addr(netif_list)));
     lwiperf_start_tcp_server_default(&iperf_report, NULL);
+    // "iperf -u -c" tests go to the same port number, over UDP
+    static udp_perf_server_t udp_server;
+    if (!udp_perf_server_init(&udp_server, UDP_PERF_PORT, udp_report, NULL)) {
+        printf("failed to start udp server\n");
+    }
 #endif
     cyw43_arch_lwip_end();
 
@@ -72,6 +162,7 @@ int main() {
         // Invert the led
         if (absolute_time_diff_us(get_absolute_time(), led_time) < 0) {
             led_on = !led_on;
+            trace_instant(trace_led, led_on);
             cyw43_gpio_set(&cyw43_state, 0, led_on);
             led_time = make_timeout_time_ms(1000);
 
@@ -86,10 +177,14 @@ int main() {
 #if PICO_CYW43_ARCH_POLL
         // if you are using pico_cyw43_arch_poll, then you must poll periodically from your
         // main loop (not from a timer interrupt) to check for Wi-Fi driver or lwIP work that needs to be done.
+        trace_begin(trace_poll, 0);
         cyw43_arch_poll();
+        trace_end(trace_poll, 0);
         // you can poll as often as you like, however if you have nothing else to do you can
         // choose to sleep until either a specified time, or cyw43_arch_poll() has work to do:
+        trace_begin(trace_wait, 0);
         cyw43_arch_wait_for_work_until(led_time);
+        trace_end(trace_wait, 0);
 #else
         // if you are not using pico_cyw43_arch_poll, then WiFI driver and lwIP work
         // is done via interrupt in the background. This sleep is just an example of some (blocking)
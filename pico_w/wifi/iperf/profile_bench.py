@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+
+# Measures each lwIP memory profile in lwipopts_examples_common.h on a Pico W.
+#
+# usage: python3 profile_bench.py --serial /dev/ttyUSB0 --ssid <ssid> --password <password>
+#                                 [--profiles low_memory,balanced,max_throughput]
+#                                 [--seconds 10] [--build-dir build_profiles]
+#
+# For each profile it builds picow_iperf_server_background with
+# -DLWIP_EXAMPLE_PROFILE, loads it with "picotool load -x -f", reads the
+# Pico's address from its console, and runs "iperf -c <pico ip>" (iperf 2)
+# against it. The Pico's own report gives the Mbit/s, and the peak RAM that
+# lwIP's heap and pools used. The console is the Pico's UART at 115200 baud;
+# if picotool can't reboot the Pico, hold BOOTSEL when it asks.
+#
+# It prints a table of the results. They depend on the Wi-Fi network and the
+# machine running iperf, so they aren't kept in the tree.
+
+import argparse
+import os
+import re
+import select
+import subprocess
+import sys
+import termios
+import time
+
+PROFILES = ["low_memory", "balanced", "max_throughput"]
+TARGET = "picow_iperf_server_background"
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.normpath(os.path.join(HERE, "..", "..", ".."))
+
+READY = re.compile(r"Ready, running iperf server at (\d+\.\d+\.\d+\.\d+)")
+COMPLETED = re.compile(r"Completed iperf transfer of \d+ MBytes @ ([\d.]+) Mbits/sec")
+PEAKS = re.compile(r"lwIP (\w+) profile peaks: heap (\d+) bytes, pbuf pool (\d+) of (\d+), TCP segments (\d+) of (\d+)")
+PEAK_RAM = re.compile(r"lwIP peak RAM (\d+) bytes")
+
+ROW = "%-17s %-14s %-16s %-12s %s"
+
+
+class Console:
+    """The Pico's UART, read a line at a time"""
+
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDONLY | os.O_NOCTTY | os.O_NONBLOCK)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[0] = 0  # iflag
+        attrs[1] = 0  # oflag
+        attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        attrs[3] = 0  # lflag
+        attrs[4] = attrs[5] = termios.B115200
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        self.pending = b""
+
+    def flush(self):
+        termios.tcflush(self.fd, termios.TCIFLUSH)
+        self.pending = b""
+
+    def wait_for(self, pattern, timeout):
+        """Returns the match for the first line that matches, or None"""
+        deadline = time.monotonic() + timeout
+        while True:
+            while b"\n" in self.pending:
+                line, self.pending = self.pending.split(b"\n", 1)
+                text = line.decode("utf-8", "replace").strip()
+                print("  pico: %s" % text)
+                match = pattern.search(text)
+                if match:
+                    return match
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return None
+            if select.select([self.fd], [], [], remaining)[0]:
+                self.pending += os.read(self.fd, 4096)
+
+
+def run(cmd):
+    print("$ %s" % " ".join(cmd))
+    subprocess.run(cmd, check=True)
+
+
+def measure(args, console, profile):
+    build = os.path.join(args.build_dir, profile)
+    run(["cmake", "-S", REPO, "-B", build, "-DPICO_BOARD=pico_w", "-DLWIP_EXAMPLE_PROFILE=" + profile,
+         "-DWIFI_SSID=" + args.ssid, "-DWIFI_PASSWORD=" + args.password])
+    run(["cmake", "--build", build, "--target", TARGET, "-j%d" % (os.cpu_count() or 1)])
+    console.flush()
+    run(["picotool", "load", "-x", "-f", os.path.join(build, "pico_w", "wifi", "iperf", TARGET + ".uf2")])
+
+    ready = console.wait_for(READY, 60)
+    if not ready:
+        raise RuntimeError("%s: the Pico didn't connect to Wi-Fi" % profile)
+    run(["iperf", "-c", ready.group(1), "-t", str(args.seconds)])
+
+    completed = console.wait_for(COMPLETED, 10)
+    peaks = completed and console.wait_for(PEAKS, 5)
+    peak_ram = peaks and console.wait_for(PEAK_RAM, 5)
+    if not peak_ram:
+        raise RuntimeError("%s: no report from the Pico" % profile)
+    if peaks.group(1) != profile:
+        raise RuntimeError("%s: the Pico is running the %s profile" % (profile, peaks.group(1)))
+    return {
+        "mbits": float(completed.group(1)),
+        "heap": int(peaks.group(2)),
+        "pbufs": "%s of %s" % (peaks.group(3), peaks.group(4)),
+        "segs": "%s of %s" % (peaks.group(5), peaks.group(6)),
+        "ram": int(peak_ram.group(1)),
+    }
+
+
+def rows(results):
+    lines = [ROW % ("", "iperf TCP", "peak RAM", "peak pbufs", "peak TCP segments")]
+    for profile in PROFILES:
+        r = results.get(profile)
+        if r:
+            lines.append(ROW % (profile, "%.1f Mbit/s" % r["mbits"], "%d bytes" % r["ram"], r["pbufs"], r["segs"]))
+        else:
+            lines.append(ROW % (profile, "-", "-", "-", "-"))
+    return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure each lwIP profile with picow_iperf")
+    parser.add_argument("--serial", required=True, help="the Pico's UART, like /dev/ttyUSB0")
+    parser.add_argument("--ssid", default=os.environ.get("WIFI_SSID"), help="Wi-Fi network (default $WIFI_SSID)")
+    parser.add_argument("--password", default=os.environ.get("WIFI_PASSWORD"),
+                        help="Wi-Fi password (default $WIFI_PASSWORD)")
+    parser.add_argument("--profiles", default=",".join(PROFILES), help="comma separated profiles to measure")
+    parser.add_argument("--seconds", type=int, default=10, help="length of each iperf run")
+    parser.add_argument("--build-dir", default="build_profiles", help="where to build each profile")
+    args = parser.parse_args()
+
+    profiles = args.profiles.split(",")
+    for profile in profiles:
+        if profile not in PROFILES:
+            parser.error("unknown profile %s" % profile)
+    if not args.ssid or not args.password:
+        parser.error("give --ssid and --password, or set WIFI_SSID and WIFI_PASSWORD")
+
+    console = Console(args.serial)
+    results = {}
+    for profile in profiles:
+        results[profile] = measure(args, console, profile)
+    print("\n".join(rows(results)))
+
+
+if __name__ == "__main__":
+    main()
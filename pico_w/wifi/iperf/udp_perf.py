@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+
+# Host end of picow_iperf's UDP tests, for when iperf 2 isn't to hand.
+#
+# usage: python3 udp_perf.py <pico ip> [--rate 10M] [--seconds 10] [--length 1470]
+#        python3 udp_perf.py --echo
+#
+# With an address it sends an iperf 2 UDP test to the Pico at the given rate,
+# just as "iperf -u -c <pico ip> -b 10M" would, then prints the loss and jitter
+# the Pico reports back. With --echo it sends back every datagram it gets on
+# port 5002, for picow_iperf_latency.
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+# These constants should match udpperf.h
+UDP_PERF_PORT = 5001
+UDP_PERF_ECHO_PORT = 5002
+
+DATAGRAM = struct.Struct("!iII")
+SERVER_HDR = struct.Struct("!iiiiiiiiii")
+HEADER_VERSION1 = 0x80000000
+
+
+def parse_rate(rate):
+    units = {"k": 1e3, "K": 1e3, "m": 1e6, "M": 1e6, "g": 1e9, "G": 1e9}
+    if rate[-1] in units:
+        return float(rate[:-1]) * units[rate[-1]]
+    return float(rate)
+
+
+def datagram(length, packet_id):
+    now = time.time()
+    header = DATAGRAM.pack(packet_id, int(now), int((now % 1) * 1000000))
+    return header + bytes(length - len(header))
+
+
+def send_test(args):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.connect((args.server, UDP_PERF_PORT))
+    interval = args.length * 8 / parse_rate(args.rate)
+    start = time.monotonic()
+    next_send = start
+    next_report = start + 1
+    packet_id = 0
+    interval_count = 0
+    while time.monotonic() - start < args.seconds:
+        now = time.monotonic()
+        if now < next_send:
+            time.sleep(min(next_send - now, 0.001))
+            continue
+        try:
+            sock.send(datagram(args.length, packet_id))
+        except OSError:
+            # No buffer space; the rate is more than the network can take
+            pass
+        packet_id += 1
+        interval_count += 1
+        next_send += interval
+        if now >= next_report:
+            print("sent %d datagrams, %.1f Mbits/sec" % (interval_count, interval_count * args.length * 8 / 1e6))
+            interval_count = 0
+            next_report += 1
+    elapsed = time.monotonic() - start
+    print("sent %d datagrams in %.1f s, %.1f Mbits/sec" % (packet_id, elapsed, packet_id * args.length * 8 / elapsed / 1e6))
+
+    # End the test like iperf: repeat the final datagram until the Pico answers
+    sock.settimeout(0.25)
+    for _ in range(10):
+        sock.send(datagram(args.length, -packet_id))
+        try:
+            reply = sock.recv(65536)
+        except socket.timeout:
+            continue
+        if len(reply) < DATAGRAM.size + SERVER_HDR.size:
+            continue
+        (flags, len1, len2, stop_sec, stop_usec, lost, out_of_order, datagrams, jitter1,
+         jitter2) = SERVER_HDR.unpack_from(reply, DATAGRAM.size)
+        if not flags & HEADER_VERSION1:
+            continue
+        duration = stop_sec + stop_usec / 1e6
+        total = (len1 << 32) | (len2 & 0xffffffff)
+        print("pico received %d bytes in %.1f s, %.1f Mbits/sec, lost %d/%d (%.2f%%), %d out of order, jitter %.3f ms" % (
+            total, duration, total * 8 / duration / 1e6 if duration else 0, lost, datagrams,
+            100 * lost / datagrams if datagrams else 0, out_of_order, (jitter1 + jitter2 / 1e6) * 1000))
+        return True
+    print("no report from the pico")
+    return False
+
+
+def echo():
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", UDP_PERF_ECHO_PORT))
+    print("echoing datagrams on port %d" % UDP_PERF_ECHO_PORT)
+    while True:
+        data, addr = sock.recvfrom(65536)
+        sock.sendto(data, addr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="UDP tests for picow_iperf")
+    parser.add_argument("server", nargs="?", help="IP address of the Pico, like 1.2.3.4")
+    parser.add_argument("--echo", action="store_true", help="send back datagrams for the latency test")
+    parser.add_argument("--rate", default="10M", help="bits per second to send, like 500k or 10M")
+    parser.add_argument("--seconds", type=float, default=10, help="how long to send for")
+    parser.add_argument("--length", type=int, default=1470, help="size of each datagram")
+    args = parser.parse_args()
+
+    if args.echo:
+        echo()
+    elif not args.server:
+        parser.error("give the Pico's address, or --echo")
+    elif args.length < DATAGRAM.size + SERVER_HDR.size:
+        parser.error("--length must be at least %d" % (DATAGRAM.size + SERVER_HDR.size))
+    else:
+        sys.exit(0 if send_test(args) else 1)
+
+
+if __name__ == "__main__":
+    main()
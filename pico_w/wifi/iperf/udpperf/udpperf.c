@@ -0,0 +1,325 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "lwip/def.h"
+#include "lwip/pbuf.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+
+#include "udpperf.h"
+
+#define DEBUG_printf(...)
+
+// Header at the start of each iperf 2 UDP datagram, all in network order.
+// The id counts up from the start of the test, and is negated in the
+// datagrams that end it.
+typedef struct udp_perf_datagram_t_ {
+    int32_t id;
+    uint32_t tv_sec;
+    uint32_t tv_usec;
+} udp_perf_datagram_t;
+
+// Sent back after the header when the test ends, so iperf can print the
+// server's view of it
+typedef struct udp_perf_server_hdr_t_ {
+    int32_t flags;
+    int32_t total_len1;
+    int32_t total_len2;
+    int32_t stop_sec;
+    int32_t stop_usec;
+    int32_t error_cnt;
+    int32_t outorder_cnt;
+    int32_t datagrams;
+    int32_t jitter1;
+    int32_t jitter2;
+} udp_perf_server_hdr_t;
+
+#define HEADER_VERSION1 0x80000000
+
+// Sent to the echo peer, which sends it straight back
+typedef struct udp_perf_request_t_ {
+    uint32_t seq;
+    uint32_t reserved;
+    uint64_t sent_us;
+} udp_perf_request_t;
+
+uint32_t udp_perf_histogram_limit_us(int bucket) {
+    if (bucket >= UDP_PERF_HISTOGRAM_BUCKETS - 1) {
+        return 0;
+    }
+    return UDP_PERF_HISTOGRAM_FIRST_US << bucket;
+}
+
+static void histogram_add(uint32_t *histogram, uint32_t us) {
+    int bucket = 0;
+    while (bucket < UDP_PERF_HISTOGRAM_BUCKETS - 1 && us >= udp_perf_histogram_limit_us(bucket)) {
+        bucket++;
+    }
+    histogram[bucket]++;
+}
+
+static void server_start_test(udp_perf_server_t *server, const ip_addr_t *addr, u16_t port, uint64_t now_us) {
+    DEBUG_printf("udp test from %s:%u\n", ipaddr_ntoa(addr), port);
+    server->running = true;
+    ip_addr_copy(server->client_addr, *addr);
+    server->client_port = port;
+    server->next_id = 0;
+    server->jitter = 0;
+    server->start_us = now_us;
+    server->interval_start_us = now_us;
+    memset(&server->total, 0, sizeof(server->total));
+    memset(&server->interval, 0, sizeof(server->interval));
+}
+
+static void server_report(udp_perf_server_t *server, udp_perf_report_t *report, uint64_t start_us, uint64_t now_us) {
+    report->ms_duration = (uint32_t)((now_us - start_us) / 1000);
+    report->jitter_us = server->jitter >> 4;
+    if (server->report_fn) {
+        server->report_fn(server->arg, report);
+    }
+}
+
+// Answer the datagram ending a test with the server report, written over it
+static void server_send_ack(udp_perf_server_t *server, struct pbuf *p) {
+    if (p->len < sizeof(udp_perf_datagram_t) + sizeof(udp_perf_server_hdr_t)) {
+        return;
+    }
+    udp_perf_server_hdr_t *hdr = (udp_perf_server_hdr_t *)((uint8_t *)p->payload + sizeof(udp_perf_datagram_t));
+    const udp_perf_report_t *total = &server->total;
+    memset(hdr, 0, p->len - sizeof(udp_perf_datagram_t));
+    hdr->flags = lwip_htonl(HEADER_VERSION1);
+    hdr->total_len1 = lwip_htonl((uint32_t)(total->bytes >> 32));
+    hdr->total_len2 = lwip_htonl((uint32_t)total->bytes);
+    hdr->stop_sec = lwip_htonl(total->ms_duration / 1000);
+    hdr->stop_usec = lwip_htonl((total->ms_duration % 1000) * 1000);
+    hdr->error_cnt = lwip_htonl(total->lost);
+    hdr->outorder_cnt = lwip_htonl(total->out_of_order);
+    hdr->datagrams = lwip_htonl(server->next_id);
+    hdr->jitter1 = lwip_htonl(total->jitter_us / 1000000);
+    hdr->jitter2 = lwip_htonl(total->jitter_us % 1000000);
+    err_t err = udp_sendto(server->pcb, p, &server->client_addr, server->client_port);
+    if (err != ERR_OK) {
+        DEBUG_printf("failed to send udp report %d\n", err);
+    }
+}
+
+static void count_datagram(udp_perf_report_t *report, int32_t id, int32_t next_id, u16_t len) {
+    report->bytes += len;
+    report->datagrams++;
+    if (id >= next_id) {
+        report->lost += id - next_id;
+    } else {
+        report->out_of_order++;
+        if (report->lost) {
+            report->lost--;
+        }
+    }
+}
+
+static void server_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    udp_perf_server_t *server = (udp_perf_server_t *)arg;
+    uint64_t now_us = time_us_64();
+    udp_perf_datagram_t datagram;
+    if (pbuf_copy_partial(p, &datagram, sizeof(datagram), 0) != sizeof(datagram)) {
+        pbuf_free(p);
+        return;
+    }
+    int32_t id = (int32_t)lwip_ntohl((uint32_t)datagram.id);
+    bool from_client = port == server->client_port && ip_addr_cmp(addr, &server->client_addr);
+    if (!server->running && from_client && id < 0) {
+        // iperf repeats the end of the test until it hears back
+        server_send_ack(server, p);
+        pbuf_free(p);
+        return;
+    }
+    if (server->running && !from_client && id != 0) {
+        // Stray datagrams, e.g. the tail of an earlier test, don't count
+        // against the one running
+        pbuf_free(p);
+        return;
+    }
+    if (!server->running || !from_client) {
+        // A new test; iperf uses a new port each time, so one that ended
+        // without its final datagram arriving is given up on
+        server_start_test(server, addr, port, now_us);
+    }
+
+    if (now_us - server->interval_start_us >= UDP_PERF_REPORT_INTERVAL_MS * 1000ull) {
+        server_report(server, &server->interval, server->interval_start_us, now_us);
+        memset(&server->interval, 0, sizeof(server->interval));
+        server->interval_start_us = now_us;
+    }
+
+    bool final = id < 0;
+    if (final) {
+        id = -id;
+    }
+    count_datagram(&server->total, id, server->next_id, p->tot_len);
+    count_datagram(&server->interval, id, server->next_id, p->tot_len);
+    if (id >= server->next_id) {
+        server->next_id = id + 1;
+    }
+
+    // RFC 3550 jitter, from the change in transit time. The clocks aren't in
+    // step, but only the difference between transit times matters.
+    int64_t sent_us = (int64_t)lwip_ntohl(datagram.tv_sec) * 1000000 + lwip_ntohl(datagram.tv_usec);
+    int64_t transit_us = (int64_t)now_us - sent_us;
+    if (server->total.datagrams > 1) {
+        int64_t d = transit_us - server->last_transit_us;
+        if (d < 0) {
+            d = -d;
+        }
+        server->jitter += (uint32_t)d - ((server->jitter + 8) >> 4);
+    }
+    server->last_transit_us = transit_us;
+
+    if (final) {
+        server->running = false;
+        server->total.final = true;
+        if (server->interval.datagrams) {
+            server_report(server, &server->interval, server->interval_start_us, now_us);
+        }
+        server_report(server, &server->total, server->start_us, now_us);
+        server_send_ack(server, p);
+    }
+    pbuf_free(p);
+}
+
+bool udp_perf_server_init(udp_perf_server_t *server, uint16_t port, udp_perf_report_fn report_fn, void *arg) {
+    memset(server, 0, sizeof(*server));
+    server->report_fn = report_fn;
+    server->arg = arg;
+    server->pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!server->pcb) {
+        return false;
+    }
+    if (udp_bind(server->pcb, IP_ANY_TYPE, port) != ERR_OK) {
+        udp_remove(server->pcb);
+        server->pcb = NULL;
+        return false;
+    }
+    udp_recv(server->pcb, server_recv, server);
+    return true;
+}
+
+void udp_perf_server_deinit(udp_perf_server_t *server) {
+    if (server->pcb) {
+        udp_remove(server->pcb);
+        server->pcb = NULL;
+    }
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void latency_report(udp_perf_latency_t *latency, uint64_t now_us) {
+    udp_perf_latency_report_t *report = &latency->report;
+    report->sent = latency->seq - latency->interval_start_seq;
+    if (latency->num_samples) {
+        qsort(latency->samples, latency->num_samples, sizeof(latency->samples[0]), compare_u32);
+        report->p50_us = latency->samples[(latency->num_samples - 1) * 50 / 100];
+        report->p99_us = latency->samples[(latency->num_samples - 1) * 99 / 100];
+        report->max_us = latency->samples[latency->num_samples - 1];
+    }
+    report->jitter_us = latency->jitter_count ? (uint32_t)(latency->jitter_sum_us / latency->jitter_count) : 0;
+    if (latency->report_fn) {
+        latency->report_fn(latency->arg, report);
+    }
+    memset(report, 0, sizeof(*report));
+    latency->num_samples = 0;
+    latency->jitter_sum_us = 0;
+    latency->jitter_count = 0;
+    latency->interval_start_seq = latency->seq;
+    latency->interval_start_us = now_us;
+}
+
+static void latency_tick(void *arg) {
+    udp_perf_latency_t *latency = (udp_perf_latency_t *)arg;
+    sys_timeout(UDP_PERF_LATENCY_INTERVAL_MS, latency_tick, latency);
+
+    uint64_t now_us = time_us_64();
+    if (now_us - latency->interval_start_us >= UDP_PERF_REPORT_INTERVAL_MS * 1000ull) {
+        latency_report(latency, now_us);
+    }
+
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, sizeof(udp_perf_request_t), PBUF_RAM);
+    if (!p) {
+        DEBUG_printf("no memory for latency request\n");
+        return;
+    }
+    udp_perf_request_t *request = (udp_perf_request_t *)p->payload;
+    request->seq = latency->seq;
+    request->reserved = 0;
+    request->sent_us = time_us_64();
+    err_t err = udp_sendto(latency->pcb, p, &latency->peer_addr, latency->peer_port);
+    pbuf_free(p);
+    if (err == ERR_OK) {
+        latency->seq++;
+    } else {
+        DEBUG_printf("failed to send latency request %d\n", err);
+    }
+}
+
+static void latency_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    udp_perf_latency_t *latency = (udp_perf_latency_t *)arg;
+    uint64_t now_us = time_us_64();
+    udp_perf_request_t request;
+    if (pbuf_copy_partial(p, &request, sizeof(request), 0) != sizeof(request) ||
+        request.seq >= latency->seq || request.sent_us > now_us) {
+        // Not one of ours
+        pbuf_free(p);
+        return;
+    }
+    pbuf_free(p);
+
+    uint32_t rtt_us = (uint32_t)(now_us - request.sent_us);
+    udp_perf_latency_report_t *report = &latency->report;
+    report->received++;
+    if (latency->num_samples < UDP_PERF_LATENCY_MAX_SAMPLES) {
+        latency->samples[latency->num_samples++] = rtt_us;
+    }
+    histogram_add(report->rtt_histogram, rtt_us);
+    if (latency->last_rtt_us) {
+        uint32_t jitter_us = rtt_us > latency->last_rtt_us ? rtt_us - latency->last_rtt_us : latency->last_rtt_us - rtt_us;
+        histogram_add(report->jitter_histogram, jitter_us);
+        latency->jitter_sum_us += jitter_us;
+        latency->jitter_count++;
+    }
+    latency->last_rtt_us = rtt_us;
+}
+
+bool udp_perf_latency_start(udp_perf_latency_t *latency, const ip_addr_t *addr, uint16_t port,
+                            udp_perf_latency_report_fn report_fn, void *arg) {
+    memset(latency, 0, sizeof(*latency));
+    ip_addr_copy(latency->peer_addr, *addr);
+    latency->peer_port = port;
+    latency->report_fn = report_fn;
+    latency->arg = arg;
+    latency->pcb = udp_new_ip_type(IP_GET_TYPE(addr));
+    if (!latency->pcb) {
+        return false;
+    }
+    udp_recv(latency->pcb, latency_recv, latency);
+    latency->interval_start_us = time_us_64();
+    sys_timeout(UDP_PERF_LATENCY_INTERVAL_MS, latency_tick, latency);
+    return true;
+}
+
+void udp_perf_latency_stop(udp_perf_latency_t *latency) {
+    sys_untimeout(latency_tick, latency);
+    if (latency->pcb) {
+        udp_remove(latency->pcb);
+        latency->pcb = NULL;
+    }
+}
@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _UDPPERF_H_
+#define _UDPPERF_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lwip/ip_addr.h"
+
+// Port used by iperf for UDP tests, and by the echo peer for latency tests
+#define UDP_PERF_PORT 5001
+#define UDP_PERF_ECHO_PORT 5002
+
+// How often reports are made while a test runs
+#ifndef UDP_PERF_REPORT_INTERVAL_MS
+#define UDP_PERF_REPORT_INTERVAL_MS 1000
+#endif
+// How often the latency test sends a request
+#ifndef UDP_PERF_LATENCY_INTERVAL_MS
+#define UDP_PERF_LATENCY_INTERVAL_MS 10
+#endif
+// Round trip times kept per report, for the percentiles
+#ifndef UDP_PERF_LATENCY_MAX_SAMPLES
+#define UDP_PERF_LATENCY_MAX_SAMPLES 256
+#endif
+// Histogram buckets, each twice as wide as the last; the first is up to
+// 64us and the last holds everything beyond
+#define UDP_PERF_HISTOGRAM_BUCKETS 12
+#define UDP_PERF_HISTOGRAM_FIRST_US 64
+
+// Received by the UDP server, for one report interval or for a whole test
+typedef struct udp_perf_report_t_ {
+    // The test has finished, and this covers all of it
+    bool final;
+    uint32_t ms_duration;
+    uint64_t bytes;
+    uint32_t datagrams;
+    uint32_t lost;
+    uint32_t out_of_order;
+    // Smoothed variation in transit time, as RFC 3550 and iperf work it out
+    uint32_t jitter_us;
+} udp_perf_report_t;
+
+typedef void (*udp_perf_report_fn)(void *arg, const udp_perf_report_t *report);
+
+// Receives the datagrams of an iperf 2 UDP test ("iperf -u -c"), works out
+// the loss and jitter, and answers the end of the test with the report
+// iperf expects
+typedef struct udp_perf_server_t_ {
+    struct udp_pcb *pcb;
+    udp_perf_report_fn report_fn;
+    void *arg;
+    bool running;
+    ip_addr_t client_addr;
+    uint16_t client_port;
+    int32_t next_id;
+    int64_t last_transit_us;
+    // Jitter in 1/16 us, so the smoothing doesn't lose precision
+    uint32_t jitter;
+    uint64_t start_us;
+    udp_perf_report_t total;
+    udp_perf_report_t interval;
+    uint64_t interval_start_us;
+} udp_perf_server_t;
+
+// Round trip times for one report interval
+typedef struct udp_perf_latency_report_t_ {
+    uint32_t sent;
+    uint32_t received;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+    // Mean change in round trip time from one reply to the next
+    uint32_t jitter_us;
+    uint32_t rtt_histogram[UDP_PERF_HISTOGRAM_BUCKETS];
+    uint32_t jitter_histogram[UDP_PERF_HISTOGRAM_BUCKETS];
+} udp_perf_latency_report_t;
+
+typedef void (*udp_perf_latency_report_fn)(void *arg, const udp_perf_latency_report_t *report);
+
+// Sends a small request to an echo peer every UDP_PERF_LATENCY_INTERVAL_MS
+// and times the replies
+typedef struct udp_perf_latency_t_ {
+    struct udp_pcb *pcb;
+    ip_addr_t peer_addr;
+    uint16_t peer_port;
+    udp_perf_latency_report_fn report_fn;
+    void *arg;
+    uint32_t seq;
+    uint32_t interval_start_seq;
+    uint64_t interval_start_us;
+    uint32_t last_rtt_us;
+    uint64_t jitter_sum_us;
+    uint32_t jitter_count;
+    uint32_t num_samples;
+    uint32_t samples[UDP_PERF_LATENCY_MAX_SAMPLES];
+    udp_perf_latency_report_t report;
+} udp_perf_latency_t;
+
+// Listen for iperf UDP tests on port. Returns false if that fails.
+bool udp_perf_server_init(udp_perf_server_t *server, uint16_t port, udp_perf_report_fn report_fn, void *arg);
+void udp_perf_server_deinit(udp_perf_server_t *server);
+
+// Start timing requests to the echo peer at addr:port. Returns false if that fails.
+bool udp_perf_latency_start(udp_perf_latency_t *latency, const ip_addr_t *addr, uint16_t port,
+                            udp_perf_latency_report_fn report_fn, void *arg);
+void udp_perf_latency_stop(udp_perf_latency_t *latency);
+
+// Upper limit of a histogram bucket in us, or 0 for the last, unlimited one
+uint32_t udp_perf_histogram_limit_us(int bucket);
+
+#endif
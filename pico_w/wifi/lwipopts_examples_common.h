@@ -5,6 +5,42 @@
 // Common settings used in most of the pico_w examples
 // (see https://www.nongnu.org/lwip/2_1_x/group__lwip__opts.html for details)
 
+// Memory profile, chosen with -DLWIP_EXAMPLE_PROFILE=low_memory|balanced|max_throughput
+// when running CMake. Most of lwIP's RAM is the pbuf pool, which holds the
+// received packets, so the TCP window can be no bigger than the pool allows.
+//
+//                   heap    pbuf pool   TCP window / send buffer   heap + pools
+// low_memory        4000    8           2 * TCP_MSS                ~16 KB
+// balanced          4000    24          8 * TCP_MSS                ~40 KB
+// max_throughput    32000   40          16 * TCP_MSS               ~92 KB
+//
+// picow_iperf prints the peak use of each, to see how much a profile needs.
+// iperf/profile_bench.py builds and loads it with each profile in turn, runs
+// iperf against it, and prints the Mbit/s and peak RAM of each.
+#if LWIP_EXAMPLE_PROFILE_LOW_MEMORY
+#define LWIP_EXAMPLE_PROFILE_NAME   "low_memory"
+#define MEM_SIZE                    4000
+#define PBUF_POOL_SIZE              8
+#define TCP_WND                     (2 * TCP_MSS)
+#define TCP_SND_BUF                 (2 * TCP_MSS)
+#define MEMP_NUM_TCP_SEG            8
+#elif LWIP_EXAMPLE_PROFILE_MAX_THROUGHPUT
+#define LWIP_EXAMPLE_PROFILE_NAME   "max_throughput"
+// Big enough to hold a full send buffer of copied data
+#define MEM_SIZE                    32000
+#define PBUF_POOL_SIZE              40
+#define TCP_WND                     (16 * TCP_MSS)
+#define TCP_SND_BUF                 (16 * TCP_MSS)
+#define MEMP_NUM_TCP_SEG            64
+#else
+#define LWIP_EXAMPLE_PROFILE_NAME   "balanced"
+#define MEM_SIZE                    4000
+#define PBUF_POOL_SIZE              24
+#define TCP_WND                     (8 * TCP_MSS)
+#define TCP_SND_BUF                 (8 * TCP_MSS)
+#define MEMP_NUM_TCP_SEG            32
+#endif
+
 // allow override in some examples
 #ifndef NO_SYS
 #define NO_SYS                      1
@@ -20,17 +56,12 @@
 #define MEM_LIBC_MALLOC             0
 #endif
 #define MEM_ALIGNMENT               4
-#define MEM_SIZE                    4000
-#define MEMP_NUM_TCP_SEG            32
 #define MEMP_NUM_ARP_QUEUE          10
-#define PBUF_POOL_SIZE              24
 #define LWIP_ARP                    1
 #define LWIP_ETHERNET               1
 #define LWIP_ICMP                   1
 #define LWIP_RAW                    1
-#define TCP_WND                     (8 * TCP_MSS)
 #define TCP_MSS                     1460
-#define TCP_SND_BUF                 (8 * TCP_MSS)
 #define TCP_SND_QUEUELEN            ((4 * (TCP_SND_BUF) + (TCP_MSS - 1)) / (TCP_MSS))
 #define LWIP_NETIF_STATUS_CALLBACK  1
 #define LWIP_NETIF_LINK_CALLBACK    1
@@ -1,47 +1,125 @@
 #!/usr/bin/python
 
+# Connects to picow_tcp_server and echoes back what it sends.
+#
+# usage: python_test_tcp_client.py <server ip> [--clients N] [--seconds N]
+#                                   [--port N] [--timeout S]
+#
+# On its own it runs the test once. With --clients it becomes a load
+# generator: N clients run the test over and over, each on a new connection,
+# for --seconds, and the throughput of all of them together is reported.
+
+import argparse
 import socket
 import sys
-
-# Check server ip address set
-if len(sys.argv) < 2:
-    raise RuntimeError('pass IP address of the server')
-
-# Set the server address here like 1.2.3.4
-SERVER_ADDR = sys.argv[1]
+import threading
+import time
 
 # These constants should match the server
 BUF_SIZE = 2048
 SERVER_PORT = 4242
 TEST_ITERATIONS = 10
+# The server gives up on a client after 5 s with nothing happening
+TIMEOUT_S = 10
+
+
+def run_test(server_addr, verbose, port=SERVER_PORT, timeout=TIMEOUT_S):
+    """Run one test on a new connection. Returns the number of bytes moved."""
+    # Open socket to the server. It is closed however the test ends, and a
+    # server that stops responding raises socket.timeout.
+    with socket.socket() as sock:
+        sock.settimeout(timeout)
+        sock.connect((server_addr, port))
+
+        # Repeat test for a number of iterations
+        for test_iteration in range(TEST_ITERATIONS):
+
+            # Read BUF_SIZE bytes from the server
+            total_size = BUF_SIZE
+            read_buf = b''
+            while total_size > 0:
+                buf = sock.recv(BUF_SIZE)
+                if not buf:
+                    raise RuntimeError('server closed the connection')
+                if verbose:
+                    print('read %d bytes from server' % len(buf))
+                total_size -= len(buf)
+                read_buf += buf
+
+            # Check size of data received
+            if len(read_buf) != BUF_SIZE:
+                raise RuntimeError('wrong amount of data read %d', len(read_buf))
+
+            # Send the data back to the server
+            sock.sendall(read_buf)
+            if verbose:
+                print('written %d bytes to server' % len(read_buf))
+
+        # The server closes the connection once it has checked the last buffer
+        if sock.recv(1):
+            raise RuntimeError('server sent more data than expected')
+    return 2 * BUF_SIZE * TEST_ITERATIONS
+
+
+class LoadClient(threading.Thread):
+    def __init__(self, server_addr, port, timeout, stop):
+        super().__init__()
+        self.server_addr = server_addr
+        self.port = port
+        self.timeout = timeout
+        self.stop = stop
+        self.bytes = 0
+        self.passed = 0
+        self.failed = 0
+
+    def run(self):
+        while not self.stop.is_set():
+            try:
+                self.bytes += run_test(self.server_addr, False, self.port, self.timeout)
+                self.passed += 1
+            except (OSError, RuntimeError):
+                # Refused when all the server's connections are busy. A
+                # timeout is an OSError too.
+                self.failed += 1
+                time.sleep(0.01)
+
+
+def load_test(server_addr, port, timeout, clients, seconds):
+    stop = threading.Event()
+    threads = [LoadClient(server_addr, port, timeout, stop) for _ in range(clients)]
+    start = time.monotonic()
+    for thread in threads:
+        thread.start()
+    time.sleep(seconds)
+    stop.set()
+    for thread in threads:
+        thread.join()
+    elapsed = time.monotonic() - start
+    total = sum(thread.bytes for thread in threads)
+    passed = sum(thread.passed for thread in threads)
+    failed = sum(thread.failed for thread in threads)
+    print('%d clients: %d tests passed, %d failed or refused in %.1f s' % (clients, passed, failed, elapsed))
+    print('throughput %.1f KB/s, %.1f tests/s' % (total / elapsed / 1000, passed / elapsed))
+    return passed > 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Test client for picow_tcp_server')
+    parser.add_argument('server', help='IP address of the server, like 1.2.3.4')
+    parser.add_argument('--clients', type=int, help='run a load test with this many clients at once')
+    parser.add_argument('--seconds', type=float, default=10, help='how long to run the load test')
+    parser.add_argument('--port', type=int, default=SERVER_PORT, help='port the server listens on')
+    parser.add_argument('--timeout', type=float, default=TIMEOUT_S,
+                        help='seconds to wait for the server before giving up')
+    args = parser.parse_args()
+
+    if args.clients:
+        sys.exit(0 if load_test(args.server, args.port, args.timeout, args.clients, args.seconds) else 1)
+
+    run_test(args.server, True, args.port, args.timeout)
+    # All done
+    print("test completed")
+
 
-# Open socket to the server
-sock = socket.socket()
-addr = (SERVER_ADDR, SERVER_PORT)
-sock.connect(addr)
-
-# Repeat test for a number of iterations
-for test_iteration in range(TEST_ITERATIONS):
-
-    # Read BUF_SIZE bytes from the server
-    total_size = BUF_SIZE
-    read_buf = b''
-    while total_size > 0:
-        buf = sock.recv(BUF_SIZE)
-        print('read %d bytes from server' % len(buf))
-        total_size -= len(buf)
-        read_buf += buf
-
-    # Check size of data received
-    if len(read_buf) != BUF_SIZE:
-        raise RuntimeError('wrong amount of data read %d', len(read_buf))
-
-    # Send the data back to the server
-    write_len = sock.send(read_buf)
-    print('written %d bytes to server' % write_len)
-    if write_len != BUF_SIZE:
-        raise RuntimeError('wrong amount of data written')
-
-# All done
-sock.close()
-print("test completed")
+if __name__ == '__main__':
+    main()
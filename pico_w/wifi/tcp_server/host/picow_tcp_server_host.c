@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// picow_tcp_server's test, served by the TCP server library on the build
+// machine: the stand-in for lwIP takes clients on port 4242 from the host's
+// TCP, so python_test_tcp_client.py can load-test it without a Pico W.
+//
+// usage: picow_tcp_server_host [--seconds N]
+//
+// Runs until interrupted, or for N seconds. Prints a summary every 16
+// clients, and exits with 0 if at least one client passed and none failed.
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lwip_standin_sockets.h"
+#include "tcpserver.h"
+
+// These should match picow_tcp_server.c
+#define TCP_PORT 4242
+#define BUF_SIZE 2048
+#define TEST_ITERATIONS 10
+#define REPORT_EVERY 16
+
+typedef struct client_t_ {
+    uint8_t buffer_sent[BUF_SIZE];
+    uint8_t buffer_recv[BUF_SIZE];
+    bool sent;
+    int recv_len;
+    int run_count;
+    uint32_t random;
+} client_t;
+
+static tcp_server_t server;
+static client_t clients[TCP_SERVER_MAX_CONNECTIONS];
+static uint32_t passed;
+static uint32_t failed;
+static uint64_t bytes;
+static double report_time;
+static volatile sig_atomic_t stop;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void result(tcp_server_connection_t *con, int status) {
+    if (status == 0) {
+        passed++;
+    } else {
+        printf("client %d: test failed %d\n", tcp_server_connection_index(con), status);
+        failed++;
+    }
+    if ((passed + failed) % REPORT_EVERY == 0) {
+        double t = now();
+        printf("%u clients passed, %u failed, %u refused; %.1f KB/s over the last %d\n", (unsigned int)passed,
+               (unsigned int)failed, (unsigned int)server.refused, bytes / (t - report_time) / 1000, REPORT_EVERY);
+        bytes = 0;
+        report_time = t;
+    }
+}
+
+static err_t finish(tcp_server_connection_t *con, int status) {
+    result(con, status);
+    return tcp_server_close(con);
+}
+
+static err_t send_data(tcp_server_connection_t *con) {
+    client_t *client = &clients[tcp_server_connection_index(con)];
+    uint32_t x = client->random;
+    for (int i = 0; i < BUF_SIZE; i += 4) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        memcpy(&client->buffer_sent[i], &x, 4);
+    }
+    client->random = x;
+    client->sent = false;
+    client->recv_len = 0;
+    if (tcp_server_send(con, client->buffer_sent, BUF_SIZE) != ERR_OK) {
+        return finish(con, -1);
+    }
+    return ERR_OK;
+}
+
+static err_t check(tcp_server_connection_t *con) {
+    client_t *client = &clients[tcp_server_connection_index(con)];
+    if (client->recv_len < BUF_SIZE || !client->sent) {
+        return ERR_OK;
+    }
+    if (memcmp(client->buffer_sent, client->buffer_recv, BUF_SIZE) != 0) {
+        return finish(con, -1);
+    }
+    bytes += 2 * BUF_SIZE;
+    if (++client->run_count >= TEST_ITERATIONS) {
+        return finish(con, 0);
+    }
+    return send_data(con);
+}
+
+static err_t echo_connected(void *arg, tcp_server_connection_t *con) {
+    client_t *client = &clients[tcp_server_connection_index(con)];
+    client->run_count = 0;
+    client->random = (uint32_t)rand() | 1;
+    return send_data(con);
+}
+
+static err_t echo_sent(void *arg, tcp_server_connection_t *con) {
+    clients[tcp_server_connection_index(con)].sent = true;
+    return check(con);
+}
+
+static err_t echo_recv(void *arg, tcp_server_connection_t *con, const struct pbuf *p) {
+    client_t *client = &clients[tcp_server_connection_index(con)];
+    if (p->tot_len > BUF_SIZE - client->recv_len) {
+        return finish(con, -1);
+    }
+    client->recv_len += pbuf_copy_partial(p, client->buffer_recv + client->recv_len, p->tot_len, 0);
+    return check(con);
+}
+
+static void echo_closed(void *arg, tcp_server_connection_t *con, err_t err) {
+    result(con, err);
+}
+
+static const tcp_server_callbacks_t callbacks = {
+    .connected = echo_connected,
+    .recv = echo_recv,
+    .sent = echo_sent,
+    .closed = echo_closed,
+};
+
+static void on_signal(int sig) {
+    stop = 1;
+}
+
+int main(int argc, char **argv) {
+    unsigned int seconds = 0;
+    if (argc == 3 && !strcmp(argv[1], "--seconds")) {
+        seconds = atoi(argv[2]);
+    } else if (argc != 1) {
+        fprintf(stderr, "usage: %s [--seconds N]\n", argv[0]);
+        return 2;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGALRM, on_signal);
+    alarm(seconds);
+
+    if (!tcp_server_init(&server, TCP_PORT, &callbacks, NULL)) {
+        return 1;
+    }
+    printf("Serving picow_tcp_server's test on port %u\n", TCP_PORT);
+    fflush(stdout);
+    report_time = now();
+    bool ok = lwip_standin_sockets_run(TCP_PORT, &stop);
+    tcp_server_deinit(&server);
+
+    printf("%u clients passed, %u failed, %u refused\n", (unsigned int)passed, (unsigned int)failed,
+           (unsigned int)server.refused);
+    return ok && passed && !failed ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the TCP server library against the lwIP stand-in:
+//
+// - buffers are sent without being copied, limited to the send buffer, with
+//   the rest written as the client acknowledges data, and the sent callback
+//   comes once all of it is acknowledged
+// - writes lwIP has no room for are retried from the poll callback
+// - received data is passed to tcp_recved and freed straight away
+// - clients beyond TCP_SERVER_MAX_CONNECTIONS are refused, and a closed
+//   connection's slot is reused
+// - the application hears when the client closes, the connection fails or
+//   is idle too long, and can close the connection from any callback
+//
+// Exits with 0 if every check passes.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lwip_standin.h"
+#include "tcpserver.h"
+
+#define PORT 4242
+
+static tcp_server_t server;
+static int failures;
+static bool section_ok;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        section_ok = false; \
+    } \
+} while (0)
+
+static void section_end(const char *name) {
+    printf("%-32s %s\n", name, section_ok ? "ok" : "FAILED");
+    if (!section_ok) {
+        failures++;
+    }
+    section_ok = true;
+}
+
+// What the application saw, and what it does next
+static struct {
+    int connected;
+    int sent;
+    int closed;
+    err_t closed_err;
+    uint8_t received[8192];
+    size_t received_len;
+    // Close the connection from the next callback
+    bool close_in_callback;
+} app;
+
+static uint8_t data[4096];
+
+static err_t app_connected(void *arg, tcp_server_connection_t *con) {
+    CHECK(arg == &app);
+    app.connected++;
+    return app.close_in_callback ? tcp_server_close(con) : ERR_OK;
+}
+
+static err_t app_recv(void *arg, tcp_server_connection_t *con, const struct pbuf *p) {
+    // Already passed to tcp_recved
+    CHECK(con->pcb->rcv_unrecved == 0);
+    app.received_len += pbuf_copy_partial(p, app.received + app.received_len, p->tot_len, 0);
+    return app.close_in_callback ? tcp_server_close(con) : ERR_OK;
+}
+
+static err_t app_sent(void *arg, tcp_server_connection_t *con) {
+    app.sent++;
+    return app.close_in_callback ? tcp_server_close(con) : ERR_OK;
+}
+
+static void app_closed(void *arg, tcp_server_connection_t *con, err_t err) {
+    CHECK(!con->pcb);
+    app.closed++;
+    app.closed_err = err;
+}
+
+static const tcp_server_callbacks_t callbacks = {
+    .connected = app_connected,
+    .recv = app_recv,
+    .sent = app_sent,
+    .closed = app_closed,
+};
+
+static tcp_server_connection_t *connection_for(struct tcp_pcb *pcb) {
+    for (int i = 0; i < TCP_SERVER_MAX_CONNECTIONS; ++i) {
+        if (server.connections[i].pcb == pcb) {
+            return &server.connections[i];
+        }
+    }
+    return NULL;
+}
+
+static struct tcp_pcb *open_connection(void) {
+    memset(&app, 0, sizeof(app));
+    err_t err;
+    struct tcp_pcb *pcb = lwip_standin_tcp_connect(PORT, &err);
+    CHECK(pcb && err == ERR_OK && app.connected == 1);
+    return pcb;
+}
+
+static void test_send(void) {
+    struct tcp_pcb *pcb = open_connection();
+    tcp_server_connection_t *con = connection_for(pcb);
+    lwip_standin_stats_t before = lwip_standin_stats;
+    CHECK(tcp_server_send(con, data, sizeof(data)) == ERR_OK);
+    CHECK(tcp_server_send(con, data, 10) == ERR_INPROGRESS);
+    CHECK(tcp_server_send(con, data, 0) == ERR_INPROGRESS);
+    lwip_standin_tcp_ack_all(pcb);
+    CHECK(pcb->out_len == sizeof(data) && !memcmp(pcb->out, data, sizeof(data)));
+    CHECK(app.sent == 1);
+    CHECK(lwip_standin_stats.tcp_copied_writes == before.tcp_copied_writes);
+    CHECK(lwip_standin_stats.tcp_ref_writes > before.tcp_ref_writes);
+
+    // The next buffer can go from the sent callback
+    CHECK(tcp_server_send(con, data, 0) == ERR_ARG);
+    CHECK(tcp_server_send(con, data + 1, 100) == ERR_OK);
+    pcb->out_len = 0;
+    lwip_standin_tcp_ack_all(pcb);
+    CHECK(pcb->out_len == 100 && !memcmp(pcb->out, data + 1, 100) && app.sent == 2);
+    CHECK(tcp_server_close(con) == ERR_OK && pcb->closed && !con->pcb);
+    CHECK(tcp_server_send(con, data, 10) == ERR_CONN);
+    lwip_standin_tcp_free(pcb);
+    section_end("send without copying");
+}
+
+static void test_back_pressure(void) {
+    struct tcp_pcb *pcb = open_connection();
+    tcp_server_connection_t *con = connection_for(pcb);
+    pcb->snd_buf_size = 700;
+    CHECK(tcp_server_send(con, data, 2048) == ERR_OK);
+    CHECK(pcb->snd_queued == 700 && con->queued_len == 700);
+    // Each acknowledgement makes room for more
+    lwip_standin_tcp_ack(pcb, 700);
+    CHECK(con->queued_len == 1400 && app.sent == 0);
+    lwip_standin_tcp_ack(pcb, 700);
+    CHECK(con->queued_len == 2048 && app.sent == 0);
+    lwip_standin_tcp_ack(pcb, 648);
+    CHECK(app.sent == 1 && pcb->out_len == 2048 && !memcmp(pcb->out, data, 2048));
+
+    // Out of segments: nothing is written until the poll
+    pcb->out_len = 0;
+    pcb->snd_buf_size = TCP_SND_BUF;
+    pcb->snd_queuelen_max = 0;
+    CHECK(tcp_server_send(con, data, 1000) == ERR_OK && con->queued_len == 0);
+    pcb->snd_queuelen_max = TCP_SND_QUEUELEN;
+    CHECK(lwip_standin_tcp_poll(pcb) == ERR_OK && con->queued_len == 1000);
+    lwip_standin_tcp_ack_all(pcb);
+    CHECK(app.sent == 2 && pcb->out_len == 1000);
+    lwip_standin_tcp_error(pcb, ERR_RST);
+    CHECK(app.closed == 1 && app.closed_err == ERR_RST && !con->pcb);
+    section_end("back-pressure");
+}
+
+static void test_recv(void) {
+    struct tcp_pcb *pcb = open_connection();
+    char request[3000];
+    memset(request, 'r', sizeof(request));
+    int32_t live = lwip_standin_stats.live_pbufs;
+    CHECK(lwip_standin_tcp_deliver(pcb, request, sizeof(request), TCP_MSS) == ERR_OK);
+    CHECK(app.received_len == sizeof(request) && !memcmp(app.received, request, sizeof(request)));
+    CHECK(pcb->rcv_unrecved == 0 && lwip_standin_stats.live_pbufs == live);
+
+    // Closing from the callback doesn't reset the connection, as the data
+    // was already taken
+    uint32_t resets = lwip_standin_stats.tcp_resets;
+    app.close_in_callback = true;
+    CHECK(lwip_standin_tcp_deliver(pcb, "x", 1, TCP_MSS) == ERR_OK);
+    CHECK(pcb->closed && lwip_standin_stats.tcp_resets == resets && app.closed == 0);
+    CHECK(lwip_standin_stats.live_pbufs == live);
+    lwip_standin_tcp_free(pcb);
+    section_end("receive");
+}
+
+static void test_pool(void) {
+    struct tcp_pcb *pcbs[TCP_SERVER_MAX_CONNECTIONS];
+    for (int i = 0; i < TCP_SERVER_MAX_CONNECTIONS; ++i) {
+        pcbs[i] = open_connection();
+    }
+    err_t err;
+    uint32_t refused = server.refused;
+    CHECK(!lwip_standin_tcp_connect(PORT, &err) && err == ERR_MEM);
+    CHECK(server.refused == refused + 1);
+
+    // The client closing frees a slot
+    tcp_server_connection_t *con = connection_for(pcbs[1]);
+    lwip_standin_tcp_fin(pcbs[1]);
+    CHECK(app.closed == 1 && app.closed_err == ERR_CLSD && pcbs[1]->closed && !con->pcb);
+    lwip_standin_tcp_free(pcbs[1]);
+    pcbs[1] = open_connection();
+    CHECK(connection_for(pcbs[1]) == con && tcp_server_connection_index(con) == 1);
+
+    // Refused from the connected callback
+    lwip_standin_tcp_fin(pcbs[2]);
+    lwip_standin_tcp_free(pcbs[2]);
+    app.close_in_callback = true;
+    pcbs[2] = lwip_standin_tcp_connect(PORT, &err);
+    CHECK(pcbs[2] && pcbs[2]->closed && !connection_for(pcbs[2]));
+    lwip_standin_tcp_free(pcbs[2]);
+    pcbs[2] = open_connection();
+
+    tcp_server_deinit(&server);
+    for (int i = 0; i < TCP_SERVER_MAX_CONNECTIONS; ++i) {
+        CHECK(pcbs[i]->closed);
+        lwip_standin_tcp_free(pcbs[i]);
+    }
+    CHECK(app.closed == 0);
+    CHECK(tcp_server_init(&server, PORT, &callbacks, &app));
+    section_end("connection pool");
+}
+
+static void test_idle(void) {
+    struct tcp_pcb *pcb = open_connection();
+    for (int i = 0; i < TCP_SERVER_IDLE_TIMEOUT_S * 2; ++i) {
+        // Anything from the client counts as activity
+        lwip_standin_tcp_poll(pcb);
+        lwip_standin_tcp_poll(pcb);
+        lwip_standin_tcp_deliver(pcb, "x", 1, TCP_MSS);
+    }
+    CHECK(!pcb->closed && app.closed == 0);
+    CHECK(pcb->pollinterval == 2);
+    for (int i = 0; i <= TCP_SERVER_IDLE_TIMEOUT_S; ++i) {
+        lwip_standin_tcp_poll(pcb);
+    }
+    CHECK(pcb->closed && app.closed == 1 && app.closed_err == ERR_TIMEOUT);
+    lwip_standin_tcp_free(pcb);
+
+    // Closed from the sent callback
+    pcb = open_connection();
+    app.close_in_callback = true;
+    CHECK(tcp_server_send(connection_for(pcb), data, 10) == ERR_OK);
+    lwip_standin_tcp_ack_all(pcb);
+    CHECK(app.sent == 1 && pcb->closed && app.closed == 0 && !connection_for(pcb));
+    lwip_standin_tcp_free(pcb);
+    section_end("closing");
+}
+
+int main() {
+    section_ok = true;
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+    if (!tcp_server_init(&server, PORT, &callbacks, &app)) {
+        printf("failed to start the server\n");
+        return 1;
+    }
+    tcp_server_t other;
+    CHECK(!tcp_server_init(&other, PORT, &callbacks, &app));
+    section_end("init");
+
+    test_send();
+    test_back_pressure();
+    test_recv();
+    test_pool();
+    test_idle();
+
+    tcp_server_deinit(&server);
+    CHECK(lwip_standin_stats.live_pbufs == 0 && lwip_standin_stats.tcp_live_pcbs == 0);
+    section_end("nothing leaked");
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
@@ -7,4 +7,8 @@
 // This example uses a common include to avoid repetition
 #include "lwipopts_examples_common.h"
 
+// The server talks to up to 4 clients at once, and connections it closes
+// wait in TIME_WAIT for a while
+#define MEMP_NUM_TCP_PCB            8
+
 #endif
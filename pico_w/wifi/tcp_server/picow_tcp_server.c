@@ -13,218 +13,195 @@
 #include "lwip/pbuf.h"
 #include "lwip/tcp.h"
 
+#include "tcpserver.h"
+
 #define TCP_PORT 4242
 #define DEBUG_printf printf
+// Messages for every packet slow down a busy server, so are off
+#define TRACE_printf(...)
 #define BUF_SIZE 2048
 #define TEST_ITERATIONS 10
-#define POLL_TIME_S 5
 
-typedef struct TCP_SERVER_T_ {
-    struct tcp_pcb *server_pcb;
-    struct tcp_pcb *client_pcb;
-    bool complete;
+// Print a summary after this many clients have finished
+#define REPORT_EVERY 16
+
+// The test run with each client, in the same slot as its connection
+typedef struct TCP_CLIENT_T_ {
+    // lwIP sends straight from buffer_sent, so it must not change until
+    // the client has acknowledged all of it
     uint8_t buffer_sent[BUF_SIZE];
     uint8_t buffer_recv[BUF_SIZE];
-    int sent_len;
+    bool sent;
     int recv_len;
     int run_count;
+    uint32_t random;
+    absolute_time_t start_time;
+} TCP_CLIENT_T;
+
+typedef struct TCP_SERVER_T_ {
+    tcp_server_t server;
+    bool complete;
+    TCP_CLIENT_T clients[TCP_SERVER_MAX_CONNECTIONS];
+    uint32_t passed;
+    uint32_t failed;
+    uint64_t bytes;
+    absolute_time_t report_time;
 } TCP_SERVER_T;
 
-static TCP_SERVER_T* tcp_server_init(void) {
-    TCP_SERVER_T *state = calloc(1, sizeof(TCP_SERVER_T));
-    if (!state) {
-        DEBUG_printf("failed to allocate state\n");
-        return NULL;
-    }
-    return state;
+static TCP_CLIENT_T *tcp_client(TCP_SERVER_T *state, tcp_server_connection_t *con) {
+    return &state->clients[tcp_server_connection_index(con)];
 }
 
-static err_t tcp_server_close(void *arg) {
-    TCP_SERVER_T *state = (TCP_SERVER_T*)arg;
-    err_t err = ERR_OK;
-    if (state->client_pcb != NULL) {
-        tcp_arg(state->client_pcb, NULL);
-        tcp_poll(state->client_pcb, NULL, 0);
-        tcp_sent(state->client_pcb, NULL);
-        tcp_recv(state->client_pcb, NULL);
-        tcp_err(state->client_pcb, NULL);
-        err = tcp_close(state->client_pcb);
-        if (err != ERR_OK) {
-            DEBUG_printf("close failed %d, calling abort\n", err);
-            tcp_abort(state->client_pcb);
-            err = ERR_ABRT;
-        }
-        state->client_pcb = NULL;
+static void tcp_server_report(TCP_SERVER_T *state) {
+    uint32_t done = state->passed + state->failed;
+    if (done % REPORT_EVERY == 0) {
+        absolute_time_t now = get_absolute_time();
+        int64_t us = absolute_time_diff_us(state->report_time, now);
+        printf("%u clients passed, %u failed, %u refused; %.1f KB/s over the last %d\n",
+               (unsigned int)state->passed, (unsigned int)state->failed, (unsigned int)state->server.refused,
+               us > 0 ? state->bytes * 1000.0 / us : 0.0, REPORT_EVERY);
+        state->bytes = 0;
+        state->report_time = now;
     }
-    if (state->server_pcb) {
-        tcp_arg(state->server_pcb, NULL);
-        tcp_close(state->server_pcb);
-        state->server_pcb = NULL;
-    }
-    return err;
 }
 
-static err_t tcp_server_result(void *arg, int status) {
-    TCP_SERVER_T *state = (TCP_SERVER_T*)arg;
+static void tcp_client_result(TCP_SERVER_T *state, tcp_server_connection_t *con, int status) {
     if (status == 0) {
-        DEBUG_printf("test success\n");
+        DEBUG_printf("client %d: test success, %lld us\n", tcp_server_connection_index(con),
+                     (long long)absolute_time_diff_us(tcp_client(state, con)->start_time, get_absolute_time()));
+        state->passed++;
     } else {
-        DEBUG_printf("test failed %d\n", status);
+        DEBUG_printf("client %d: test failed %d\n", tcp_server_connection_index(con), status);
+        state->failed++;
     }
-    state->complete = true;
-    return tcp_server_close(arg);
+    tcp_server_report(state);
 }
 
-static err_t tcp_server_sent(void *arg, struct tcp_pcb *tpcb, u16_t len) {
-    TCP_SERVER_T *state = (TCP_SERVER_T*)arg;
-    DEBUG_printf("tcp_server_sent %u\n", len);
-    state->sent_len += len;
-
-    if (state->sent_len >= BUF_SIZE) {
-
-        // We should get the data back from the client
-        state->recv_len = 0;
-        DEBUG_printf("Waiting for buffer from client\n");
-    }
-
-    return ERR_OK;
+// Finish with a client, freeing its slot for the next one. Returns ERR_ABRT
+// if the pcb had to be aborted, which callbacks must pass back to lwIP.
+static err_t tcp_client_finish(TCP_SERVER_T *state, tcp_server_connection_t *con, int status) {
+    tcp_client_result(state, con, status);
+    return tcp_server_close(con);
 }
 
-err_t tcp_server_send_data(void *arg, struct tcp_pcb *tpcb)
-{
-    TCP_SERVER_T *state = (TCP_SERVER_T*)arg;
-    for(int i=0; i< BUF_SIZE; i++) {
-        state->buffer_sent[i] = rand();
-    }
+// Fill the buffer a word at a time; the client only echoes it back, so it
+// just needs to be different each time
+static void tcp_client_fill(TCP_CLIENT_T *client) {
+    uint32_t x = client->random;
+    for (int i = 0; i < BUF_SIZE; i += 4) {
+        // xorshift32
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        memcpy(&client->buffer_sent[i], &x, 4);
+    }
+    client->random = x;
+}
 
-    state->sent_len = 0;
-    DEBUG_printf("Writing %ld bytes to client\n", BUF_SIZE);
-    // this method is callback from lwIP, so cyw43_arch_lwip_begin is not required, however you
-    // can use this method to cause an assertion in debug mode, if this method is called when
-    // cyw43_arch_lwip_begin IS needed
-    cyw43_arch_lwip_check();
-    err_t err = tcp_write(tpcb, state->buffer_sent, BUF_SIZE, TCP_WRITE_FLAG_COPY);
+static err_t tcp_client_send_data(TCP_SERVER_T *state, tcp_server_connection_t *con) {
+    TCP_CLIENT_T *client = tcp_client(state, con);
+    tcp_client_fill(client);
+    client->sent = false;
+    client->recv_len = 0;
+    TRACE_printf("Writing %d bytes to client\n", BUF_SIZE);
+    err_t err = tcp_server_send(con, client->buffer_sent, BUF_SIZE);
     if (err != ERR_OK) {
         DEBUG_printf("Failed to write data %d\n", err);
-        return tcp_server_result(arg, -1);
+        return tcp_client_finish(state, con, -1);
     }
     return ERR_OK;
 }
 
-err_t tcp_server_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
-    TCP_SERVER_T *state = (TCP_SERVER_T*)arg;
-    if (!p) {
-        return tcp_server_result(arg, -1);
+// The next buffer can go once the last one is both echoed back and
+// acknowledged, whichever of those lwIP tells us about last
+static err_t tcp_client_check(TCP_SERVER_T *state, tcp_server_connection_t *con) {
+    TCP_CLIENT_T *client = tcp_client(state, con);
+    if (client->recv_len < BUF_SIZE || !client->sent) {
+        return ERR_OK;
     }
-    // this method is callback from lwIP, so cyw43_arch_lwip_begin is not required, however you
-    // can use this method to cause an assertion in debug mode, if this method is called when
-    // cyw43_arch_lwip_begin IS needed
-    cyw43_arch_lwip_check();
-    if (p->tot_len > 0) {
-        DEBUG_printf("tcp_server_recv %d/%d err %d\n", p->tot_len, state->recv_len, err);
-
-        // Receive the buffer
-        const uint16_t buffer_left = BUF_SIZE - state->recv_len;
-        state->recv_len += pbuf_copy_partial(p, state->buffer_recv + state->recv_len,
-                                             p->tot_len > buffer_left ? buffer_left : p->tot_len, 0);
-        tcp_recved(tpcb, p->tot_len);
+    // check it matches
+    if (memcmp(client->buffer_sent, client->buffer_recv, BUF_SIZE) != 0) {
+        DEBUG_printf("buffer mismatch\n");
+        return tcp_client_finish(state, con, -1);
     }
-    pbuf_free(p);
-
-    // Have we have received the whole buffer
-    if (state->recv_len == BUF_SIZE) {
+    TRACE_printf("tcp_server_recv buffer ok\n");
+    state->bytes += 2 * BUF_SIZE;
 
-        // check it matches
-        if (memcmp(state->buffer_sent, state->buffer_recv, BUF_SIZE) != 0) {
-            DEBUG_printf("buffer mismatch\n");
-            return tcp_server_result(arg, -1);
-        }
-        DEBUG_printf("tcp_server_recv buffer ok\n");
-
-        // Test complete?
-        state->run_count++;
-        if (state->run_count >= TEST_ITERATIONS) {
-            tcp_server_result(arg, 0);
-            return ERR_OK;
-        }
-
-        // Send another buffer
-        return tcp_server_send_data(arg, state->client_pcb);
+    // Test complete?
+    client->run_count++;
+    if (client->run_count >= TEST_ITERATIONS) {
+        return tcp_client_finish(state, con, 0);
     }
-    return ERR_OK;
-}
 
-static err_t tcp_server_poll(void *arg, struct tcp_pcb *tpcb) {
-    DEBUG_printf("tcp_server_poll_fn\n");
-    return tcp_server_result(arg, -1); // no response is an error?
+    // Send another buffer
+    return tcp_client_send_data(state, con);
 }
 
-static void tcp_server_err(void *arg, err_t err) {
-    if (err != ERR_ABRT) {
-        DEBUG_printf("tcp_client_err_fn %d\n", err);
-        tcp_server_result(arg, err);
-    }
+static err_t tcp_client_connected(void *arg, tcp_server_connection_t *con) {
+    TCP_SERVER_T *state = (TCP_SERVER_T*)arg;
+    TCP_CLIENT_T *client = tcp_client(state, con);
+    DEBUG_printf("Client %d connected\n", tcp_server_connection_index(con));
+    client->run_count = 0;
+    client->random = (uint32_t)rand() | 1;
+    client->start_time = get_absolute_time();
+    return tcp_client_send_data(state, con);
 }
 
-static err_t tcp_server_accept(void *arg, struct tcp_pcb *client_pcb, err_t err) {
+static err_t tcp_client_sent(void *arg, tcp_server_connection_t *con) {
     TCP_SERVER_T *state = (TCP_SERVER_T*)arg;
-    if (err != ERR_OK || client_pcb == NULL) {
-        DEBUG_printf("Failure in accept\n");
-        tcp_server_result(arg, err);
-        return ERR_VAL;
-    }
-    DEBUG_printf("Client connected\n");
-
-    state->client_pcb = client_pcb;
-    tcp_arg(client_pcb, state);
-    tcp_sent(client_pcb, tcp_server_sent);
-    tcp_recv(client_pcb, tcp_server_recv);
-    tcp_poll(client_pcb, tcp_server_poll, POLL_TIME_S * 2);
-    tcp_err(client_pcb, tcp_server_err);
-
-    return tcp_server_send_data(arg, state->client_pcb);
+    // We should get the data back from the client
+    TRACE_printf("Waiting for buffer from client\n");
+    tcp_client(state, con)->sent = true;
+    return tcp_client_check(state, con);
 }
 
-static bool tcp_server_open(void *arg) {
+static err_t tcp_client_recv(void *arg, tcp_server_connection_t *con, const struct pbuf *p) {
     TCP_SERVER_T *state = (TCP_SERVER_T*)arg;
-    DEBUG_printf("Starting server at %s on port %u\n", ip4addr_ntoa(netif_ip4_addr(netif_list)), TCP_PORT);
-
-    struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY);
-    if (!pcb) {
-        DEBUG_printf("failed to create pcb\n");
-        return false;
-    }
-
-    err_t err = tcp_bind(pcb, NULL, TCP_PORT);
-    if (err) {
-        DEBUG_printf("failed to bind to port %u\n", TCP_PORT);
-        return false;
-    }
-
-    state->server_pcb = tcp_listen_with_backlog(pcb, 1);
-    if (!state->server_pcb) {
-        DEBUG_printf("failed to listen\n");
-        if (pcb) {
-            tcp_close(pcb);
-        }
-        return false;
+    TCP_CLIENT_T *client = tcp_client(state, con);
+    // this method is callback from lwIP, so cyw43_arch_lwip_begin is not required, however you
+    // can use this method to cause an assertion in debug mode, if this method is called when
+    // cyw43_arch_lwip_begin IS needed
+    cyw43_arch_lwip_check();
+    TRACE_printf("tcp_server_recv %d/%d\n", p->tot_len, client->recv_len);
+    if (p->tot_len > BUF_SIZE - client->recv_len) {
+        // The client should only send back what we sent it
+        DEBUG_printf("too much data from client\n");
+        return tcp_client_finish(state, con, -1);
     }
+    // Receive the buffer. The pbufs go straight back to the pool, which
+    // every connection shares, rather than waiting for the whole buffer.
+    client->recv_len += pbuf_copy_partial(p, client->buffer_recv + client->recv_len, p->tot_len, 0);
 
-    tcp_arg(state->server_pcb, state);
-    tcp_accept(state->server_pcb, tcp_server_accept);
+    // Have we have received the whole buffer
+    return tcp_client_check(state, con);
+}
 
-    return true;
+// The client went away, or stopped responding, before the test finished
+static void tcp_client_closed(void *arg, tcp_server_connection_t *con, err_t err) {
+    TCP_SERVER_T *state = (TCP_SERVER_T*)arg;
+    tcp_client_result(state, con, err);
 }
 
+static const tcp_server_callbacks_t tcp_client_callbacks = {
+    .connected = tcp_client_connected,
+    .recv = tcp_client_recv,
+    .sent = tcp_client_sent,
+    .closed = tcp_client_closed,
+};
+
 void run_tcp_server_test(void) {
-    TCP_SERVER_T *state = tcp_server_init();
+    TCP_SERVER_T *state = calloc(1, sizeof(TCP_SERVER_T));
     if (!state) {
+        DEBUG_printf("failed to allocate state\n");
         return;
     }
-    if (!tcp_server_open(state)) {
-        tcp_server_result(state, -1);
+    state->report_time = get_absolute_time();
+    DEBUG_printf("Starting server at %s on port %u\n", ip4addr_ntoa(netif_ip4_addr(netif_list)), TCP_PORT);
+    if (!tcp_server_init(&state->server, TCP_PORT, &tcp_client_callbacks, state)) {
+        free(state);
         return;
     }
+    // Serve clients until something stops the server
     while(!state->complete) {
         // the following #ifdef is only here so this same example can be used in multiple modes;
         // you do not need it in your code
@@ -242,6 +219,7 @@ void run_tcp_server_test(void) {
         sleep_ms(1000);
 #endif
     }
+    tcp_server_deinit(&state->server);
     free(state);
 }
 
@@ -265,4 +243,4 @@ int main() {
     run_tcp_server_test();
     cyw43_arch_deinit();
     return 0;
-}
\ No newline at end of file
+}
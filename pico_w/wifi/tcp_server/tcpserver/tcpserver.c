@@ -0,0 +1,264 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// A TCP server for a fixed number of clients at once. Each client gets a
+// slot in the server's connection array, so accept never allocates, and
+// clients beyond that are refused. Data is sent without being copied:
+// lwIP refers to the application's buffer, and whatever doesn't fit in the
+// send buffer is written from the sent callback as the client acknowledges
+// data. Received pbufs are handed to the application and freed straight
+// away, as the pool they come from is shared by every connection.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tcpserver.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+
+#define DEBUG_printf(...)
+#define ERROR_printf printf
+
+// tcp_poll interval, in lwIP's half second ticks
+#define POLL_INTERVAL 2
+#define POLLS_PER_SECOND 1
+
+static void connection_free(tcp_server_connection_t *con) {
+    con->pcb = NULL;
+    con->tx = NULL;
+    con->tx_len = 0;
+}
+
+static err_t connection_close(tcp_server_connection_t *con) {
+    struct tcp_pcb *pcb = con->pcb;
+    DEBUG_printf("TCP: closing connection %d\n", tcp_server_connection_index(con));
+    tcp_arg(pcb, NULL);
+    tcp_poll(pcb, NULL, 0);
+    tcp_sent(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_err(pcb, NULL);
+    connection_free(con);
+    err_t err = tcp_close(pcb);
+    if (err != ERR_OK) {
+        ERROR_printf("TCP: close failed %d, calling abort\n", err);
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
+}
+
+// Close the connection for a reason the application didn't choose, and tell
+// it. Returns what lwIP needs back from the callback.
+static err_t connection_end(tcp_server_connection_t *con, err_t reason) {
+    tcp_server_t *server = con->server;
+    err_t err = connection_close(con);
+    if (server->callbacks->closed) {
+        server->callbacks->closed(server->arg, con, reason);
+    }
+    return err;
+}
+
+// Only ERR_ABRT means anything to lwIP; anything else would make it offer
+// received data again, which has already been freed
+static err_t callback_result(err_t err) {
+    return err == ERR_ABRT ? ERR_ABRT : ERR_OK;
+}
+
+// Hand as much of the buffer to lwIP as it has room for
+static err_t send_pending(tcp_server_connection_t *con) {
+    while (con->queued_len < con->tx_len) {
+        uint16_t len = tcp_sndbuf(con->pcb);
+        if (len == 0) {
+            break;
+        }
+        if (len > con->tx_len - con->queued_len) {
+            len = con->tx_len - con->queued_len;
+        }
+        // No TCP_WRITE_FLAG_COPY: lwIP refers to the buffer rather than
+        // copying it into the heap
+        err_t err = tcp_write(con->pcb, con->tx + con->queued_len, len,
+                              con->queued_len + len < con->tx_len ? TCP_WRITE_FLAG_MORE : 0);
+        if (err == ERR_MEM) {
+            // Out of segments; try again once some are acknowledged
+            break;
+        }
+        if (err != ERR_OK) {
+            ERROR_printf("TCP: write failed %d\n", err);
+            return err;
+        }
+        con->queued_len += len;
+    }
+    tcp_output(con->pcb);
+    return ERR_OK;
+}
+
+static err_t tcp_server_sent_cb(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    tcp_server_connection_t *con = (tcp_server_connection_t *)arg;
+    tcp_server_t *server = con->server;
+    con->idle_polls = 0;
+    con->acked_len += len;
+    if (con->tx && con->acked_len >= con->tx_len) {
+        con->tx = NULL;
+        if (!server->callbacks->sent) {
+            return ERR_OK;
+        }
+        return callback_result(server->callbacks->sent(server->arg, con));
+    }
+    err_t err = send_pending(con);
+    if (err != ERR_OK) {
+        return connection_end(con, err);
+    }
+    return ERR_OK;
+}
+
+static err_t tcp_server_recv_cb(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    tcp_server_connection_t *con = (tcp_server_connection_t *)arg;
+    tcp_server_t *server = con->server;
+    if (!p) {
+        DEBUG_printf("TCP: client closed\n");
+        return connection_end(con, ERR_CLSD);
+    }
+    con->idle_polls = 0;
+    // Taken as read now, so the window stays open whatever the application
+    // does with it
+    tcp_recved(pcb, p->tot_len);
+    if (err == ERR_OK && server->callbacks->recv) {
+        err = callback_result(server->callbacks->recv(server->arg, con, p));
+    } else {
+        err = ERR_OK;
+    }
+    pbuf_free(p);
+    return err;
+}
+
+static err_t tcp_server_poll_cb(void *arg, struct tcp_pcb *pcb) {
+    tcp_server_connection_t *con = (tcp_server_connection_t *)arg;
+    if (++con->idle_polls > TCP_SERVER_IDLE_TIMEOUT_S * POLLS_PER_SECOND) {
+        DEBUG_printf("TCP: idle timeout\n");
+        return connection_end(con, ERR_TIMEOUT);
+    }
+    // Picks up writes that lwIP had no room for
+    err_t err = send_pending(con);
+    if (err != ERR_OK) {
+        return connection_end(con, err);
+    }
+    return ERR_OK;
+}
+
+static void tcp_server_err_cb(void *arg, err_t err) {
+    tcp_server_connection_t *con = (tcp_server_connection_t *)arg;
+    // Our own aborts happen after tcp_arg is cleared, so this is lwIP giving
+    // up on the connection
+    if (con) {
+        // lwIP has already freed the pcb
+        DEBUG_printf("TCP: connection error %d\n", err);
+        connection_free(con);
+        if (con->server->callbacks->closed) {
+            con->server->callbacks->closed(con->server->arg, con, err);
+        }
+    }
+}
+
+static err_t tcp_server_accept_cb(void *arg, struct tcp_pcb *pcb, err_t err) {
+    tcp_server_t *server = (tcp_server_t *)arg;
+    if (err != ERR_OK || !pcb) {
+        ERROR_printf("TCP: failure in accept\n");
+        return ERR_VAL;
+    }
+    tcp_server_connection_t *con = NULL;
+    for (int i = 0; i < TCP_SERVER_MAX_CONNECTIONS; ++i) {
+        if (!server->connections[i].pcb) {
+            con = &server->connections[i];
+            break;
+        }
+    }
+    if (!con) {
+        // lwIP aborts the connection
+        DEBUG_printf("TCP: too many connections\n");
+        server->refused++;
+        return ERR_MEM;
+    }
+    memset(con, 0, sizeof(*con));
+    con->pcb = pcb;
+    con->server = server;
+
+    tcp_arg(pcb, con);
+    tcp_sent(pcb, tcp_server_sent_cb);
+    tcp_recv(pcb, tcp_server_recv_cb);
+    tcp_poll(pcb, tcp_server_poll_cb, POLL_INTERVAL);
+    tcp_err(pcb, tcp_server_err_cb);
+    if (!server->callbacks->connected) {
+        return ERR_OK;
+    }
+    return callback_result(server->callbacks->connected(server->arg, con));
+}
+
+bool tcp_server_init(tcp_server_t *server, uint16_t port, const tcp_server_callbacks_t *callbacks, void *arg) {
+    memset(server, 0, sizeof(*server));
+    server->callbacks = callbacks;
+    server->arg = arg;
+    for (int i = 0; i < TCP_SERVER_MAX_CONNECTIONS; ++i) {
+        server->connections[i].server = server;
+    }
+
+    struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb) {
+        ERROR_printf("TCP: failed to create pcb\n");
+        return false;
+    }
+    err_t err = tcp_bind(pcb, IP_ANY_TYPE, port);
+    if (err != ERR_OK) {
+        ERROR_printf("TCP: failed to bind to port %u\n", port);
+        tcp_close(pcb);
+        return false;
+    }
+    server->pcb = tcp_listen_with_backlog(pcb, TCP_SERVER_MAX_CONNECTIONS);
+    if (!server->pcb) {
+        ERROR_printf("TCP: failed to listen\n");
+        tcp_close(pcb);
+        return false;
+    }
+    tcp_arg(server->pcb, server);
+    tcp_accept(server->pcb, tcp_server_accept_cb);
+    return true;
+}
+
+err_t tcp_server_send(tcp_server_connection_t *con, const void *data, size_t len) {
+    if (!con->pcb) {
+        return ERR_CONN;
+    }
+    if (con->tx) {
+        return ERR_INPROGRESS;
+    }
+    if (len == 0 || len > UINT32_MAX) {
+        return ERR_ARG;
+    }
+    con->tx = (const uint8_t *)data;
+    con->tx_len = len;
+    con->queued_len = 0;
+    con->acked_len = 0;
+    return send_pending(con);
+}
+
+err_t tcp_server_close(tcp_server_connection_t *con) {
+    if (!con->pcb) {
+        return ERR_OK;
+    }
+    return connection_close(con);
+}
+
+void tcp_server_deinit(tcp_server_t *server) {
+    for (int i = 0; i < TCP_SERVER_MAX_CONNECTIONS; ++i) {
+        if (server->connections[i].pcb) {
+            connection_close(&server->connections[i]);
+        }
+    }
+    if (server->pcb) {
+        tcp_arg(server->pcb, NULL);
+        tcp_close(server->pcb);
+        server->pcb = NULL;
+    }
+}
@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _TCPSERVER_H_
+#define _TCPSERVER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lwip/err.h"
+#include "lwip/pbuf.h"
+
+// Connections served at once; more are refused. Each one takes a TCP pcb, so
+// MEMP_NUM_TCP_PCB needs to allow for them.
+#ifndef TCP_SERVER_MAX_CONNECTIONS
+#define TCP_SERVER_MAX_CONNECTIONS 4
+#endif
+// Connections with nothing received or acknowledged are closed after this long
+#ifndef TCP_SERVER_IDLE_TIMEOUT_S
+#define TCP_SERVER_IDLE_TIMEOUT_S 5
+#endif
+
+typedef struct tcp_server_connection_t_ tcp_server_connection_t;
+
+// What the application does with each connection. They are called from
+// lwIP's callbacks. Those that return err_t return ERR_OK, or ERR_ABRT if
+// tcp_server_close returned it, which is passed back to lwIP.
+typedef struct tcp_server_callbacks_t_ {
+    // A client connected
+    err_t (*connected)(void *arg, tcp_server_connection_t *con);
+    // Data from the client, already passed to tcp_recved. The pbufs go back
+    // to the pool, which every connection shares, when this returns, so copy
+    // out what is needed.
+    err_t (*recv)(void *arg, tcp_server_connection_t *con, const struct pbuf *p);
+    // The client has acknowledged everything given to tcp_server_send, so
+    // the buffer can change
+    err_t (*sent)(void *arg, tcp_server_connection_t *con);
+    // The connection ended other than by tcp_server_close: the client closed
+    // it (ERR_CLSD), it was idle too long (ERR_TIMEOUT), a write failed, or
+    // lwIP gave up on it. The slot is already free.
+    void (*closed)(void *arg, tcp_server_connection_t *con, err_t err);
+} tcp_server_callbacks_t;
+
+struct tcp_server_connection_t_ {
+    struct tcp_pcb *pcb;
+    struct tcp_server_t_ *server;
+    // The buffer from tcp_server_send. lwIP refers to it rather than copying
+    // it, so it must not change until the sent callback.
+    const uint8_t *tx;
+    uint32_t tx_len;
+    // Bytes of it given to lwIP, and acknowledged by the client so far
+    uint32_t queued_len;
+    uint32_t acked_len;
+    uint8_t idle_polls;
+};
+
+typedef struct tcp_server_t_ {
+    struct tcp_pcb *pcb;
+    const tcp_server_callbacks_t *callbacks;
+    void *arg;
+    // Clients refused because every connection was busy
+    uint32_t refused;
+    tcp_server_connection_t connections[TCP_SERVER_MAX_CONNECTIONS];
+} tcp_server_t;
+
+// Start listening on port. The callbacks are not copied. Returns false if
+// the server could not be started.
+bool tcp_server_init(tcp_server_t *server, uint16_t port, const tcp_server_callbacks_t *callbacks, void *arg);
+
+// Send len bytes from data. As much as lwIP has room for is written now,
+// and the rest as the client acknowledges it, so a slow client holds back
+// only its own connection. One buffer at a time: returns ERR_INPROGRESS if
+// the last one hasn't been acknowledged, ERR_ARG if len is 0, or the error
+// if a write failed.
+err_t tcp_server_send(tcp_server_connection_t *con, const void *data, size_t len);
+
+// Close the connection, freeing its slot for the next client. Returns
+// ERR_ABRT if the pcb had to be aborted.
+err_t tcp_server_close(tcp_server_connection_t *con);
+
+void tcp_server_deinit(tcp_server_t *server);
+
+// The connection's slot, for applications that keep state of their own for
+// each one
+static inline int tcp_server_connection_index(const tcp_server_connection_t *con) {
+    return (int)(con - con->server->connections);
+}
+
+#endif
@@ -8,6 +8,12 @@
 #undef TCP_WND
 #define TCP_WND  16384
 
+/* The pbuf pool has to hold a full window, which the low_memory profile's doesn't */
+#if PBUF_POOL_SIZE < 12
+#undef PBUF_POOL_SIZE
+#define PBUF_POOL_SIZE 12
+#endif
+
 #define LWIP_ALTCP               1
 #define LWIP_ALTCP_TLS           1
 #define LWIP_ALTCP_TLS_MBEDTLS   1
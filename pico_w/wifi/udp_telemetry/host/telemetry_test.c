@@ -0,0 +1,201 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the telemetry sender against the access point's stand-in for lwIP:
+//
+// - samples are packed into a datagram until it holds max_samples, which is
+//   then sent with the right seq, count and sample_size in its header
+// - a datagram that isn't full is sent once its first sample is
+//   TELEMETRY_FLUSH_MS old
+// - the datagrams are used over and over, taking off the headers lwIP put
+//   in front of the data, without allocating more
+// - a datagram lwIP still holds when its turn comes round again is replaced,
+//   and counted in replaced
+//
+// Exits with 0 if every check passes.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cyw43_config.h"
+#include "lwip_standin.h"
+#include "telemetry.h"
+
+#define PORT 4445
+#define SAMPLE_SIZE 6
+
+static int failures;
+static bool section_ok;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        section_ok = false; \
+    } \
+} while (0)
+
+static void section_end(const char *name) {
+    printf("%-32s %s\n", name, section_ok ? "ok" : "FAILED");
+    if (!section_ok) {
+        failures++;
+    }
+    section_ok = true;
+}
+
+static telemetry_sender_t sender;
+static ip_addr_t receiver;
+static uint32_t next_sample;
+
+static void add_samples(int n) {
+    for (int i = 0; i < n; i++) {
+        uint8_t sample[SAMPLE_SIZE];
+        for (int j = 0; j < SAMPLE_SIZE; j++) {
+            sample[j] = (uint8_t)(next_sample + j);
+        }
+        next_sample++;
+        telemetry_add(&sender, sample);
+    }
+}
+
+// Check the last datagram sent has the given header, and holds the count
+// samples starting from first
+static void check_sent(uint32_t seq, uint16_t count, uint32_t first) {
+    telemetry_header_t header;
+    CHECK(lwip_standin_sent.len == sizeof(header) + count * SAMPLE_SIZE);
+    CHECK(ip_addr_cmp(&lwip_standin_sent.addr, &receiver) && lwip_standin_sent.port == PORT);
+    memcpy(&header, lwip_standin_sent.data, sizeof(header));
+    CHECK(header.seq == seq && header.count == count && header.sample_size == SAMPLE_SIZE);
+    bool samples_ok = true;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < SAMPLE_SIZE; j++) {
+            if (lwip_standin_sent.data[sizeof(header) + i * SAMPLE_SIZE + j] != (uint8_t)(first + i + j)) {
+                samples_ok = false;
+            }
+        }
+    }
+    CHECK(samples_ok);
+}
+
+static void test_packing(void) {
+    uint16_t max_samples = (TELEMETRY_MAX_PAYLOAD - sizeof(telemetry_header_t)) / SAMPLE_SIZE;
+    CHECK(sender.max_samples == max_samples);
+
+    uint32_t sent = lwip_standin_stats.datagrams_sent;
+    add_samples(max_samples - 1);
+    CHECK(lwip_standin_stats.datagrams_sent == sent);
+    add_samples(1);
+    CHECK(lwip_standin_stats.datagrams_sent == sent + 1);
+    check_sent(0, max_samples, 0);
+
+    add_samples(max_samples);
+    CHECK(lwip_standin_stats.datagrams_sent == sent + 2);
+    check_sent(1, max_samples, max_samples);
+    CHECK(sender.stats.samples == 2u * max_samples && sender.stats.datagrams == 2);
+    section_end("packing to max_samples");
+}
+
+static void test_flush(void) {
+    uint32_t sent = lwip_standin_stats.datagrams_sent;
+    uint32_t first = next_sample;
+    add_samples(3);
+    lwip_standin_advance(TELEMETRY_FLUSH_MS - 1);
+    telemetry_poll(&sender);
+    CHECK(lwip_standin_stats.datagrams_sent == sent);
+    // Samples added since don't hold it back
+    add_samples(2);
+    lwip_standin_advance(1);
+    telemetry_poll(&sender);
+    CHECK(lwip_standin_stats.datagrams_sent == sent + 1);
+    check_sent(sender.seq - 1, 5, first);
+
+    // Nothing to send until there is another sample
+    lwip_standin_advance(TELEMETRY_FLUSH_MS);
+    telemetry_poll(&sender);
+    CHECK(lwip_standin_stats.datagrams_sent == sent + 1);
+    section_end("flush after TELEMETRY_FLUSH_MS");
+}
+
+static void test_reuse(void) {
+    struct pbuf *pbufs[TELEMETRY_NUM_PBUFS];
+    memcpy(pbufs, sender.pbufs, sizeof(pbufs));
+    uint32_t heap_allocs = lwip_standin_stats.heap_allocs;
+    uint32_t header_pbufs = lwip_standin_stats.header_pbufs;
+
+    // Twice round each datagram, with lwIP's headers in front of the data
+    // of each one sent before it is wanted again
+    for (int i = 0; i < 2 * TELEMETRY_NUM_PBUFS; i++) {
+        uint32_t first = next_sample;
+        add_samples(1);
+        int current = sender.current;
+        CHECK(sender.pbufs[current]->payload == sender.data[current]);
+        telemetry_flush(&sender);
+        CHECK(sender.pbufs[current]->payload != sender.data[current]);
+        check_sent(sender.seq - 1, 1, first);
+    }
+    CHECK(!memcmp(pbufs, sender.pbufs, sizeof(pbufs)));
+    CHECK(lwip_standin_stats.heap_allocs == heap_allocs);
+    CHECK(lwip_standin_stats.header_pbufs == header_pbufs);
+    CHECK(sender.stats.replaced == 0);
+    section_end("datagrams reused");
+}
+
+static void test_replaced(void) {
+    uint32_t heap_allocs = lwip_standin_stats.heap_allocs;
+    int32_t live_pbufs = lwip_standin_stats.live_pbufs;
+
+    lwip_standin_udp_hold = true;
+    int held = sender.next;
+    struct pbuf *held_pbuf = sender.pbufs[held];
+    add_samples(1);
+    telemetry_flush(&sender);
+    lwip_standin_udp_hold = false;
+    CHECK(held_pbuf->ref == 2);
+
+    // Round the others and back to the held one, which is replaced
+    for (int i = 0; i < TELEMETRY_NUM_PBUFS; i++) {
+        uint32_t first = next_sample;
+        add_samples(1);
+        telemetry_flush(&sender);
+        check_sent(sender.seq - 1, 1, first);
+    }
+    CHECK(sender.stats.replaced == 1);
+    CHECK(sender.pbufs[held] != held_pbuf);
+    CHECK(lwip_standin_stats.heap_allocs == heap_allocs + 1);
+    CHECK(lwip_standin_stats.live_pbufs == live_pbufs + 1);
+
+    // lwIP frees the old one when it is done with it
+    lwip_standin_udp_release();
+    CHECK(lwip_standin_stats.live_pbufs == live_pbufs);
+    for (int i = 0; i < TELEMETRY_NUM_PBUFS; i++) {
+        add_samples(1);
+        telemetry_flush(&sender);
+    }
+    CHECK(sender.stats.replaced == 1);
+    CHECK(lwip_standin_stats.heap_allocs == heap_allocs + 1);
+    section_end("held datagram replaced");
+}
+
+int main() {
+    section_ok = true;
+    IP4_ADDR(&receiver, 192, 168, 4, 2);
+    lwip_standin_set_time(5000);
+    if (!telemetry_init(&sender, &receiver, PORT, SAMPLE_SIZE)) {
+        printf("failed to start the sender\n");
+        return 1;
+    }
+
+    test_packing();
+    test_flush();
+    test_reuse();
+    test_replaced();
+
+    CHECK(sender.stats.dropped == 0 && sender.stats.send_errors == 0);
+    telemetry_deinit(&sender);
+    CHECK(lwip_standin_stats.live_pbufs == 0);
+    section_end("nothing leaked");
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
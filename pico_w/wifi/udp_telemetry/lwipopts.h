@@ -0,0 +1,17 @@
+#ifndef _LWIPOPTS_H
+#define _LWIPOPTS_H
+
+// Generally you would define your own explicit list of lwIP options
+// (see https://www.nongnu.org/lwip/2_1_x/group__lwip__opts.html)
+//
+// This example uses a common include to avoid repetition
+#include "lwipopts_examples_common.h"
+
+// The telemetry sender keeps TELEMETRY_NUM_PBUFS full size datagrams
+// allocated from the heap
+#if MEM_SIZE < 10000
+#undef MEM_SIZE
+#define MEM_SIZE                    10000
+#endif
+
+#endif
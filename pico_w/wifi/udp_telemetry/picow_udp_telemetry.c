@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "hardware/adc.h"
+
+#include "lwip/ip_addr.h"
+
+#include "telemetry.h"
+
+#define TELEMETRY_PORT 4445
+// Broadcasts go out at the slowest WiFi rate and aren't acknowledged, so for
+// high sample rates give the receiver's address with -DTELEMETRY_SERVER_IP=...
+#ifndef TELEMETRY_SERVER_IP
+#define TELEMETRY_SERVER_IP "255.255.255.255"
+#endif
+#ifndef SAMPLE_RATE_HZ
+#define SAMPLE_RATE_HZ 10000
+#endif
+#define REPORT_INTERVAL_MS 1000
+
+// One reading of the temperature sensor; see telemetry_receiver.py
+typedef struct sample_t_ {
+    uint32_t time_us;
+    uint16_t adc;
+    uint16_t reserved;
+} sample_t;
+
+static void report(const telemetry_stats_t *stats, const telemetry_stats_t *last, uint64_t elapsed_us, uint64_t idle_us) {
+    float seconds = elapsed_us / 1000000.0f;
+    printf("%.0f samples/s in %.0f datagrams/s, cpu %.1f%%, %u dropped, %u send errors, %u replaced\n",
+           (stats->samples - last->samples) / seconds, (stats->datagrams - last->datagrams) / seconds,
+           100.0f * (elapsed_us - idle_us) / elapsed_us, stats->dropped - last->dropped,
+           stats->send_errors - last->send_errors, stats->replaced - last->replaced);
+}
+
+static void run_udp_telemetry(void) {
+    ip_addr_t addr;
+    ipaddr_aton(TELEMETRY_SERVER_IP, &addr);
+
+    static telemetry_sender_t sender;
+    cyw43_arch_lwip_begin();
+    bool ok = telemetry_init(&sender, &addr, TELEMETRY_PORT, sizeof(sample_t));
+    cyw43_arch_lwip_end();
+    if (!ok) {
+        printf("failed to start telemetry\n");
+        return;
+    }
+    printf("Sending %d samples/s to %s port %d\n", SAMPLE_RATE_HZ, TELEMETRY_SERVER_IP, TELEMETRY_PORT);
+
+    adc_init();
+    adc_set_temp_sensor_enabled(true);
+    adc_select_input(4);
+
+    const uint32_t period_us = 1000000 / SAMPLE_RATE_HZ;
+    absolute_time_t next_sample = get_absolute_time();
+    absolute_time_t next_report = make_timeout_time_ms(REPORT_INTERVAL_MS);
+    uint64_t report_start_us = time_us_64();
+    uint64_t idle_us = 0;
+    telemetry_stats_t last = sender.stats;
+    while (true) {
+        if (absolute_time_diff_us(next_sample, get_absolute_time()) >= 0) {
+            sample_t sample = {
+                .time_us = time_us_32(),
+                .adc = adc_read(),
+            };
+            cyw43_arch_lwip_begin();
+            telemetry_add(&sender, &sample);
+            cyw43_arch_lwip_end();
+            next_sample = delayed_by_us(next_sample, period_us);
+        }
+        cyw43_arch_lwip_begin();
+        telemetry_poll(&sender);
+        cyw43_arch_lwip_end();
+
+        if (absolute_time_diff_us(next_report, get_absolute_time()) >= 0) {
+            uint64_t now_us = time_us_64();
+            report(&sender.stats, &last, now_us - report_start_us, idle_us);
+            last = sender.stats;
+            report_start_us = now_us;
+            idle_us = 0;
+            next_report = delayed_by_ms(next_report, REPORT_INTERVAL_MS);
+        }
+
+#if PICO_CYW43_ARCH_POLL
+        // if you are using pico_cyw43_arch_poll, then you must poll periodically from your
+        // main loop (not from a timer) to check for Wi-Fi driver or lwIP work that needs to be done.
+        cyw43_arch_poll();
+#endif
+        // Time spent waiting for the next sample is idle; the rest is taken
+        // by sampling, sending and (when polling) the WiFi driver and lwIP
+        uint64_t wait_start_us = time_us_64();
+#if PICO_CYW43_ARCH_POLL
+        cyw43_arch_wait_for_work_until(next_sample);
+#else
+        // if you are not using pico_cyw43_arch_poll, then WiFI driver and lwIP work
+        // is done via interrupt in the background, and is counted as idle here
+        sleep_until(next_sample);
+#endif
+        idle_us += time_us_64() - wait_start_us;
+    }
+}
+
+int main() {
+    stdio_init_all();
+
+    if (cyw43_arch_init()) {
+        printf("failed to initialise\n");
+        return 1;
+    }
+
+    cyw43_arch_enable_sta_mode();
+
+    printf("Connecting to Wi-Fi...\n");
+    if (cyw43_arch_wifi_connect_timeout_ms(WIFI_SSID, WIFI_PASSWORD, CYW43_AUTH_WPA2_AES_PSK, 30000)) {
+        printf("failed to connect.\n");
+        return 1;
+    } else {
+        printf("Connected.\n");
+    }
+    run_udp_telemetry();
+    cyw43_arch_deinit();
+    return 0;
+}
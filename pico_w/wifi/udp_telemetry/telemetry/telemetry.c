@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+#include "telemetry.h"
+
+#define DEBUG_printf(...)
+
+static bool datagram_alloc(telemetry_sender_t *sender, int i) {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, TELEMETRY_MAX_PAYLOAD, PBUF_RAM);
+    sender->pbufs[i] = p;
+    sender->data[i] = p ? (uint8_t *)p->payload : NULL;
+    return p != NULL;
+}
+
+// Get the next datagram ready to fill
+static bool datagram_start(telemetry_sender_t *sender) {
+    int i = sender->next;
+    struct pbuf *p = sender->pbufs[i];
+    if (p && p->ref > 1) {
+        // lwIP still has it, so leave it to lwIP to free and use a new one
+        pbuf_free(p);
+        sender->pbufs[i] = NULL;
+        sender->stats.replaced++;
+    } else if (p) {
+        // Take off the headers lwIP added in front of the data when it was
+        // last sent
+        pbuf_remove_header(p, sender->data[i] - (uint8_t *)p->payload);
+    }
+    if (!sender->pbufs[i] && !datagram_alloc(sender, i)) {
+        return false;
+    }
+    sender->current = i;
+    sender->count = 0;
+    sender->first_sample_us = time_us_64();
+    return true;
+}
+
+void telemetry_flush(telemetry_sender_t *sender) {
+    if (sender->current < 0) {
+        return;
+    }
+    int i = sender->current;
+    struct pbuf *p = sender->pbufs[i];
+    telemetry_header_t header = {
+        .seq = sender->seq++,
+        .count = sender->count,
+        .sample_size = sender->sample_size,
+    };
+    memcpy(sender->data[i], &header, sizeof(header));
+    // Send only the part that is filled; the allocation stays full size
+    p->len = p->tot_len = sizeof(header) + sender->count * sender->sample_size;
+    err_t err = udp_sendto(sender->pcb, p, &sender->addr, sender->port);
+    if (err == ERR_OK) {
+        sender->stats.datagrams++;
+    } else {
+        DEBUG_printf("failed to send telemetry %d\n", err);
+        sender->stats.send_errors++;
+    }
+    sender->current = -1;
+    sender->next = (i + 1) % TELEMETRY_NUM_PBUFS;
+}
+
+void telemetry_add(telemetry_sender_t *sender, const void *sample) {
+    if (sender->current < 0 && !datagram_start(sender)) {
+        sender->stats.dropped++;
+        return;
+    }
+    uint8_t *data = sender->data[sender->current] + sizeof(telemetry_header_t);
+    memcpy(data + sender->count * sender->sample_size, sample, sender->sample_size);
+    sender->stats.samples++;
+    if (++sender->count == sender->max_samples) {
+        telemetry_flush(sender);
+    }
+}
+
+void telemetry_poll(telemetry_sender_t *sender) {
+    if (sender->current >= 0 && time_us_64() - sender->first_sample_us >= TELEMETRY_FLUSH_MS * 1000ull) {
+        telemetry_flush(sender);
+    }
+}
+
+bool telemetry_init(telemetry_sender_t *sender, const ip_addr_t *addr, uint16_t port, uint16_t sample_size) {
+    memset(sender, 0, sizeof(*sender));
+    if (!sample_size || sample_size > TELEMETRY_MAX_PAYLOAD - sizeof(telemetry_header_t)) {
+        return false;
+    }
+    ip_addr_copy(sender->addr, *addr);
+    sender->port = port;
+    sender->sample_size = sample_size;
+    sender->max_samples = (TELEMETRY_MAX_PAYLOAD - sizeof(telemetry_header_t)) / sample_size;
+    sender->current = -1;
+    sender->pcb = udp_new_ip_type(IP_GET_TYPE(addr));
+    if (!sender->pcb) {
+        return false;
+    }
+    for (int i = 0; i < TELEMETRY_NUM_PBUFS; i++) {
+        if (!datagram_alloc(sender, i)) {
+            telemetry_deinit(sender);
+            return false;
+        }
+    }
+    return true;
+}
+
+void telemetry_deinit(telemetry_sender_t *sender) {
+    for (int i = 0; i < TELEMETRY_NUM_PBUFS; i++) {
+        if (sender->pbufs[i]) {
+            pbuf_free(sender->pbufs[i]);
+            sender->pbufs[i] = NULL;
+        }
+    }
+    if (sender->pcb) {
+        udp_remove(sender->pcb);
+        sender->pcb = NULL;
+    }
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lwip/ip_addr.h"
+
+// Largest datagram that fits in one Ethernet frame without fragmenting:
+// 1500 bytes less the IP and UDP headers
+#ifndef TELEMETRY_MAX_PAYLOAD
+#define TELEMETRY_MAX_PAYLOAD 1472
+#endif
+// Datagrams allocated up front and used over and over. Each one lwIP still
+// holds (e.g. queued waiting for ARP) when its turn comes round again is
+// replaced with a new one.
+#ifndef TELEMETRY_NUM_PBUFS
+#define TELEMETRY_NUM_PBUFS 4
+#endif
+// A datagram is sent when it is full, or when its first sample is this old
+#ifndef TELEMETRY_FLUSH_MS
+#define TELEMETRY_FLUSH_MS 20
+#endif
+
+// At the start of every datagram, in little endian order, followed by count
+// samples of sample_size bytes each. The receiver spots lost datagrams from
+// gaps in seq.
+typedef struct __attribute__((packed)) telemetry_header_t_ {
+    uint32_t seq;
+    uint16_t count;
+    uint16_t sample_size;
+} telemetry_header_t;
+
+typedef struct telemetry_stats_t_ {
+    uint32_t samples;
+    uint32_t datagrams;
+    // Samples thrown away because no datagram could be had to put them in
+    uint32_t dropped;
+    uint32_t send_errors;
+    // Datagrams lwIP was still holding when they were wanted again
+    uint32_t replaced;
+} telemetry_stats_t;
+
+typedef struct telemetry_sender_t_ {
+    struct udp_pcb *pcb;
+    ip_addr_t addr;
+    uint16_t port;
+    uint16_t sample_size;
+    uint16_t max_samples;
+    struct pbuf *pbufs[TELEMETRY_NUM_PBUFS];
+    // Where each datagram's header goes; lwIP moves the payload to add its own
+    uint8_t *data[TELEMETRY_NUM_PBUFS];
+    // The datagram being filled, or -1, and how many samples it has so far
+    int current;
+    int next;
+    uint16_t count;
+    uint32_t seq;
+    uint64_t first_sample_us;
+    telemetry_stats_t stats;
+} telemetry_sender_t;
+
+// Start sending samples of sample_size bytes to addr:port. Returns false if
+// the datagrams couldn't be allocated.
+bool telemetry_init(telemetry_sender_t *sender, const ip_addr_t *addr, uint16_t port, uint16_t sample_size);
+
+// Add a sample, sending the datagram it goes in if that is now full
+void telemetry_add(telemetry_sender_t *sender, const void *sample);
+
+// Send the datagram being filled if its first sample has waited
+// TELEMETRY_FLUSH_MS; call this regularly
+void telemetry_poll(telemetry_sender_t *sender);
+
+// Send the datagram being filled, however full it is
+void telemetry_flush(telemetry_sender_t *sender);
+
+void telemetry_deinit(telemetry_sender_t *sender);
+
+#endif
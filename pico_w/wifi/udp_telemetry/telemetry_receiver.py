@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+
+# Receives the datagrams picow_udp_telemetry sends.
+#
+# usage: python3 telemetry_receiver.py [--port 4445] [--seconds N] [--verbose]
+#
+# Every second it prints the datagrams and samples received, datagrams lost
+# (from gaps in their sequence numbers) and how late the oldest sample in a
+# datagram arrives compared to the newest, which is the delay from batching.
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+# These should match telemetry.h and picow_udp_telemetry.c
+HEADER = struct.Struct("<IHH")
+SAMPLE = struct.Struct("<IHH")
+
+
+class Receiver:
+    def __init__(self):
+        self.next_seq = None
+        self.datagrams = 0
+        self.samples = 0
+        self.lost = 0
+        self.bad = 0
+        self.batch_us = []
+
+    def receive(self, data, verbose):
+        if len(data) < HEADER.size:
+            self.bad += 1
+            return
+        seq, count, sample_size = HEADER.unpack_from(data)
+        if sample_size != SAMPLE.size or len(data) != HEADER.size + count * sample_size:
+            self.bad += 1
+            return
+        if self.next_seq is None or seq >= self.next_seq:
+            if self.next_seq is not None:
+                self.lost += seq - self.next_seq
+            self.next_seq = seq + 1
+        elif self.lost:
+            # Late rather than lost
+            self.lost -= 1
+        self.datagrams += 1
+        self.samples += count
+        if count:
+            first, _, _ = SAMPLE.unpack_from(data, HEADER.size)
+            last, adc, _ = SAMPLE.unpack_from(data, HEADER.size + (count - 1) * sample_size)
+            self.batch_us.append((last - first) & 0xffffffff)
+            if verbose:
+                # Temperature from the RP2040 datasheet, with a 3.3V reference
+                volts = adc * 3.3 / 4096
+                print("datagram %d: %d samples, last %.1f C" % (seq, count, 27 - (volts - 0.706) / 0.001721))
+
+    def report(self, seconds):
+        batch = sorted(self.batch_us)
+        print("%.0f datagrams/s, %.0f samples/s, %d lost, %d bad, batches span %.1f ms median %.1f ms max" % (
+            self.datagrams / seconds, self.samples / seconds, self.lost, self.bad,
+            batch[len(batch) // 2] / 1000 if batch else 0, batch[-1] / 1000 if batch else 0))
+        self.datagrams = self.samples = self.lost = self.bad = 0
+        self.batch_us = []
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Receiver for picow_udp_telemetry")
+    parser.add_argument("--port", type=int, default=4445, help="UDP port to listen on")
+    parser.add_argument("--seconds", type=float, help="stop after this long")
+    parser.add_argument("--verbose", action="store_true", help="print every datagram")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+    sock.bind(("", args.port))
+    sock.settimeout(0.1)
+    receiver = Receiver()
+    start = report_start = time.monotonic()
+    total = 0
+    while args.seconds is None or time.monotonic() - start < args.seconds:
+        try:
+            data = sock.recv(65536)
+            receiver.receive(data, args.verbose)
+            total += 1
+        except socket.timeout:
+            pass
+        now = time.monotonic()
+        if now - report_start >= 1:
+            receiver.report(now - report_start)
+            report_start = now
+    sys.exit(0 if total else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "trace.h"
+
+// The dump format, all little-endian:
+//
+//   "PTRACE01"
+//   u32 name count, then for each name: u32 address, u16 length, characters
+//   for each core: u32 event count, then that many trace_event_t, oldest
+//   first
+//   "PTRACEND"
+//
+// It may be surrounded by ordinary stdout text.
+
+#define MAX_NAMES 64
+
+trace_buffer_t trace_buffers[2];
+volatile bool trace_paused;
+
+static void put_bytes(const void *data, size_t len) {
+    const uint8_t *p = data;
+    // putchar_raw, so nothing gets CRLF translated
+    while (len--)
+        putchar_raw(*p++);
+}
+
+static void put_u32(uint32_t value) {
+    put_bytes(&value, sizeof(value));
+}
+
+static uint32_t events_held(const trace_buffer_t *buf) {
+    return buf->count < TRACE_BUFFER_SIZE ? buf->count : TRACE_BUFFER_SIZE;
+}
+
+void trace_dump(void) {
+    trace_paused = true;
+    // Let an event being recorded on the other core finish; it checks the
+    // flag with interrupts disabled, so this only has to cover a few
+    // instructions (and maybe a flash cache miss)
+    busy_wait_us(10);
+
+    const char *names[MAX_NAMES];
+    uint name_count = 0;
+    for (uint core = 0; core < 2; core++) {
+        const trace_buffer_t *buf = &trace_buffers[core];
+        for (uint32_t i = 0; i < events_held(buf); i++) {
+            const char *name = (const char *)(uintptr_t)(buf->events[i].name_phase & ~3u);
+            uint n;
+            for (n = 0; n < name_count && names[n] != name; n++)
+                ;
+            if (n == name_count && name_count < MAX_NAMES)
+                names[name_count++] = name;
+        }
+    }
+
+    put_bytes("PTRACE01", 8);
+    put_u32(name_count);
+    for (uint n = 0; n < name_count; n++) {
+        uint16_t len = strlen(names[n]);
+        put_u32((uintptr_t)names[n]);
+        put_bytes(&len, sizeof(len));
+        put_bytes(names[n], len);
+    }
+    for (uint core = 0; core < 2; core++) {
+        trace_buffer_t *buf = &trace_buffers[core];
+        uint32_t held = events_held(buf);
+        put_u32(held);
+        for (uint32_t i = buf->count - held; i != buf->count; i++)
+            put_bytes(&buf->events[i & (TRACE_BUFFER_SIZE - 1)], sizeof(trace_event_t));
+        buf->count = 0;
+    }
+    put_bytes("PTRACEND", 8);
+    stdio_flush();
+
+    trace_paused = false;
+}
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2023 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "pico/stdlib.h"
+#include "hardware/structs/timer.h"
+#include "hardware/sync.h"
+
+// A tiny event tracer for seeing what each core is doing, and when.
+//
+// Each core records events into its own ring buffer, so the cores never
+// contend, and the oldest events are overwritten when a buffer is full.
+// An event is three words: the 1MHz system timer (which both cores share, so
+// their events line up), the event's name and phase, and an argument.
+// Recording one takes a handful of instructions with interrupts disabled.
+//
+// Event names are string constants declared with TRACE_NAME(); the address
+// of the string identifies the event, so there's nothing to register.
+// trace_dump() writes both buffers, and the names used in them, to stdout in
+// binary, and trace_to_json.py turns a capture of that into Chrome's trace
+// event JSON for chrome://tracing or https://ui.perfetto.dev
+//
+// Define TRACE_ENABLED to 0 to compile the tracing out.
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+// Events per core; must be a power of two
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 512
+#endif
+
+#if TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)
+#error TRACE_BUFFER_SIZE must be a power of two
+#endif
+
+// Phases, kept in the bottom two bits of the name's address
+#define TRACE_PHASE_INSTANT 0
+#define TRACE_PHASE_BEGIN 1
+#define TRACE_PHASE_END 2
+#define TRACE_PHASE_COUNTER 3
+
+// Declare an event name; word alignment leaves room for the phase
+#define TRACE_NAME(var, str) static const char var[] __aligned(4) = str
+
+typedef struct {
+    uint32_t timestamp_us;
+    uint32_t name_phase;
+    uint32_t arg;
+} trace_event_t;
+
+typedef struct {
+    trace_event_t events[TRACE_BUFFER_SIZE];
+    // Total events recorded, wrapping into the ring
+    uint32_t count;
+} trace_buffer_t;
+
+extern trace_buffer_t trace_buffers[2];
+extern volatile bool trace_paused;
+
+static inline void trace_record(const char *name, uint phase, uint32_t arg) {
+#if TRACE_ENABLED
+    trace_buffer_t *buf = &trace_buffers[get_core_num()];
+    // Interrupts on this core may record events too
+    uint32_t save = save_and_disable_interrupts();
+    if (trace_paused) {
+        restore_interrupts(save);
+        return;
+    }
+    trace_event_t *event = &buf->events[buf->count++ & (TRACE_BUFFER_SIZE - 1)];
+    event->timestamp_us = timer_hw->timerawl;
+    event->name_phase = (uintptr_t)name | phase;
+    event->arg = arg;
+    restore_interrupts(save);
+#endif
+}
+
+// Something that takes time starts or ends. Begins and ends must nest on
+// each core.
+static inline void trace_begin(const char *name, uint32_t arg) {
+    trace_record(name, TRACE_PHASE_BEGIN, arg);
+}
+
+static inline void trace_end(const char *name, uint32_t arg) {
+    trace_record(name, TRACE_PHASE_END, arg);
+}
+
+// Something happened
+static inline void trace_instant(const char *name, uint32_t arg) {
+    trace_record(name, TRACE_PHASE_INSTANT, arg);
+}
+
+// A value changed, shown as a graph
+static inline void trace_counter(const char *name, uint32_t value) {
+    trace_record(name, TRACE_PHASE_COUNTER, value);
+}
+
+// Write both cores' events to stdout in binary, then empty the buffers.
+// Recording is paused while this runs.
+void trace_dump(void);
+
+#endif
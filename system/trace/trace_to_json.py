@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+
+# Converts a trace_dump() capture into Chrome trace event JSON.
+#
+# usage: python3 trace_to_json.py capture.bin > trace.json
+#
+# Capture the device's stdout to a file without any translation, e.g. with
+# "cat /dev/ttyACM0 > capture.bin" or a terminal program's binary logging.
+# Other output around the dump is ignored, and if the capture holds several
+# dumps they are all converted, one after the other. Open the JSON in
+# chrome://tracing or https://ui.perfetto.dev
+
+import json
+import struct
+import sys
+
+START_MAGIC = b"PTRACE01"
+END_MAGIC = b"PTRACEND"
+EVENT_SIZE = 12
+PHASES = ["i", "B", "E", "C"]
+
+
+def parse_dump(data, pos):
+    """Parse the dump starting after its magic at `pos`, returning (names, events per core, end)."""
+    (name_count,) = struct.unpack_from("<I", data, pos)
+    pos += 4
+    names = {}
+    for _ in range(name_count):
+        address, length = struct.unpack_from("<IH", data, pos)
+        pos += 6
+        names[address] = data[pos:pos + length].decode("ascii", "replace")
+        pos += length
+    cores = []
+    for _ in range(2):
+        (count,) = struct.unpack_from("<I", data, pos)
+        pos += 4
+        cores.append([struct.unpack_from("<III", data, pos + i * EVENT_SIZE) for i in range(count)])
+        pos += count * EVENT_SIZE
+    if data[pos:pos + len(END_MAGIC)] != END_MAGIC:
+        raise ValueError("dump is truncated or corrupt")
+    return names, cores, pos + len(END_MAGIC)
+
+
+def find_dumps(data):
+    dumps = []
+    pos = data.find(START_MAGIC)
+    while pos >= 0:
+        try:
+            names, cores, end = parse_dump(data, pos + len(START_MAGIC))
+            dumps.append((names, cores))
+        except (ValueError, struct.error) as e:
+            print(f"Skipping dump at offset {pos}: {e}", file=sys.stderr)
+            end = pos + len(START_MAGIC)
+        pos = data.find(START_MAGIC, end)
+    return dumps
+
+
+def unwrap(timestamp, base):
+    """Microseconds since `base`, allowing for the 32-bit timer wrapping."""
+    return (timestamp - base) & 0xffffffff
+
+
+def convert(dumps):
+    trace_events = []
+    for core in range(2):
+        trace_events.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": core,
+                             "args": {"name": f"core {core}"}})
+    offset = 0
+    for names, cores in dumps:
+        firsts = [events[0][0] for events in cores if events]
+        if not firsts:
+            continue
+        # The events may straddle the timer wrapping, so start from the
+        # oldest event of either core rather than the smallest value
+        base = firsts[0]
+        for first in firsts[1:]:
+            if unwrap(base, first) < 0x80000000:
+                base = first
+        last = 0
+        for core, events in enumerate(cores):
+            for timestamp, name_phase, arg in events:
+                ts = offset + unwrap(timestamp, base)
+                last = max(last, ts)
+                name = names.get(name_phase & ~3, f"0x{name_phase & ~3:08x}")
+                phase = PHASES[name_phase & 3]
+                event = {"name": name, "ph": phase, "ts": ts, "pid": 0, "tid": core}
+                if phase == "C":
+                    event["args"] = {name: arg}
+                else:
+                    event["args"] = {"arg": arg}
+                    if phase == "i":
+                        event["s"] = "t"
+                trace_events.append(event)
+        # Lay later dumps out after earlier ones
+        offset = last + 1000
+    return {"traceEvents": trace_events}
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(f"usage: {sys.argv[0]} capture.bin > trace.json")
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+    dumps = find_dumps(data)
+    if not dumps:
+        sys.exit("No trace dump found")
+    json.dump(convert(dumps), sys.stdout, indent=1)
+
+
+if __name__ == "__main__":
+    main()